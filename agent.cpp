@@ -0,0 +1,337 @@
+#ifdef _WIN32
+#include <winsock2.h> // Must come before windows.h
+#include <ws2tcpip.h>
+#include <afunix.h>   // AF_UNIX sockets, Windows 10 1803 and later
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+#include <chrono>
+#include <cstring>
+#include "agent.hpp"
+#include "snapshot_metrics.hpp"
+
+#ifdef _WIN32
+typedef SOCKET native_socket;
+#define SOCKET_TYPE_FLAGS 0
+#define SOCKET_WOULD_BLOCK() (WSAGetLastError() == WSAEWOULDBLOCK)
+#define SOCKET_IN_PROGRESS() (WSAGetLastError() == WSAEWOULDBLOCK)
+#define SEND_FLAGS 0
+#else
+typedef int native_socket;
+#define SOCKET_TYPE_FLAGS SOCK_CLOEXEC // Not inherited by nvidia-smi or alert hooks
+#define SOCKET_WOULD_BLOCK() (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+#define SOCKET_IN_PROGRESS() (errno == EINPROGRESS)
+#define SEND_FLAGS MSG_NOSIGNAL // A dead aggregator must not kill the agent with SIGPIPE
+#endif
+
+#define RECONNECT_MIN_MS 1000
+#define RECONNECT_MAX_MS 30000
+
+static unsigned long long nowMs() {
+    return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+static void closeNative(native_socket s) {
+#ifdef _WIN32
+    closesocket(s);
+#else
+    close(s);
+#endif
+}
+
+static bool setNonBlocking(native_socket s) {
+#ifdef _WIN32
+    u_long mode = 1;
+    return ioctlsocket(s, FIONBIO, &mode) == 0;
+#else
+    int flags = fcntl(s, F_GETFL, 0);
+    return flags != -1 && fcntl(s, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+std::string localHostName() {
+#ifdef _WIN32
+    char name[MAX_COMPUTERNAME_LENGTH + 1];
+    DWORD size = sizeof(name);
+    if (GetComputerNameA(name, &size)) return std::string(name, size);
+#else
+    char name[256];
+    if (gethostname(name, sizeof(name)) == 0) {
+        name[sizeof(name) - 1] = '\0';
+        return name;
+    }
+#endif
+    return "unknown";
+}
+
+struct AgentSender::ResolvedEndpoint {
+    int family;
+    int socktype;
+    int protocol;
+    sockaddr_storage address;
+    socklen_t length;
+};
+
+// Resolves a "host:port" endpoint (port 9400 when there is none), null when it does not resolve.
+// Runs on a helper thread, getaddrinfo() can block for as long as the resolver's timeouts.
+static std::shared_ptr<AgentSender::ResolvedEndpoint> resolveEndpoint(const std::string& endpoint) {
+    // Split at the last colon
+    size_t colon = endpoint.rfind(':');
+    std::string host = colon == std::string::npos ? endpoint : endpoint.substr(0, colon);
+    std::string port = colon == std::string::npos ? "9400" : endpoint.substr(colon + 1);
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res = nullptr;
+    std::shared_ptr<AgentSender::ResolvedEndpoint> resolved;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res) == 0 && res &&
+        res->ai_addrlen <= sizeof(sockaddr_storage)) {
+        resolved = std::make_shared<AgentSender::ResolvedEndpoint>();
+        resolved->family = res->ai_family;
+        resolved->socktype = res->ai_socktype;
+        resolved->protocol = res->ai_protocol;
+        std::memcpy(&resolved->address, res->ai_addr, res->ai_addrlen);
+        resolved->length = static_cast<socklen_t>(res->ai_addrlen);
+    }
+    if (res) freeaddrinfo(res);
+    return resolved;
+}
+
+AgentSender::AgentSender(const std::string& endpoint, size_t maxQueuedBytes, unsigned int batchFrames,
+                         const std::string& hostName)
+    : endpoint_(endpoint),
+      hostName_(hostName.empty() ? localHostName() : hostName),
+      maxQueuedBytes_(maxQueuedBytes),
+      batchFrames_(batchFrames ? batchFrames : 1) {
+#ifdef _WIN32
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+}
+
+AgentSender::~AgentSender() {
+    closeSocket();
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+void AgentSender::closeSocket() {
+    if (sock_ != -1) {
+        closeNative(static_cast<native_socket>(sock_));
+        sock_ = -1;
+        resolved_.reset(); // Resolved again for the next connection
+    }
+    connecting_ = false;
+    samplesDropped_ += batchCount_ + outSamples_;
+    sketchesDropped_ += batchSketches_ + outSketches_;
+    batch_.clear();
+    batchCount_ = 0;
+    batchSketches_ = 0;
+    out_.clear();
+    outOffset_ = 0;
+    outSamples_ = 0;
+    outSketches_ = 0;
+}
+
+// Starts a non-blocking connect, schedules a retry with backoff if it fails right away
+void AgentSender::startConnect() {
+    native_socket s;
+    int rc;
+    if (endpoint_.compare(0, 5, "unix:") == 0) {
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        std::string path = endpoint_.substr(5);
+        if (path.size() >= sizeof(addr.sun_path)) {
+            retryAtMs_ = nowMs() + RECONNECT_MAX_MS;
+            return;
+        }
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        s = socket(AF_UNIX, SOCK_STREAM | SOCKET_TYPE_FLAGS, 0);
+        if (s == static_cast<native_socket>(-1) || !setNonBlocking(s)) {
+            if (s != static_cast<native_socket>(-1)) closeNative(s);
+            s = static_cast<native_socket>(-1);
+            rc = -1;
+        } else {
+            rc = connect(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        }
+    } else {
+        if (!resolved_) {
+            // The lookup runs on a helper thread; until it is done every pump() just checks on it
+            if (!resolving_.valid()) {
+                resolving_ = std::async(std::launch::async, resolveEndpoint, endpoint_);
+            }
+            if (resolving_.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                return;
+            }
+            resolved_ = resolving_.get();
+        }
+        s = static_cast<native_socket>(-1);
+        rc = -1;
+        if (resolved_) {
+            s = socket(resolved_->family, resolved_->socktype | SOCKET_TYPE_FLAGS, resolved_->protocol);
+            if (s != static_cast<native_socket>(-1) && setNonBlocking(s)) {
+                rc = connect(s, reinterpret_cast<const sockaddr*>(&resolved_->address), static_cast<int>(resolved_->length));
+            }
+        }
+    }
+
+    if (s == static_cast<native_socket>(-1) || (rc != 0 && !SOCKET_IN_PROGRESS())) {
+        if (s != static_cast<native_socket>(-1)) closeNative(s);
+        resolved_.reset(); // The name may point elsewhere by the next attempt
+        backoffMs_ = backoffMs_ ? (backoffMs_ * 2 < RECONNECT_MAX_MS ? backoffMs_ * 2 : RECONNECT_MAX_MS)
+                                : RECONNECT_MIN_MS;
+        retryAtMs_ = nowMs() + backoffMs_;
+        return;
+    }
+
+    sock_ = static_cast<std::intptr_t>(s);
+    connecting_ = rc != 0;
+    if (!connecting_) finishConnect();
+}
+
+// Checks whether a pending connect completed, and greets the aggregator once it has
+void AgentSender::finishConnect() {
+    native_socket s = static_cast<native_socket>(sock_);
+    if (connecting_) {
+#ifdef _WIN32
+        WSAPOLLFD pfd = {s, POLLOUT, 0};
+        if (WSAPoll(&pfd, 1, 0) <= 0) return;
+#else
+        pollfd pfd = {s, POLLOUT, 0};
+        if (poll(&pfd, 1, 0) <= 0) return;
+#endif
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(s, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&err), &len);
+        if (err != 0) {
+            closeSocket();
+            backoffMs_ = backoffMs_ ? (backoffMs_ * 2 < RECONNECT_MAX_MS ? backoffMs_ * 2 : RECONNECT_MAX_MS)
+                                    : RECONNECT_MIN_MS;
+            retryAtMs_ = nowMs() + backoffMs_;
+            return;
+        }
+        connecting_ = false;
+    }
+    backoffMs_ = 0;
+    // A fresh stream starts with HELLO, which also makes the next sample a keyframe
+    encoder_.encodeHello(hostName_, out_);
+}
+
+void AgentSender::flushOut() {
+    native_socket s = static_cast<native_socket>(sock_);
+    while (outOffset_ < out_.size()) {
+        int n = send(s, out_.data() + outOffset_, static_cast<int>(out_.size() - outOffset_), SEND_FLAGS);
+        if (n > 0) {
+            outOffset_ += static_cast<size_t>(n);
+            bytesSent_ += static_cast<unsigned long long>(n);
+            continue;
+        }
+        if (n < 0 && SOCKET_WOULD_BLOCK()) return; // Backpressure: try again next tick
+        closeSocket();
+        retryAtMs_ = nowMs() + RECONNECT_MIN_MS;
+        return;
+    }
+    out_.clear();
+    outOffset_ = 0;
+    samplesSent_ += outSamples_;
+    outSamples_ = 0;
+    sketchesSent_ += outSketches_;
+    outSketches_ = 0;
+}
+
+void AgentSender::pump() {
+    if (sock_ == -1) {
+        if (nowMs() < retryAtMs_) return;
+        startConnect();
+        if (sock_ == -1) return;
+    }
+    if (connecting_) {
+        finishConnect();
+        if (sock_ == -1 || connecting_) return;
+    }
+    flushOut();
+}
+
+// Appends the sketches of the window that just closed to the batch, the metrics not collected left out.
+// A sketch that does not fit in a frame (values spread over more than some 400 bins per sign) is
+// sent with half as many bins until it does, the lowest ones folded together: its quantiles near
+// zero get coarser, the rest stay within SKETCH_RELATIVE_ACCURACY. Only one that would not fit
+// even with a single bin is dropped, and counted.
+void AgentSender::encodeClosedSketches() {
+    WireSketch sketch;
+    sketch.startMs = sketches_.closedStartMs();
+    sketch.windowMs = sketches_.windowMs();
+    for (size_t i = 0; i < SNAPSHOT_METRIC_COUNT; ++i) {
+        const QuantileSketch& closed = sketches_.closed()[i];
+        if (closed.empty()) continue;
+        sketch.metric = snapshotMetric(i).name;
+        sketch.data.clear();
+        closed.encode(sketch.data);
+        bool queued = encoder_.encodeSketch(sketch, batch_);
+        if (!queued) {
+            QuantileSketch narrowed = closed;
+            for (size_t bins = SKETCH_MAX_BINS / 2; !queued && bins > 0; bins /= 2) {
+                narrowed.collapseTo(bins);
+                sketch.data.clear();
+                narrowed.encode(sketch.data);
+                queued = encoder_.encodeSketch(sketch, batch_);
+            }
+            if (queued) sketchesNarrowed_++;
+        }
+        if (queued) {
+            batchSketches_++;
+        } else {
+            sketchesDropped_++;
+        }
+    }
+}
+
+void AgentSender::submit(const StatsSnapshot& snap) {
+    // Sketches see every snapshot, connected or not; only the sending needs a connection
+    bool windowClosed = sketches_.add(snap);
+    if (!connected()) {
+        samplesDropped_++;
+        pump();
+        return;
+    }
+
+    encoder_.encodeSample(snap, batch_);
+    batchCount_++;
+    if (windowClosed) {
+        encodeClosedSketches();
+    }
+
+    if (batchCount_ >= batchFrames_) {
+        size_t backlog = out_.size() - outOffset_;
+        if (backlog == 0) {
+            out_.swap(batch_);
+            outOffset_ = 0;
+            outSamples_ = batchCount_;
+            outSketches_ = batchSketches_;
+        } else if (backlog + batch_.size() <= maxQueuedBytes_) {
+            out_.append(batch_);
+            outSamples_ += batchCount_;
+            outSketches_ += batchSketches_;
+        } else {
+            // The aggregator is not keeping up: shed this batch rather than buffer without bound.
+            // The decoder never sees these deltas, so restart the chain with a keyframe.
+            samplesDropped_ += batchCount_;
+            sketchesDropped_ += batchSketches_;
+            encoder_.forceKeyframe();
+        }
+        batch_.clear();
+        batchCount_ = 0;
+        batchSketches_ = 0;
+    }
+    pump();
+}
@@ -0,0 +1,98 @@
+#ifndef STATS_AGENT_HPP
+#define STATS_AGENT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include "quantile_sketch.hpp"
+#include "snapshot.hpp"
+#include "wire_format.hpp"
+
+/**
+ * Agent mode: pushes every snapshot to an aggregator instead of (or as well as) drawing it.
+ *
+ * Endpoints are "host:port" for TCP or "unix:/path/to/socket" for a Unix domain socket.
+ * Frames are batched (batchFrames samples per write) and the socket is non-blocking, so a
+ * slow or dead aggregator never stalls the sampling loop. If the unsent backlog would grow
+ * past maxQueuedBytes the newest batch is dropped and the next sample goes out as a keyframe.
+ * Lost connections are retried with exponential backoff; samples taken while disconnected
+ * are dropped, since only live data is of interest to the aggregator.
+ * Host names are resolved on a helper thread, never in submit(): a slow or unreachable DNS
+ * server only delays the connection, not the sampling. The address is kept while it works
+ * and resolved again after the connection to it fails or is lost.
+ * Every snapshot also goes into per-metric quantile sketches (see quantile_sketch.hpp), and
+ * each time a rollup window closes its sketches follow in the next batch as SKETCH frames,
+ * so the aggregator can answer percentiles over any span of windows without raw samples.
+ * A sketch spread over too many bins for one frame goes out with its lowest bins folded
+ * together, see encodeClosedSketches().
+ */
+class AgentSender {
+public:
+    // hostName is what the agent announces itself as, localHostName() when empty
+    explicit AgentSender(const std::string& endpoint,
+                         size_t maxQueuedBytes = 64 * 1024,
+                         unsigned int batchFrames = 4,
+                         const std::string& hostName = std::string());
+    ~AgentSender(); // Waits for a host name lookup still running
+
+    AgentSender(const AgentSender&) = delete;
+    AgentSender& operator=(const AgentSender&) = delete;
+
+    // Encodes the snapshot into the current batch, then pumps the connection
+    void submit(const StatsSnapshot& snap);
+    // Non-blocking: finishes a pending connect, writes whatever the socket accepts
+    void pump();
+
+    bool connected() const { return sock_ != -1 && !connecting_; }
+    unsigned long long samplesSent() const { return samplesSent_; }
+    unsigned long long samplesDropped() const { return samplesDropped_; }
+    unsigned long long bytesSent() const { return bytesSent_; }
+    unsigned long long sketchesSent() const { return sketchesSent_; }
+    unsigned long long sketchesNarrowed() const { return sketchesNarrowed_; } // Encoded with fewer bins to fit a frame
+    unsigned long long sketchesDropped() const { return sketchesDropped_; }  // Too wide for a frame, or in a shed batch
+
+    struct ResolvedEndpoint; // Address getaddrinfo() found, see agent.cpp
+
+private:
+    void startConnect();
+    void finishConnect();
+    void closeSocket();
+    void flushOut();
+    void encodeClosedSketches();
+
+    std::string endpoint_;
+    std::string hostName_;
+    size_t maxQueuedBytes_;
+    unsigned int batchFrames_;
+
+    std::intptr_t sock_ = -1;
+    bool connecting_ = false;
+    std::shared_ptr<ResolvedEndpoint> resolved_;                // TCP endpoints, null until resolved
+    std::future<std::shared_ptr<ResolvedEndpoint>> resolving_; // Lookup running on the helper thread
+    unsigned long long retryAtMs_ = 0;
+    unsigned long long backoffMs_ = 0;
+
+    FrameEncoder encoder_;
+    SnapshotSketches sketches_;
+    std::string batch_;         // Encoded frames not yet handed to the socket
+    unsigned int batchCount_ = 0;
+    unsigned int batchSketches_ = 0;
+    std::string out_;           // Bytes being written, possibly partially sent
+    size_t outOffset_ = 0;
+    unsigned long long outSamples_ = 0;
+    unsigned long long outSketches_ = 0;
+
+    unsigned long long samplesSent_ = 0;
+    unsigned long long samplesDropped_ = 0;
+    unsigned long long bytesSent_ = 0;
+    unsigned long long sketchesSent_ = 0;
+    unsigned long long sketchesNarrowed_ = 0;
+    unsigned long long sketchesDropped_ = 0;
+};
+
+// Hostname the agent announces itself with
+std::string localHostName();
+
+#endif
@@ -0,0 +1,672 @@
+// Aggregator daemon: collects the snapshots pushed by "stats_display --agent" on many hosts.
+// Linux only (epoll).
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iomanip>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "quantile_sketch.hpp"
+#include "wire_format.hpp"
+
+/**
+ * Program structure:
+ * SHARD BLOCK
+ *      Shard - Per-host store owned by one worker thread. Hosts are assigned to
+ *              shards by hash of the hostname, each shard has its own locks, so
+ *              ingest never contends on a global lock. The inbox is capped: while
+ *              it is full, the agents of that shard are not read, so TCP pushes
+ *              back on them instead of the aggregator buffering without bound.
+ *      addWindow() - Merges a metric's quantile sketch into the window it covers.
+ *      workerLoop() - Drains the shard inbox into its store: latest samples, and the
+ *                     per-host and shard-wide sketch windows. Forgets hosts that went silent.
+ * QUERY BLOCK
+ *      fleetView() - One line per known host with its latest sample.
+ *      topGpus() - The N hottest GPUs of the fleet, merged from per-shard top-N lists.
+ *      ingestStats() - Samples received, ingest rate and hosts expired.
+ *      quantiles() - Percentiles of a metric over the last minutes, one host or the fleet,
+ *                    merged from the sketch windows the agents sent.
+ * EVENT LOOP BLOCK
+ *      Connection - Agent or query client, with its read buffer and frame decoder.
+ *      pauseAgent() / resumeAgents() - Stop and restart reading agents whose shard inbox is full.
+ *      handleAgentData() - Decodes frames and routes samples to their shard.
+ *      handleQuery() - Answers "FLEET", "TOP <n>", "STATS" and "QUANTILE <metric> <minutes> [host]"
+ *                      text queries. A client that lets responses pile up unread is closed.
+ *      main() - Sets up the listeners and runs the epoll loop.
+ */
+
+#define DEFAULT_AGENT_PORT 9400
+#define DEFAULT_QUERY_PORT 9401
+#define READ_CHUNK 65536
+#define MAX_EVENTS 256
+#define MAX_QUERY_LINE 256
+#define MAX_QUERY_OUTPUT (16u << 20) // Unsent response bytes past which a query client is closed
+#define SHARD_INBOX_MAX 16384        // Frames waiting in a shard inbox (about 1 KB each) past which its agents are not read
+#define PAUSED_POLL_MS 10            // Wait of the event loop while agents are paused, to resume them soon
+#define HOST_SKETCH_WINDOWS 15       // Rollup windows kept per host and metric (15 minutes of 1-minute windows)
+#define FLEET_SKETCH_WINDOWS 60      // Windows kept per metric merged over a shard's hosts
+#define HOST_EXPIRY_S 600            // Default for --expire: hosts silent this long are forgotten, sketches included
+#define HOST_SWEEP_MS 10000          // How often a shard looks for expired hosts, at most
+
+// Wall clock, for the sketch windows, which agents align to it
+static unsigned long long nowMs() {
+    return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+// For ages and expiry, which must not jump when the wall clock is stepped
+static unsigned long long steadyMs() {
+    return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// SHARD BLOCK
+
+// Quantile sketch of one metric over one rollup window
+struct SketchWindow {
+    unsigned long long startMs;
+    unsigned long long endMs;
+    QuantileSketch sketch;
+};
+
+// Windows of each metric by name, oldest first
+typedef std::unordered_map<std::string, std::deque<SketchWindow>> SketchSeries;
+
+// Latest state known for one host
+struct HostState {
+    StatsSnapshot latest;
+    unsigned long long receivedMs = 0; // Of the latest sample, steadyMs()
+    unsigned long long seenMs = 0;     // Of the latest frame, sample or sketch, steadyMs()
+    unsigned long long samples = 0;
+    SketchSeries sketches;
+};
+
+// A sample, or a sketch when sketch.metric is set
+struct HostSample {
+    std::string host;
+    StatsSnapshot snapshot;
+    WireSketch sketch;
+};
+
+struct Shard {
+    // Inbox: the event loop appends, the worker swaps it out. Held only for a push or a swap.
+    std::mutex inboxMutex;
+    std::condition_variable inboxReady;
+    std::vector<HostSample> inbox;
+    std::atomic<size_t> inboxSize{0}; // Of inbox, read by the event loop without the lock
+
+    // Store: written by the worker, read by queries
+    std::mutex storeMutex;
+    std::unordered_map<std::string, HostState> hosts;
+    SketchSeries fleetSketches; // Of all the shard's hosts; queries merge them across shards
+
+    std::atomic<unsigned long long> samplesIngested{0}; // Samples only, not sketches
+    std::atomic<unsigned long long> hostsExpired{0};
+    std::thread worker;
+};
+
+static std::vector<std::unique_ptr<Shard>> g_shards;
+static std::atomic<bool> g_running{true};
+static unsigned long long g_startMs = 0; // steadyMs()
+static unsigned long long g_hostExpiryMs = HOST_EXPIRY_S * 1000ULL; // 0: never
+
+// Merges a sketch into the window of the series it covers, which every host of the fleet
+// shares as agents align windows to the wall clock. Keeps the newest keep windows.
+void addWindow(std::deque<SketchWindow>& series, const WireSketch& wire, const QuantileSketch& sketch, size_t keep) {
+    auto it = series.end();
+    while (it != series.begin() && std::prev(it)->startMs > wire.startMs) --it;
+    if (it != series.begin() && std::prev(it)->startMs == wire.startMs) {
+        std::prev(it)->sketch.merge(sketch);
+        return;
+    }
+    if (series.size() >= keep && it == series.begin()) return; // Older than anything kept
+    series.insert(it, SketchWindow{wire.startMs, wire.startMs + wire.windowMs, sketch});
+    if (series.size() > keep) series.pop_front();
+}
+
+// Removes the hosts nothing was received from for g_hostExpiryMs, so a fleet that churns
+// through hostnames (autoscaling, reimaged nodes) does not grow the store forever
+static void expireHosts(Shard& shard, unsigned long long now) {
+    if (g_hostExpiryMs == 0) return;
+    std::lock_guard<std::mutex> lock(shard.storeMutex);
+    for (auto it = shard.hosts.begin(); it != shard.hosts.end();) {
+        if (now - it->second.seenMs >= g_hostExpiryMs) {
+            it = shard.hosts.erase(it);
+            shard.hostsExpired++;
+        } else {
+            ++it;
+        }
+    }
+}
+
+void workerLoop(Shard& shard) {
+    std::vector<HostSample> batch;
+    QuantileSketch sketch;
+    const unsigned long long sweepMs = g_hostExpiryMs ? std::min<unsigned long long>(HOST_SWEEP_MS, g_hostExpiryMs) : HOST_SWEEP_MS;
+    unsigned long long nextSweepMs = steadyMs() + sweepMs;
+    while (g_running) {
+        {
+            // Woken up at least once per sweep period, so an idle shard still expires its hosts
+            std::unique_lock<std::mutex> lock(shard.inboxMutex);
+            shard.inboxReady.wait_for(lock, std::chrono::milliseconds(sweepMs),
+                                      [&] { return !shard.inbox.empty() || !g_running; });
+            batch.swap(shard.inbox);
+            shard.inboxSize = 0;
+        }
+        unsigned long long received = steadyMs();
+        if (received >= nextSweepMs) {
+            expireHosts(shard, received);
+            nextSweepMs = received + sweepMs;
+        }
+        if (batch.empty()) continue;
+
+        unsigned long long samples = 0;
+        {
+            std::lock_guard<std::mutex> lock(shard.storeMutex);
+            for (HostSample& s : batch) {
+                HostState& state = shard.hosts[s.host];
+                state.seenMs = received;
+                if (!s.sketch.metric.empty()) {
+                    // Malformed or of another accuracy: dropped, it could not be merged
+                    if (!sketch.decode(reinterpret_cast<const unsigned char*>(s.sketch.data.data()), s.sketch.data.size())) continue;
+                    addWindow(state.sketches[s.sketch.metric], s.sketch, sketch, HOST_SKETCH_WINDOWS);
+                    addWindow(shard.fleetSketches[s.sketch.metric], s.sketch, sketch, FLEET_SKETCH_WINDOWS);
+                    continue;
+                }
+                state.latest = std::move(s.snapshot);
+                state.receivedMs = received;
+                state.samples++;
+                samples++;
+            }
+        }
+        shard.samplesIngested += samples;
+        batch.clear(); // Keeps its capacity for the next swap
+    }
+}
+
+// QUERY BLOCK
+
+std::string fleetView() {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(2);
+    unsigned long long now = steadyMs();
+    for (auto& shard : g_shards) {
+        std::lock_guard<std::mutex> lock(shard->storeMutex);
+        for (const auto& entry : shard->hosts) {
+            const StatsSnapshot& s = entry.second.latest;
+            oss << entry.first
+                << " age_ms=" << (now - entry.second.receivedMs)
+                << " cpu=" << s.cpuUsage
+                << " ram_gb=" << s.ramUsage;
+            if (s.gpuDataAvailable) {
+                oss << " gpu=\"" << s.gpu.name << "\""
+                    << " temp=" << s.gpu.temperature
+                    << " util=" << s.gpu.utilizationGpu
+                    << " vram_gb=" << s.gpu.memoryUsed << "/" << s.gpu.memoryTotal;
+            }
+            oss << "\n";
+        }
+    }
+    return oss.str();
+}
+
+struct GpuRank {
+    unsigned int temperature;
+    unsigned int utilization;
+    std::string host;
+    std::string name;
+};
+
+std::string topGpus(size_t n) {
+    auto hotter = [](const GpuRank& a, const GpuRank& b) {
+        return a.temperature != b.temperature ? a.temperature > b.temperature : a.utilization > b.utilization;
+    };
+
+    // Each shard contributes at most n candidates, so the merge stays O(shards * n)
+    std::vector<GpuRank> merged;
+    std::vector<GpuRank> local;
+    for (auto& shard : g_shards) {
+        local.clear();
+        {
+            std::lock_guard<std::mutex> lock(shard->storeMutex);
+            for (const auto& entry : shard->hosts) {
+                const StatsSnapshot& s = entry.second.latest;
+                if (s.gpuDataAvailable) {
+                    local.push_back({s.gpu.temperature, s.gpu.utilizationGpu, entry.first, s.gpu.name});
+                }
+            }
+        }
+        size_t keep = std::min(n, local.size());
+        std::partial_sort(local.begin(), local.begin() + keep, local.end(), hotter);
+        merged.insert(merged.end(), local.begin(), local.begin() + keep);
+    }
+    size_t keep = std::min(n, merged.size());
+    std::partial_sort(merged.begin(), merged.begin() + keep, merged.end(), hotter);
+
+    std::ostringstream oss;
+    for (size_t i = 0; i < keep; ++i) {
+        oss << merged[i].host << " temp=" << merged[i].temperature
+            << " util=" << merged[i].utilization << " gpu=\"" << merged[i].name << "\"\n";
+    }
+    return oss.str();
+}
+
+std::string ingestStats() {
+    unsigned long long total = 0, expired = 0;
+    size_t hosts = 0;
+    for (auto& shard : g_shards) {
+        total += shard->samplesIngested;
+        expired += shard->hostsExpired;
+        std::lock_guard<std::mutex> lock(shard->storeMutex);
+        hosts += shard->hosts.size();
+    }
+    double seconds = (steadyMs() - g_startMs) / 1000.0;
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(1)
+        << "hosts=" << hosts << " samples=" << total
+        << " rate=" << (seconds > 0 ? total / seconds : 0.0) << "/s"
+        << " expired=" << expired << "\n";
+    return oss.str();
+}
+
+// Percentiles of a metric over the windows that end in the last minutes, of one host
+// or, with host empty, of the whole fleet
+std::string quantiles(const std::string& metric, unsigned long long minutes, const std::string& host) {
+    // More minutes than since the epoch (or enough to overflow) means everything kept
+    unsigned long long now = nowMs();
+    unsigned long long since = minutes < now / 60000 ? now - minutes * 60000 : 0;
+    QuantileSketch merged;
+    size_t windows = 0;
+    auto mergeSeries = [&](const SketchSeries& series) {
+        auto found = series.find(metric);
+        if (found == series.end()) return;
+        for (const SketchWindow& window : found->second) {
+            if (window.endMs <= since) continue;
+            merged.merge(window.sketch);
+            windows++;
+        }
+    };
+    for (auto& shard : g_shards) {
+        std::lock_guard<std::mutex> lock(shard->storeMutex);
+        if (host.empty()) {
+            mergeSeries(shard->fleetSketches);
+        } else {
+            auto state = shard->hosts.find(host);
+            if (state != shard->hosts.end()) mergeSeries(state->second.sketches);
+        }
+    }
+    if (merged.empty()) {
+        return "ERR no sketches of " + metric + (host.empty() ? "" : " from " + host) + " in that span\n";
+    }
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(2)
+        << metric << " windows=" << windows << " count=" << merged.count()
+        << " min=" << merged.min() << " p5=" << merged.quantile(0.05) << " p50=" << merged.quantile(0.5)
+        << " p95=" << merged.quantile(0.95) << " p99=" << merged.quantile(0.99) << " max=" << merged.max()
+        << " mean=" << merged.sum() / static_cast<double>(merged.count()) << "\n";
+    return oss.str();
+}
+
+// EVENT LOOP BLOCK
+
+enum ConnectionKind { AGENT_LISTENER, QUERY_LISTENER, AGENT, QUERY };
+
+struct Connection {
+    int fd;
+    ConnectionKind kind;
+    std::string in;
+    std::string out;      // Pending query response
+    size_t outOffset = 0;
+    FrameDecoder decoder;
+    size_t shard = SIZE_MAX; // Of an agent, once its HELLO named the host
+    bool paused = false;     // Agent not read until its shard inbox has room again
+};
+
+static int g_epoll = -1;
+static std::unordered_map<int, std::unique_ptr<Connection>> g_connections;
+static std::vector<int> g_pausedAgents;
+
+static bool setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+static void addConnection(int fd, ConnectionKind kind) {
+    std::unique_ptr<Connection> conn(new Connection());
+    conn->fd = fd;
+    conn->kind = kind;
+    epoll_event ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    epoll_ctl(g_epoll, EPOLL_CTL_ADD, fd, &ev);
+    g_connections[fd] = std::move(conn);
+}
+
+static void closeConnection(int fd) {
+    epoll_ctl(g_epoll, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    g_connections.erase(fd);
+}
+
+// Frames queued for a shard, handed over or not yet
+static size_t shardBacklog(size_t shard, const std::vector<std::vector<HostSample>>& pending) {
+    return g_shards[shard]->inboxSize + pending[shard].size();
+}
+
+// Stops reading an agent; what it sends meanwhile waits in the socket buffers, then in its own
+static void pauseAgent(Connection& conn) {
+    epoll_event ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ev.data.fd = conn.fd;
+    epoll_ctl(g_epoll, EPOLL_CTL_MOD, conn.fd, &ev);
+    conn.paused = true;
+    g_pausedAgents.push_back(conn.fd);
+}
+
+// Reads the paused agents again whose shard worker caught up
+static void resumeAgents(const std::vector<std::vector<HostSample>>& pending) {
+    size_t kept = 0;
+    for (int fd : g_pausedAgents) {
+        auto it = g_connections.find(fd);
+        if (it == g_connections.end() || !it->second->paused) continue; // Closed, maybe the fd reused
+        Connection& conn = *it->second;
+        if (shardBacklog(conn.shard, pending) >= SHARD_INBOX_MAX) {
+            g_pausedAgents[kept++] = fd;
+            continue;
+        }
+        epoll_event ev;
+        std::memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(g_epoll, EPOLL_CTL_MOD, fd, &ev);
+        conn.paused = false;
+    }
+    g_pausedAgents.resize(kept);
+}
+
+static int listenTcp(int port) {
+    int fd = socket(AF_INET6, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    int one = 1, zero = 0;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero)); // Accept IPv4 too
+    sockaddr_in6 addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin6_family = AF_INET6;
+    addr.sin6_addr = in6addr_any;
+    addr.sin6_port = htons(static_cast<unsigned short>(port));
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        return -1;
+    }
+    setNonBlocking(fd);
+    return fd;
+}
+
+static int listenUnix(const std::string& path) {
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    if (path.size() >= sizeof(addr.sun_path)) return -1;
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    unlink(path.c_str());
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        return -1;
+    }
+    setNonBlocking(fd);
+    return fd;
+}
+
+static void acceptAll(int listenFd, ConnectionKind kind) {
+    for (;;) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return; // EAGAIN: backlog drained
+        addConnection(fd, kind);
+    }
+}
+
+// Decodes every complete frame in the buffer, batching samples per shard before handing them over
+void handleAgentData(Connection& conn, std::vector<std::vector<HostSample>>& pending) {
+    size_t offset = 0;
+    for (;;) {
+        size_t consumed = 0;
+        FrameDecoder::Result r = conn.decoder.decode(
+            reinterpret_cast<const unsigned char*>(conn.in.data()) + offset, conn.in.size() - offset, consumed);
+        if (r == FrameDecoder::NEED_MORE) break;
+        if (r == FrameDecoder::CORRUPT) {
+            std::fprintf(stderr, "Dropping agent connection: corrupt stream\n");
+            closeConnection(conn.fd);
+            return;
+        }
+        offset += consumed;
+        if (r == FrameDecoder::HELLO) {
+            conn.shard = std::hash<std::string>()(conn.decoder.hostName()) % g_shards.size();
+        }
+        if ((r == FrameDecoder::SAMPLE || r == FrameDecoder::SKETCH) && conn.shard != SIZE_MAX) {
+            size_t shard = conn.shard;
+            HostSample sample;
+            sample.host = conn.decoder.hostName();
+            if (r == FrameDecoder::SAMPLE) {
+                sample.snapshot = dequantizeSample(conn.decoder.sample());
+            } else {
+                sample.sketch = conn.decoder.sketch();
+            }
+            pending[shard].push_back(std::move(sample));
+        }
+    }
+    conn.in.erase(0, offset);
+}
+
+static void flushQuery(Connection& conn) {
+    while (conn.outOffset < conn.out.size()) {
+        ssize_t n = send(conn.fd, conn.out.data() + conn.outOffset, conn.out.size() - conn.outOffset, MSG_NOSIGNAL);
+        if (n > 0) {
+            conn.outOffset += static_cast<size_t>(n);
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            closeConnection(conn.fd);
+            return;
+        }
+    }
+    // Only ask for EPOLLOUT while a response is still pending
+    epoll_event ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ev.data.fd = conn.fd;
+    if (conn.outOffset < conn.out.size()) {
+        ev.events = EPOLLIN | EPOLLOUT;
+    } else {
+        conn.out.clear();
+        conn.outOffset = 0;
+        ev.events = EPOLLIN;
+    }
+    epoll_ctl(g_epoll, EPOLL_CTL_MOD, conn.fd, &ev);
+}
+
+void handleQuery(Connection& conn) {
+    size_t eol;
+    while ((eol = conn.in.find('\n')) != std::string::npos) {
+        std::string line = conn.in.substr(0, eol);
+        conn.in.erase(0, eol + 1);
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+
+        // Responses still unsent from earlier queries: the client is not reading them
+        if (conn.out.size() - conn.outOffset > MAX_QUERY_OUTPUT) {
+            std::fprintf(stderr, "Dropping query connection: responses not read\n");
+            closeConnection(conn.fd);
+            return;
+        }
+
+        std::istringstream iss(line);
+        std::string command;
+        iss >> command;
+        if (command == "FLEET") {
+            conn.out += fleetView();
+        } else if (command == "TOP") {
+            size_t n = 10;
+            iss >> n;
+            conn.out += topGpus(n);
+        } else if (command == "STATS") {
+            conn.out += ingestStats();
+        } else if (command == "QUANTILE") {
+            std::string metric, host;
+            unsigned long long minutes = 5;
+            iss >> metric >> minutes >> host;
+            conn.out += quantiles(metric, minutes, host);
+        } else {
+            conn.out += "ERR unknown query, use FLEET, TOP <n>, STATS or QUANTILE <metric> <minutes> [host]\n";
+        }
+        conn.out += ".\n"; // End of response marker
+    }
+    if (conn.in.size() > MAX_QUERY_LINE) {
+        closeConnection(conn.fd);
+        return;
+    }
+    flushQuery(conn);
+}
+
+int main(int argc, char** argv) {
+    int agentPort = DEFAULT_AGENT_PORT;
+    int queryPort = DEFAULT_QUERY_PORT;
+    std::string unixPath;
+    unsigned int shardCount = std::thread::hardware_concurrency();
+    if (shardCount == 0) shardCount = 4;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string opt = argv[i];
+        if (opt == "--listen") agentPort = std::atoi(argv[i + 1]);
+        else if (opt == "--query") queryPort = std::atoi(argv[i + 1]);
+        else if (opt == "--unix") unixPath = argv[i + 1];
+        else if (opt == "--shards") shardCount = static_cast<unsigned int>(std::atoi(argv[i + 1]));
+        else if (opt == "--expire") g_hostExpiryMs = std::strtoull(argv[i + 1], nullptr, 10) * 1000;
+        else {
+            std::fprintf(stderr, "usage: %s [--listen port] [--unix path] [--query port] [--shards n] [--expire seconds]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (shardCount == 0) shardCount = 1;
+
+    signal(SIGPIPE, SIG_IGN);
+    g_epoll = epoll_create1(EPOLL_CLOEXEC);
+
+    int agentFd = listenTcp(agentPort);
+    int queryFd = listenTcp(queryPort);
+    if (g_epoll < 0 || agentFd < 0 || queryFd < 0) {
+        std::fprintf(stderr, "Failed to listen on ports %d/%d: %s\n", agentPort, queryPort, std::strerror(errno));
+        return 1;
+    }
+    addConnection(agentFd, AGENT_LISTENER);
+    addConnection(queryFd, QUERY_LISTENER);
+    if (!unixPath.empty()) {
+        int unixFd = listenUnix(unixPath);
+        if (unixFd < 0) {
+            std::fprintf(stderr, "Failed to listen on %s: %s\n", unixPath.c_str(), std::strerror(errno));
+            return 1;
+        }
+        addConnection(unixFd, AGENT_LISTENER);
+    }
+
+    g_startMs = steadyMs();
+    for (unsigned int i = 0; i < shardCount; ++i) {
+        g_shards.emplace_back(new Shard());
+    }
+    for (auto& shard : g_shards) {
+        Shard* s = shard.get();
+        s->worker = std::thread([s] { workerLoop(*s); });
+    }
+
+    std::vector<std::vector<HostSample>> pending(g_shards.size());
+    std::vector<char> buffer(READ_CHUNK);
+    epoll_event events[MAX_EVENTS];
+
+    while (g_running) {
+        int n = epoll_wait(g_epoll, events, MAX_EVENTS, g_pausedAgents.empty() ? 1000 : PAUSED_POLL_MS);
+        if (n < 0 && errno != EINTR) break;
+
+        for (int i = 0; i < n; ++i) {
+            auto it = g_connections.find(events[i].data.fd);
+            if (it == g_connections.end()) continue; // Closed earlier in this batch
+            Connection& conn = *it->second;
+
+            if (conn.kind == AGENT_LISTENER) { acceptAll(conn.fd, AGENT); continue; }
+            if (conn.kind == QUERY_LISTENER) { acceptAll(conn.fd, QUERY); continue; }
+
+            if (events[i].events & EPOLLOUT) {
+                flushQuery(conn);
+                if (g_connections.find(events[i].data.fd) == g_connections.end()) continue;
+            }
+            if (!(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) continue;
+            if (conn.kind == AGENT && conn.shard != SIZE_MAX && !conn.paused &&
+                shardBacklog(conn.shard, pending) >= SHARD_INBOX_MAX) {
+                pauseAgent(conn);
+                continue;
+            }
+
+            // Level-triggered: read one chunk now, the rest comes on the next wakeup
+            ssize_t got = read(conn.fd, buffer.data(), buffer.size());
+            if (got == 0 || (got < 0 && errno != EAGAIN && errno != EINTR)) {
+                closeConnection(conn.fd);
+                continue;
+            }
+            if (got < 0) continue;
+            conn.in.append(buffer.data(), static_cast<size_t>(got));
+            if (conn.kind == AGENT) {
+                handleAgentData(conn, pending);
+            } else {
+                handleQuery(conn);
+            }
+        }
+
+        // One inbox lock and wakeup per shard per loop iteration, not per sample
+        for (size_t s = 0; s < pending.size(); ++s) {
+            if (pending[s].empty()) continue;
+            Shard& shard = *g_shards[s];
+            {
+                std::lock_guard<std::mutex> lock(shard.inboxMutex);
+                if (shard.inbox.empty()) {
+                    shard.inbox.swap(pending[s]);
+                } else {
+                    std::move(pending[s].begin(), pending[s].end(), std::back_inserter(shard.inbox));
+                }
+                shard.inboxSize = shard.inbox.size();
+            }
+            pending[s].clear();
+            shard.inboxReady.notify_one();
+        }
+        if (!g_pausedAgents.empty()) resumeAgents(pending);
+    }
+
+    g_running = false;
+    for (auto& shard : g_shards) {
+        shard->inboxReady.notify_one();
+        shard->worker.join();
+    }
+    return 0;
+}
+// comand line to compile:
+// g++ -O2 -std=c++17 -pthread aggregator.cpp wire_format.cpp quantile_sketch.cpp snapshot_metrics.cpp -o stats_aggregator
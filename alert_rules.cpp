@@ -0,0 +1,403 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include "alert_rules.hpp"
+#include "snapshot_metrics.hpp"
+#include "value_parse.hpp"
+
+static const double NOT_AVAILABLE = std::numeric_limits<double>::quiet_NaN();
+
+// Parses "30s", "500ms", "5m" or "1h" into milliseconds
+static bool parseDuration(const std::string& text, unsigned long long& ms) {
+    ParsedValue value = parseValue(text);
+    if (value.status != VALUE_OK || value.number < 0) {
+        return false;
+    }
+    double scale = 0.0;
+    if (value.unit == "ms") scale = 1.0;
+    else if (value.unit == "s") scale = 1000.0;
+    else if (value.unit == "m") scale = 60000.0;
+    else if (value.unit == "h") scale = 3600000.0;
+    else return false;
+    ms = static_cast<unsigned long long>(value.number * scale + 0.5);
+    return true;
+}
+
+AlertConfig loadAlertConfig() {
+    AlertConfig config;
+    const char* path = std::getenv("STATS_ALERT_RULES");
+    if (!path || !*path) {
+        return config;
+    }
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error(std::string("Cannot read alert rules ") + path);
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        std::istringstream words(line);
+        std::string kind;
+        if (!(words >> kind) || kind[0] == '#') {
+            continue;
+        }
+        std::string where = std::string(path) + ":" + std::to_string(lineNumber) + ": ";
+        if (kind == "sink") {
+            std::string sinkKind, target;
+            words >> sinkKind;
+            std::getline(words >> std::ws, target);
+            if (target.empty()) {
+                throw std::runtime_error(where + "expected sink <log|exec|socket> <target>");
+            }
+            config.sinks.emplace_back(sinkKind, target);
+            continue;
+        }
+        if (kind != "rule") {
+            throw std::runtime_error(where + "expected a rule or sink line");
+        }
+
+        // rule <name> <condition words> [for <duration>] [clear <condition words>]
+        AlertRuleSpec spec;
+        std::string word;
+        std::string* text = &spec.condition;
+        words >> spec.name;
+        while (words >> word) {
+            if (word == "for") {
+                std::string duration;
+                if (!(words >> duration) || !parseDuration(duration, spec.forMs)) {
+                    throw std::runtime_error(where + "expected a duration like 30s after \"for\"");
+                }
+            } else if (word == "clear") {
+                text = &spec.clear;
+            } else {
+                if (!text->empty()) *text += ' ';
+                *text += word;
+            }
+        }
+        if (spec.name.empty() || spec.condition.empty()) {
+            throw std::runtime_error(where + "expected rule <name> <condition> [for <duration>] [clear <condition>]");
+        }
+        config.rules.push_back(spec);
+    }
+    return config;
+}
+
+// Compiles a condition into postfix instructions appended to the engine's code:
+//   or-expr    := and-expr ("or" and-expr)*
+//   and-expr   := comparison ("and" comparison)*
+//   comparison := "(" or-expr ")" | [ "rate" "(" ] metric [ ")" ] <op> number
+class AlertEngine::Compiler {
+public:
+    Compiler(AlertEngine& engine, const std::string& text) : engine_(engine), text_(text) {}
+
+    // Returns the metrics the condition reads
+    std::vector<unsigned int> compile() {
+        parseOr();
+        if (!peek().empty()) fail("unexpected \"" + peek() + "\"");
+        return metrics_;
+    }
+
+private:
+    // Next token: a parenthesis, an operator, or a run of anything else
+    std::string token(bool consume) {
+        size_t p = pos_;
+        while (p < text_.size() && std::isspace(static_cast<unsigned char>(text_[p]))) ++p;
+        size_t start = p;
+        if (p < text_.size() && (text_[p] == '(' || text_[p] == ')')) {
+            ++p;
+        } else if (p < text_.size() && std::strchr("<>=!", text_[p])) {
+            ++p;
+            if (p < text_.size() && text_[p] == '=') ++p;
+        } else {
+            while (p < text_.size() && !std::isspace(static_cast<unsigned char>(text_[p])) &&
+                   !std::strchr("()<>=!", text_[p])) ++p;
+        }
+        if (consume) pos_ = p;
+        return text_.substr(start, p - start);
+    }
+    std::string peek() { return token(false); }
+    std::string next() { return token(true); }
+
+    void expect(const char* what) {
+        if (next() != what) fail(std::string("expected \"") + what + "\"");
+    }
+
+    [[noreturn]] void fail(const std::string& why) const {
+        throw std::runtime_error("\"" + text_ + "\": " + why);
+    }
+
+    void push() {
+        if (++depth_ > ALERT_STACK_DEPTH) fail("nested too deeply");
+    }
+
+    void parseOr() {
+        parseAnd();
+        while (peek() == "or") {
+            next();
+            parseAnd();
+            emitLogic(OP_OR);
+        }
+    }
+
+    void parseAnd() {
+        parseComparison();
+        while (peek() == "and") {
+            next();
+            parseComparison();
+            emitLogic(OP_AND);
+        }
+    }
+
+    void emitLogic(Op op) {
+        Instruction instruction = {op, CMP_GT, 0, 0.0};
+        engine_.code_.push_back(instruction);
+        --depth_;
+    }
+
+    void parseComparison() {
+        if (peek() == "(") {
+            next();
+            parseOr();
+            expect(")");
+            return;
+        }
+        Instruction instruction = {OP_VALUE, CMP_GT, 0, 0.0};
+        std::string name = next();
+        if (name == "rate") {
+            expect("(");
+            name = next();
+            expect(")");
+            instruction.op = OP_RATE;
+        }
+        const std::vector<std::string>& names = engine_.metricNames_;
+        size_t metric = std::find(names.begin(), names.end(), name) - names.begin();
+        if (metric == names.size()) {
+            std::string known;
+            for (const std::string& n : names) known += (known.empty() ? "" : ", ") + n;
+            fail("unknown metric \"" + name + "\", known: " + known);
+        }
+        instruction.metric = static_cast<unsigned int>(metric);
+
+        std::string op = next();
+        if (op == ">") instruction.compare = CMP_GT;
+        else if (op == ">=") instruction.compare = CMP_GE;
+        else if (op == "<") instruction.compare = CMP_LT;
+        else if (op == "<=") instruction.compare = CMP_LE;
+        else if (op == "==") instruction.compare = CMP_EQ;
+        else if (op == "!=") instruction.compare = CMP_NE;
+        else fail("expected a comparison after " + name);
+
+        ParsedValue threshold = parseValue(next());
+        if (threshold.status != VALUE_OK || !threshold.unit.empty()) fail("expected a number after " + name + " " + op);
+        instruction.threshold = threshold.number;
+        engine_.code_.push_back(instruction);
+        push();
+
+        if (instruction.op == OP_RATE) engine_.metricUsesRate_[metric] = true;
+        if (std::find(metrics_.begin(), metrics_.end(), metric) == metrics_.end()) {
+            metrics_.push_back(static_cast<unsigned int>(metric));
+        }
+    }
+
+    AlertEngine& engine_;
+    const std::string& text_;
+    size_t pos_ = 0;
+    int depth_ = 0;
+    std::vector<unsigned int> metrics_;
+};
+
+AlertEngine::AlertEngine(const std::vector<std::string>& metrics)
+    : metricNames_(metrics), values_(metrics.size(), NOT_AVAILABLE), rates_(metrics.size(), NOT_AVAILABLE),
+      setMs_(metrics.size(), 0), metricUsesRate_(metrics.size(), false), metricRules_(metrics.size()) {}
+
+void AlertEngine::addRule(const AlertRuleSpec& spec) {
+    const unsigned int rule = static_cast<unsigned int>(names_.size());
+    const size_t codeSize = code_.size();
+    std::vector<unsigned int> metrics;
+    unsigned int fireBegin = static_cast<unsigned int>(code_.size()), clearBegin = 0, clearEnd = 0;
+    try {
+        metrics = Compiler(*this, spec.condition).compile();
+        clearBegin = clearEnd = static_cast<unsigned int>(code_.size());
+        if (!spec.clear.empty()) {
+            for (unsigned int metric : Compiler(*this, spec.clear).compile()) {
+                if (std::find(metrics.begin(), metrics.end(), metric) == metrics.end()) metrics.push_back(metric);
+            }
+            clearEnd = static_cast<unsigned int>(code_.size());
+        }
+    } catch (const std::runtime_error& e) {
+        code_.resize(codeSize);
+        throw std::runtime_error("Alert rule " + spec.name + ": " + e.what());
+    }
+
+    names_.push_back(spec.name);
+    conditions_.push_back(spec.condition);
+    fireBegin_.push_back(fireBegin);
+    fireEnd_.push_back(clearBegin);
+    clearBegin_.push_back(clearBegin);
+    clearEnd_.push_back(clearEnd);
+    forMs_.push_back(spec.forMs);
+    states_.push_back(INACTIVE);
+    generations_.push_back(0);
+    markedIn_.push_back(0);
+    for (unsigned int metric : metrics) {
+        metricRules_[metric].push_back(rule);
+    }
+}
+
+void AlertEngine::set(size_t metric, double value, unsigned long long nowMs) {
+    // The rate needs two samples at different times, a repeated time leaves it as it was
+    if (setMs_[metric] != 0 && nowMs > setMs_[metric]) {
+        rates_[metric] = (value - values_[metric]) * 1000.0 / static_cast<double>(nowMs - setMs_[metric]);
+    }
+    setMs_[metric] = nowMs;
+    values_[metric] = value;
+    for (unsigned int rule : metricRules_[metric]) {
+        if (markedIn_[rule] != round_) {
+            markedIn_[rule] = round_;
+            marked_.push_back(rule);
+        }
+    }
+}
+
+bool AlertEngine::run(unsigned int begin, unsigned int end) const {
+    bool stack[ALERT_STACK_DEPTH];
+    int top = 0;
+    for (unsigned int i = begin; i < end; ++i) {
+        const Instruction& in = code_[i];
+        if (in.op == OP_AND || in.op == OP_OR) {
+            --top;
+            stack[top - 1] = in.op == OP_AND ? stack[top - 1] && stack[top] : stack[top - 1] || stack[top];
+            continue;
+        }
+        double v = in.op == OP_VALUE ? values_[in.metric] : rates_[in.metric];
+        bool result = false;
+        switch (in.compare) {
+        case CMP_GT: result = v > in.threshold; break;
+        case CMP_GE: result = v >= in.threshold; break;
+        case CMP_LT: result = v < in.threshold; break;
+        case CMP_LE: result = v <= in.threshold; break;
+        case CMP_EQ: result = v == in.threshold; break;
+        case CMP_NE: result = v == v && v != in.threshold; break; // NaN is not "different", it is unknown
+        }
+        stack[top++] = result;
+    }
+    return top > 0 && stack[0];
+}
+
+void AlertEngine::emit(unsigned int rule, bool firing, unsigned long long nowMs, std::vector<AlertEvent>& events) const {
+    AlertEvent event;
+    event.rule = names_[rule];
+    event.firing = firing;
+    event.timeMs = nowMs;
+    std::ostringstream detail;
+    detail << conditions_[rule] << " (";
+    const char* separator = "";
+    for (unsigned int i = fireBegin_[rule]; i < fireEnd_[rule]; ++i) {
+        const Instruction& in = code_[i];
+        if (in.op != OP_VALUE && in.op != OP_RATE) continue;
+        detail << separator << (in.op == OP_RATE ? "rate(" : "") << metricNames_[in.metric]
+               << (in.op == OP_RATE ? ")" : "") << "=" << (in.op == OP_RATE ? rates_[in.metric] : values_[in.metric]);
+        separator = ", ";
+    }
+    detail << ")";
+    event.detail = detail.str();
+    events.push_back(event);
+}
+
+void AlertEngine::evaluate(unsigned long long nowMs, std::vector<AlertEvent>& events) {
+    for (unsigned int rule : marked_) {
+        ++evaluations_;
+        bool holds = run(fireBegin_[rule], fireEnd_[rule]);
+        switch (states_[rule]) {
+        case INACTIVE:
+            if (!holds) break;
+            if (forMs_[rule] == 0) {
+                states_[rule] = FIRING;
+                emit(rule, true, nowMs, events);
+            } else {
+                states_[rule] = PENDING;
+                Deadline deadline = {nowMs + forMs_[rule], rule, ++generations_[rule]};
+                deadlines_.push_back(deadline);
+                std::push_heap(deadlines_.begin(), deadlines_.end(), std::greater<Deadline>());
+            }
+            break;
+        case PENDING:
+            if (!holds) {
+                states_[rule] = INACTIVE;
+                ++generations_[rule]; // Its deadline is void now
+            }
+            break;
+        case FIRING: {
+            bool clears = clearBegin_[rule] == clearEnd_[rule] ? !holds : run(clearBegin_[rule], clearEnd_[rule]);
+            if (clears) {
+                states_[rule] = INACTIVE;
+                emit(rule, false, nowMs, events);
+            }
+            break;
+        }
+        }
+    }
+    marked_.clear();
+    ++round_;
+
+    // Rules whose condition held for their whole duration
+    while (!deadlines_.empty() && deadlines_.front().dueMs <= nowMs) {
+        Deadline deadline = deadlines_.front();
+        std::pop_heap(deadlines_.begin(), deadlines_.end(), std::greater<Deadline>());
+        deadlines_.pop_back();
+        if (states_[deadline.rule] == PENDING && generations_[deadline.rule] == deadline.generation) {
+            states_[deadline.rule] = FIRING;
+            emit(deadline.rule, true, nowMs, events);
+        }
+    }
+}
+
+static std::vector<std::string> snapshotMetricNames() {
+    std::vector<std::string> names;
+    for (size_t i = 0; i < SNAPSHOT_METRIC_COUNT; ++i) names.push_back(snapshotMetric(i).name);
+    return names;
+}
+
+// The configured sinks, or the log on stderr when there are none
+static std::vector<std::unique_ptr<AlertSink>> makeSinks(const AlertConfig& config) {
+    std::vector<std::unique_ptr<AlertSink>> sinks;
+    for (const auto& sink : config.sinks) {
+        sinks.push_back(makeAlertSink(sink.first, sink.second));
+    }
+    if (sinks.empty()) sinks.push_back(makeAlertSink("log", "-"));
+    return sinks;
+}
+
+SnapshotAlerts::SnapshotAlerts(const AlertConfig& config)
+    : engine_(snapshotMetricNames()), dispatcher_(makeSinks(config)) {
+    for (const AlertRuleSpec& rule : config.rules) {
+        engine_.addRule(rule);
+    }
+}
+
+void SnapshotAlerts::onSnapshot(const StatsSnapshot& snap) {
+    // Durations run on the monotonic clock, a wall clock step must not fire or hold back a rule
+    unsigned long long nowMs = static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+    for (size_t i = 0; i < engine_.metricCount(); ++i) {
+        const SnapshotMetric& metric = snapshotMetric(i);
+        if ((snap.changed & metric.changedBits) || engine_.usesRate(i)) {
+            engine_.set(i, metric.read(snap), nowMs);
+        }
+    }
+    events_.clear();
+    engine_.evaluate(nowMs, events_);
+    for (AlertEvent& event : events_) {
+        event.timeMs = snap.timestampMs;
+    }
+    dispatcher_.post(events_);
+}
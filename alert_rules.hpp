@@ -0,0 +1,142 @@
+#ifndef STATS_ALERT_RULES_HPP
+#define STATS_ALERT_RULES_HPP
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "alert_sinks.hpp"
+#include "snapshot.hpp"
+
+#define ALERT_STACK_DEPTH 32 // Deepest nesting of and/or a rule may compile to
+
+// One rule: fires once condition has held for forMs, resolves when clear holds
+// (or, without a clear condition, as soon as condition no longer holds)
+struct AlertRuleSpec {
+    std::string name;
+    std::string condition;
+    unsigned long long forMs = 0;
+    std::string clear;
+};
+
+struct AlertConfig {
+    std::vector<AlertRuleSpec> rules;
+    std::vector<std::pair<std::string, std::string>> sinks; // Kind and target
+};
+
+// Reads the rules and sinks from the file named by STATS_ALERT_RULES; empty when it is not set.
+// One entry per line, blank lines and lines starting with '#' skipped:
+//   rule <name> <condition> [for <duration>] [clear <condition>]
+//   sink <log|exec|socket> <path or command>
+// A condition compares metrics, or their rate of change per second, with numbers, joined
+// with and/or and grouped with parentheses:
+//   rule gpu_hot gpu.temperature > 85 for 30s clear gpu.temperature < 80
+//   rule vram_full gpu.memory_percent > 95
+//   rule ram_climbing rate(ram.used_gb) > 0.5 and ram.percent > 80 for 1m
+// Durations take ms, s, m or h. Throws std::runtime_error when the file cannot be read
+// or a line is malformed.
+AlertConfig loadAlertConfig();
+
+/**
+ * Evaluates alert rules over a set of named metrics.
+ *
+ * Every condition is compiled into a flat bytecode: one instruction per
+ * comparison (a metric's value or rate against a constant) and one per
+ * and/or, in postfix order, all rules in a single array. Rules are not
+ * evaluated on a schedule: set() marks the rules that read the metric, and
+ * evaluate() runs only those, so a sample costs O(rules touching the metrics
+ * that changed) whatever the total. A rule waiting out its "for" duration
+ * sits in a deadline heap and fires from there without being re-evaluated.
+ * Hysteresis comes from the separate clear condition: a firing rule resolves
+ * only when that holds, so a value hovering around the threshold does not
+ * flap.
+ * Metrics that were never set read as NaN, and so do rates until a metric
+ * has two samples; every comparison with NaN is false.
+ */
+class AlertEngine {
+public:
+    explicit AlertEngine(const std::vector<std::string>& metrics);
+
+    // Compiles a rule; throws std::runtime_error naming the rule and the problem
+    void addRule(const AlertRuleSpec& spec);
+    size_t ruleCount() const { return names_.size(); }
+    size_t metricCount() const { return metricNames_.size(); }
+    // Whether some rule reads the rate of the metric, which then has to be set every sample
+    bool usesRate(size_t metric) const { return metricUsesRate_[metric]; }
+
+    // Records a new value of a metric at nowMs (a monotonic clock) and marks the rules that read it
+    void set(size_t metric, double value, unsigned long long nowMs);
+    // Evaluates the marked rules and the durations that ran out by nowMs, appending any
+    // firing or resolved events (timeMs is nowMs, for the caller to replace)
+    void evaluate(unsigned long long nowMs, std::vector<AlertEvent>& events);
+
+    unsigned long long evaluations() const { return evaluations_; } // Rule evaluations so far
+
+private:
+    enum Op : unsigned char { OP_VALUE, OP_RATE, OP_AND, OP_OR };
+    enum Compare : unsigned char { CMP_GT, CMP_GE, CMP_LT, CMP_LE, CMP_EQ, CMP_NE };
+    enum State : unsigned char { INACTIVE, PENDING, FIRING };
+
+    struct Instruction {
+        Op op;
+        Compare compare;
+        unsigned int metric;
+        double threshold;
+    };
+
+    struct Deadline {
+        unsigned long long dueMs;
+        unsigned int rule;
+        unsigned int generation; // Stale once the rule left PENDING since
+        bool operator>(const Deadline& other) const { return dueMs > other.dueMs; }
+    };
+
+    class Compiler;
+
+    bool run(unsigned int begin, unsigned int end) const;
+    void emit(unsigned int rule, bool firing, unsigned long long nowMs, std::vector<AlertEvent>& events) const;
+
+    std::vector<std::string> metricNames_;
+    std::vector<double> values_;
+    std::vector<double> rates_;
+    std::vector<unsigned long long> setMs_;
+    std::vector<bool> metricUsesRate_;
+    std::vector<std::vector<unsigned int>> metricRules_; // Rules reading each metric
+
+    std::vector<Instruction> code_;
+    // Per rule, one array per field
+    std::vector<std::string> names_;
+    std::vector<std::string> conditions_;
+    std::vector<unsigned int> fireBegin_, fireEnd_;   // Ranges of code_
+    std::vector<unsigned int> clearBegin_, clearEnd_; // Empty range: clears when the condition stops holding
+    std::vector<unsigned long long> forMs_;
+    std::vector<State> states_;
+    std::vector<unsigned int> generations_;
+    std::vector<unsigned long long> markedIn_;        // Last round the rule was marked in
+
+    std::vector<unsigned int> marked_;
+    unsigned long long round_ = 1;
+    std::vector<Deadline> deadlines_;                 // Min-heap on dueMs
+    unsigned long long evaluations_ = 0;
+};
+
+/**
+ * Alerting on the collected snapshots: the snapshot's values as metrics
+ * (cpu.usage, ram.percent, gpu.temperature, ...; an unknown name in a rule
+ * is reported with the list), fed to an AlertEngine after every tick and the
+ * events handed to the configured sinks. Only the metrics whose
+ * SNAPSHOT_CHANGED_* bits are set are fed, plus those whose rate a rule reads.
+ */
+class SnapshotAlerts {
+public:
+    explicit SnapshotAlerts(const AlertConfig& config); // Throws std::runtime_error for a bad rule or sink
+
+    void onSnapshot(const StatsSnapshot& snap);
+    size_t ruleCount() const { return engine_.ruleCount(); }
+
+private:
+    AlertEngine engine_;
+    AlertDispatcher dispatcher_;
+    std::vector<AlertEvent> events_;
+};
+
+#endif
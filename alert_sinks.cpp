@@ -0,0 +1,142 @@
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <stdexcept>
+#include "alert_sinks.hpp"
+#include "process_runner.hpp"
+
+std::string formatAlertEvent(const AlertEvent& event) {
+    std::time_t seconds = static_cast<std::time_t>(event.timeMs / 1000);
+    std::tm utc;
+#ifdef _WIN32
+    gmtime_s(&utc, &seconds);
+#else
+    gmtime_r(&seconds, &utc);
+#endif
+    char stamp[32];
+    std::strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", &utc);
+    return std::string(stamp) + (event.firing ? " FIRING " : " RESOLVED ") + event.rule + ": " + event.detail;
+}
+
+LogAlertSink::LogAlertSink(const std::string& path) {
+    file_ = path == "-" ? stderr : std::fopen(path.c_str(), "a");
+    if (!file_) {
+        throw std::runtime_error("Cannot open alert log " + path + ": " + std::strerror(errno));
+    }
+}
+
+LogAlertSink::~LogAlertSink() {
+    if (file_ != stderr) std::fclose(file_);
+}
+
+void LogAlertSink::deliver(const AlertEvent& event) {
+    std::string line = formatAlertEvent(event);
+    std::fprintf(file_, "%s\n", line.c_str());
+    std::fflush(file_); // Readable by tail -f right away
+}
+
+void ExecAlertSink::deliver(const AlertEvent& event) {
+    ProcessOptions options;
+    options.timeoutMs = ALERT_EXEC_TIMEOUT_MS;
+    ProcessResult result = runProcess({command_, event.firing ? "firing" : "resolved", event.rule, event.detail}, options);
+    if (result.status != ProcessResult::EXITED || result.exitCode != 0) {
+        std::cerr << "Alert hook " << command_ << " " << describeFailure(result) << std::endl;
+    }
+}
+
+SocketAlertSink::SocketAlertSink(const std::string& path) : path_(path) {
+#ifdef _WIN32
+    throw std::runtime_error("Alert socket " + path + ": datagram Unix sockets are not available on Windows");
+#else
+    if (path.size() >= sizeof(sockaddr_un().sun_path)) {
+        throw std::runtime_error("Alert socket path too long: " + path);
+    }
+    sock_ = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sock_ < 0) {
+        throw std::runtime_error(std::string("Cannot create alert socket: ") + std::strerror(errno));
+    }
+    fcntl(sock_, F_SETFL, fcntl(sock_, F_GETFL, 0) | O_NONBLOCK); // A stalled reader loses events, it does not stall us
+#endif
+}
+
+SocketAlertSink::~SocketAlertSink() {
+#ifndef _WIN32
+    if (sock_ >= 0) close(sock_);
+#endif
+}
+
+void SocketAlertSink::deliver(const AlertEvent& event) {
+#ifndef _WIN32
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path_.c_str(), path_.size());
+    std::string line = formatAlertEvent(event);
+    // ENOENT or ECONNREFUSED when no one listens, EAGAIN when the reader is behind: dropped either way
+    sendto(sock_, line.data(), line.size(), 0, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+#else
+    (void)event;
+#endif
+}
+
+std::unique_ptr<AlertSink> makeAlertSink(const std::string& kind, const std::string& target) {
+    if (kind == "log") return std::unique_ptr<AlertSink>(new LogAlertSink(target));
+    if (kind == "exec") return std::unique_ptr<AlertSink>(new ExecAlertSink(target));
+    if (kind == "socket") return std::unique_ptr<AlertSink>(new SocketAlertSink(target));
+    throw std::runtime_error("Unknown alert sink \"" + kind + "\", expected log, exec or socket");
+}
+
+AlertDispatcher::AlertDispatcher(std::vector<std::unique_ptr<AlertSink>> sinks) : sinks_(std::move(sinks)) {
+    thread_ = std::thread(&AlertDispatcher::run, this);
+}
+
+AlertDispatcher::~AlertDispatcher() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+}
+
+void AlertDispatcher::post(const std::vector<AlertEvent>& events) {
+    if (events.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const AlertEvent& event : events) {
+            if (queue_.size() >= ALERT_QUEUE_MAX) {
+                ++dropped_;
+                continue;
+            }
+            queue_.push_back(event);
+        }
+    }
+    wake_.notify_one();
+}
+
+unsigned long long AlertDispatcher::dropped() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dropped_;
+}
+
+void AlertDispatcher::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+        if (queue_.empty()) return; // Stopping, and everything was delivered
+        AlertEvent event = std::move(queue_.front());
+        queue_.pop_front();
+        lock.unlock();
+        for (const std::unique_ptr<AlertSink>& sink : sinks_) {
+            sink->deliver(event);
+        }
+        lock.lock();
+    }
+}
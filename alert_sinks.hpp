@@ -0,0 +1,99 @@
+#ifndef STATS_ALERT_SINKS_HPP
+#define STATS_ALERT_SINKS_HPP
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define ALERT_QUEUE_MAX 1024        // Events waiting for the sinks; more than that are dropped
+#define ALERT_EXEC_TIMEOUT_MS 5000  // Longest an exec hook may run before it is killed
+
+// A rule starting or stopping to fire (see alert_rules.hpp)
+struct AlertEvent {
+    std::string rule;
+    bool firing = false;             // Otherwise resolved
+    unsigned long long timeMs = 0;   // Milliseconds since the Unix epoch
+    std::string detail;              // The condition and the values it saw
+};
+
+// One line per event: "2026-10-16T10:00:00Z FIRING gpu_hot: gpu.temperature > 85 (gpu.temperature=87)"
+std::string formatAlertEvent(const AlertEvent& event);
+
+// Where events go. deliver() runs on the dispatcher thread and may block (within reason).
+class AlertSink {
+public:
+    virtual ~AlertSink() {}
+    virtual void deliver(const AlertEvent& event) = 0;
+};
+
+// Appends each event's line to a file, or writes it to stderr for the path "-"
+class LogAlertSink : public AlertSink {
+public:
+    explicit LogAlertSink(const std::string& path); // Throws std::runtime_error if it cannot be opened
+    ~LogAlertSink();
+    void deliver(const AlertEvent& event);
+
+private:
+    std::FILE* file_;
+};
+
+// Runs "<command> <firing|resolved> <rule> <detail>" for each event, with a deadline
+class ExecAlertSink : public AlertSink {
+public:
+    explicit ExecAlertSink(const std::string& command) : command_(command) {}
+    void deliver(const AlertEvent& event);
+
+private:
+    std::string command_;
+};
+
+// Sends each event's line as one datagram to a Unix domain socket (not on Windows).
+// Nobody listening is not an error: the event is simply not seen there.
+class SocketAlertSink : public AlertSink {
+public:
+    explicit SocketAlertSink(const std::string& path); // Throws std::runtime_error where unsupported
+    ~SocketAlertSink();
+    void deliver(const AlertEvent& event);
+
+private:
+    std::string path_;
+    int sock_ = -1;
+};
+
+// Sink of a "sink <log|exec|socket> <target>" line, throws std::runtime_error for an unknown kind
+std::unique_ptr<AlertSink> makeAlertSink(const std::string& kind, const std::string& target);
+
+/**
+ * Delivers events to the sinks on a thread of its own, so a slow hook or a
+ * full disk never holds up sampling. post() only queues; when the sinks fall
+ * ALERT_QUEUE_MAX events behind, further events are dropped and counted.
+ */
+class AlertDispatcher {
+public:
+    explicit AlertDispatcher(std::vector<std::unique_ptr<AlertSink>> sinks);
+    ~AlertDispatcher(); // Delivers what is queued, then stops
+
+    AlertDispatcher(const AlertDispatcher&) = delete;
+    AlertDispatcher& operator=(const AlertDispatcher&) = delete;
+
+    void post(const std::vector<AlertEvent>& events);
+    unsigned long long dropped() const;
+
+private:
+    void run();
+
+    std::vector<std::unique_ptr<AlertSink>> sinks_;
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<AlertEvent> queue_;
+    bool stopping_ = false;
+    unsigned long long dropped_ = 0;
+    std::thread thread_;
+};
+
+#endif
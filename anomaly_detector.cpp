@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "anomaly_detector.hpp"
+#include "snapshot_metrics.hpp"
+
+#define MAD_TO_SIGMA 1.4826 // MAD of a normal distribution times this is its standard deviation
+
+AnomalyDetectors::AnomalyDetectors(size_t series)
+    : mean_(series, 0.0), variance_(series, 0.0), samples_(series, 0), window_(series * ANOMALY_WINDOW, 0.0),
+      sorted_(series * ANOMALY_WINDOW, 0.0), next_(series, 0) {}
+
+// The median of |x - median| over a sorted window: the deviations grow both ways from the
+// median, so the smallest ones come from walking outwards and taking the nearer side first
+double AnomalyDetectors::medianAbsoluteDeviation(const double* sorted, size_t count, double median) const {
+    size_t right = static_cast<size_t>(std::upper_bound(sorted, sorted + count, median) - sorted);
+    size_t left = right; // sorted[left - 1] is the next one below
+    double deviation = 0.0;
+    for (size_t taken = 0; taken <= count / 2; ++taken) {
+        if (left > 0 && (right == count || median - sorted[left - 1] <= sorted[right] - median)) {
+            deviation = median - sorted[--left];
+        } else {
+            deviation = sorted[right++] - median;
+        }
+    }
+    return deviation;
+}
+
+unsigned int AnomalyDetectors::update(size_t series, double value) {
+    if (std::isnan(value)) {
+        return 0;
+    }
+    unsigned int flags = 0;
+    const size_t count = static_cast<size_t>(std::min<unsigned long long>(samples_[series], ANOMALY_WINDOW));
+    double* ring = window(series);
+    double* order = sorted(series);
+
+    if (samples_[series] == 0) {
+        mean_[series] = value;
+    } else {
+        // Judged against the baseline as it was, then added to it
+        double deviation = value - mean_[series];
+        if (samples_[series] >= ANOMALY_WARMUP) {
+            double floor = ANOMALY_MIN_SCALE_FRACTION * std::fabs(mean_[series]);
+            if (std::fabs(deviation) > ANOMALY_EWMA_THRESHOLD * std::max(std::sqrt(variance_[series]), floor)) {
+                flags |= ANOMALY_EWMA;
+            }
+            double median = count % 2 ? order[count / 2] : (order[count / 2 - 1] + order[count / 2]) / 2.0;
+            double scale = MAD_TO_SIGMA * medianAbsoluteDeviation(order, count, median);
+            floor = ANOMALY_MIN_SCALE_FRACTION * std::fabs(median);
+            if (std::fabs(value - median) > ANOMALY_MAD_THRESHOLD * std::max(scale, floor)) {
+                flags |= ANOMALY_MAD;
+            }
+        }
+        mean_[series] += ANOMALY_EWMA_ALPHA * deviation;
+        variance_[series] = (1.0 - ANOMALY_EWMA_ALPHA) * (variance_[series] + ANOMALY_EWMA_ALPHA * deviation * deviation);
+    }
+
+    // Out goes the oldest sample once the window is full, in goes this one
+    size_t kept = count;
+    if (count == ANOMALY_WINDOW) {
+        double* oldest = std::lower_bound(order, order + count, ring[next_[series]]);
+        std::memmove(oldest, oldest + 1, static_cast<size_t>(order + count - oldest - 1) * sizeof(double));
+        --kept;
+    }
+    double* slot = std::upper_bound(order, order + kept, value);
+    std::memmove(slot + 1, slot, static_cast<size_t>(order + kept - slot) * sizeof(double));
+    *slot = value;
+    ring[next_[series]] = value;
+    next_[series] = (next_[series] + 1) % ANOMALY_WINDOW;
+    ++samples_[series];
+    return flags;
+}
+
+SnapshotAnomalies::SnapshotAnomalies() : detectors_(SNAPSHOT_METRIC_COUNT) {}
+
+unsigned long long SnapshotAnomalies::update(const StatsSnapshot& snap) {
+    for (size_t i = 0; i < SNAPSHOT_METRIC_COUNT; ++i) {
+        const SnapshotMetric& metric = snapshotMetric(i);
+        if (!(snap.changed & metric.changedBits)) continue;
+        unsigned long long bit = 1ULL << i;
+        if (detectors_.update(i, metric.read(snap))) {
+            flagged_ |= bit;
+        } else {
+            flagged_ &= ~bit;
+        }
+    }
+    return flagged_;
+}
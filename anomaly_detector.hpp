@@ -0,0 +1,77 @@
+#ifndef STATS_ANOMALY_DETECTOR_HPP
+#define STATS_ANOMALY_DETECTOR_HPP
+
+#include <cstddef>
+#include <vector>
+#include "snapshot.hpp"
+
+#define ANOMALY_EWMA_ALPHA 0.05         // Weight of a new sample in the moving mean and variance
+#define ANOMALY_EWMA_THRESHOLD 4.0      // Standard deviations from the moving mean
+#define ANOMALY_WINDOW 31               // Samples the median and MAD are taken over
+#define ANOMALY_MAD_THRESHOLD 5.0       // Scaled MADs from the median
+#define ANOMALY_WARMUP 30               // Samples a series needs before it is judged
+#define ANOMALY_MIN_SCALE_FRACTION 0.01 // A flat series still tolerates 1% of its level
+
+// What AnomalyDetectors::update() found
+#define ANOMALY_EWMA 0x1 // Far from the exponentially weighted mean, in its standard deviations
+#define ANOMALY_MAD  0x2 // Far from the median of the window, in its median absolute deviations
+
+/**
+ * Streaming anomaly detection over many series at once, each sample judged
+ * against the series' own baseline, so a busy node and an idle one need no
+ * separate thresholds.
+ *
+ * Two detectors run on every series:
+ *  - EWMA: an exponentially weighted mean and variance, updated in O(1).
+ *  - Median/MAD: the median of the last ANOMALY_WINDOW samples and their
+ *    median absolute deviation, which a burst of outliers does not drag along
+ *    like it does a mean. The window is kept sorted next to its ring buffer,
+ *    so a sample is one binary search and a memmove of at most the window
+ *    in each, and the MAD one walk outwards from the median: bounded by the
+ *    fixed window, not by how long the series has run.
+ * A sample is judged against the baseline before it is added to it. Either
+ * scale is floored at ANOMALY_MIN_SCALE_FRACTION of the level, so a series
+ * that was perfectly flat is not flagged for every small move.
+ * State is one array per field, series after series.
+ */
+class AnomalyDetectors {
+public:
+    explicit AnomalyDetectors(size_t series);
+
+    size_t seriesCount() const { return samples_.size(); }
+    // Adds a sample to a series and returns the ANOMALY_* bits of the detectors that flag it,
+    // 0 while the series warms up. NaN (a value not collected) is skipped.
+    unsigned int update(size_t series, double value);
+
+private:
+    double* window(size_t series) { return &window_[series * ANOMALY_WINDOW]; }
+    double* sorted(size_t series) { return &sorted_[series * ANOMALY_WINDOW]; }
+    double medianAbsoluteDeviation(const double* sorted, size_t count, double median) const;
+
+    std::vector<double> mean_;
+    std::vector<double> variance_;
+    std::vector<unsigned long long> samples_;
+    std::vector<double> window_;      // Ring buffer of the last samples
+    std::vector<double> sorted_;      // The same samples in order
+    std::vector<unsigned int> next_;  // Ring position the next sample goes to
+};
+
+/**
+ * Anomaly detection on the collected snapshots: one series per snapshot
+ * metric (see snapshot_metrics.hpp), fed with the metrics whose
+ * SNAPSHOT_CHANGED_* bits are set. update() returns the mask of metrics whose
+ * latest sample was flagged by either detector; a metric stays flagged until
+ * its next sample.
+ */
+class SnapshotAnomalies {
+public:
+    SnapshotAnomalies();
+
+    unsigned long long update(const StatsSnapshot& snap);
+
+private:
+    AnomalyDetectors detectors_;
+    unsigned long long flagged_ = 0;
+};
+
+#endif
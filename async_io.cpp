@@ -0,0 +1,233 @@
+#include "async_io.hpp"
+
+#ifdef STATS_ASYNC_IO
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <stdexcept>
+
+#define REACTOR_MAX_EVENTS 32
+#define ASYNC_CANCEL_POLL_MS 50 // Longest a probe waits before checking the cancel flag and the child
+
+unsigned long long Reactor::nowMs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<unsigned long long>(ts.tv_sec) * 1000ULL + static_cast<unsigned long long>(ts.tv_nsec) / 1000000ULL;
+}
+
+Reactor::Reactor() {
+    epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd_ < 0) {
+        throw std::runtime_error(std::string("epoll_create1 failed: ") + std::strerror(errno));
+    }
+}
+
+Reactor::~Reactor() {
+    waits_.clear();
+    tasks_.clear(); // Destroys the frames of tasks that never finished
+    close(epollFd_);
+}
+
+bool Reactor::Wait::await_suspend(std::coroutine_handle<> awaiting) {
+    handle = awaiting;
+    if (fd >= 0) {
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.ptr = this;
+        if (epoll_ctl(reactor->epollFd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+            // Not pollable (a regular file), so never going to block: carry on
+            ready = true;
+            return false;
+        }
+    }
+    reactor->waits_.push_back(this);
+    return true;
+}
+
+void Reactor::resume(Wait* wait, bool ready) {
+    auto it = std::find(waits_.begin(), waits_.end(), wait);
+    if (it == waits_.end()) {
+        return; // Already resumed earlier in this round
+    }
+    waits_.erase(it);
+    if (wait->fd >= 0) {
+        epoll_ctl(epollFd_, EPOLL_CTL_DEL, wait->fd, nullptr);
+    }
+    wait->ready = ready;
+    wait->handle.resume();
+}
+
+void Reactor::spawn(Task<void> task) {
+    Task<void>::Handle handle = task.handle();
+    tasks_.push_back(std::move(task));
+    handle.resume();
+}
+
+void Reactor::run() {
+    for (;;) {
+        // Drop the finished tasks, the first error is rethrown once they are gone
+        std::exception_ptr error;
+        for (size_t i = 0; i < tasks_.size();) {
+            if (tasks_[i].done()) {
+                if (!error) error = tasks_[i].handle().promise().error;
+                tasks_.erase(tasks_.begin() + static_cast<long>(i));
+            } else {
+                ++i;
+            }
+        }
+        if (error) std::rethrow_exception(error);
+        if (tasks_.empty()) return;
+        if (waits_.empty()) {
+            throw std::logic_error("Reactor tasks are suspended on something other than the reactor");
+        }
+
+        unsigned long long now = nowMs();
+        unsigned long long nextDeadline = waits_.front()->deadlineMs;
+        for (Wait* wait : waits_) nextDeadline = std::min(nextDeadline, wait->deadlineMs);
+        int timeout = nextDeadline > now ? static_cast<int>(std::min<unsigned long long>(nextDeadline - now, 60000)) : 0;
+
+        epoll_event events[REACTOR_MAX_EVENTS];
+        int count = epoll_wait(epollFd_, events, REACTOR_MAX_EVENTS, timeout);
+        if (count < 0 && errno != EINTR) {
+            throw std::runtime_error(std::string("epoll_wait failed: ") + std::strerror(errno));
+        }
+        for (int i = 0; i < count; ++i) {
+            resume(static_cast<Wait*>(events[i].data.ptr), true);
+        }
+
+        now = nowMs();
+        std::vector<Wait*> expired;
+        for (Wait* wait : waits_) {
+            if (wait->deadlineMs <= now) expired.push_back(wait);
+        }
+        for (Wait* wait : expired) {
+            resume(wait, false);
+        }
+    }
+}
+
+Task<bool> readFileAsync(Reactor& reactor, std::string path, std::string& content) {
+    (void)reactor;
+    content.clear();
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) co_return false;
+    char chunk[4096];
+    for (;;) {
+        ssize_t n = read(fd, chunk, sizeof(chunk));
+        if (n > 0) {
+            content.append(chunk, static_cast<size_t>(n));
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            break;
+        }
+    }
+    close(fd);
+    co_return true;
+}
+
+// pidfd_open(2), Linux 5.3+; -1 elsewhere, the exit is then polled with waitpid
+static int openPidFd(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+    (void)pid;
+    return -1;
+#endif
+}
+
+Task<void> runProcessAsync(Reactor& reactor, PreparedCommand& command, ProcessOptions options) {
+    pid_t pid;
+    int readFd = command.start(pid);
+    if (readFd < 0) {
+        co_return;
+    }
+
+    unsigned long long deadline = Reactor::nowMs() + options.timeoutMs;
+    ProcessResult::Status status = ProcessResult::EXITED;
+    int waitStatus = 0;
+    bool reaped = false;
+    bool pipeOpen = true;
+
+    // Read until EOF, or until the child itself exited (a grandchild may keep the pipe open)
+    while (pipeOpen && !reaped && status == ProcessResult::EXITED) {
+        if (options.cancel && *options.cancel) { status = ProcessResult::CANCELLED; break; }
+        unsigned long long now = Reactor::nowMs();
+        if (now >= deadline) { status = ProcessResult::TIMED_OUT; break; }
+
+        co_await reactor.readable(readFd, std::min(deadline, now + ASYNC_CANCEL_POLL_MS));
+        reaped = waitpid(pid, &waitStatus, WNOHANG) == pid;
+        pipeOpen = command.drain(readFd, options.maxOutputBytes);
+        status = command.result().status; // OUTPUT_LIMIT once drain() read past the limit
+    }
+    close(readFd);
+
+    // The pipe hit EOF but the child may still be running, e.g. after closing its stdout
+    if (!reaped && status == ProcessResult::EXITED) {
+        int pidFd = openPidFd(pid);
+        while (!(reaped = waitpid(pid, &waitStatus, WNOHANG) == pid)) {
+            unsigned long long now = Reactor::nowMs();
+            if (now >= deadline) { status = ProcessResult::TIMED_OUT; break; }
+            if (pidFd >= 0) {
+                co_await reactor.readable(pidFd, deadline);
+            } else {
+                co_await reactor.sleepFor(5);
+            }
+        }
+        if (pidFd >= 0) close(pidFd);
+    }
+    if (!reaped) {
+        kill(pid, SIGKILL);
+        while (waitpid(pid, &waitStatus, 0) < 0 && errno == EINTR) {}
+    }
+    command.finish(status, waitStatus);
+}
+
+Task<ProcessResult> runProcessAsync(Reactor& reactor, std::vector<std::string> argv, ProcessOptions options) {
+    PreparedCommand command(std::move(argv));
+    co_await runProcessAsync(reactor, command, options);
+    ProcessResult result = command.result();
+    result.output.assign(command.output().data(), command.output().size());
+    co_return result;
+}
+
+void ReactorCollector::add(std::unique_ptr<AsyncCollector> collector) {
+    Entry entry;
+    entry.collector = std::move(collector);
+    entries_.push_back(std::move(entry));
+}
+
+Task<void> ReactorCollector::runOne(Reactor& reactor, Entry& entry) {
+    try {
+        co_await entry.collector->collect(reactor);
+        entry.succeeded = true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error in collector " << entry.collector->name() << ": " << e.what() << std::endl;
+    }
+}
+
+void ReactorCollector::collect() {
+    for (Entry& entry : entries_) {
+        entry.succeeded = false;
+        reactor_.spawn(runOne(reactor_, entry));
+    }
+    reactor_.run();
+}
+
+unsigned int ReactorCollector::apply(StatsSnapshot& snapshot) {
+    unsigned int changed = 0;
+    for (Entry& entry : entries_) {
+        if (entry.succeeded) changed |= entry.collector->apply(snapshot);
+    }
+    return changed;
+}
+
+#endif
@@ -0,0 +1,228 @@
+#ifndef STATS_ASYNC_IO_HPP
+#define STATS_ASYNC_IO_HPP
+
+/**
+ * Coroutine-based collectors for I/O-bound probes (Linux, C++20).
+ *
+ * A probe is written as straight-line code that co_awaits a pipe, a timer or a
+ * child process instead of blocking on it. All probes of a ReactorCollector run
+ * on one thread and one epoll reactor, so a tick costs the slowest probe rather
+ * than the sum of them:
+ *
+ *      Task<void> collect(Reactor& reactor) {
+ *          co_await runProcessAsync(reactor, command_); // A PreparedCommand
+ *          ...
+ *      }
+ *
+ * The monitor's Linux build is C++20 and runs its nvidia-smi probe this way
+ * (AsyncGpuCollector in main.cpp). The module is only compiled in when the
+ * compiler supports coroutines, STATS_ASYNC_IO is defined then; a C++17 build
+ * still works, with the probe blocking a pool thread instead.
+ */
+#if defined(__linux__) && defined(__cpp_impl_coroutine)
+#define STATS_ASYNC_IO 1
+
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "collector_engine.hpp"
+#include "process_runner.hpp"
+
+template <typename T>
+class Task;
+
+// Promise parts shared by Task<T> and Task<void>. Tasks start suspended and resume
+// whoever awaited them when they finish.
+struct TaskPromiseBase {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> done) noexcept {
+            std::coroutine_handle<> next = done.promise().continuation;
+            return next ? next : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() { error = std::current_exception(); }
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase {
+    std::optional<T> value;
+    Task<T> get_return_object();
+    void return_value(T v) { value = std::move(v); }
+    T result() {
+        if (error) std::rethrow_exception(error);
+        return std::move(*value);
+    }
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase {
+    Task<void> get_return_object();
+    void return_void() {}
+    void result() {
+        if (error) std::rethrow_exception(error);
+    }
+};
+
+// A lazily started coroutine returning T, run by co_await'ing it or by Reactor::spawn()
+template <typename T>
+class Task {
+public:
+    using promise_type = TaskPromise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    explicit Task(Handle handle) : handle_(handle) {}
+    Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (handle_) handle_.destroy();
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+    ~Task() {
+        if (handle_) handle_.destroy();
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    bool done() const { return !handle_ || handle_.done(); }
+    Handle handle() const { return handle_; }
+
+    auto operator co_await() const noexcept {
+        struct Awaiter {
+            Handle handle;
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+            T await_resume() { return handle.promise().result(); }
+        };
+        return Awaiter{handle_};
+    }
+
+private:
+    Handle handle_;
+};
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() {
+    return Task<T>(Task<T>::Handle::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() {
+    return Task<void>(Task<void>::Handle::from_promise(*this));
+}
+
+/**
+ * Single-threaded epoll event loop the tasks suspend on.
+ * Every wait has a deadline, kept in a plain list: a reactor serves tens of
+ * probes, not thousands, so a scan per wakeup beats maintaining a heap.
+ */
+class Reactor {
+public:
+    Reactor();
+    ~Reactor();
+
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
+
+    // Starts the task; it runs until its first suspension, then whenever what it awaits is ready
+    void spawn(Task<void> task);
+    // Runs until every spawned task finished. Exceptions escaping a task are rethrown here.
+    void run();
+
+    // Milliseconds on the monotonic clock, the time base of all deadlines
+    static unsigned long long nowMs();
+
+    struct Wait {
+        Wait(Reactor* r, int waitFd, unsigned long long deadline) : reactor(r), fd(waitFd), deadlineMs(deadline) {}
+
+        Reactor* reactor;
+        int fd;                        // -1 for a plain timer
+        unsigned long long deadlineMs;
+        bool ready = false;
+        std::coroutine_handle<> handle;
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> awaiting);
+        bool await_resume() const noexcept { return ready; }
+    };
+    // co_await: true once fd is readable (or hung up), false if deadlineMs passed first
+    Wait readable(int fd, unsigned long long deadlineMs) { return Wait{this, fd, deadlineMs}; }
+    // co_await: resumes after ms
+    Wait sleepFor(unsigned int ms) { return Wait{this, -1, nowMs() + ms}; }
+
+private:
+    void resume(Wait* wait, bool ready);
+
+    int epollFd_ = -1;
+    std::vector<Wait*> waits_;
+    std::vector<Task<void>> tasks_;
+};
+
+// Reads a whole file into content, false if it cannot be opened. Regular files (and /proc)
+// never report "not ready" to epoll, so this reads straight away; it is a Task so probes
+// can treat all input alike. content must outlive the co_await, as a local of the caller does.
+Task<bool> readFileAsync(Reactor& reactor, std::string path, std::string& content);
+
+// PreparedCommand::run() as a coroutine: waits on the child's pipe and exit through the
+// reactor, with the same deadline, cancellation and output-limit handling. The command's
+// prepared spawn and output buffer are reused, the result and output are in command.result()
+// and command.output() afterwards. command must outlive the co_await.
+Task<void> runProcessAsync(Reactor& reactor, PreparedCommand& command, ProcessOptions options = ProcessOptions());
+// runProcess() as a coroutine, a one-off command (output in result.output)
+Task<ProcessResult> runProcessAsync(Reactor& reactor, std::vector<std::string> argv,
+                                    ProcessOptions options = ProcessOptions());
+
+// A collector written as a coroutine, see ReactorCollector
+class AsyncCollector {
+public:
+    virtual ~AsyncCollector() {}
+    virtual const char* name() const = 0;
+    // Same contract as Collector::collect(), but may suspend on the reactor
+    virtual Task<void> collect(Reactor& reactor) = 0;
+    virtual unsigned int apply(StatsSnapshot& snapshot) = 0;
+};
+
+// Runs a group of async collectors concurrently on one reactor, as one task of the collector engine
+class ReactorCollector : public Collector {
+public:
+    ReactorCollector(const char* name, unsigned int periodMs) : name_(name), periodMs_(periodMs) {}
+
+    void add(std::unique_ptr<AsyncCollector> collector);
+
+    const char* name() const { return name_; }
+    unsigned int periodMs() const { return periodMs_; }
+    void collect();
+    unsigned int apply(StatsSnapshot& snapshot);
+
+private:
+    struct Entry {
+        std::unique_ptr<AsyncCollector> collector;
+        bool succeeded = false;
+    };
+    static Task<void> runOne(Reactor& reactor, Entry& entry);
+
+    const char* name_;
+    unsigned int periodMs_;
+    Reactor reactor_;
+    std::vector<Entry> entries_;
+};
+
+#endif
+
+#endif
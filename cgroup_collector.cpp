@@ -0,0 +1,274 @@
+#include "cgroup_collector.hpp"
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#define CGROUP_GROUP_BUFFER (CGROUP_CPU_BUFFER + CGROUP_MEMORY_BUFFER + CGROUP_IO_BUFFER)
+#define CGROUP_FILE_MISSING -2
+
+static const char* const CGROUP_FILES[] = {"cpu.stat", "memory.current", "io.stat"};
+static const size_t CGROUP_FILE_OFFSETS[] = {0, CGROUP_CPU_BUFFER, CGROUP_CPU_BUFFER + CGROUP_MEMORY_BUFFER};
+static const size_t CGROUP_FILE_SIZES[] = {CGROUP_CPU_BUFFER, CGROUP_MEMORY_BUFFER, CGROUP_IO_BUFFER};
+
+// The cgroup2 mount, or an empty string on hosts without one
+static std::string findCgroupRoot() {
+    const char* configured = std::getenv("STATS_CGROUP_ROOT");
+    if (configured && *configured) return configured;
+    if (access("/sys/fs/cgroup/cgroup.controllers", F_OK) == 0) return "/sys/fs/cgroup";
+    if (access("/sys/fs/cgroup/unified/cgroup.controllers", F_OK) == 0) return "/sys/fs/cgroup/unified";
+    return "";
+}
+
+// Value of a "key=value" field, 0 if there is none
+static unsigned long long keyedNumber(std::string_view field) {
+    size_t equals = field.find('=');
+    unsigned long long value = 0;
+    if (equals == std::string_view::npos) return 0;
+    for (size_t i = equals + 1; i < field.size() && field[i] >= '0' && field[i] <= '9'; ++i) {
+        value = value * 10 + static_cast<unsigned long long>(field[i] - '0');
+    }
+    return value;
+}
+
+CgroupCollector::CgroupCollector(unsigned int periodMs, const std::string& root)
+    : periodMs_(periodMs), root_(root.empty() ? findCgroupRoot() : root), reader_(CGROUP_BATCH * FILES) {
+    if (!root_.empty()) {
+        inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    }
+    fdBudget_ = std::min<size_t>(raiseOpenFileLimit() / 4, CGROUP_MAX_FDS);
+}
+
+CgroupCollector::~CgroupCollector() {
+    for (Group& group : groups_) closeFiles(group);
+    if (inotifyFd_ >= 0) close(inotifyFd_);
+}
+
+int CgroupCollector::openFile(const Group& group, int file) const {
+    std::string path = root_;
+    if (!group.path.empty()) path += "/" + group.path;
+    path += "/";
+    path += CGROUP_FILES[file];
+    return open(path.c_str(), O_RDONLY | O_CLOEXEC);
+}
+
+void CgroupCollector::closeFiles(Group& group) {
+    for (int& fd : group.fds) {
+        if (fd >= 0) {
+            close(fd);
+            --cachedFds_;
+        }
+        fd = -1;
+    }
+}
+
+void CgroupCollector::walk(const std::string& relative, int depth) {
+    std::string directory = relative.empty() ? root_ : root_ + "/" + relative;
+    DIR* dir = opendir(directory.c_str());
+    if (!dir) {
+        return; // Removed while walking
+    }
+    // Creating or removing a cgroup is a mkdir or rmdir in its parent
+    if (inotifyFd_ < 0 || inotify_add_watch(inotifyFd_, directory.c_str(), IN_CREATE | IN_DELETE | IN_ONLYDIR) < 0) {
+        watchFailed_ = true;
+    }
+    size_t self = scanned_.size();
+    scanned_.emplace_back(relative, true);
+    while (dirent* item = readdir(dir)) {
+        if (item->d_name[0] == '.') continue; // ".", "..", cgroups cannot be hidden
+        bool isDirectory = item->d_type == DT_DIR;
+        std::string child = relative.empty() ? item->d_name : relative + "/" + item->d_name;
+        if (item->d_type == DT_UNKNOWN) {
+            struct stat st;
+            isDirectory = stat((root_ + "/" + child).c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+        }
+        if (!isDirectory) continue;
+        scanned_[self].second = false;
+        if (depth < CGROUP_MAX_DEPTH) walk(child, depth + 1);
+    }
+    closedir(dir);
+}
+
+void CgroupCollector::rescan() {
+    scanned_.clear();
+    watchFailed_ = false;
+    walk("", 0);
+    std::sort(scanned_.begin(), scanned_.end());
+    lastScan_ = std::chrono::steady_clock::now();
+    dirty_ = false;
+
+    // Merge with the known cgroups: keep the survivors with their counters and files
+    merged_.clear();
+    size_t known = 0;
+    for (const auto& found : scanned_) {
+        for (; known < groups_.size() && groups_[known].path < found.first; ++known) {
+            closeFiles(groups_[known]);
+        }
+        if (known < groups_.size() && groups_[known].path == found.first) {
+            merged_.push_back(std::move(groups_[known++]));
+            merged_.back().leaf = found.second;
+            continue;
+        }
+        Group group;
+        group.path = found.first;
+        group.leaf = found.second;
+        for (int file = 0; file < FILES; ++file) {
+            group.fds[file] = -1;
+            if (cachedFds_ >= fdBudget_) continue;
+            int fd = openFile(group, file);
+            if (fd >= 0) {
+                group.fds[file] = fd;
+                ++cachedFds_;
+            } else if (errno == ENOENT) {
+                group.fds[file] = CGROUP_FILE_MISSING; // Controller not enabled there, or the root's memory.current
+            }
+        }
+        merged_.push_back(std::move(group));
+    }
+    for (; known < groups_.size(); ++known) {
+        closeFiles(groups_[known]);
+    }
+    groups_.swap(merged_);
+}
+
+bool CgroupCollector::treeChanged() {
+    if (inotifyFd_ < 0) return false;
+    bool changed = false;
+    char events[4096] __attribute__((aligned(__alignof__(inotify_event))));
+    while (read(inotifyFd_, events, sizeof(events)) > 0) {
+        changed = true; // Any event, IN_Q_OVERFLOW included, means the tree has to be walked again
+    }
+    return changed;
+}
+
+void CgroupCollector::readBatch(size_t from, size_t count, double seconds) {
+    buffers_.resize(CGROUP_BATCH * CGROUP_GROUP_BUFFER);
+    readIndex_.assign(count * FILES, -1);
+    tempFds_.clear();
+    reader_.clear();
+    for (size_t i = 0; i < count; ++i) {
+        const Group& group = groups_[from + i];
+        for (int file = 0; file < FILES; ++file) {
+            int fd = group.fds[file];
+            if (fd == CGROUP_FILE_MISSING) continue;
+            if (fd < 0) {
+                fd = openFile(group, file);
+                if (fd < 0) continue;
+                tempFds_.push_back(fd);
+            }
+            char* buffer = &buffers_[i * CGROUP_GROUP_BUFFER + CGROUP_FILE_OFFSETS[file]];
+            readIndex_[i * FILES + file] = static_cast<long>(reader_.add(fd, buffer, CGROUP_FILE_SIZES[file]));
+        }
+    }
+    reader_.run();
+    for (int fd : tempFds_) close(fd);
+
+    const double intervalUsec = seconds * 1e6;
+    for (size_t i = 0; i < count; ++i) {
+        Group& group = groups_[from + i];
+        long lengths[FILES];
+        for (int file = 0; file < FILES; ++file) {
+            long index = readIndex_[i * FILES + file];
+            lengths[file] = index >= 0 ? reader_.result(static_cast<size_t>(index)) : -1;
+        }
+        if (lengths[CPU_STAT] < 0 && group.fds[CPU_STAT] != CGROUP_FILE_MISSING) {
+            dirty_ = true; // ENODEV: removed, and the inotify event may still be on its way
+            continue;
+        }
+        const char* base = &buffers_[i * CGROUP_GROUP_BUFFER];
+
+        unsigned long long usageUsec = 0, throttledUsec = 0;
+        if (lengths[CPU_STAT] > 0) {
+            ProcScanner scan(base + CGROUP_FILE_OFFSETS[CPU_STAT], static_cast<size_t>(lengths[CPU_STAT]));
+            for (; !scan.atEnd(); scan.nextLine()) {
+                std::string_view key = scan.token();
+                if (key == "usage_usec") usageUsec = scan.number();
+                else if (key == "throttled_usec") throttledUsec = scan.number();
+            }
+        }
+        unsigned long long memoryBytes = 0;
+        if (lengths[MEMORY_CURRENT] > 0) {
+            ProcScanner scan(base + CGROUP_FILE_OFFSETS[MEMORY_CURRENT], static_cast<size_t>(lengths[MEMORY_CURRENT]));
+            memoryBytes = scan.number();
+        }
+        // One "major:minor rbytes=... wbytes=... rios=... wios=... dbytes=... dios=..." line per device
+        unsigned long long readBytes = 0, writeBytes = 0;
+        if (lengths[IO_STAT] > 0) {
+            ProcScanner scan(base + CGROUP_FILE_OFFSETS[IO_STAT], static_cast<size_t>(lengths[IO_STAT]));
+            for (; !scan.atEnd(); scan.nextLine()) {
+                scan.token();
+                for (std::string_view field = scan.token(); !field.empty(); field = scan.token()) {
+                    if (field.compare(0, 7, "rbytes=") == 0) readBytes += keyedNumber(field);
+                    else if (field.compare(0, 7, "wbytes=") == 0) writeBytes += keyedNumber(field);
+                }
+            }
+        }
+
+        CgroupSample& sample = group.sample;
+        sample.path = group.path.empty() ? "/" : group.path;
+        sample.memoryMb = static_cast<double>(memoryBytes) / (1024.0 * 1024.0);
+        if (!group.fresh && intervalUsec > 0.0) {
+            sample.cpuUsage = static_cast<double>(counterDelta(group.usageUsec, usageUsec)) / intervalUsec * 100.0;
+            sample.throttledPercent = static_cast<double>(counterDelta(group.throttledUsec, throttledUsec)) / intervalUsec * 100.0;
+            sample.readBytesPerSec = static_cast<double>(counterDelta(group.readBytes, readBytes)) / seconds;
+            sample.writeBytesPerSec = static_cast<double>(counterDelta(group.writeBytes, writeBytes)) / seconds;
+        }
+        group.usageUsec = usageUsec;
+        group.throttledUsec = throttledUsec;
+        group.readBytes = readBytes;
+        group.writeBytes = writeBytes;
+        group.fresh = false;
+    }
+}
+
+void CgroupCollector::collect() {
+    if (root_.empty()) {
+        return; // No cgroup v2 here
+    }
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    bool fallbackDue = watchFailed_ && now - lastScan_ >= std::chrono::milliseconds(CGROUP_RESCAN_FALLBACK_MS);
+    if (treeChanged() || dirty_ || fallbackDue) {
+        rescan();
+    }
+    double seconds = std::chrono::duration<double>(now - lastRead_).count();
+    lastRead_ = now;
+    for (size_t from = 0; from < groups_.size(); from += CGROUP_BATCH) {
+        readBatch(from, std::min<size_t>(CGROUP_BATCH, groups_.size() - from), seconds);
+    }
+    groupCount_ = static_cast<unsigned int>(groups_.size());
+
+    // Busiest leaves first, then by memory
+    ranked_.clear();
+    for (size_t i = 0; i < groups_.size(); ++i) {
+        if (groups_[i].leaf && !groups_[i].path.empty()) ranked_.push_back(i);
+    }
+    size_t shown = std::min<size_t>(CGROUP_TOP_COUNT, ranked_.size());
+    std::partial_sort(ranked_.begin(), ranked_.begin() + static_cast<long>(shown), ranked_.end(),
+                      [this](size_t a, size_t b) {
+                          const CgroupSample& x = groups_[a].sample;
+                          const CgroupSample& y = groups_[b].sample;
+                          return x.cpuUsage != y.cpuUsage ? x.cpuUsage > y.cpuUsage : x.memoryMb > y.memoryMb;
+                      });
+    top_.resize(shown);
+    for (size_t i = 0; i < shown; ++i) {
+        top_[i] = groups_[ranked_[i]].sample;
+    }
+}
+
+unsigned int CgroupCollector::apply(StatsSnapshot& snapshot) {
+    bool changed = updateField(snapshot.cgroupCount, groupCount_);
+    if (snapshot.cgroups != top_) {
+        snapshot.cgroups = top_;
+        changed = true;
+    }
+    return changed ? SNAPSHOT_CHANGED_CGROUPS : 0;
+}
+
+#endif
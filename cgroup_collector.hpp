@@ -0,0 +1,94 @@
+#ifndef STATS_CGROUP_COLLECTOR_HPP
+#define STATS_CGROUP_COLLECTOR_HPP
+
+#ifdef __linux__
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+#include "collector_engine.hpp"
+#include "proc_reader.hpp"
+
+#define CGROUP_TOP_COUNT 5              // Busiest cgroups shown
+#define CGROUP_MAX_FDS 16384            // Most cgroup files kept open
+#define CGROUP_BATCH 512                // Cgroups read per batch, bounds the read buffers
+#define CGROUP_RESCAN_FALLBACK_MS 10000 // Rescan period when inotify cannot watch the whole tree
+#define CGROUP_MAX_DEPTH 32
+#define CGROUP_CPU_BUFFER 512           // Per cgroup and tick: cpu.stat,
+#define CGROUP_MEMORY_BUFFER 32         // memory.current,
+#define CGROUP_IO_BUFFER 1504           // and io.stat, whose lines past that are left out
+
+/**
+ * Per-cgroup CPU, memory and I/O from the cgroup v2 hierarchy (Linux).
+ *
+ * Every cgroup's cpu.stat, memory.current and io.stat are read each tick, as
+ * batches through BatchFileReader, with the files kept open from tick to tick
+ * (up to a quarter of the open file limit, the rest are opened per read).
+ * CPU usage, throttling and I/O throughput are rates of the counter deltas.
+ * The tree is only walked again when inotify reports a cgroup created or
+ * removed; if a directory cannot be watched (fs.inotify.max_user_watches), the
+ * tree is rescanned every CGROUP_RESCAN_FALLBACK_MS instead.
+ *
+ * The busiest leaf cgroups (containers, services) go into the snapshot; their
+ * parents only add up the same usage.
+ * root is the cgroup2 mount; empty looks for it at /sys/fs/cgroup and then
+ * /sys/fs/cgroup/unified (hybrid hosts), or takes STATS_CGROUP_ROOT when set.
+ */
+class CgroupCollector : public Collector {
+public:
+    explicit CgroupCollector(unsigned int periodMs, const std::string& root = "");
+    ~CgroupCollector();
+
+    const char* name() const { return "cgroups"; }
+    unsigned int periodMs() const { return periodMs_; }
+    void collect();
+    unsigned int apply(StatsSnapshot& snapshot);
+
+private:
+    enum File { CPU_STAT, MEMORY_CURRENT, IO_STAT, FILES };
+
+    struct Group {
+        std::string path;                 // Relative to the root, "" for the root itself
+        int fds[FILES];                   // Kept-open files, -1 when not cached, -2 when the cgroup has none
+        bool leaf = true;
+        bool fresh = true;                // No previous counters yet
+        unsigned long long usageUsec = 0;
+        unsigned long long throttledUsec = 0;
+        unsigned long long readBytes = 0;
+        unsigned long long writeBytes = 0;
+        CgroupSample sample;
+    };
+
+    void rescan();
+    void walk(const std::string& relative, int depth);
+    bool treeChanged();               // Drains the inotify events
+    int openFile(const Group& group, int file) const;
+    void closeFiles(Group& group);
+    void readBatch(size_t from, size_t count, double seconds);
+
+    unsigned int periodMs_;
+    std::string root_;
+    int inotifyFd_ = -1;
+    bool watchFailed_ = false;        // Part of the tree is not watched, rescan periodically
+    bool dirty_ = true;
+    std::chrono::steady_clock::time_point lastScan_;
+    std::chrono::steady_clock::time_point lastRead_;
+    size_t cachedFds_ = 0;
+    size_t fdBudget_ = 0;
+
+    std::vector<Group> groups_;       // Sorted by path
+    // Per-rescan and per-tick working sets, members so their storage is reused
+    std::vector<std::pair<std::string, bool>> scanned_; // Path and leaf flag of every cgroup found
+    std::vector<Group> merged_;
+    BatchFileReader reader_;
+    std::vector<char> buffers_;       // CGROUP_BATCH groups of the three buffers
+    std::vector<long> readIndex_;     // Per group and file of the batch, index in reader_ or -1
+    std::vector<int> tempFds_;        // Opened for this batch only
+    std::vector<size_t> ranked_;
+    std::vector<CgroupSample> top_;
+    unsigned int groupCount_ = 0;
+};
+
+#endif
+
+#endif
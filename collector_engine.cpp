@@ -0,0 +1,187 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include "collector_engine.hpp"
+
+#define ENGINE_MAX_THREADS 4 // Collection is mostly waiting on files and pipes, a few threads are plenty
+
+// Lowers the calling thread to idle priority, so it only gets CPU time nobody else wants
+static void setIdlePriority() {
+#ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_IDLE);
+#elif defined(SCHED_IDLE)
+    sched_param param = {};
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+}
+
+CollectorEngine::CollectorEngine(unsigned int threads) {
+    if (threads == 0) {
+        unsigned int cpus = std::thread::hardware_concurrency();
+        threads = std::min<unsigned int>(ENGINE_MAX_THREADS, cpus > 1 ? cpus / 2 : 1);
+    }
+    for (unsigned int i = 0; i < threads; ++i) {
+        workers_.push_back(std::unique_ptr<Worker>(new Worker()));
+    }
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        workers_[i]->thread = std::thread(&CollectorEngine::workerLoop, this, i);
+    }
+}
+
+CollectorEngine::~CollectorEngine() {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) {
+        worker->thread.join();
+    }
+}
+
+void CollectorEngine::add(std::unique_ptr<Collector> collector) {
+    Slot slot;
+    slot.timing.name = collector->name();
+    slot.collector = std::move(collector);
+    slots_.push_back(std::move(slot));
+}
+
+unsigned int CollectorEngine::tick(StatsSnapshot& snapshot, unsigned long long nowMs) {
+    // Deal the due collectors round-robin onto the workers
+    size_t dealt = 0;
+    size_t self = workers_.size();
+    for (size_t i = 0; i < slots_.size(); ++i) {
+        Slot& slot = slots_[i];
+        slot.succeeded = false;
+        if (nowMs < slot.nextDueMs) {
+            continue;
+        }
+        slot.nextDueMs = nowMs + slot.collector->periodMs();
+        if (self == 0) {
+            runTask(i); // No pool, everything runs here
+            continue;
+        }
+        Worker& worker = *workers_[dealt % workers_.size()];
+        {
+            std::lock_guard<std::mutex> lock(stateMutex_);
+            ++pending_;
+        }
+        {
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            worker.tasks.push_back(i);
+        }
+        ++dealt;
+    }
+
+    if (dealt > 0) {
+        {
+            std::lock_guard<std::mutex> lock(stateMutex_);
+            ++generation_;
+        }
+        wake_.notify_all();
+
+        // Help instead of only waiting, then wait for the tasks still running on workers
+        size_t task;
+        while (takeTask(self, task)) {
+            runTask(task);
+        }
+        std::unique_lock<std::mutex> lock(stateMutex_);
+        done_.wait(lock, [this] { return pending_ == 0; });
+    }
+
+    unsigned int changed = 0;
+    for (Slot& slot : slots_) {
+        if (slot.succeeded) {
+            changed |= slot.collector->apply(snapshot);
+        }
+    }
+    return changed;
+}
+
+void CollectorEngine::expedite(const std::string& name) {
+    for (Slot& slot : slots_) {
+        if (slot.timing.name == name) slot.nextDueMs = 0;
+    }
+}
+
+std::vector<CollectorTiming> CollectorEngine::timings() const {
+    std::vector<CollectorTiming> result;
+    for (const Slot& slot : slots_) {
+        result.push_back(slot.timing);
+    }
+    return result;
+}
+
+void CollectorEngine::workerLoop(size_t self) {
+    setIdlePriority();
+    unsigned long long seen = 0;
+    for (;;) {
+        size_t task;
+        if (takeTask(self, task)) {
+            runTask(task);
+            continue;
+        }
+        // Nothing left anywhere; sleep unless a new tick was dealt since the deques were checked
+        std::unique_lock<std::mutex> lock(stateMutex_);
+        wake_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+        if (stopping_) {
+            return;
+        }
+        seen = generation_;
+    }
+}
+
+bool CollectorEngine::takeTask(size_t self, size_t& task) {
+    // Own deque first, newest task first
+    if (self < workers_.size()) {
+        Worker& own = *workers_[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    // Then steal the oldest task of another worker, starting with the next one
+    for (size_t n = 1; n <= workers_.size(); ++n) {
+        Worker& victim = *workers_[(self + n) % workers_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void CollectorEngine::runTask(size_t task) {
+    Slot& slot = slots_[task];
+    auto start = std::chrono::steady_clock::now();
+    try {
+        slot.collector->collect();
+        slot.succeeded = true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error in collector " << slot.timing.name << ": " << e.what() << std::endl;
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    slot.timing.lastMs = ms;
+    slot.timing.maxMs = std::max(slot.timing.maxMs, ms);
+    slot.timing.totalMs += ms;
+    ++slot.timing.runs;
+
+    if (workers_.empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(stateMutex_);
+    if (--pending_ == 0) {
+        done_.notify_all();
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef STATS_COLLECTOR_ENGINE_HPP
+#define STATS_COLLECTOR_ENGINE_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "snapshot.hpp"
+
+// One source of data for the snapshot, e.g. CPU usage or a GPU backend.
+// Collection happens in two steps so that collectors can run in parallel and still
+// produce one coherent snapshot: collect() runs on a pool thread and may only touch
+// the collector's own state, then apply() runs on the engine's thread after every
+// collector of the tick has finished and copies the results into the snapshot.
+class Collector {
+public:
+    virtual ~Collector() {}
+    virtual const char* name() const = 0;
+    // How often the collector is due, a multiple of the tick period in practice
+    virtual unsigned int periodMs() const = 0;
+    // May throw, the error is logged and apply() skipped for that tick
+    virtual void collect() = 0;
+    // Returns the SNAPSHOT_CHANGED_* bits of what it changed
+    virtual unsigned int apply(StatsSnapshot& snapshot) = 0;
+};
+
+struct CollectorTiming {
+    std::string name;
+    double lastMs = 0.0; // Wall time of the last collect()
+    double maxMs = 0.0;
+    double totalMs = 0.0;
+    unsigned long long runs = 0;
+};
+
+/**
+ * Runs the due collectors of every tick as tasks on a small work-stealing pool.
+ *
+ * tick() deals the due collectors round-robin onto the workers' deques and wakes
+ * them. A worker pops from the back of its own deque and, once that is empty,
+ * steals from the front of the others', so the collectors dealt behind a slow one
+ * run elsewhere instead of queueing after it. The calling thread steals too
+ * instead of just waiting. When everything has run, the collectors are applied
+ * in the order they were added.
+ * tick() still waits for every due collector, so a tick lasts at least as long as
+ * its slowest collect(): while nvidia-smi runs (up to 2 s, whether GpuCollector
+ * blocks on it or a ReactorCollector awaits it) the tick does not end. Stealing
+ * only keeps the other collectors from adding their time to that.
+ * Workers run at idle priority (SCHED_IDLE on Linux, THREAD_PRIORITY_IDLE on
+ * Windows), in line with the monitor's IDLE_PRIORITY_CLASS: collection only
+ * uses cycles the real workload leaves over.
+ */
+class CollectorEngine {
+public:
+    // threads = 0 picks a small pool sized from the number of CPUs
+    explicit CollectorEngine(unsigned int threads = 0);
+    ~CollectorEngine();
+
+    CollectorEngine(const CollectorEngine&) = delete;
+    CollectorEngine& operator=(const CollectorEngine&) = delete;
+
+    // Not while a tick is running
+    void add(std::unique_ptr<Collector> collector);
+    // Runs every due collector, waits for all of them and applies them to snapshot.
+    // Returns the SNAPSHOT_CHANGED_* bits of what changed.
+    unsigned int tick(StatsSnapshot& snapshot, unsigned long long nowMs);
+    // Makes the collector with this name due on the next tick, whatever its period.
+    // Not while a tick is running.
+    void expedite(const std::string& name);
+    // Per-collector wall times, from the thread that calls tick()
+    std::vector<CollectorTiming> timings() const;
+
+private:
+    struct Slot {
+        std::unique_ptr<Collector> collector;
+        unsigned long long nextDueMs = 0;
+        bool succeeded = false; // In the current tick
+        CollectorTiming timing;
+    };
+    struct Worker {
+        std::mutex mutex;
+        std::deque<size_t> tasks; // Indexes into slots_
+        std::thread thread;
+    };
+
+    void workerLoop(size_t self);
+    bool takeTask(size_t self, size_t& task); // self == workers_.size() for the calling thread
+    void runTask(size_t task);
+
+    std::vector<Slot> slots_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::mutex stateMutex_;
+    std::condition_variable wake_;   // Workers: a new tick was dealt, or stopping_
+    std::condition_variable done_;   // tick(): the last task finished
+    unsigned long long generation_ = 0;
+    size_t pending_ = 0;             // Tasks of the current tick not finished yet
+    bool stopping_ = false;
+};
+
+#endif
@@ -0,0 +1,116 @@
+#include "disk_collector.hpp"
+
+#ifdef __linux__
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+DiskCollector::DiskCollector(unsigned int periodMs, const char* path)
+    : periodMs_(periodMs), file_(path), slots_(DISK_MAX_SLOTS) {
+    lineSlots_.reserve(DISK_MAX_SLOTS);
+    active_.reserve(DISK_MAX_SLOTS);
+}
+
+size_t DiskCollector::findSlot(unsigned long long device, size_t hint) {
+    if (hint < slots_.size() && slots_[hint].used && slots_[hint].device == device) {
+        return hint;
+    }
+    size_t free = slots_.size();
+    for (size_t i = 0; i < slots_.size(); ++i) {
+        if (slots_[i].used && slots_[i].device == device) return i;
+        if (!slots_[i].used && free == slots_.size()) free = i;
+    }
+    if (free < slots_.size()) {
+        Slot& slot = slots_[free];
+        slot.used = true;
+        slot.fresh = true;
+        slot.device = device;
+    }
+    return free; // slots_.size() when the table is full
+}
+
+void DiskCollector::collect() {
+    long length = file_.read(buffer_);
+    if (length < 0) {
+        throw std::runtime_error("Cannot read /proc/diskstats");
+    }
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(now - lastRead_).count();
+    double intervalMs = seconds * 1000.0;
+    lastRead_ = now;
+    ++tick_;
+
+    // Line format: major minor name reads merged sectors ms writes merged sectors ms in-flight io-ms weighted-ms ...
+    ProcScanner scan(buffer_.data(), static_cast<size_t>(length));
+    active_.clear();
+    size_t line = 0;
+    for (; !scan.atEnd(); scan.nextLine(), ++line) {
+        unsigned long long major = scan.number();
+        unsigned long long minor = scan.number();
+        std::string_view name = scan.token();
+        if (name.empty()) continue;
+        unsigned long long fields[11];
+        for (unsigned long long& field : fields) field = scan.number();
+        unsigned long long current[COUNTERS] = {fields[0], fields[2], fields[3], fields[4],
+                                                fields[6], fields[7], fields[9], fields[10]};
+
+        size_t index = findSlot(major << 32 | minor, line < lineSlots_.size() ? lineSlots_[line] : slots_.size());
+        if (line < lineSlots_.size()) lineSlots_[line] = index;
+        else lineSlots_.push_back(index);
+        if (index == slots_.size()) continue;
+        Slot& slot = slots_[index];
+        slot.seenTick = tick_;
+        if (slot.fresh) {
+            size_t size = std::min(name.size(), sizeof(slot.sample.name) - 1);
+            std::memcpy(slot.sample.name, name.data(), size);
+            slot.sample.name[size] = '\0';
+            std::memcpy(slot.counters, current, sizeof(current));
+            slot.fresh = false;
+            continue;
+        }
+
+        unsigned long long delta[COUNTERS];
+        for (int c = 0; c < COUNTERS; ++c) delta[c] = counterDelta(slot.counters[c], current[c]);
+        std::memcpy(slot.counters, current, sizeof(current));
+        unsigned long long ios = delta[READS] + delta[WRITES];
+        if (seconds <= 0.0 || (ios == 0 && delta[IO_MS] == 0)) continue;
+
+        DiskSample& sample = slot.sample;
+        sample.readIops = static_cast<double>(delta[READS]) / seconds;
+        sample.writeIops = static_cast<double>(delta[WRITES]) / seconds;
+        sample.readBytesPerSec = static_cast<double>(delta[READ_SECTORS]) * DISK_SECTOR_BYTES / seconds;
+        sample.writeBytesPerSec = static_cast<double>(delta[WRITE_SECTORS]) * DISK_SECTOR_BYTES / seconds;
+        sample.utilization = std::min(100.0, static_cast<double>(delta[IO_MS]) / intervalMs * 100.0);
+        sample.awaitMs = ios ? static_cast<double>(delta[READ_MS] + delta[WRITE_MS]) / static_cast<double>(ios) : 0.0;
+        sample.queueDepth = static_cast<double>(delta[WEIGHTED_MS]) / intervalMs;
+        active_.push_back(index);
+    }
+    lineSlots_.resize(line);
+
+    // Free the slots of devices that are gone
+    for (Slot& slot : slots_) {
+        if (slot.used && slot.seenTick != tick_) slot.used = false;
+    }
+
+    // Busiest first, then by throughput
+    size_t shown = std::min<size_t>(DISK_TOP_COUNT, active_.size());
+    std::partial_sort(active_.begin(), active_.begin() + static_cast<long>(shown), active_.end(),
+                      [this](size_t a, size_t b) {
+                          const DiskSample& x = slots_[a].sample;
+                          const DiskSample& y = slots_[b].sample;
+                          if (x.utilization != y.utilization) return x.utilization > y.utilization;
+                          return x.readBytesPerSec + x.writeBytesPerSec > y.readBytesPerSec + y.writeBytesPerSec;
+                      });
+    top_.resize(shown);
+    for (size_t i = 0; i < shown; ++i) {
+        top_[i] = slots_[active_[i]].sample;
+    }
+}
+
+unsigned int DiskCollector::apply(StatsSnapshot& snapshot) {
+    if (snapshot.disks == top_) return 0;
+    snapshot.disks = top_;
+    return SNAPSHOT_CHANGED_DISKS;
+}
+
+#endif
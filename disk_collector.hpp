@@ -0,0 +1,62 @@
+#ifndef STATS_DISK_COLLECTOR_HPP
+#define STATS_DISK_COLLECTOR_HPP
+
+#ifdef __linux__
+#include <chrono>
+#include <vector>
+#include "collector_engine.hpp"
+#include "proc_reader.hpp"
+
+#define DISK_TOP_COUNT 4       // Busiest devices shown
+#define DISK_MAX_SLOTS 1024    // Devices tracked; more than that are ignored
+#define DISK_SECTOR_BYTES 512  // /proc/diskstats counts 512-byte sectors whatever the device uses
+
+/**
+ * Block device throughput and latency from /proc/diskstats (Linux).
+ *
+ * Every tick re-reads the file in place (see ProcFile) and scans it with
+ * ProcScanner, turning the counter deltas into IOPS, bytes/s, utilization,
+ * average latency and queue depth per device, like iostat -x. Each device has
+ * a slot in a table sized once; the file lists devices in the same order from
+ * tick to tick, so the slot of line n is found at the slot used for line n
+ * last time, with a search only when devices come or go. A tick allocates
+ * nothing once the read buffer has grown to the file's size.
+ */
+class DiskCollector : public Collector {
+public:
+    explicit DiskCollector(unsigned int periodMs, const char* path = "/proc/diskstats");
+
+    const char* name() const { return "disks"; }
+    unsigned int periodMs() const { return periodMs_; }
+    void collect();
+    unsigned int apply(StatsSnapshot& snapshot);
+
+private:
+    // The diskstats fields used, in the order kept in Slot::counters
+    enum Counter { READS, READ_SECTORS, READ_MS, WRITES, WRITE_SECTORS, WRITE_MS, IO_MS, WEIGHTED_MS, COUNTERS };
+
+    struct Slot {
+        bool used = false;
+        bool fresh = true;              // No previous counters yet
+        unsigned long long device = 0;  // major << 32 | minor
+        unsigned long long seenTick = 0;
+        unsigned long long counters[COUNTERS] = {};
+        DiskSample sample;
+    };
+
+    size_t findSlot(unsigned long long device, size_t hint);
+
+    unsigned int periodMs_;
+    ProcFile file_;
+    std::vector<char> buffer_;
+    std::vector<Slot> slots_;           // DISK_MAX_SLOTS, allocated once
+    std::vector<size_t> lineSlots_;     // Slot of each line of the previous read
+    std::vector<size_t> active_;        // Slots that did I/O this tick
+    unsigned long long tick_ = 0;
+    std::chrono::steady_clock::time_point lastRead_;
+    std::vector<DiskSample> top_;
+};
+
+#endif
+
+#endif
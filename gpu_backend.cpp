@@ -0,0 +1,220 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include "gpu_backend.hpp"
+
+// The subset of the NVML ABI used here, declared locally so no NVML headers are needed.
+// Every function returns an nvmlReturn_t, 0 being NVML_SUCCESS.
+#define NVML_SUCCESS 0
+#define NVML_TEMPERATURE_GPU 0
+#define NVML_DEVICE_NAME_BUFFER_SIZE 96
+#define NVML_SYSTEM_DRIVER_VERSION_BUFFER_SIZE 80
+#define NVML_DEVICE_UUID_BUFFER_SIZE 80
+#define NVML_CLOCK_SM 1
+#define NVML_CLOCK_MEM 2
+#define NVML_PCIE_UTIL_TX_BYTES 0
+#define NVML_PCIE_UTIL_RX_BYTES 1
+#define NVML_MEMORY_ERROR_TYPE_CORRECTED 0
+#define NVML_MEMORY_ERROR_TYPE_UNCORRECTED 1
+#define NVML_VOLATILE_ECC 0
+
+typedef void* nvmlDevice_t;
+struct nvmlMemory_t { unsigned long long total, free, used; };
+struct nvmlUtilization_t { unsigned int gpu, memory; };
+
+struct NvmlGpuBackend::Api {
+    int (*init)();
+    int (*shutdown)();
+    int (*deviceGetCount)(unsigned int*);
+    int (*deviceGetHandleByIndex)(unsigned int, nvmlDevice_t*);
+    int (*deviceGetName)(nvmlDevice_t, char*, unsigned int);
+    int (*systemGetDriverVersion)(char*, unsigned int);
+    int (*deviceGetTemperature)(nvmlDevice_t, int, unsigned int*);
+    int (*deviceGetMemoryInfo)(nvmlDevice_t, nvmlMemory_t*);
+    int (*deviceGetUtilizationRates)(nvmlDevice_t, nvmlUtilization_t*);
+    int (*deviceGetUUID)(nvmlDevice_t, char*, unsigned int); // Optional
+    // Optional too, for the extended counters; a missing or failing one leaves its value at 0
+    int (*deviceGetPowerUsage)(nvmlDevice_t, unsigned int*);              // mW
+    int (*deviceGetEnforcedPowerLimit)(nvmlDevice_t, unsigned int*);      // mW
+    int (*deviceGetClockInfo)(nvmlDevice_t, int, unsigned int*);          // MHz
+    int (*deviceGetPcieThroughput)(nvmlDevice_t, int, unsigned int*);     // KB/s
+    int (*deviceGetEncoderUtilization)(nvmlDevice_t, unsigned int*, unsigned int*);
+    int (*deviceGetDecoderUtilization)(nvmlDevice_t, unsigned int*, unsigned int*);
+    int (*deviceGetTotalEccErrors)(nvmlDevice_t, int, int, unsigned long long*);
+    int (*deviceGetCurrentClocksThrottleReasons)(nvmlDevice_t, unsigned long long*);
+};
+
+static void* openLibrary(const char* path) {
+#ifdef _WIN32
+    return LoadLibraryA(path);
+#else
+    return dlopen(path, RTLD_NOW | RTLD_LOCAL);
+#endif
+}
+
+static void closeLibrary(void* library) {
+#ifdef _WIN32
+    FreeLibrary(static_cast<HMODULE>(library));
+#else
+    dlclose(library);
+#endif
+}
+
+// Resolves a symbol into a typed function pointer, returns false if it is missing
+template <typename Fn>
+static bool resolve(void* library, const char* symbol, Fn& fn) {
+#ifdef _WIN32
+    fn = reinterpret_cast<Fn>(GetProcAddress(static_cast<HMODULE>(library), symbol));
+#else
+    fn = reinterpret_cast<Fn>(dlsym(library, symbol));
+#endif
+    return fn != nullptr;
+}
+
+std::unique_ptr<NvmlGpuBackend> NvmlGpuBackend::load() {
+    void* library = nullptr;
+    const char* overridePath = std::getenv("STATS_NVML_LIBRARY");
+    if (overridePath && *overridePath) {
+        library = openLibrary(overridePath);
+    } else {
+#ifdef _WIN32
+        // System32 for current drivers, the NVSMI folder for older ones
+        library = openLibrary("nvml.dll");
+        if (!library) library = openLibrary("C:\\Program Files\\NVIDIA Corporation\\NVSMI\\nvml.dll");
+#else
+        library = openLibrary("libnvidia-ml.so.1");
+#endif
+    }
+    if (!library) return nullptr;
+
+    std::unique_ptr<Api> api(new Api());
+    bool resolved = resolve(library, "nvmlInit_v2", api->init)
+        && resolve(library, "nvmlShutdown", api->shutdown)
+        && resolve(library, "nvmlDeviceGetCount_v2", api->deviceGetCount)
+        && resolve(library, "nvmlDeviceGetHandleByIndex_v2", api->deviceGetHandleByIndex)
+        && resolve(library, "nvmlDeviceGetName", api->deviceGetName)
+        && resolve(library, "nvmlSystemGetDriverVersion", api->systemGetDriverVersion)
+        && resolve(library, "nvmlDeviceGetTemperature", api->deviceGetTemperature)
+        && resolve(library, "nvmlDeviceGetMemoryInfo", api->deviceGetMemoryInfo)
+        && resolve(library, "nvmlDeviceGetUtilizationRates", api->deviceGetUtilizationRates);
+    resolve(library, "nvmlDeviceGetUUID", api->deviceGetUUID);
+    resolve(library, "nvmlDeviceGetPowerUsage", api->deviceGetPowerUsage);
+    resolve(library, "nvmlDeviceGetEnforcedPowerLimit", api->deviceGetEnforcedPowerLimit);
+    resolve(library, "nvmlDeviceGetClockInfo", api->deviceGetClockInfo);
+    resolve(library, "nvmlDeviceGetPcieThroughput", api->deviceGetPcieThroughput);
+    resolve(library, "nvmlDeviceGetEncoderUtilization", api->deviceGetEncoderUtilization);
+    resolve(library, "nvmlDeviceGetDecoderUtilization", api->deviceGetDecoderUtilization);
+    resolve(library, "nvmlDeviceGetTotalEccErrors", api->deviceGetTotalEccErrors);
+    resolve(library, "nvmlDeviceGetCurrentClocksThrottleReasons", api->deviceGetCurrentClocksThrottleReasons);
+    if (!resolved || api->init() != NVML_SUCCESS) {
+        closeLibrary(library);
+        return nullptr;
+    }
+
+    // Same device as the nvidia-smi path shows: the first one
+    unsigned int count = 0;
+    nvmlDevice_t device = nullptr;
+    if (api->deviceGetCount(&count) != NVML_SUCCESS || count == 0 ||
+        api->deviceGetHandleByIndex(0, &device) != NVML_SUCCESS) {
+        api->shutdown();
+        closeLibrary(library);
+        return nullptr;
+    }
+
+    std::unique_ptr<NvmlGpuBackend> backend(new NvmlGpuBackend());
+    char name[NVML_DEVICE_NAME_BUFFER_SIZE] = "";
+    char driver[NVML_SYSTEM_DRIVER_VERSION_BUFFER_SIZE] = "";
+    char uuid[NVML_DEVICE_UUID_BUFFER_SIZE] = "";
+    api->deviceGetName(device, name, sizeof(name));
+    api->systemGetDriverVersion(driver, sizeof(driver));
+    if (api->deviceGetUUID) api->deviceGetUUID(device, uuid, sizeof(uuid));
+    backend->deviceName_ = name;
+    backend->driverVersion_ = driver;
+    backend->uuid_ = uuid;
+    backend->library_ = library;
+    backend->device_ = device;
+    backend->api_ = std::move(api);
+    return backend;
+}
+
+NvmlGpuBackend::NvmlGpuBackend() {}
+
+NvmlGpuBackend::~NvmlGpuBackend() {
+    if (api_) api_->shutdown();
+    if (library_) closeLibrary(library_);
+}
+
+bool NvmlGpuBackend::query(GpuData& data) {
+    unsigned int temperature = 0;
+    nvmlMemory_t memory;
+    nvmlUtilization_t utilization;
+    if (api_->deviceGetTemperature(device_, NVML_TEMPERATURE_GPU, &temperature) != NVML_SUCCESS ||
+        api_->deviceGetMemoryInfo(device_, &memory) != NVML_SUCCESS ||
+        api_->deviceGetUtilizationRates(device_, &utilization) != NVML_SUCCESS) {
+        throw std::runtime_error("NVML query failed");
+    }
+
+    // The descriptor only changes on the first query, after that this is a few compares
+    bool descriptorChanged = updateField(data.name, deviceName_.c_str());
+    descriptorChanged |= updateField(data.driverVersion, driverVersion_.c_str());
+    descriptorChanged |= updateField(data.uuid, uuid_.c_str());
+    descriptorChanged |= updateField(data.memoryTotal, memory.total / (1024.0 * 1024.0 * 1024.0)); // Bytes to GB
+    if (descriptorChanged) ++data.generation;
+
+    data.temperature = temperature;
+    data.memoryUsed = memory.used / (1024.0 * 1024.0 * 1024.0);
+    data.utilizationGpu = utilization.gpu;
+    queryExtended(data.extended);
+    return true;
+}
+
+void NvmlGpuBackend::queryExtended(GpuExtendedCounters& out) const {
+    const Api& api = *api_;
+    out = GpuExtendedCounters();
+    unsigned int value = 0, samplingUs = 0;
+    if (api.deviceGetPowerUsage && api.deviceGetPowerUsage(device_, &value) == NVML_SUCCESS) out.powerDraw = value / 1000.0;
+    if (api.deviceGetEnforcedPowerLimit && api.deviceGetEnforcedPowerLimit(device_, &value) == NVML_SUCCESS) {
+        out.powerLimit = value / 1000.0;
+    }
+    if (api.deviceGetClockInfo) {
+        if (api.deviceGetClockInfo(device_, NVML_CLOCK_SM, &value) == NVML_SUCCESS) out.smClock = value;
+        if (api.deviceGetClockInfo(device_, NVML_CLOCK_MEM, &value) == NVML_SUCCESS) out.memoryClock = value;
+    }
+    // Each PCIe call measures the link over 20 ms, on the collector's pool thread rather than the UI's
+    if (api.deviceGetPcieThroughput) {
+        if (api.deviceGetPcieThroughput(device_, NVML_PCIE_UTIL_RX_BYTES, &value) == NVML_SUCCESS) out.pcieRx = value;
+        if (api.deviceGetPcieThroughput(device_, NVML_PCIE_UTIL_TX_BYTES, &value) == NVML_SUCCESS) out.pcieTx = value;
+    }
+    if (api.deviceGetEncoderUtilization && api.deviceGetEncoderUtilization(device_, &value, &samplingUs) == NVML_SUCCESS) {
+        out.utilizationEncoder = value;
+    }
+    if (api.deviceGetDecoderUtilization && api.deviceGetDecoderUtilization(device_, &value, &samplingUs) == NVML_SUCCESS) {
+        out.utilizationDecoder = value;
+    }
+    unsigned long long count = 0;
+    if (api.deviceGetTotalEccErrors) {
+        // NOT_SUPPORTED on consumer cards, the counts then stay 0
+        if (api.deviceGetTotalEccErrors(device_, NVML_MEMORY_ERROR_TYPE_CORRECTED, NVML_VOLATILE_ECC, &count) == NVML_SUCCESS) {
+            out.eccCorrected = count;
+        }
+        if (api.deviceGetTotalEccErrors(device_, NVML_MEMORY_ERROR_TYPE_UNCORRECTED, NVML_VOLATILE_ECC, &count) == NVML_SUCCESS) {
+            out.eccUncorrected = count;
+        }
+    }
+    unsigned long long reasons = 0;
+    if (api.deviceGetCurrentClocksThrottleReasons &&
+        api.deviceGetCurrentClocksThrottleReasons(device_, &reasons) == NVML_SUCCESS) {
+        out.throttleReasons = static_cast<unsigned int>(reasons);
+    }
+}
+
+std::unique_ptr<GpuBackend> selectGpuBackend(std::unique_ptr<GpuBackend> fallback) {
+    std::unique_ptr<NvmlGpuBackend> nvml = NvmlGpuBackend::load();
+    if (nvml) return std::unique_ptr<GpuBackend>(std::move(nvml));
+    return fallback;
+}
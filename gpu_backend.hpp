@@ -0,0 +1,53 @@
+#ifndef STATS_GPU_BACKEND_HPP
+#define STATS_GPU_BACKEND_HPP
+
+#include <memory>
+#include "snapshot.hpp"
+
+// Source of the GPU numbers. query() updates data in place: the counters every call, the
+// descriptor only when it changed, bumping its generation. It returns false when no data
+// is available this tick and throws std::runtime_error when the backend itself failed.
+class GpuBackend {
+public:
+    virtual ~GpuBackend() {}
+    virtual const char* name() const = 0;
+    virtual bool query(GpuData& data) = 0;
+    // The configured extra fields (see gpu_fields.hpp) from the last successful query,
+    // or nullptr for a backend that cannot provide them
+    virtual const GpuFieldRecord* fields() const { return nullptr; }
+};
+
+/**
+ * In-process backend: loads the NVIDIA management library (nvml.dll /
+ * libnvidia-ml.so.1) at runtime and calls its per-field query functions
+ * directly, instead of spawning nvidia-smi and parsing its XML every tick.
+ * The STATS_NVML_LIBRARY environment variable overrides the library path,
+ * e.g. to point at a stub implementing the same ABI on machines without a GPU.
+ */
+class NvmlGpuBackend : public GpuBackend {
+public:
+    // Returns nullptr if the library is absent or does not initialize
+    static std::unique_ptr<NvmlGpuBackend> load();
+    ~NvmlGpuBackend();
+
+    const char* name() const { return "nvml"; }
+    bool query(GpuData& data);
+
+    struct Api; // Resolved entry points
+
+private:
+    NvmlGpuBackend();
+    void queryExtended(GpuExtendedCounters& out) const;
+
+    void* library_ = nullptr;
+    std::unique_ptr<Api> api_;
+    void* device_ = nullptr;
+    std::string deviceName_;    // Static for the life of the process, fetched once
+    std::string driverVersion_;
+    std::string uuid_;
+};
+
+// Picks the in-process backend when the library is there, the given fallback otherwise
+std::unique_ptr<GpuBackend> selectGpuBackend(std::unique_ptr<GpuBackend> fallback);
+
+#endif
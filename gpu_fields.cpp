@@ -0,0 +1,258 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include "gpu_fields.hpp"
+#include "value_parse.hpp"
+
+#define GPU_FIELD_VALUE_MAX 256 // Longest value kept, including the terminator
+
+std::vector<GpuFieldSpec> loadGpuFieldSpecs() {
+    std::vector<GpuFieldSpec> specs;
+    const char* path = std::getenv("STATS_GPU_FIELDS");
+    if (!path || !*path) {
+        return specs;
+    }
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error(std::string("Cannot read GPU field list ") + path);
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        std::istringstream fields(line);
+        GpuFieldSpec spec;
+        std::string type;
+        if (!(fields >> spec.name) || spec.name[0] == '#') {
+            continue;
+        }
+        fields >> type;
+        std::getline(fields >> std::ws, spec.xpath);
+        if ((type != "number" && type != "text") || spec.xpath.empty()) {
+            throw std::runtime_error(std::string(path) + ":" + std::to_string(lineNumber) +
+                                     ": expected <name> <number|text> <xpath>");
+        }
+        spec.isText = (type == "text");
+        specs.push_back(spec);
+    }
+    return specs;
+}
+
+#ifndef PUGIXML_NO_XPATH
+
+GpuFieldQueryCache::GpuFieldQueryCache(const std::vector<GpuFieldSpec>& specs) {
+    fields_.reserve(specs.size());
+    for (const GpuFieldSpec& spec : specs) {
+        try {
+            fields_.push_back(Field{spec.name, spec.isText, pugi::xpath_query(spec.xpath.c_str())});
+        } catch (const pugi::xpath_exception& e) {
+            std::cerr << "GPU field " << spec.name << " ignored, bad XPath \"" << spec.xpath
+                      << "\": " << e.what() << std::endl;
+        }
+    }
+}
+
+// Leading number of a value like "250.50 W"; NaN for "N/A", "[N/A]" and the like
+static double leadingNumber(const char* value) {
+    double number = std::numeric_limits<double>::quiet_NaN();
+    parseDouble(value, number);
+    return number;
+}
+
+void GpuFieldQueryCache::extract(const pugi::xml_document& doc, GpuFieldRecord& record) const {
+    pugi::xml_node root = doc.child("nvidia_smi_log");
+    size_t gpuCount = 0;
+    for (pugi::xml_node gpu = root.child("gpu"); gpu; gpu = gpu.next_sibling("gpu")) {
+        ++gpuCount;
+    }
+
+    // Only rebuild the layout when the field list or the number of GPUs changed
+    size_t cells = fields_.size() * gpuCount;
+    if (record.names.size() != fields_.size() || record.gpuCount != gpuCount) {
+        record.names.clear();
+        record.isText.clear();
+        for (const Field& field : fields_) {
+            record.names.push_back(field.name);
+            record.isText.push_back(field.isText);
+        }
+        record.gpuCount = gpuCount;
+        record.numbers.assign(cells, std::numeric_limits<double>::quiet_NaN());
+        record.texts.assign(cells, std::string());
+    }
+
+    // Field by field, so each column is written front to back
+    char value[GPU_FIELD_VALUE_MAX];
+    for (size_t f = 0; f < fields_.size(); ++f) {
+        const Field& field = fields_[f];
+        size_t cell = f * gpuCount;
+        for (pugi::xml_node gpu = root.child("gpu"); gpu; gpu = gpu.next_sibling("gpu"), ++cell) {
+            if (!field.isText && field.query.return_type() == pugi::xpath_type_number) {
+                record.numbers[cell] = field.query.evaluate_number(gpu);
+                continue;
+            }
+            // Truncated into value. The strings the evaluation builds on the way (concat(), a
+            // node's text in some cases) come from pugixml's scratch blocks on the stack and
+            // only reach the heap once they outgrow them, so this is allocation-free in the
+            // common case, not guaranteed to be.
+            field.query.evaluate_string(value, sizeof(value), gpu);
+            if (field.isText) {
+                record.texts[cell].assign(value);
+            } else {
+                record.numbers[cell] = leadingNumber(value);
+            }
+        }
+    }
+}
+
+#else
+
+GpuFieldQueryCache::GpuFieldQueryCache(const std::vector<GpuFieldSpec>& specs) {
+    if (!specs.empty()) {
+        std::cerr << "GPU fields ignored, this build has no XPath support (STATS_XML_PROFILE)" << std::endl;
+    }
+}
+
+void GpuFieldQueryCache::extract(const pugi::xml_document&, GpuFieldRecord& record) const {
+    record = GpuFieldRecord();
+}
+
+#endif
+
+// Memory size of an nvidia-smi value like "81920 MiB", in GB
+static bool parseMemoryGb(const char* text, double& out) {
+    ParsedValue value = parseValue(text);
+    if (value.status != VALUE_OK) {
+        return false;
+    }
+    double toMiB = memoryUnitToMiB(value.unit);
+    out = value.number * (toMiB > 0.0 ? toMiB : 1.0) / 1024; // nvidia-smi reports MiB
+    return true;
+}
+
+const GpuThrottleName GPU_THROTTLE_NAMES[GPU_THROTTLE_NAME_COUNT] = {
+    {"gpu_idle", GPU_THROTTLE_IDLE},
+    {"applications_clocks_setting", GPU_THROTTLE_APPLICATION_CLOCKS},
+    {"sw_power_cap", GPU_THROTTLE_SW_POWER_CAP},
+    {"hw_slowdown", GPU_THROTTLE_HW_SLOWDOWN},
+    {"sync_boost", GPU_THROTTLE_SYNC_BOOST},
+    {"sw_thermal_slowdown", GPU_THROTTLE_SW_THERMAL},
+    {"hw_thermal_slowdown", GPU_THROTTLE_HW_THERMAL},
+    {"hw_power_brake_slowdown", GPU_THROTTLE_HW_POWER_BRAKE},
+    {"display_clocks_setting", GPU_THROTTLE_DISPLAY_CLOCKS},
+};
+
+// Text of the first of the children that exists, for fields renamed across driver versions
+static const char* firstChildText(pugi::xml_node node, const char* a, const char* b, const char* c = nullptr) {
+    pugi::xml_node found = node.child(a);
+    if (!found) found = node.child(b);
+    if (!found && c) found = node.child(c);
+    return found.text().get();
+}
+
+// The sections are picked in one walk over the children of the <gpu> node, which finds them
+// under either driver's name in a single pass; on an 8-GPU document this costs about the same
+// as a child() lookup per section, roughly 1.5 us per GPU
+void parseGpuExtended(pugi::xml_node gpu_node, GpuExtendedCounters& out) {
+    for (pugi::xml_node section = gpu_node.first_child(); section; section = section.next_sibling()) {
+        const char* name = section.name();
+        if (std::strcmp(name, "pci") == 0) {
+            parseDouble(section.child("rx_util").text().get(), out.pcieRx); // KB/s
+            parseDouble(section.child("tx_util").text().get(), out.pcieTx);
+        } else if (std::strcmp(name, "clocks_event_reasons") == 0 || std::strcmp(name, "clocks_throttle_reasons") == 0) {
+            for (pugi::xml_node reason = section.first_child(); reason; reason = reason.next_sibling()) {
+                if (std::strcmp(reason.text().get(), "Active") != 0) continue; // Usually "Not Active"
+                const char* suffix = std::strstr(reason.name(), "reason_");
+                if (!suffix) continue;
+                for (const auto& known : GPU_THROTTLE_NAMES) {
+                    if (std::strcmp(suffix + 7, known.name) == 0) out.throttleReasons |= known.bit;
+                }
+            }
+        } else if (std::strcmp(name, "utilization") == 0) {
+            parseUnsigned(section.child("encoder_util").text().get(), out.utilizationEncoder);
+            parseUnsigned(section.child("decoder_util").text().get(), out.utilizationDecoder);
+        } else if (std::strcmp(name, "ecc_errors") == 0) {
+            // Ampere and later: sram_/dram_ (un)correctable; before: single_bit/double_bit totals
+            for (pugi::xml_node counter = section.child("volatile").first_child(); counter; counter = counter.next_sibling()) {
+                const char* kind = counter.name();
+                const char* text = counter.text().get();
+                if (std::strcmp(kind, "single_bit") == 0 || std::strcmp(kind, "double_bit") == 0) {
+                    text = counter.child("total").text().get();
+                }
+                unsigned int count = 0;
+                if (!parseUnsigned(text, count)) continue;
+                bool uncorrected = std::strstr(kind, "uncorrectable") || std::strcmp(kind, "double_bit") == 0;
+                (uncorrected ? out.eccUncorrected : out.eccCorrected) += count;
+            }
+        } else if (std::strcmp(name, "gpu_power_readings") == 0 || std::strcmp(name, "power_readings") == 0) {
+            parseDouble(firstChildText(section, "power_draw", "instant_power_draw"), out.powerDraw);
+            parseDouble(firstChildText(section, "current_power_limit", "enforced_power_limit", "power_limit"), out.powerLimit);
+        } else if (std::strcmp(name, "clocks") == 0) {
+            parseUnsigned(section.child("sm_clock").text().get(), out.smClock);
+            parseUnsigned(section.child("mem_clock").text().get(), out.memoryClock);
+        }
+    }
+}
+
+void parseGpuData(const pugi::xml_document& doc, GpuData& data, bool refreshDescriptor) {
+    pugi::xml_node gpu_node = doc.child("nvidia_smi_log").child("gpu");
+    GpuCounters counters;
+
+    if (gpu_node) {
+        if (refreshDescriptor) {
+            double memoryTotal = 0.0;
+            parseMemoryGb(gpu_node.child("fb_memory_usage").child("total").text().get(), memoryTotal);
+            bool changed = updateField(data.name, gpu_node.child("product_name").text().get());
+            changed |= updateField(data.driverVersion, doc.child("nvidia_smi_log").child("driver_version").text().get());
+            changed |= updateField(data.uuid, gpu_node.child("uuid").text().get());
+            changed |= updateField(data.memoryTotal, memoryTotal);
+            if (changed) ++data.generation;
+        }
+
+        // Temperature
+        parseUnsigned(gpu_node.child("temperature").child("gpu_temp").text().get(), counters.temperature);
+
+        // Memory Usage
+        parseMemoryGb(gpu_node.child("fb_memory_usage").child("used").text().get(), counters.memoryUsed);
+
+        // Utilization
+        parseUnsigned(gpu_node.child("utilization").child("gpu_util").text().get(), counters.utilizationGpu);
+
+        // Power, clocks, PCIe, encoder and decoder, ECC and throttle reasons
+        parseGpuExtended(gpu_node, counters.extended);
+    }
+    static_cast<GpuCounters&>(data) = counters;
+}
+
+// True if both records hold the same fields with bit-identical values (NaN included)
+static bool sameGpuFields(const GpuFieldRecord& a, const GpuFieldRecord& b) {
+    return a.gpuCount == b.gpuCount && a.names == b.names && a.texts == b.texts &&
+           a.numbers.size() == b.numbers.size() &&
+           (a.numbers.empty() || std::memcmp(a.numbers.data(), b.numbers.data(), a.numbers.size() * sizeof(double)) == 0);
+}
+
+unsigned int applyGpuData(StatsSnapshot& snap, bool available, const GpuData& data, const GpuFieldRecord* fields) {
+    unsigned int changed = 0;
+    if (updateField(snap.gpuDataAvailable, available)) changed |= SNAPSHOT_CHANGED_GPU_AVAILABLE;
+    if (snap.gpu.generation != data.generation) {
+        static_cast<GpuDescriptor&>(snap.gpu) = data;
+        changed |= SNAPSHOT_CHANGED_GPU_DESCRIPTOR;
+    }
+    if (updateField(snap.gpu.temperature, data.temperature)) changed |= SNAPSHOT_CHANGED_GPU_TEMP;
+    if (updateField(snap.gpu.memoryUsed, data.memoryUsed)) changed |= SNAPSHOT_CHANGED_GPU_MEM_USED;
+    if (updateField(snap.gpu.utilizationGpu, data.utilizationGpu)) changed |= SNAPSHOT_CHANGED_GPU_UTIL;
+    if (!(snap.gpu.extended == data.extended)) {
+        snap.gpu.extended = data.extended;
+        changed |= SNAPSHOT_CHANGED_GPU_EXTENDED;
+    }
+    static const GpuFieldRecord noFields;
+    if (!sameGpuFields(snap.gpuFields, fields ? *fields : noFields)) {
+        snap.gpuFields = fields ? *fields : noFields; // Copy-assignment reuses the snapshot's storage
+        changed |= SNAPSHOT_CHANGED_GPU_FIELDS;
+    }
+    return changed;
+}
@@ -0,0 +1,82 @@
+#ifndef STATS_GPU_FIELDS_HPP
+#define STATS_GPU_FIELDS_HPP
+
+#include <string>
+#include <vector>
+#include "pugixml.hpp"
+#include "snapshot.hpp"
+
+#define GPU_THROTTLE_NAME_COUNT 9
+
+// The built-in fields of an nvidia-smi -q -x document, converted with the non-throwing
+// parsers of value_parse.hpp; values that are "N/A" (common on consumer cards) or unreadable
+// read as zero.
+// parseGpuData() reads the first GPU in place: the counters on every call, the descriptor
+// only when refreshDescriptor is set, bumping data.generation if any of it changed.
+void parseGpuData(const pugi::xml_document& doc, GpuData& data, bool refreshDescriptor);
+// Power, clocks, PCIe, codec, ECC and throttle reasons of one <gpu> node
+void parseGpuExtended(pugi::xml_node gpu, GpuExtendedCounters& out);
+// Copies what a GPU collector read into the snapshot, only the parts that differ (the
+// descriptor when its generation moved), and returns their SNAPSHOT_CHANGED_* bits
+unsigned int applyGpuData(StatsSnapshot& snap, bool available, const GpuData& data, const GpuFieldRecord* fields);
+
+// Throttle reasons by the name nvidia-smi gives them, after "clocks_event_reason_"
+// (drivers before 530: "clocks_throttle_reason_")
+struct GpuThrottleName {
+    const char* name;
+    unsigned int bit;
+};
+extern const GpuThrottleName GPU_THROTTLE_NAMES[GPU_THROTTLE_NAME_COUNT];
+
+// One user-configured GPU field: an XPath expression evaluated with a <gpu> node of
+// the nvidia-smi XML as its context, e.g. "gpu_power_readings/power_draw".
+struct GpuFieldSpec {
+    std::string name;
+    std::string xpath;
+    bool isText = false; // Otherwise the number of the value is kept ("250.50 W" -> 250.5, see value_parse.hpp)
+};
+
+// Reads the field list from the file named by the STATS_GPU_FIELDS environment variable.
+// One field per line, "<name> <number|text> <xpath>"; blank lines and lines starting
+// with '#' are skipped. Returns an empty list when the variable is not set.
+// Throws std::runtime_error when the file cannot be read or a line is malformed.
+std::vector<GpuFieldSpec> loadGpuFieldSpecs();
+
+/**
+ * The configured fields, each compiled once into a pugi::xpath_query.
+ *
+ * Compiling an expression costs a few evaluations of it (bench_gpu_fields), so
+ * the queries are built when the cache is constructed and only evaluated per
+ * tick, once per <gpu> node. Evaluation dominates what is left: on 8 GPUs, 60
+ * fields take several times the document load, 6 fields well under it. Results go into a GpuFieldRecord that is reused between
+ * ticks: once its shape is settled, numeric fields cost no allocation at all and
+ * text fields only when a value grows.
+ * In builds without XPath (the minimal and compact profiles in pugiconfig.hpp)
+ * the cache is always empty and only the built-in fields are collected.
+ */
+class GpuFieldQueryCache {
+public:
+    // Expressions that do not compile are reported on stderr and left out
+    explicit GpuFieldQueryCache(const std::vector<GpuFieldSpec>& specs);
+
+    GpuFieldQueryCache(const GpuFieldQueryCache&) = delete;
+    GpuFieldQueryCache& operator=(const GpuFieldQueryCache&) = delete;
+
+    bool empty() const { return fields_.empty(); }
+    // Evaluates every field on every <gpu> node of an nvidia-smi document
+    void extract(const pugi::xml_document& doc, GpuFieldRecord& record) const;
+
+private:
+#ifndef PUGIXML_NO_XPATH
+    struct Field {
+        std::string name;
+        bool isText;
+        pugi::xpath_query query;
+    };
+    std::vector<Field> fields_;
+#else
+    std::vector<GpuFieldSpec> fields_; // Always empty
+#endif
+};
+
+#endif
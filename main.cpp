@@ -1,5 +1,13 @@
+#ifdef _WIN32
 #include <windows.h> // Required for Windows API functions
+#include <shlwapi.h> // For PathFileExistsA, to search the path of nvidia-smi.exe
+#else
+#include <sys/resource.h> // For setpriority
+#include <sys/stat.h>     // For stat, to search the path of nvidia-smi
+#include <unistd.h>
+#endif
 #include <string>    // For std::string and std::to_string
+#include <string_view>
 #include <iomanip>   // For std::fixed and std::setprecision
 #include <sstream>   // For std::ostringstream
 #include "pugixml.hpp"  //requiered library for XML parsing
@@ -7,44 +15,114 @@
 #include <stdexcept>
 #include <iostream>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
 #include <array>
 #include <vector>
-#include <shlwapi.h> // For PathFileExistsA, to search the path of nvidia-smi.exe
+#include <chrono>
+#include <thread>
+#include "snapshot.hpp"
+#include "agent.hpp"
+#include "shm_publisher.hpp"
+#include "process_runner.hpp"
+#include "gpu_backend.hpp"
+#include "xml_arena.hpp"
+#include "gpu_fields.hpp"
+#include "value_parse.hpp"
+#include "snapshot_bus.hpp"
+#include "collector_engine.hpp"
+#include "proc_reader.hpp"
+#include "process_collector.hpp"
+#include "disk_collector.hpp"
+#include "net_collector.hpp"
+#include "pressure_collector.hpp"
+#include "cgroup_collector.hpp"
+#include "memory_stats.hpp"
+#include "thermal_collector.hpp"
+#include "snapshot_metrics.hpp"
+#include "anomaly_detector.hpp"
+#include "alert_rules.hpp"
+#include "async_io.hpp"
 
 // Define a unique ID for our timer
 #define CPU_USAGE_TIMER_ID 1 
 #define WINDOW_H 400 // Horizontal of the window
 #define WINDOW_V 200 // Vertical of the window
+#define REFRESH_INTERVAL_MS 250 // Sampling period, 4 times per second
+#define NVSMI_TIMEOUT_MS 2000 // Longest a single nvidia-smi run may take before it is killed
+#define GPU_DESCRIPTOR_REFRESH_TICKS 240 // Re-read name, driver, UUID and total memory once a minute
+#define PROCESS_REFRESH_MS 1000 // The per-process scan reads every /proc/<pid>/stat, so it runs once a second
+#define CGROUP_REFRESH_MS 1000 // Same for the three files of every cgroup
 
 /**
  * Program structure:
  * CPU BLOCK
  *      getCurrentCpuUsage() - Calculates the current CPU usage percentage.
  * RAM BLOCK
- *      getCurrentRamUsage() - Calculates the current RAM usage in gigabytes.
+ *      getCurrentRamUsage() - Calculates the current RAM usage in gigabytes (Windows).
+ *      On Linux both keep their /proc files open and re-read them in place (see proc_reader.hpp);
+ *      RAM comes with the full breakdown of memory_stats.hpp: cache, swap, dirty pages, commit
+ *      charge, hugepages and page fault and swap rates.
  * GPU BLOCK
  *      getNVSMIPath() - Determines the best path to nvidia-smi.exe.
  *          GetNVSMIPathFromRegistry() - Tries to get the path from the registry.
  *          findInPath() - Searches for nvidia-smi.exe in the system PATH.
  *          fileExists() - Checks if a file exists at a given path.
- *      exec_no_console() - Child process execution function to run nvidia-smi.exe and capture its output.
- *      getXmlGpuData() - Obtains the GPU data
- *      parseGpuData() - Parses the XML output from nvidia-smi.exe to extract GPU information.
- * WINDOW AND RENDERING BLOCK
- *      refreshAllData() - Refreshes CPU, RAM, and GPU data and updates the display text.
+ *      getXmlGpuData() - Obtains the GPU data, running nvidia-smi.exe with a deadline and
+ *                        backing off when it keeps failing (see process_runner.hpp).
+ *          checkNvsmiAllowed(), checkNvsmiResult() - The backoff, shared with AsyncGpuCollector.
+ *      SmiGpuBackend - GPU backend built on getXmlGpuData() and on parseGpuData() and
+ *                      parseGpuExtended() of gpu_fields.hpp, which extract the GPU information
+ *                      from the XML; applyGpuData() there copies what changed into the snapshot. It is the fallback when the in-process NVML backend
+ *                      (see gpu_backend.hpp) cannot be loaded, and also collects the
+ *                      user-configured XPath fields (see gpu_fields.hpp).
+ * SNAPSHOT BLOCK
+ *      CpuCollector, RamCollector, GpuCollector - The blocks above as collectors for the engine
+ *                         (see collector_engine.hpp), which runs them in parallel every tick.
+ *                         In the C++20 Linux build the GPU comes from AsyncGpuCollector instead,
+ *                         which awaits nvidia-smi on the reactor of a ReactorCollector (see async_io.hpp).
+ *                         On Linux the engine also runs the per-process ProcessCollector
+ *                         (see process_collector.hpp), the block device DiskCollector
+ *                         (see disk_collector.hpp), the network NetCollector (see net_collector.hpp)
+ *                         the load and pressure PressureCollector (see pressure_collector.hpp),
+ *                         the per-container CgroupCollector (see cgroup_collector.hpp) and the
+ *                         CPU clock and temperature ThermalCollector (see thermal_collector.hpp).
+ *      formatStatsText() - Formats a snapshot into the display text.
+ *      collectAllData() - Refreshes CPU, RAM, and GPU data into the current snapshot and publishes it
+ *                         on the snapshot bus (see snapshot_bus.hpp), which the window, terminal and
+ *                         agent read, and to shared memory for other local tools (see stats_shm.h).
+ *                         Only what changed is copied, flagged in the snapshot's change mask.
+ *                         Each snapshot metric (see snapshot_metrics.hpp) that changed also goes through
+ *                         the EWMA and median/MAD detectors of anomaly_detector.hpp, which flag values
+ *                         far off the metric's own baseline in the display and in shared memory.
+ *                         With STATS_ALERT_RULES set, every snapshot then goes through the alert
+ *                         rules, whose events go to a log, a hook or a socket (see alert_rules.hpp).
+ *      waitForNextTick() - Sleeps until the next tick, or less when a PSI trigger fires.
+ *      runAgent() - Headless agent mode, pushes every snapshot to an aggregator (see agent.hpp),
+ *                   along with per-minute quantile sketches of every metric (see quantile_sketch.hpp).
+ * WINDOW AND RENDERING BLOCK (Windows only)
+ *      refreshAllData() - Collects all data and repaints the window when the latest snapshot changed.
  *      wndProc() - Window procedure function to handle messages, updates display
  *      WinMain() - Main function to create the window and start the message loop.
+ * TERMINAL BLOCK (other platforms)
+ *      main() - Prints the stats to the terminal (with --timings, also per-collector wall times),
+ *               or runs the agent mode.
  */
 
 // Global variable to store all data text
 // Reminder: If you switch to Unicode (no 'A' suffix on functions), this should be wchar_t.
-char g_statsText[1024] = "Initializing..."; // Buffer to hold the stats display text
-bool g_gpuDataAvailable = false; // Flag to indicate if GPU data is available
+char g_statsText[4096] = "Initializing..."; // Buffer to hold the stats display text, owned by the window or terminal
+StatsSnapshot g_snapshot; // Snapshot being collected, only touched by collectAllData()
+SnapshotBus g_snapshotBus; // Where collectAllData() publishes every snapshot, and where all consumers read it
 
+#ifdef _WIN32
 // A helper function to convert FILETIME to a 64-bit integer
 unsigned long long FileTimeToInt64(const FILETIME& ft) {
     return (static_cast<unsigned long long>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
 }
+#endif
 
 // Static variables to store previous CPU times for calculation
 static unsigned long long previousIdleTime = 0;
@@ -52,21 +130,10 @@ static unsigned long long previousKernelTime = 0;
 static unsigned long long previousUserTime = 0;
 static bool firstCall = true; // Flag for the first call to initialize previous times
 
-// A structure to hold the GPU data
-struct GpuData {
-    std::string name;
-    std::string driverVersion;
-    unsigned int temperature;
-    double memoryTotal;
-    
-    double memoryUsed;
-    unsigned int utilizationGpu;
-};
-
-GpuData g_gpuData; // Global variable to hold GPU data
 
 // CPU BLOCK
 
+#ifdef _WIN32
 // Function to calculate current CPU usage
 double getCurrentCpuUsage() {
     FILETIME idleTime, kernelTime, userTime;
@@ -114,9 +181,53 @@ double getCurrentCpuUsage() {
     // Calculate CPU usage percentage
     return (1.0 - (static_cast<double>(idleTimeDelta) / totalActivityTime)) * 100.0;
 }
+#else
+// Function to calculate current CPU usage from the aggregate "cpu" line of /proc/stat.
+// The file stays open and is re-read with one pread per tick (see proc_reader.hpp).
+double getCurrentCpuUsage() {
+    static ProcFile statFile("/proc/stat");
+    char buffer[512]; // The aggregate line comes first, the rest of the file is not needed
+    if (statFile.read(buffer, sizeof(buffer)) < 0) {
+        return -1.0;
+    }
+    unsigned long long user = 0, nice = 0, system = 0, idle = 0, iowait = 0, irq = 0, softirq = 0, steal = 0;
+    int fields = std::sscanf(buffer, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+                             &user, &nice, &system, &idle, &iowait, &irq, &softirq, &steal);
+    if (fields < 4) {
+        return -1.0;
+    }
+
+    // Same bookkeeping as the Windows version: "kernel" time includes idle time
+    unsigned long long currentIdleTime = idle + iowait;
+    unsigned long long currentKernelTime = system + irq + softirq + steal + currentIdleTime;
+    unsigned long long currentUserTime = user + nice;
+
+    if (firstCall) {
+        previousIdleTime = currentIdleTime;
+        previousKernelTime = currentKernelTime;
+        previousUserTime = currentUserTime;
+        firstCall = false;
+        return 0.0;
+    }
+
+    unsigned long long idleTimeDelta = currentIdleTime - previousIdleTime;
+    unsigned long long totalActivityTime = (currentKernelTime - previousKernelTime) + (currentUserTime - previousUserTime);
+
+    previousIdleTime = currentIdleTime;
+    previousKernelTime = currentKernelTime;
+    previousUserTime = currentUserTime;
+
+    if (totalActivityTime == 0) {
+        return 0.0; // Avoid division by zero
+    }
+
+    return (1.0 - (static_cast<double>(idleTimeDelta) / totalActivityTime)) * 100.0;
+}
+#endif
 
 // RAM BLOCK
 
+#ifdef _WIN32
 // This function calculates and returns the current RAM usage in gigabytes (GB)
 double getCurrentRamUsage() {
     MEMORYSTATUSEX memInfo;
@@ -132,80 +243,27 @@ double getCurrentRamUsage() {
     // Convert bytes to gigabytes (GB)
     return static_cast<double>(usedPhysMem) / (1024.0 * 1024.0 * 1024.0);
 }
+#else
+// On Linux the RAM collector reads the full breakdown instead, used memory included
+// (MemTotal - MemAvailable), with MemoryStatsReader (see memory_stats.hpp)
+#endif
 
 // GPU BLOCK
 
-// Function to create a child process and capture its output without showing a console window
-std::string exec_no_console(const char* cmd) {
-    HANDLE hReadPipe, hWritePipe;
-    
-    SECURITY_ATTRIBUTES sa;
-    sa.nLength = sizeof(SECURITY_ATTRIBUTES);
-    sa.bInheritHandle = TRUE;
-    sa.lpSecurityDescriptor = NULL;
-    
-    if (!CreatePipe(&hReadPipe, &hWritePipe, &sa, 0)) {
-        throw std::runtime_error("CreatePipe failed!");
-    }
-    
-    STARTUPINFOA si;
-    ZeroMemory(&si, sizeof(si));
-    si.cb = sizeof(si);
-    si.hStdError = hWritePipe;
-    si.hStdOutput = hWritePipe;
-    si.dwFlags |= STARTF_USESTDHANDLES;
-    si.dwFlags |= STARTF_USESHOWWINDOW;
-    si.wShowWindow = SW_HIDE;
-    
-    PROCESS_INFORMATION pi;
-    ZeroMemory(&pi, sizeof(pi));
-
-    // Create a modifiable copy of the command string
-    std::string command_str(cmd);
-    std::vector<char> cmd_copy(command_str.begin(), command_str.end());
-    cmd_copy.push_back('\0');
-
-    // Create the child process. The first parameter is NULL, so CreateProcessA
-    // will parse the full command line string from cmd_copy.data().
-    if (!CreateProcessA(NULL,             // Use command line for application name
-                        cmd_copy.data(),  // Command line
-                        NULL,             // Process handle not inheritable
-                        NULL,             // Thread handle not inheritable
-                        TRUE,             // Set handle inheritance to TRUE
-                        CREATE_NO_WINDOW, // Prevents a console window
-                        NULL,             // Use parent's environment block
-                        NULL,             // Use parent's starting directory 
-                        &si,              // Pointer to STARTUPINFO structure
-                        &pi)              // Pointer to PROCESS_INFORMATION structure
-    ) {
-        CloseHandle(hReadPipe);
-        CloseHandle(hWritePipe);
-        // Get the specific error code to diagnose further
-        DWORD errorCode = GetLastError();
-        std::ostringstream error_oss;
-        error_oss << "CreateProcess failed with error code: " << errorCode;
-        throw std::runtime_error(error_oss.str());
-    }
-    
-    CloseHandle(hWritePipe);
-    std::string result;
-    DWORD dwRead;
-    char buffer[32768];
-    while (ReadFile(hReadPipe, buffer, sizeof(buffer), &dwRead, NULL) && dwRead > 0) {
-        result.append(buffer, dwRead);
-    }
-    WaitForSingleObject(pi.hProcess, INFINITE);
-    CloseHandle(pi.hProcess);
-    CloseHandle(pi.hThread);
-    CloseHandle(hReadPipe);
-    return result;
-}
-
+#ifdef _WIN32
 // Helper: Check if a file exists
 bool fileExists(const std::string& path) {
     return PathFileExistsA(path.c_str());
 }
+#else
+// Helper: Check if a file exists
+bool fileExists(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+}
+#endif
 
+#ifdef _WIN32
 // Helper: Try to get NVSMI path from registry
 std::string getNVSMIPathFromRegistry() {
     HKEY hKey;
@@ -244,7 +302,23 @@ std::string findInPath(const std::string& exeName) {
     free(envPath);
     return result;
 }
+#else
+// Helper: Search for nvidia-smi in PATH
+std::string findInPath(const std::string& exeName) {
+    const char* envPath = std::getenv("PATH");
+    if (!envPath) return "";
+    std::istringstream iss(envPath);
+    std::string dir;
+    while (std::getline(iss, dir, ':')) {
+        if (!dir.empty() && dir.back() != '/') dir += '/';
+        std::string fullPath = dir + exeName;
+        if (fileExists(fullPath)) return fullPath;
+    }
+    return "";
+}
+#endif
 
+#ifdef _WIN32
 // Main function to get the best path to nvidia-smi.exe
 std::string getNVSMIPath() {
     // 1. Try registry
@@ -278,105 +352,506 @@ std::string getNVSMIPath() {
     // 5. Fallback: just the name (let CreateProcess try PATH)
     return "nvidia-smi.exe";
 }
+#else
+// Main function to get the best path to nvidia-smi
+std::string getNVSMIPath() {
+    std::string path = findInPath("nvidia-smi");
+    if (!path.empty()) return path;
+    if (fileExists("/usr/bin/nvidia-smi")) return "/usr/bin/nvidia-smi";
+    return "nvidia-smi"; // Let the shell try PATH
+}
+#endif
 
-// Function to get the XML output from nvidia-smi, adapted to use the full path from the registry
-std::string getXmlGpuData() {
-    std::string nvsmiExePath = getNVSMIPath();
-    std::string command;
-    // Only quote if it's a full path (contains \ or space)
-    if (nvsmiExePath.find('\\') != std::string::npos || nvsmiExePath.find(' ') != std::string::npos) {
-        command = "\"" + nvsmiExePath + "\" -q -x";
-    } else {
-        command = nvsmiExePath + " -q -x";
+// A hung or missing nvidia-smi must not stall the UI: every run gets a deadline,
+// and after repeated failures it is only retried with an increasing backoff.
+// The breaker is shared by the blocking and the coroutine way of running it.
+static CircuitBreaker g_nvsmiBreaker;
+
+static unsigned long long steadyMs() {
+    return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Throws while nvidia-smi is backed off
+static void checkNvsmiAllowed() {
+    unsigned long long now = steadyMs();
+    if (!g_nvsmiBreaker.allow(now)) {
+        throw std::runtime_error("nvidia-smi disabled after repeated failures, retrying in " +
+                                 std::to_string((g_nvsmiBreaker.openUntilMs() - now) / 1000 + 1) + " s");
     }
-    return exec_no_console(command.c_str());
 }
 
-// Function to parse the GPU data from the XML string
-GpuData parseGpuData(const pugi::xml_document& doc) {
-    GpuData data;
-    pugi::xml_node gpu_node = doc.child("nvidia_smi_log").child("gpu");
-
-    if (gpu_node) {
-        data.name = std::string(gpu_node.child("product_name").text().get());
-        data.driverVersion = doc.child("nvidia_smi_log").child("driver_version").text().get();
-        
-        // Temperature
-        pugi::xml_node temperature_node = gpu_node.child("temperature").child("gpu_temp");
-        if (temperature_node) {
-            data.temperature = std::stoul(temperature_node.text().get());
+// Records how a run went, throws if it failed
+static void checkNvsmiResult(const ProcessResult& result) {
+    if (result.status != ProcessResult::EXITED || result.exitCode != 0) {
+        // Backoff counts from when the run ended, a timeout must not use up part of it
+        g_nvsmiBreaker.recordFailure(steadyMs());
+        throw std::runtime_error("nvidia-smi " + describeFailure(result));
+    }
+    g_nvsmiBreaker.recordSuccess();
+}
+
+static ProcessOptions nvsmiOptions() {
+    ProcessOptions options;
+    options.timeoutMs = NVSMI_TIMEOUT_MS;
+    return options;
+}
+
+// Function to get the XML output from nvidia-smi, adapted to use the full path from the registry.
+// The returned view stays valid until the next call.
+std::string_view getXmlGpuData() {
+    checkNvsmiAllowed();
+    // The path lookup, argv and output buffer are set up once, not on every tick
+    static PreparedCommand nvsmi({getNVSMIPath(), "-q", "-x"});
+    checkNvsmiResult(nvsmi.run(nvsmiOptions()));
+    return nvsmi.output();
+}
+
+// Backend that runs nvidia-smi and parses its XML output, used when NVML is not available
+class SmiGpuBackend : public GpuBackend {
+public:
+    SmiGpuBackend() : fieldQueries_(configuredFieldSpecs()) {}
+
+    const char* name() const { return "nvidia-smi"; }
+
+    bool query(GpuData& data) {
+        return parse(getXmlGpuData(), data);
+    }
+
+    // The second half of query(), for output obtained some other way (see AsyncGpuCollector)
+    bool parse(std::string_view xmlOutput, GpuData& data) {
+        if (xmlOutput.empty()) {
+            return false;
         }
+        // The parse allocates from an arena that is reset when the scope ends,
+        // instead of going through malloc/free four times a second
+        XmlArenaScope arenaScope(arena_);
+        pugi::xml_document doc;
+        pugi::xml_parse_result result = doc.load_buffer(xmlOutput.data(), xmlOutput.size());
+        if (!result) {
+            ticksUntilDescriptor_ = 0; // Re-read everything once it parses again
+            return false;
+        }
+        parseGpuData(doc, data, ticksUntilDescriptor_ == 0);
+        ticksUntilDescriptor_ = ticksUntilDescriptor_ == 0 ? GPU_DESCRIPTOR_REFRESH_TICKS : ticksUntilDescriptor_ - 1;
+        if (!fieldQueries_.empty()) {
+            fieldQueries_.extract(doc, fields_);
+        }
+        return true;
+    }
 
-        // Memory Usage
-        pugi::xml_node memory_node = gpu_node.child("fb_memory_usage");
-        if (memory_node) {
-            data.memoryTotal = std::stoul(memory_node.child("total").text().get());
-            data.memoryUsed = std::stoul(memory_node.child("used").text().get());
-            data.memoryTotal /= 1024; // Convert from MB to GB
-            data.memoryUsed /= 1024;  // Convert from MB to GB
+    const GpuFieldRecord* fields() const { return &fields_; }
+
+private:
+    // A bad field list costs the extra fields, not the GPU data: warned about once, then ignored
+    static std::vector<GpuFieldSpec> configuredFieldSpecs() {
+        try {
+            return loadGpuFieldSpecs();
+        } catch (const std::exception& e) {
+            std::cerr << "GPU fields disabled: " << e.what() << std::endl;
+            return std::vector<GpuFieldSpec>();
         }
+    }
 
-        // Utilization
-        pugi::xml_node utilization_node = gpu_node.child("utilization");
-        if (utilization_node) {
-            data.utilizationGpu = std::stoul(utilization_node.child("gpu_util").text().get());
+    XmlArena arena_;
+    unsigned int ticksUntilDescriptor_ = 0;
+    GpuFieldQueryCache fieldQueries_; // Compiled once, evaluated every tick
+    GpuFieldRecord fields_;
+};
+
+// SNAPSHOT BLOCK
+
+// Collectors run by the engine (see collector_engine.hpp), one per data source.
+// collect() may run on any pool thread, apply() copies the result into the snapshot afterwards.
+class CpuCollector : public Collector {
+public:
+    const char* name() const { return "cpu"; }
+    unsigned int periodMs() const { return REFRESH_INTERVAL_MS; }
+    void collect() { cpuUsage_ = getCurrentCpuUsage(); }
+    unsigned int apply(StatsSnapshot& snap) {
+        return updateField(snap.cpuUsage, cpuUsage_) ? SNAPSHOT_CHANGED_CPU : 0;
+    }
+
+private:
+    double cpuUsage_ = 0.0;
+};
+
+class RamCollector : public Collector {
+public:
+    const char* name() const { return "ram"; }
+    unsigned int periodMs() const { return REFRESH_INTERVAL_MS; }
+#ifdef _WIN32
+    void collect() { ramUsage_ = getCurrentRamUsage(); }
+#else
+    void collect() {
+        reader_.read(memory_);
+        ramUsage_ = (memory_[MEMORY_TOTAL] - memory_[MEMORY_AVAILABLE]) / 1024.0;
+    }
+#endif
+    unsigned int apply(StatsSnapshot& snap) {
+        unsigned int changed = updateField(snap.ramUsage, ramUsage_) ? SNAPSHOT_CHANGED_RAM : 0;
+        if (!(snap.memory == memory_)) {
+            snap.memory = memory_;
+            changed |= SNAPSHOT_CHANGED_MEMORY;
         }
+        return changed;
     }
-    return data;
-}
 
-// WINDOW AND RENDERING BLOCK
+private:
+    double ramUsage_ = 0.0;
+    MemoryStats memory_;
+#ifndef _WIN32
+    MemoryStatsReader reader_;
+#endif
+};
 
-// Function to refresh all data (CPU, RAM, and GPU)
-void refreshAllData(HWND hwnd) {
-    double cpuUsage = getCurrentCpuUsage();
-    double ramUsage = getCurrentRamUsage();
-
-    // GPU data retrieval
-    // Wrap GPU data retrieval in try-catch to handle potential errors
-    try {
-        std::string xmlOutput = getXmlGpuData();
-        if (!xmlOutput.empty()) {
-            pugi::xml_document doc;
-            pugi::xml_parse_result result = doc.load_string(xmlOutput.c_str());
-            if (result) {
-                g_gpuData = parseGpuData(doc);
-                g_gpuDataAvailable = true;
+class GpuCollector : public Collector {
+public:
+    const char* name() const { return "gpu"; }
+    unsigned int periodMs() const { return REFRESH_INTERVAL_MS; }
+
+    void collect() {
+        // GPU data retrieval, in-process through NVML when the library is installed,
+        // otherwise through nvidia-smi. The backend is chosen once, on the first run.
+        // Wrap GPU data retrieval in try-catch to handle potential errors
+        try {
+            if (!backend_) {
+                backend_ = selectGpuBackend(std::unique_ptr<GpuBackend>(new SmiGpuBackend()));
+            }
+            available_ = backend_->query(data_);
+        } catch (const std::exception& e) {
+            available_ = false;
+            std::cerr << "Error getting GPU data: " << e.what() << std::endl;
+        }
+    }
+
+    unsigned int apply(StatsSnapshot& snap) {
+        return applyGpuData(snap, available_, data_, available_ ? backend_->fields() : nullptr);
+    }
+
+private:
+    std::unique_ptr<GpuBackend> backend_;
+    GpuData data_;
+    bool available_ = false;
+};
+
+#ifdef STATS_ASYNC_IO
+// GpuCollector as a coroutine, run by the engine through a ReactorCollector (see async_io.hpp):
+// when it falls back to nvidia-smi, the run is awaited on the reactor instead of blocking a
+// pool thread for as long as nvidia-smi takes. NVML queries are in-process and stay direct.
+class AsyncGpuCollector : public AsyncCollector {
+public:
+    const char* name() const { return "gpu"; }
+
+    Task<void> collect(Reactor& reactor) {
+        try {
+            if (!backend_) {
+                backend_ = selectGpuBackend(std::unique_ptr<GpuBackend>(new SmiGpuBackend()));
+                smi_ = dynamic_cast<SmiGpuBackend*>(backend_.get());
+            }
+            if (smi_) {
+                checkNvsmiAllowed();
+                if (!nvsmi_) nvsmi_.reset(new PreparedCommand({getNVSMIPath(), "-q", "-x"}));
+                co_await runProcessAsync(reactor, *nvsmi_, nvsmiOptions());
+                checkNvsmiResult(nvsmi_->result());
+                available_ = smi_->parse(nvsmi_->output(), data_);
             } else {
-                g_gpuDataAvailable = false;
+                available_ = backend_->query(data_);
             }
-        } else {
-            g_gpuDataAvailable = false;
+        } catch (const std::exception& e) {
+            available_ = false;
+            std::cerr << "Error getting GPU data: " << e.what() << std::endl;
         }
-    } catch (const std::exception& e) {
-        g_gpuDataAvailable = false;
-        std::cerr << "Error getting GPU data: " << e.what() << std::endl;
     }
 
-    // Format the stats text
+    unsigned int apply(StatsSnapshot& snap) {
+        return applyGpuData(snap, available_, data_, available_ ? backend_->fields() : nullptr);
+    }
+
+private:
+    std::unique_ptr<GpuBackend> backend_;
+    SmiGpuBackend* smi_ = nullptr; // backend_, when it is the nvidia-smi one
+    std::unique_ptr<PreparedCommand> nvsmi_; // Prepared on first use, its output buffer reused every tick
+    GpuData data_;
+    bool available_ = false;
+};
+#endif
+
+// The engine collectAllData() runs, created with all collectors on first use
+CollectorEngine& collectorEngine() {
+    static std::unique_ptr<CollectorEngine> engine;
+    if (!engine) {
+        engine.reset(new CollectorEngine());
+        engine->add(std::unique_ptr<Collector>(new CpuCollector()));
+        engine->add(std::unique_ptr<Collector>(new RamCollector()));
+#ifdef STATS_ASYNC_IO
+        // I/O-bound probes share one reactor thread, see async_io.hpp
+        std::unique_ptr<ReactorCollector> probes(new ReactorCollector("probes", REFRESH_INTERVAL_MS));
+        probes->add(std::unique_ptr<AsyncCollector>(new AsyncGpuCollector()));
+        engine->add(std::move(probes));
+#else
+        engine->add(std::unique_ptr<Collector>(new GpuCollector()));
+#endif
+#ifdef __linux__
+        engine->add(std::unique_ptr<Collector>(new ProcessCollector(PROCESS_REFRESH_MS)));
+        engine->add(std::unique_ptr<Collector>(new DiskCollector(REFRESH_INTERVAL_MS)));
+        engine->add(std::unique_ptr<Collector>(new NetCollector(REFRESH_INTERVAL_MS)));
+        engine->add(std::unique_ptr<Collector>(new PressureCollector(REFRESH_INTERVAL_MS)));
+        engine->add(std::unique_ptr<Collector>(new CgroupCollector(CGROUP_REFRESH_MS)));
+        engine->add(std::unique_ptr<Collector>(new ThermalCollector(REFRESH_INTERVAL_MS)));
+#endif
+    }
+    return *engine;
+}
+
+// Formats a snapshot into the display text
+void formatStatsText(const StatsSnapshot& snap, char* text, size_t size) {
     std::ostringstream oss;
     oss << std::fixed << std::setprecision(2);
     
-    if (cpuUsage >= 0) {
-        oss << "CPU Usage: " << cpuUsage << "%\n"
-            << "RAM Usage: " << ramUsage << " GB\n";
+    if (snap.cpuUsage >= 0) {
+        oss << "CPU Usage: " << snap.cpuUsage << "%\n"
+            << "RAM Usage: " << snap.ramUsage << " GB\n";
     } else {
         oss << "Error getting CPU/RAM usage.\n";
     }
+    const MemoryStats& memory = snap.memory;
+    if (memory.available) {
+        oss << "Memory: cache " << (memory[MEMORY_CACHED] + memory[MEMORY_BUFFERS]) / 1024.0 << " GB, "
+            << "dirty " << memory[MEMORY_DIRTY] << " MB, writeback " << memory[MEMORY_WRITEBACK] << " MB\n"
+            << "Swap: " << (memory[MEMORY_SWAP_TOTAL] - memory[MEMORY_SWAP_FREE]) / 1024.0 << " / "
+            << memory[MEMORY_SWAP_TOTAL] / 1024.0 << " GB, in " << memory[MEMORY_SWAP_IN]
+            << " out " << memory[MEMORY_SWAP_OUT] << " MB/s\n"
+            << "Commit: " << memory[MEMORY_COMMITTED] / 1024.0 << " / " << memory[MEMORY_COMMIT_LIMIT] / 1024.0
+            << " GB, faults " << memory[MEMORY_PAGE_FAULTS] << "/s (" << memory[MEMORY_MAJOR_FAULTS] << " major)\n";
+        if (memory[MEMORY_HUGEPAGES] > 0) {
+            oss << "Hugepages: " << memory[MEMORY_HUGEPAGES] - memory[MEMORY_HUGEPAGES_FREE] << " / "
+                << memory[MEMORY_HUGEPAGES] << " MB\n";
+        }
+    }
+    if (snap.loadAverage[0] >= 0) {
+        oss << "Load: " << snap.loadAverage[0] << " " << snap.loadAverage[1] << " " << snap.loadAverage[2] << "\n";
+    }
+    if (snap.pressure[PRESSURE_CPU].available) {
+        // Share of the last 10 s that some (and, for memory and IO, all) tasks were stalled
+        const PressureSample& memory = snap.pressure[PRESSURE_MEMORY];
+        const PressureSample& io = snap.pressure[PRESSURE_IO];
+        oss << "Pressure: CPU " << snap.pressure[PRESSURE_CPU].some[0] << "%, "
+            << "memory " << memory.some[0] << "/" << memory.full[0] << "%, "
+            << "IO " << io.some[0] << "/" << io.full[0] << "%\n";
+    }
+    if (!snap.coreFrequencyMhz.empty()) {
+        const std::vector<double>& clocks = snap.coreFrequencyMhz;
+        double sum = 0.0;
+        for (double mhz : clocks) sum += mhz;
+        auto range = std::minmax_element(clocks.begin(), clocks.end());
+        oss << "CPU Clock: " << sum / static_cast<double>(clocks.size()) / 1000.0 << " GHz avg, "
+            << *range.first / 1000.0 << "-" << *range.second / 1000.0 << " GHz over " << clocks.size() << " cores\n";
+    }
+    if (snap.coreThrottlesPerSec > 0 || snap.packageThrottlesPerSec > 0) {
+        oss << "Thermal throttling: " << snap.coreThrottlesPerSec << "/s core, "
+            << snap.packageThrottlesPerSec << "/s package\n";
+    }
+    if (!snap.thermalZones.empty()) {
+        oss << "Thermal:";
+        for (size_t i = 0; i < snap.thermalZones.size(); ++i) {
+            oss << (i ? ", " : " ") << snap.thermalZones[i].type << " " << snap.thermalZones[i].temperature << " C";
+        }
+        oss << "\n";
+    }
+    if (snap.anomalies) {
+        // Metrics far off their own recent baseline, see anomaly_detector.hpp
+        oss << "Anomalies:";
+        const char* separator = " ";
+        for (size_t i = 0; i < SNAPSHOT_METRIC_COUNT; ++i) {
+            if (!(snap.anomalies & (1ULL << i))) continue;
+            oss << separator << snapshotMetric(i).name;
+            separator = ", ";
+        }
+        oss << "\n";
+    }
 
-    if (g_gpuDataAvailable) {
+    const GpuData& gpu = snap.gpu;
+    if (snap.gpuDataAvailable) {
         oss << "\n--- GPU Stats ---\n"
-            << "GPU: " << g_gpuData.name << "\n"
-            << "Temp: " << g_gpuData.temperature << " C\n"
-            << "VRAM: " << g_gpuData.memoryUsed << " GB / " << g_gpuData.memoryTotal << " GB\n"
-            << "GPU Util: " << g_gpuData.utilizationGpu << " %";
+            << "GPU: " << gpu.name << "\n"
+            << "Temp: " << gpu.temperature << " C\n"
+            << "VRAM: " << gpu.memoryUsed << " GB / " << gpu.memoryTotal << " GB\n"
+            << "GPU Util: " << gpu.utilizationGpu << " %";
+        const GpuExtendedCounters& extended = gpu.extended;
+        oss << "\nPower: " << extended.powerDraw << " W / " << extended.powerLimit << " W, "
+            << "SM " << extended.smClock << " MHz, memory " << extended.memoryClock << " MHz"
+            << "\nPCIe: RX " << extended.pcieRx / 1024.0 << " MB/s, TX " << extended.pcieTx / 1024.0 << " MB/s, "
+            << "encoder " << extended.utilizationEncoder << " %, decoder " << extended.utilizationDecoder << " %";
+        if (extended.eccCorrected || extended.eccUncorrected) {
+            oss << "\nECC errors: " << extended.eccCorrected << " corrected, " << extended.eccUncorrected << " uncorrected";
+        }
+        // Idle is not a slowdown, anything else is
+        if (extended.throttleReasons & ~GPU_THROTTLE_IDLE) {
+            oss << "\nThrottled:";
+            const char* separator = " ";
+            for (const auto& known : GPU_THROTTLE_NAMES) {
+                if (known.bit == GPU_THROTTLE_IDLE || !(extended.throttleReasons & known.bit)) continue;
+                oss << separator << known.name;
+                separator = ", ";
+            }
+        }
+        // Configured fields, one line each with the value of every GPU
+        const GpuFieldRecord& extra = snap.gpuFields;
+        for (size_t f = 0; f < extra.names.size(); ++f) {
+            oss << "\n" << extra.names[f] << ":";
+            for (size_t i = 0; i < extra.gpuCount; ++i) {
+                oss << (i ? " / " : " ");
+                if (extra.isText[f]) {
+                    oss << extra.text(f, i);
+                } else if (std::isnan(extra.number(f, i))) {
+                    oss << "N/A";
+                } else {
+                    oss << extra.number(f, i);
+                }
+            }
+        }
     } else {
         oss << "\n--- GPU Stats ---\n"
             << "GPU data not available or initializing...";
     }
-    strncpy_s(g_statsText, sizeof(g_statsText), oss.str().c_str(), _TRUNCATE);
-    // Optionally, update g_cpuUsageText for legacy code compatibility
-    InvalidateRect(hwnd, NULL, TRUE);
+
+    if (!snap.topProcesses.empty()) {
+        oss << "\n\n--- Top Processes (" << snap.processCount << " running) ---";
+        for (const ProcessSample& process : snap.topProcesses) {
+            oss << "\n" << process.name << " (" << process.pid << "): "
+                << process.cpuUsage << "% CPU, " << process.rssMb << " MB";
+        }
+    }
+
+    if (!snap.cgroups.empty()) {
+        oss << "\n\n--- Cgroups (" << snap.cgroupCount << ") ---";
+        for (const CgroupSample& group : snap.cgroups) {
+            oss << "\n" << group.path << ": " << group.cpuUsage << "% CPU";
+            if (group.throttledPercent > 0) oss << " (" << group.throttledPercent << "% throttled)";
+            oss << ", " << group.memoryMb << " MB, IO R " << group.readBytesPerSec / (1024.0 * 1024.0)
+                << " W " << group.writeBytesPerSec / (1024.0 * 1024.0) << " MB/s";
+        }
+    }
+
+    if (!snap.disks.empty()) {
+        oss << "\n\n--- Disks ---";
+        for (const DiskSample& disk : snap.disks) {
+            oss << "\n" << disk.name << ": " << disk.utilization << "% busy, "
+                << "R " << disk.readIops << " IOPS " << disk.readBytesPerSec / (1024.0 * 1024.0) << " MB/s, "
+                << "W " << disk.writeIops << " IOPS " << disk.writeBytesPerSec / (1024.0 * 1024.0) << " MB/s, "
+                << disk.awaitMs << " ms, queue " << disk.queueDepth;
+        }
+    }
+
+    if (!snap.interfaces.empty()) {
+        oss << "\n\n--- Network ---";
+        for (const NetSample& nic : snap.interfaces) {
+            oss << "\n" << nic.name << ": RX " << nic.rxBytesPerSec / (1024.0 * 1024.0) << " MB/s, "
+                << "TX " << nic.txBytesPerSec / (1024.0 * 1024.0) << " MB/s";
+            double drops = nic.rxDropsPerSec + nic.txDropsPerSec;
+            double errors = nic.rxErrorsPerSec + nic.txErrorsPerSec;
+            if (drops > 0 || errors > 0) {
+                oss << ", " << drops << " drops/s, " << errors << " errors/s";
+            }
+        }
+    }
+    std::snprintf(text, size, "%s", oss.str().c_str());
+}
+
+// Function to refresh all data (CPU, RAM, and GPU) into g_snapshot and publish it on g_snapshotBus.
+// The collectors run in parallel on the engine's pool; only what changed since the previous
+// tick is copied into the snapshot, and its changed mask tells consumers which parts those were.
+void collectAllData() {
+    static bool firstTick = true;
+    unsigned long long nowMs = static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    unsigned int changed = collectorEngine().tick(g_snapshot, nowMs);
+    if (firstTick) {
+        changed = ~0u;
+        firstTick = false;
+    }
+    g_snapshot.timestampMs = nowMs;
+    g_snapshot.changed = changed;
+    static SnapshotAnomalies anomalies;
+    if (updateField(g_snapshot.anomalies, anomalies.update(g_snapshot))) {
+        g_snapshot.changed |= SNAPSHOT_CHANGED_ANOMALIES;
+    }
+
+    static bool busWarned = false;
+    if (!g_snapshotBus.publish(g_snapshot) && !busWarned) {
+        busWarned = true;
+        std::cerr << "Snapshot not published, its address does not fit the bus (see snapshot_bus.hpp)" << std::endl;
+    }
+    static ShmPublisher publisher;
+    publisher.publish(g_snapshot);
+
+    static std::unique_ptr<SnapshotAlerts> alerts;
+    static bool alertsLoaded = false;
+    if (!alertsLoaded) {
+        alertsLoaded = true;
+        try {
+            AlertConfig config = loadAlertConfig();
+            if (!config.rules.empty()) alerts.reset(new SnapshotAlerts(config));
+        } catch (const std::exception& e) {
+            std::cerr << "Alerting disabled: " << e.what() << std::endl;
+        }
+    }
+    if (alerts) {
+        alerts->onSnapshot(g_snapshot);
+    }
+}
+
+// Sleeps until nextTick and moves it one period on. When a PSI trigger configured in
+// STATS_PSI_TRIGGERS fires first (see pressure_collector.hpp), it returns early instead and
+// makes the cheap collectors due, so the stall shows in the tick that follows right away.
+void waitForNextTick(std::chrono::steady_clock::time_point& nextTick) {
+    static std::unique_ptr<PressureTriggers> triggers;
+    if (!triggers) {
+        triggers.reset(new PressureTriggers());
+        triggers->addFromEnvironment();
+    }
+    if (triggers->waitUntil(nextTick)) {
+        collectorEngine().expedite("pressure");
+        collectorEngine().expedite("cpu");
+        collectorEngine().expedite("ram");
+        return;
+    }
+    nextTick += std::chrono::milliseconds(REFRESH_INTERVAL_MS);
+}
+
+// Agent mode: no window, sample at the usual rate and push every snapshot to the aggregator
+int runAgent(const std::string& endpoint) {
+    AgentSender sender(endpoint);
+    getCurrentCpuUsage(); // Set up the previous CPU times, as WM_CREATE does for the window
+    auto nextTick = std::chrono::steady_clock::now() + std::chrono::milliseconds(REFRESH_INTERVAL_MS);
+    for (;;) {
+        waitForNextTick(nextTick);
+        collectAllData();
+        sender.submit(*g_snapshotBus.latest());
+    }
+    return 0;
+}
+
+// Returns the value following "--agent" on the command line, or an empty string
+std::string agentEndpointFromArgs(const std::vector<std::string>& args) {
+    for (size_t i = 0; i + 1 < args.size(); ++i) {
+        if (args[i] == "--agent") return args[i + 1];
+    }
+    return "";
+}
+
+#ifdef _WIN32
+// WINDOW AND RENDERING BLOCK
+
+// Function to refresh all data (CPU, RAM, and GPU) and repaint the window
+void refreshAllData(HWND hwnd) {
+    collectAllData();
+    SnapshotBus::Ref snap = g_snapshotBus.latest();
+    if (snap->changed) {
+        formatStatsText(*snap, g_statsText, sizeof(g_statsText));
+        InvalidateRect(hwnd, NULL, TRUE);
+    }
 }
 
 // Window Procedure function - handles messages sent to the window
@@ -384,7 +859,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     switch (msg) {
         case WM_CREATE: {
             // Set a timer to update CPU usage every 250 milliseconds (4 times per second)
-            SetTimer(hwnd, CPU_USAGE_TIMER_ID, 250, NULL);
+            SetTimer(hwnd, CPU_USAGE_TIMER_ID, REFRESH_INTERVAL_MS, NULL);
             // Perform an initial call to getCurrentCpuUsage to set up static variables
             // for correct delta calculations on subsequent timer ticks.
             getCurrentCpuUsage();
@@ -397,7 +872,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
         }
         case WM_EXITSIZEMOVE: {
             // Restart the timer after resizing
-            SetTimer(hwnd, CPU_USAGE_TIMER_ID, 250, NULL);
+            SetTimer(hwnd, CPU_USAGE_TIMER_ID, REFRESH_INTERVAL_MS, NULL);
             refreshAllData(hwnd); // Refresh data after resizing
             break;
         }
@@ -462,6 +937,16 @@ int WINAPI WinMain(HINSTANCE hInstance,
                    LPSTR lpCmdLine,
                    int nCmdShow)
 {
+    // "--agent <host:port | unix:/path>" runs headless and ships the stats to an aggregator
+    std::vector<std::string> args;
+    std::istringstream cmdLine(lpCmdLine ? lpCmdLine : "");
+    for (std::string arg; cmdLine >> arg;) args.push_back(arg);
+    std::string agentEndpoint = agentEndpointFromArgs(args);
+    if (!agentEndpoint.empty()) {
+        SetPriorityClass(GetCurrentProcess(), IDLE_PRIORITY_CLASS);
+        return runAgent(agentEndpoint);
+    }
+
     WNDCLASSEXA wc = {0}; // Using WNDCLASSEXA for ANSI compatibility
 
     wc.cbSize        = sizeof(WNDCLASSEXA);
@@ -515,7 +1000,51 @@ int WINAPI WinMain(HINSTANCE hInstance,
 
     return static_cast<int>(msg.wParam);
 }
+#else
+// TERMINAL BLOCK
+
+int main(int argc, char** argv) {
+    // Same intent as IDLE_PRIORITY_CLASS on Windows: stay out of the way of the real workload
+    setpriority(PRIO_PROCESS, 0, 19);
+
+    std::vector<std::string> args(argv + 1, argv + argc);
+    std::string agentEndpoint = agentEndpointFromArgs(args);
+    if (!agentEndpoint.empty()) {
+        return runAgent(agentEndpoint);
+    }
+
+    // --timings adds the wall time each collector took under the stats
+    bool showTimings = std::find(args.begin(), args.end(), "--timings") != args.end();
+    getCurrentCpuUsage();
+    auto nextTick = std::chrono::steady_clock::now() + std::chrono::milliseconds(REFRESH_INTERVAL_MS);
+    for (;;) {
+        waitForNextTick(nextTick);
+        collectAllData();
+        SnapshotBus::Ref snap = g_snapshotBus.latest();
+        if (snap->changed || showTimings) {
+            formatStatsText(*snap, g_statsText, sizeof(g_statsText));
+            // Clear the terminal and redraw the stats at the top
+            std::cout << "\033[H\033[2J" << g_statsText << std::endl;
+        }
+        if (showTimings) {
+            std::cout << "\n--- Collectors ---" << std::fixed << std::setprecision(2) << "\n";
+            for (const CollectorTiming& t : collectorEngine().timings()) {
+                std::cout << t.name << ": " << t.lastMs << " ms (max " << t.maxMs << " ms, avg "
+                          << (t.runs ? t.totalMs / t.runs : 0.0) << " ms)\n";
+            }
+            std::cout << std::flush;
+        }
+    }
+    return 0;
+}
+#endif
 // comand line to compile:
-// cl main.cpp pugixml.cpp user32.lib gdi32.lib kernel32.lib Advapi32.lib Shlwapi.lib /EHsc /Festats_display.exe
+// cl main.cpp agent.cpp wire_format.cpp shm_publisher.cpp process_runner.cpp gpu_backend.cpp xml_arena.cpp gpu_fields.cpp value_parse.cpp snapshot_bus.cpp collector_engine.cpp pressure_collector.cpp snapshot_metrics.cpp anomaly_detector.cpp quantile_sketch.cpp alert_rules.cpp alert_sinks.cpp pugixml.cpp user32.lib gdi32.lib kernel32.lib Advapi32.lib Shlwapi.lib Ws2_32.lib /EHsc /Festats_display.exe
 // /Festats_display.exe to name the output file, same as -o in gcc.
-// /EHsc to enable C++ exceptions.
\ No newline at end of file
+// /EHsc to enable C++ exceptions.
+// /DSTATS_XML_PROFILE=minimal (or compact) for a trimmed XML parser build, see pugiconfig.hpp.
+// Such builds have no XPath, so STATS_GPU_FIELDS is ignored there (see gpu_fields.hpp).
+// On Linux (terminal and agent modes only):
+// g++ -O2 -std=c++20 main.cpp agent.cpp wire_format.cpp shm_publisher.cpp process_runner.cpp gpu_backend.cpp xml_arena.cpp gpu_fields.cpp value_parse.cpp snapshot_bus.cpp collector_engine.cpp proc_reader.cpp process_collector.cpp disk_collector.cpp net_collector.cpp pressure_collector.cpp cgroup_collector.cpp memory_stats.cpp thermal_collector.cpp snapshot_metrics.cpp anomaly_detector.cpp quantile_sketch.cpp alert_rules.cpp alert_sinks.cpp async_io.cpp pugixml.cpp -pthread -lrt -ldl -o stats_display
+// -std=c++17 still builds (async_io.cpp is then empty), with nvidia-smi run on a pool thread by GpuCollector.
+// Tests and benchmarks (Linux): make -C tests, make -C tests bench, see tests/Makefile.
\ No newline at end of file
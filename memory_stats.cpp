@@ -0,0 +1,90 @@
+#include "memory_stats.hpp"
+
+#ifdef __linux__
+#include <unistd.h>
+
+#define MEMINFO_HUGEPAGE_SIZE MEMORY_FIELDS // Extra slot, only needed to size the hugepages
+
+// The /proc/meminfo fields kept, all in kB except the hugepage counts
+static const KeySlotMap::Key MEMINFO_KEYS[] = {
+    {"MemTotal", MEMORY_TOTAL},
+    {"MemFree", MEMORY_FREE},
+    {"MemAvailable", MEMORY_AVAILABLE},
+    {"Buffers", MEMORY_BUFFERS},
+    {"Cached", MEMORY_CACHED},
+    {"Shmem", MEMORY_SHMEM},
+    {"AnonPages", MEMORY_ANON},
+    {"Slab", MEMORY_SLAB},
+    {"SwapTotal", MEMORY_SWAP_TOTAL},
+    {"SwapFree", MEMORY_SWAP_FREE},
+    {"SwapCached", MEMORY_SWAP_CACHED},
+    {"Dirty", MEMORY_DIRTY},
+    {"Writeback", MEMORY_WRITEBACK},
+    {"Committed_AS", MEMORY_COMMITTED},
+    {"CommitLimit", MEMORY_COMMIT_LIMIT},
+    {"HugePages_Total", MEMORY_HUGEPAGES},
+    {"HugePages_Free", MEMORY_HUGEPAGES_FREE},
+    {"Hugepagesize", MEMINFO_HUGEPAGE_SIZE},
+};
+
+// The /proc/vmstat counters kept, slots in MemoryStatsReader::Counter order
+static const KeySlotMap::Key VMSTAT_KEYS[] = {
+    {"pgfault", 0},
+    {"pgmajfault", 1},
+    {"pswpin", 2},
+    {"pswpout", 3},
+};
+
+MemoryStatsReader::MemoryStatsReader(const std::string& pathPrefix)
+    : meminfo_((pathPrefix + "/meminfo").c_str()), vmstat_((pathPrefix + "/vmstat").c_str()),
+      meminfoKeys_(MEMINFO_KEYS, sizeof(MEMINFO_KEYS) / sizeof(MEMINFO_KEYS[0])),
+      vmstatKeys_(VMSTAT_KEYS, sizeof(VMSTAT_KEYS) / sizeof(VMSTAT_KEYS[0])) {
+    pageMb_ = static_cast<double>(sysconf(_SC_PAGESIZE)) / (1024.0 * 1024.0);
+}
+
+bool MemoryStatsReader::read(MemoryStats& stats) {
+    stats = MemoryStats();
+    long length = meminfo_.read(buffer_);
+    if (length <= 0) {
+        return false;
+    }
+    // "MemTotal:       16318168 kB", a field missing on older kernels stays 0
+    unsigned long long meminfo[MEMORY_FIELDS + 1] = {};
+    for (ProcScanner scan(buffer_.data(), static_cast<size_t>(length)); !scan.atEnd(); scan.nextLine()) {
+        int slot = meminfoKeys_.find(scan.token(':'));
+        if (slot >= 0) meminfo[slot] = scan.number();
+    }
+    for (int field = 0; field < MEMORY_HUGEPAGES; ++field) {
+        stats.values[field] = static_cast<double>(meminfo[field]) / 1024.0;
+    }
+    double hugepageMb = static_cast<double>(meminfo[MEMINFO_HUGEPAGE_SIZE]) / 1024.0;
+    stats.values[MEMORY_HUGEPAGES] = static_cast<double>(meminfo[MEMORY_HUGEPAGES]) * hugepageMb;
+    stats.values[MEMORY_HUGEPAGES_FREE] = static_cast<double>(meminfo[MEMORY_HUGEPAGES_FREE]) * hugepageMb;
+    stats.available = true;
+
+    // "pgfault 1234567", the counters since boot
+    length = vmstat_.read(buffer_);
+    if (length <= 0) {
+        haveCounters_ = false;
+        return true;
+    }
+    unsigned long long counters[COUNTERS] = {};
+    for (ProcScanner scan(buffer_.data(), static_cast<size_t>(length)); !scan.atEnd(); scan.nextLine()) {
+        int slot = vmstatKeys_.find(scan.token());
+        if (slot >= 0) counters[slot] = scan.number();
+    }
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(now - lastRead_).count();
+    if (haveCounters_ && seconds > 0.0) {
+        for (int c = 0; c < COUNTERS; ++c) {
+            double perSecond = static_cast<double>(counterDelta(counters_[c], counters[c])) / seconds;
+            stats.values[MEMORY_PAGE_FAULTS + c] = c == SWAP_IN || c == SWAP_OUT ? perSecond * pageMb_ : perSecond;
+        }
+    }
+    for (int c = 0; c < COUNTERS; ++c) counters_[c] = counters[c];
+    haveCounters_ = true;
+    lastRead_ = now;
+    return true;
+}
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef STATS_MEMORY_STATS_HPP
+#define STATS_MEMORY_STATS_HPP
+
+#ifdef __linux__
+#include <chrono>
+#include <string>
+#include <vector>
+#include "proc_reader.hpp"
+#include "snapshot.hpp"
+
+/**
+ * The memory breakdown behind the RAM usage (Linux): page cache, buffers,
+ * swap, dirty and writeback pages, commit charge and hugepages from
+ * /proc/meminfo, and page fault and swap rates from the /proc/vmstat counters.
+ *
+ * Both files are kept open and parsed in place every tick. Each line's key
+ * goes through a KeySlotMap, so it costs one hash and one compare whether it
+ * is one of the few fields wanted or one of the ~150 other vmstat counters.
+ * pathPrefix is where the files are looked for, "/proc" outside of tests.
+ */
+class MemoryStatsReader {
+public:
+    explicit MemoryStatsReader(const std::string& pathPrefix = "/proc");
+
+    // Reads both files into stats, rates over the time since the previous read.
+    // False, with stats not available, when /proc/meminfo cannot be read.
+    bool read(MemoryStats& stats);
+
+private:
+    enum Counter { PAGE_FAULTS, MAJOR_FAULTS, SWAP_IN, SWAP_OUT, COUNTERS }; // Same order as the rate fields
+
+    ProcFile meminfo_;
+    ProcFile vmstat_;
+    KeySlotMap meminfoKeys_;
+    KeySlotMap vmstatKeys_;
+    std::vector<char> buffer_;
+    double pageMb_;
+    unsigned long long counters_[COUNTERS] = {};
+    bool haveCounters_ = false;
+    std::chrono::steady_clock::time_point lastRead_;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,133 @@
+#include "net_collector.hpp"
+
+#ifdef __linux__
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+NetCollector::NetCollector(unsigned int periodMs, const char* path)
+    : periodMs_(periodMs), file_(path), slots_(NET_MAX_SLOTS) {
+    lineSlots_.reserve(NET_MAX_SLOTS);
+    active_.reserve(NET_MAX_SLOTS);
+    byName_.reserve(NET_MAX_SLOTS);
+    freeSlots_.reserve(NET_MAX_SLOTS);
+    for (size_t i = NET_MAX_SLOTS; i-- > 0;) freeSlots_.push_back(i);
+}
+
+size_t NetCollector::findSlot(std::string_view name, size_t hint) {
+    if (hint < slots_.size() && slots_[hint].used && name == slots_[hint].sample.name) {
+        return hint;
+    }
+    std::vector<size_t>::iterator at = std::lower_bound(byName_.begin(), byName_.end(), name,
+                                                        [this](size_t slot, std::string_view key) {
+                                                            return std::string_view(slots_[slot].sample.name) < key;
+                                                        });
+    if (at != byName_.end() && name == slots_[*at].sample.name) {
+        return *at;
+    }
+    if (freeSlots_.empty()) {
+        return slots_.size(); // The table is full
+    }
+    size_t index = freeSlots_.back();
+    freeSlots_.pop_back();
+    byName_.insert(at, index);
+    Slot& slot = slots_[index];
+    slot.used = true;
+    slot.fresh = true;
+    slot.sample = NetSample();
+    size_t size = std::min(name.size(), sizeof(slot.sample.name) - 1);
+    std::memcpy(slot.sample.name, name.data(), size);
+    return index;
+}
+
+void NetCollector::collect() {
+    long length = file_.read(buffer_);
+    if (length < 0) {
+        throw std::runtime_error("Cannot read /proc/net/dev");
+    }
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(now - lastRead_).count();
+    lastRead_ = now;
+    ++tick_;
+
+    // Two header lines, then "name: rx bytes packets errs drop fifo frame compressed multicast
+    // tx bytes packets errs drop fifo colls carrier compressed"
+    ProcScanner scan(buffer_.data(), static_cast<size_t>(length));
+    scan.nextLine();
+    scan.nextLine();
+    active_.clear();
+    size_t line = 0;
+    for (; !scan.atEnd(); scan.nextLine(), ++line) {
+        std::string_view name = scan.token(':');
+        if (name.empty()) continue;
+        unsigned long long fields[16];
+        for (unsigned long long& field : fields) field = scan.number();
+        unsigned long long current[COUNTERS] = {fields[0], fields[1], fields[2], fields[3],
+                                                fields[8], fields[9], fields[10], fields[11]};
+
+        size_t index = findSlot(name, line < lineSlots_.size() ? lineSlots_[line] : slots_.size());
+        if (line < lineSlots_.size()) lineSlots_[line] = index;
+        else lineSlots_.push_back(index);
+        if (index == slots_.size()) continue;
+        Slot& slot = slots_[index];
+        slot.seenTick = tick_;
+        if (slot.fresh) {
+            std::memcpy(slot.counters, current, sizeof(current));
+            slot.fresh = false;
+            continue;
+        }
+
+        unsigned long long delta[COUNTERS];
+        for (int c = 0; c < COUNTERS; ++c) delta[c] = counterDelta(slot.counters[c], current[c]);
+        std::memcpy(slot.counters, current, sizeof(current));
+        if (seconds <= 0.0 || delta[RX_PACKETS] + delta[TX_PACKETS] + delta[RX_DROPS] + delta[TX_DROPS] == 0) {
+            continue;
+        }
+
+        NetSample& sample = slot.sample;
+        sample.rxBytesPerSec = static_cast<double>(delta[RX_BYTES]) / seconds;
+        sample.txBytesPerSec = static_cast<double>(delta[TX_BYTES]) / seconds;
+        sample.rxPacketsPerSec = static_cast<double>(delta[RX_PACKETS]) / seconds;
+        sample.txPacketsPerSec = static_cast<double>(delta[TX_PACKETS]) / seconds;
+        sample.rxDropsPerSec = static_cast<double>(delta[RX_DROPS]) / seconds;
+        sample.txDropsPerSec = static_cast<double>(delta[TX_DROPS]) / seconds;
+        sample.rxErrorsPerSec = static_cast<double>(delta[RX_ERRORS]) / seconds;
+        sample.txErrorsPerSec = static_cast<double>(delta[TX_ERRORS]) / seconds;
+        if (name != "lo") active_.push_back(index);
+    }
+    lineSlots_.resize(line);
+
+    // Free the slots of interfaces that are gone
+    size_t freed = freeSlots_.size();
+    for (size_t i = slots_.size(); i-- > 0;) {
+        if (slots_[i].used && slots_[i].seenTick != tick_) {
+            slots_[i].used = false;
+            freeSlots_.push_back(i);
+        }
+    }
+    if (freeSlots_.size() != freed) {
+        byName_.erase(std::remove_if(byName_.begin(), byName_.end(), [this](size_t slot) { return !slots_[slot].used; }),
+                      byName_.end());
+    }
+
+    // Busiest first
+    size_t shown = std::min<size_t>(NET_TOP_COUNT, active_.size());
+    std::partial_sort(active_.begin(), active_.begin() + static_cast<long>(shown), active_.end(),
+                      [this](size_t a, size_t b) {
+                          const NetSample& x = slots_[a].sample;
+                          const NetSample& y = slots_[b].sample;
+                          return x.rxBytesPerSec + x.txBytesPerSec > y.rxBytesPerSec + y.txBytesPerSec;
+                      });
+    top_.resize(shown);
+    for (size_t i = 0; i < shown; ++i) {
+        top_[i] = slots_[active_[i]].sample;
+    }
+}
+
+unsigned int NetCollector::apply(StatsSnapshot& snapshot) {
+    if (snapshot.interfaces == top_) return 0;
+    snapshot.interfaces = top_;
+    return SNAPSHOT_CHANGED_NETWORK;
+}
+
+#endif
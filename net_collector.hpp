@@ -0,0 +1,62 @@
+#ifndef STATS_NET_COLLECTOR_HPP
+#define STATS_NET_COLLECTOR_HPP
+
+#ifdef __linux__
+#include <chrono>
+#include <vector>
+#include "collector_engine.hpp"
+#include "proc_reader.hpp"
+
+#define NET_TOP_COUNT 4       // Busiest interfaces shown
+#define NET_MAX_SLOTS 4096    // Interfaces tracked (container hosts have thousands of veths); more are ignored
+
+/**
+ * Network interface throughput from /proc/net/dev (Linux).
+ *
+ * Same scheme as DiskCollector: the file is re-read in place and scanned with
+ * ProcScanner, and each interface keeps a slot in a fixed table, found through
+ * its line number of the previous tick, or when interfaces come or go by a
+ * binary search of the slots sorted by name: a container host starting
+ * thousands of veths at once must not cost a scan of the table per veth. Counters are turned into rates with counterDelta(),
+ * so drivers that still keep 32-bit counters wrap cleanly instead of showing
+ * a spike. The loopback interface is tracked but not shown.
+ */
+class NetCollector : public Collector {
+public:
+    explicit NetCollector(unsigned int periodMs, const char* path = "/proc/net/dev");
+
+    const char* name() const { return "network"; }
+    unsigned int periodMs() const { return periodMs_; }
+    void collect();
+    unsigned int apply(StatsSnapshot& snapshot);
+
+private:
+    // The /proc/net/dev fields used, in the order kept in Slot::counters
+    enum Counter { RX_BYTES, RX_PACKETS, RX_ERRORS, RX_DROPS, TX_BYTES, TX_PACKETS, TX_ERRORS, TX_DROPS, COUNTERS };
+
+    struct Slot {
+        bool used = false;
+        bool fresh = true;              // No previous counters yet
+        unsigned long long seenTick = 0;
+        unsigned long long counters[COUNTERS] = {};
+        NetSample sample;               // Its name is the slot's key
+    };
+
+    size_t findSlot(std::string_view name, size_t hint);
+
+    unsigned int periodMs_;
+    ProcFile file_;
+    std::vector<char> buffer_;
+    std::vector<Slot> slots_;           // NET_MAX_SLOTS, allocated once
+    std::vector<size_t> lineSlots_;     // Slot of each line of the previous read
+    std::vector<size_t> byName_;        // Used slots, sorted by interface name
+    std::vector<size_t> freeSlots_;     // Unused slots, taken from the back
+    std::vector<size_t> active_;        // Slots with traffic this tick
+    unsigned long long tick_ = 0;
+    std::chrono::steady_clock::time_point lastRead_;
+    std::vector<NetSample> top_;
+};
+
+#endif
+
+#endif
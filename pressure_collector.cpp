@@ -0,0 +1,175 @@
+#include "pressure_collector.hpp"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include "value_parse.hpp"
+
+#ifdef __linux__
+static const char* const PRESSURE_NAMES[PRESSURE_RESOURCES] = {"cpu", "memory", "io"};
+
+// Parses the averages of a "some avg10=1.50 avg60=1.91 avg300=5.18 total=68639163" line
+static void parseAverages(ProcScanner& scan, double averages[3]) {
+    for (int i = 0; i < 3; ++i) {
+        std::string_view field = scan.token();
+        size_t equals = field.find('=');
+        averages[i] = 0.0;
+        if (equals != std::string_view::npos) parseDouble(field.substr(equals + 1), averages[i]);
+    }
+}
+
+PressureCollector::PressureCollector(unsigned int periodMs, const std::string& pathPrefix) : periodMs_(periodMs) {
+    loadFile_.reset(new ProcFile((pathPrefix + "/loadavg").c_str()));
+    for (int r = 0; r < PRESSURE_RESOURCES; ++r) {
+        pressureFiles_[r].reset(new ProcFile((pathPrefix + "/pressure/" + PRESSURE_NAMES[r]).c_str()));
+    }
+}
+
+void PressureCollector::collect() {
+    char buffer[256];
+    if (loadFile_->read(buffer, sizeof(buffer)) > 0) {
+        ProcScanner scan(buffer, std::strlen(buffer));
+        for (double& load : loadAverage_) {
+            load = -1.0;
+            parseDouble(scan.token(), load);
+        }
+    }
+
+    for (int r = 0; r < PRESSURE_RESOURCES; ++r) {
+        PressureSample& sample = pressure_[r];
+        long length = pressureFiles_[r]->read(buffer, sizeof(buffer));
+        // Fails with EOPNOTSUPP when the kernel was booted with psi=0
+        sample = PressureSample();
+        if (length <= 0) continue;
+        ProcScanner scan(buffer, static_cast<size_t>(length));
+        for (; !scan.atEnd(); scan.nextLine()) {
+            std::string_view kind = scan.token();
+            if (kind == "some") {
+                parseAverages(scan, sample.some);
+                sample.available = true;
+            } else if (kind == "full") {
+                parseAverages(scan, sample.full);
+            }
+        }
+    }
+}
+
+unsigned int PressureCollector::apply(StatsSnapshot& snapshot) {
+    bool changed = false;
+    for (int i = 0; i < 3; ++i) {
+        changed |= updateField(snapshot.loadAverage[i], loadAverage_[i]);
+    }
+    for (int r = 0; r < PRESSURE_RESOURCES; ++r) {
+        if (!(snapshot.pressure[r] == pressure_[r])) {
+            snapshot.pressure[r] = pressure_[r];
+            changed = true;
+        }
+    }
+    return changed ? SNAPSHOT_CHANGED_PRESSURE : 0;
+}
+#endif
+
+PressureTriggers::~PressureTriggers() {
+#ifdef __linux__
+    for (const Watch& watch : watches_) close(watch.fd);
+#endif
+}
+
+void PressureTriggers::addFromEnvironment() {
+    const char* config = std::getenv("STATS_PSI_TRIGGERS");
+    if (!config) return;
+    std::istringstream entries(config);
+    std::string entry;
+    while (std::getline(entries, entry, ';')) {
+        std::istringstream fields(entry);
+        std::string resource, spec, error;
+        if (!(fields >> resource)) continue;
+        std::getline(fields >> std::ws, spec);
+        if (!add(resource, spec, error)) {
+            std::cerr << "Ignoring PSI trigger \"" << entry << "\": " << error << std::endl;
+        }
+    }
+}
+
+bool PressureTriggers::add(const std::string& resource, const std::string& spec, std::string& error) {
+#ifdef __linux__
+    if (resource != "cpu" && resource != "memory" && resource != "io") {
+        error = "unknown resource, expected cpu, memory or io";
+        return false;
+    }
+    std::string path = "/proc/pressure/" + resource;
+    int fd = open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        error = path + ": " + std::strerror(errno);
+        return false;
+    }
+    // The trigger lives as long as the descriptor; the kernel validates the spec on write
+    if (write(fd, spec.c_str(), spec.size() + 1) < 0) {
+        error = std::strerror(errno);
+        close(fd);
+        return false;
+    }
+    Watch watch = {fd, false};
+    watches_.push_back(watch);
+    return true;
+#else
+    (void)resource;
+    (void)spec;
+    error = "pressure stall information is only available on Linux";
+    return false;
+#endif
+}
+
+void PressureTriggers::addDescriptor(int fd) {
+#ifdef __linux__
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK); // So draining it cannot block
+#endif
+    Watch watch = {fd, true};
+    watches_.push_back(watch);
+}
+
+bool PressureTriggers::waitUntil(std::chrono::steady_clock::time_point deadline) {
+#ifdef __linux__
+    while (!watches_.empty()) {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now >= deadline) return false;
+        long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count() + 1;
+
+        std::vector<pollfd> pfds(watches_.size());
+        for (size_t i = 0; i < watches_.size(); ++i) {
+            pfds[i].fd = watches_[i].fd;
+            pfds[i].events = watches_[i].readable ? POLLPRI | POLLIN : POLLPRI;
+        }
+        int count = poll(pfds.data(), pfds.size(), static_cast<int>(ms));
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        bool fired = false;
+        for (size_t i = pfds.size(); i-- > 0;) {
+            if (pfds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+                // Gone (e.g. the cgroup or the pipe writer), stop watching it
+                close(watches_[i].fd);
+                watches_.erase(watches_.begin() + static_cast<long>(i));
+            } else if (pfds[i].revents & pfds[i].events) {
+                if (watches_[i].readable) {
+                    char drain[64];
+                    while (read(pfds[i].fd, drain, sizeof(drain)) > 0) {}
+                }
+                fired = true;
+            }
+        }
+        if (fired) return true;
+    }
+#endif
+    std::this_thread::sleep_until(deadline);
+    return false;
+}
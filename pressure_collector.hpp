@@ -0,0 +1,81 @@
+#ifndef STATS_PRESSURE_COLLECTOR_HPP
+#define STATS_PRESSURE_COLLECTOR_HPP
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include "collector_engine.hpp"
+
+#ifdef __linux__
+#include <memory>
+#include "proc_reader.hpp"
+
+/**
+ * Load averages from /proc/loadavg and pressure stall information from
+ * /proc/pressure/{cpu,memory,io} (Linux 4.20+ with PSI enabled).
+ *
+ * CPU usage says how busy the CPUs are, PSI says how long tasks waited for
+ * them (or for memory, or for I/O). The files are kept open and re-read in
+ * place; a resource whose file cannot be read is reported as not available.
+ * pathPrefix is where the files are looked for, "/proc" outside of tests.
+ */
+class PressureCollector : public Collector {
+public:
+    explicit PressureCollector(unsigned int periodMs, const std::string& pathPrefix = "/proc");
+
+    const char* name() const { return "pressure"; }
+    unsigned int periodMs() const { return periodMs_; }
+    void collect();
+    unsigned int apply(StatsSnapshot& snapshot);
+
+private:
+    unsigned int periodMs_;
+    std::unique_ptr<ProcFile> loadFile_;
+    std::unique_ptr<ProcFile> pressureFiles_[PRESSURE_RESOURCES];
+    double loadAverage_[3] = {-1.0, -1.0, -1.0};
+    PressureSample pressure_[PRESSURE_RESOURCES];
+};
+#endif
+
+/**
+ * PSI triggers: instead of only sampling pressure every tick, the kernel is
+ * asked to wake the monitor as soon as a resource stalls for longer than a
+ * threshold within a window (see Documentation/accounting/psi.rst). Each
+ * trigger is a kept-open /proc/pressure file that polls with POLLPRI when it
+ * fires, at most once per window.
+ *
+ * Triggers come from STATS_PSI_TRIGGERS, ';'-separated entries of
+ * "<cpu|memory|io> <some|full> <stall us> <window us>", e.g.
+ * "memory some 150000 1000000;io full 100000 2000000". Without root the window
+ * must be a multiple of 2 s. Elsewhere than Linux, or without triggers,
+ * waitUntil() is a plain sleep.
+ */
+class PressureTriggers {
+public:
+    PressureTriggers() {}
+    ~PressureTriggers();
+
+    PressureTriggers(const PressureTriggers&) = delete;
+    PressureTriggers& operator=(const PressureTriggers&) = delete;
+
+    // Adds the triggers of STATS_PSI_TRIGGERS; invalid or refused entries are logged and skipped
+    void addFromEnvironment();
+    // Adds one trigger, false (with the reason in error) if the kernel refused it
+    bool add(const std::string& resource, const std::string& spec, std::string& error);
+    // Watches an already open descriptor, which counts as fired when readable or
+    // priority-readable (e.g. the read end of a pipe); the triggers take ownership of it
+    void addDescriptor(int fd);
+    bool empty() const { return watches_.empty(); }
+
+    // Sleeps until deadline, or until a trigger fires; returns true in the latter case
+    bool waitUntil(std::chrono::steady_clock::time_point deadline);
+
+private:
+    struct Watch {
+        int fd;
+        bool readable;  // Fires on POLLIN too; a PSI file always polls readable, so only POLLPRI counts there
+    };
+    std::vector<Watch> watches_;
+};
+
+#endif
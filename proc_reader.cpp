@@ -0,0 +1,327 @@
+#include "proc_reader.hpp"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+size_t raiseOpenFileLimit() {
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0) return 1024;
+    rlim_t wanted = std::min<rlim_t>(limit.rlim_max, OPEN_FILE_LIMIT);
+    if (limit.rlim_cur < wanted) {
+        limit.rlim_cur = wanted;
+        if (setrlimit(RLIMIT_NOFILE, &limit) != 0) getrlimit(RLIMIT_NOFILE, &limit);
+    }
+    return static_cast<size_t>(std::min<rlim_t>(limit.rlim_cur, OPEN_FILE_LIMIT));
+}
+
+ProcFile::ProcFile(const char* path) : path_(path) {
+    fd_ = open(path, O_RDONLY | O_CLOEXEC);
+}
+
+ProcFile::~ProcFile() {
+    if (fd_ >= 0) close(fd_);
+}
+
+long ProcFile::read(char* buffer, size_t size) {
+    if (fd_ < 0) {
+        fd_ = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0) return -1;
+    }
+    ssize_t n;
+    do {
+        n = pread(fd_, buffer, size - 1, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        close(fd_);
+        fd_ = -1;
+        return -1;
+    }
+    buffer[n] = '\0';
+    return static_cast<long>(n);
+}
+
+long ProcFile::read(std::vector<char>& buffer) {
+    if (buffer.size() < 4096) buffer.resize(4096);
+    for (;;) {
+        long length = read(buffer.data(), buffer.size());
+        if (length < 0 || static_cast<size_t>(length) + 1 < buffer.size()) return length;
+        buffer.resize(buffer.size() * 2); // Filled it, so there may be more
+    }
+}
+
+KeySlotMap::KeySlotMap(const Key* keys, size_t count) {
+    // Keys that agree in length and all three sampled characters share every sampled hash
+    for (size_t i = 0; i < count && !wholeKeys_; ++i) {
+        std::string_view a = keys[i].key;
+        size_t n = a.size();
+        for (size_t j = i + 1; j < count && !wholeKeys_; ++j) {
+            std::string_view b = keys[j].key;
+            wholeKeys_ = b.size() == n && (n == 0 || (a[0] == b[0] && a[n / 2] == b[n / 2] && a[n - 1] == b[n - 1]));
+        }
+    }
+    if (!place(keys, count)) {
+        throw std::runtime_error("No perfect hash for the keys, is one of them listed twice?");
+    }
+}
+
+bool KeySlotMap::place(const Key* keys, size_t count) {
+    // Twice as many buckets as keys usually needs a few dozen seeds; grow when none fits
+    size_t size = 4;
+    while (size < count * 2) size *= 2;
+    for (; size <= 65536; size *= 2) {
+        buckets_.assign(size, Bucket());
+        mask_ = static_cast<unsigned int>(size - 1);
+        for (seed_ = 0; seed_ < 4096; ++seed_) {
+            size_t placed = 0;
+            for (; placed < count; ++placed) {
+                std::string_view key = keys[placed].key;
+                Bucket& bucket = buckets_[(wholeKeys_ ? hashWhole(key, seed_) : hashSampled(key, seed_)) & mask_];
+                if (bucket.slot >= 0) break;
+                bucket.key = key;
+                bucket.slot = keys[placed].slot;
+            }
+            if (placed == count) return true;
+            buckets_.assign(size, Bucket());
+        }
+    }
+    return false;
+}
+
+BatchFileReader::BatchFileReader(unsigned int queueDepth) {
+    const char* disabled = std::getenv("STATS_NO_IO_URING");
+    if (!(disabled && *disabled && std::strcmp(disabled, "0") != 0)) {
+        setupRing(queueDepth);
+    }
+}
+
+BatchFileReader::~BatchFileReader() {
+    closeRing();
+}
+
+size_t BatchFileReader::add(int fd, char* buffer, size_t size) {
+    Read read;
+    read.fd = fd;
+    read.buffer = buffer;
+    read.size = static_cast<unsigned int>(size);
+    read.result = -EAGAIN;
+    reads_.push_back(read);
+    return reads_.size() - 1;
+}
+
+void BatchFileReader::run() {
+    if (reads_.empty()) return;
+    if (ringFd_ < 0) {
+        runPread(0);
+        return;
+    }
+    // /proc cannot be read without blocking, so io_uring hands each read to a kernel worker
+    // thread. With several CPUs those run in parallel; on one CPU the hand-off can cost more
+    // than the syscalls it saves. So the second run times the ring, the third pread (the
+    // first sets up the workers), and the faster one per read is kept from then on.
+    ++runs_;
+    if (runs_ != 2 && runs_ != 3) {
+        if (!runRing()) runPread(0);
+        return;
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (runs_ == 2) {
+        if (!runRing()) {
+            runPread(0);
+            return;
+        }
+    } else {
+        runPread(0);
+    }
+    double nsPerRead = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+                       static_cast<double>(reads_.size());
+    if (runs_ == 2) {
+        ringNsPerRead_ = nsPerRead;
+    } else if (nsPerRead < ringNsPerRead_) {
+        closeRing();
+    }
+}
+
+void BatchFileReader::runPread(size_t from) {
+    for (size_t i = from; i < reads_.size(); ++i) {
+        Read& read = reads_[i];
+        ssize_t n;
+        do {
+            n = pread(read.fd, read.buffer, read.size, 0);
+            ++syscalls_;
+        } while (n < 0 && errno == EINTR);
+        read.result = n < 0 ? -errno : static_cast<long>(n);
+    }
+}
+
+bool BatchFileReader::setupRing(unsigned int queueDepth) {
+#ifdef __NR_io_uring_setup
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    int fd = static_cast<int>(syscall(__NR_io_uring_setup, queueDepth, &params));
+    if (fd < 0) {
+        return false; // ENOSYS, EPERM under seccomp or io_uring_disabled: pread it is
+    }
+    ringFd_ = fd;
+    entries_ = params.sq_entries;
+
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMmap) {
+        sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+    }
+    sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED) {
+        sqRing_ = nullptr;
+        closeRing();
+        return false;
+    }
+    if (singleMmap) {
+        cqRing_ = sqRing_;
+    } else {
+        cqRing_ = mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED) {
+            cqRing_ = nullptr;
+            closeRing();
+            return false;
+        }
+    }
+    sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes_ == MAP_FAILED) {
+        sqes_ = nullptr;
+        closeRing();
+        return false;
+    }
+
+    char* sq = static_cast<char*>(sqRing_);
+    char* cq = static_cast<char*>(cqRing_);
+    sqTail_ = reinterpret_cast<unsigned int*>(sq + params.sq_off.tail);
+    sqMask_ = reinterpret_cast<unsigned int*>(sq + params.sq_off.ring_mask);
+    sqArray_ = reinterpret_cast<unsigned int*>(sq + params.sq_off.array);
+    cqHead_ = reinterpret_cast<unsigned int*>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned int*>(cq + params.cq_off.tail);
+    cqMask_ = reinterpret_cast<unsigned int*>(cq + params.cq_off.ring_mask);
+    cqes_ = cq + params.cq_off.cqes;
+    return true;
+#else
+    (void)queueDepth;
+    return false;
+#endif
+}
+
+void BatchFileReader::closeRing() {
+    if (sqes_) munmap(sqes_, sqesSize_);
+    if (cqRing_ && cqRing_ != sqRing_) munmap(cqRing_, cqRingSize_);
+    if (sqRing_) munmap(sqRing_, sqRingSize_);
+    sqes_ = sqRing_ = cqRing_ = nullptr;
+    if (ringFd_ >= 0) close(ringFd_);
+    ringFd_ = -1;
+}
+
+// Takes the completions the kernel has posted, returns how many there were
+unsigned int BatchFileReader::reapCompletions() {
+    const io_uring_cqe* cqes = static_cast<const io_uring_cqe*>(cqes_);
+    const unsigned int cqMask = *cqMask_;
+    unsigned int head = *cqHead_;
+    unsigned int cqTail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    unsigned int reaped = cqTail - head;
+    for (; head != cqTail; ++head) {
+        const io_uring_cqe& cqe = cqes[head & cqMask];
+        reads_[cqe.user_data].result = cqe.res;
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+    return reaped;
+}
+
+// Waits for reads already submitted, without submitting more; false if the ring cannot even do that
+bool BatchFileReader::drainRing(unsigned int inFlight) {
+#ifdef __NR_io_uring_enter
+    while (inFlight > 0) {
+        long rc = syscall(__NR_io_uring_enter, ringFd_, 0, inFlight, IORING_ENTER_GETEVENTS, nullptr, 0);
+        ++syscalls_;
+        if (rc < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) return false;
+        inFlight -= std::min(inFlight, reapCompletions());
+    }
+    return true;
+#else
+    return inFlight == 0;
+#endif
+}
+
+bool BatchFileReader::runRing() {
+#ifdef __NR_io_uring_enter
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(sqes_);
+    const unsigned int sqMask = *sqMask_;
+
+    // At most entries_ reads in flight, the completion queue is twice that so it never overflows
+    for (size_t from = 0; from < reads_.size(); from += entries_) {
+        unsigned int count = static_cast<unsigned int>(std::min<size_t>(entries_, reads_.size() - from));
+        unsigned int tail = *sqTail_; // Only this thread writes the tail
+        for (unsigned int i = 0; i < count; ++i) {
+            Read& read = reads_[from + i];
+            read.result = -EINPROGRESS; // Until its completion is reaped
+            unsigned int index = (tail + i) & sqMask;
+            io_uring_sqe& sqe = sqes[index];
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = IORING_OP_READ;
+            sqe.fd = read.fd;
+            sqe.off = 0;
+            sqe.addr = reinterpret_cast<unsigned long long>(read.buffer);
+            sqe.len = read.size;
+            sqe.user_data = from + i;
+            sqArray_[index] = index;
+        }
+        __atomic_store_n(sqTail_, tail + count, __ATOMIC_RELEASE);
+
+        // One syscall submits the batch and waits for all of it in the common case
+        unsigned int toSubmit = count;
+        unsigned int reaped = 0;
+        while (reaped < count) {
+            long rc = syscall(__NR_io_uring_enter, ringFd_, toSubmit, count - reaped, IORING_ENTER_GETEVENTS, nullptr, 0);
+            ++syscalls_;
+            if (rc < 0) {
+                if (errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+                // Broken ring. The kernel takes entries in order, so the first ones of the batch
+                // were submitted and may still be writing into their buffers: they are waited
+                // for before the ring is closed, and only the rest are redone with pread.
+                unsigned int submitted = count - toSubmit;
+                if (!drainRing(submitted - reaped)) {
+                    // Only a ring being torn down fails to wait; its reads are given up on
+                    // rather than redone into buffers the kernel may still fill
+                    for (size_t i = from; i < from + submitted; ++i) {
+                        if (reads_[i].result == -EINPROGRESS) reads_[i].result = -EIO;
+                    }
+                }
+                closeRing();
+                runPread(from + submitted);
+                return true;
+            }
+            toSubmit -= std::min<unsigned int>(toSubmit, static_cast<unsigned int>(rc));
+            reaped += reapCompletions();
+        }
+
+        // Kernels before 5.6 set up a ring but reject IORING_OP_READ
+        if (from == 0 && reads_[0].result == -EINVAL) {
+            closeRing();
+            return false;
+        }
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+#endif
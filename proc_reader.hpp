@@ -0,0 +1,227 @@
+#ifndef STATS_PROC_READER_HPP
+#define STATS_PROC_READER_HPP
+
+#ifdef __linux__
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define OPEN_FILE_LIMIT 65536 // Highest soft RLIMIT_NOFILE raiseOpenFileLimit() asks for
+
+// Raises the soft RLIMIT_NOFILE towards the hard limit (once, up to OPEN_FILE_LIMIT) and
+// returns it. Collectors that keep a file open per process or per cgroup need more than the
+// usual 1024, and share what they get out of this.
+size_t raiseOpenFileLimit();
+
+/**
+ * Reading /proc files without re-opening them.
+ *
+ * A /proc file regenerates its content on every read from offset 0, so a
+ * descriptor can be kept open and read with pread each tick: one syscall per
+ * sample instead of open, read and close.
+ */
+class ProcFile {
+public:
+    explicit ProcFile(const char* path);
+    ~ProcFile();
+
+    ProcFile(const ProcFile&) = delete;
+    ProcFile& operator=(const ProcFile&) = delete;
+
+    // Reads the whole file into buffer and NUL-terminates it. Returns the length, or -1.
+    long read(char* buffer, size_t size);
+    // Same, growing buffer until the whole file fits; once it does, reads allocate nothing
+    long read(std::vector<char>& buffer);
+
+private:
+    std::string path_;
+    int fd_ = -1; // Re-opened on the next read if it failed
+};
+
+/**
+ * Walks the text of a /proc file in place, without copying or allocating.
+ * Fields are separated by blanks, records by newlines; every method stops at
+ * the end of the current line, so a short line cannot shift the next one.
+ */
+class ProcScanner {
+public:
+    ProcScanner(const char* data, size_t size) : p_(data), end_(data + size) {}
+
+    bool atEnd() const { return p_ >= end_; }
+
+    // Next field of the line, empty at its end. Fields also end at stop, which is consumed.
+    std::string_view token(char stop = ' ') {
+        skipBlanks();
+        const char* start = p_;
+        while (p_ < end_ && *p_ != ' ' && *p_ != '\t' && *p_ != '\n' && *p_ != stop) ++p_;
+        std::string_view field(start, static_cast<size_t>(p_ - start));
+        if (p_ < end_ && *p_ == stop && stop != ' ') ++p_;
+        return field;
+    }
+
+    // Next field as an unsigned decimal; 0 at the end of the line or for a non-number
+    unsigned long long number() {
+        skipBlanks();
+        unsigned long long value = 0;
+        for (; p_ < end_ && *p_ >= '0' && *p_ <= '9'; ++p_) {
+            value = value * 10 + static_cast<unsigned long long>(*p_ - '0');
+        }
+        while (p_ < end_ && *p_ != ' ' && *p_ != '\t' && *p_ != '\n') ++p_;
+        return value;
+    }
+
+    // Moves to the start of the next line
+    void nextLine() {
+        while (p_ < end_ && *p_ != '\n') ++p_;
+        if (p_ < end_) ++p_;
+    }
+
+private:
+    void skipBlanks() {
+        while (p_ < end_ && (*p_ == ' ' || *p_ == '\t')) ++p_;
+    }
+
+    const char* p_;
+    const char* end_;
+};
+
+// Growth of a kernel counter between two reads. A counter that went backwards either
+// wrapped, from near the top of its 32 or 64 bits (32-bit kernels and some drivers still
+// keep 32-bit counters), or was reset (device re-created, driver reloaded). A reset gives
+// 0 rather than a huge bogus delta.
+inline unsigned long long counterDelta(unsigned long long previous, unsigned long long current) {
+    if (current >= previous) return current - previous;
+    if (previous > 0x80000000ULL && previous <= 0xFFFFFFFFULL) return current + (0x100000000ULL - previous);
+    if (previous > 0x8000000000000000ULL) return current - previous; // Modulo 2^64
+    return 0;
+}
+
+/**
+ * Finds the slot of a key in "key: value" /proc files (meminfo, vmstat) with
+ * a perfect hash: the constructor searches for a seed under which every known
+ * key gets a bucket of its own, so a lookup is one hash of the key and one
+ * compare, whatever the number of keys. Unknown keys land in some bucket and
+ * fail the compare. The keys must outlive the map (string literals).
+ * The hash only mixes the length and the first, middle and last characters,
+ * which tells the kernel's key names apart without walking each one; a key
+ * set those do not separate is hashed over whole keys instead.
+ */
+class KeySlotMap {
+public:
+    struct Key {
+        const char* key;
+        int slot;
+    };
+
+    KeySlotMap(const Key* keys, size_t count);
+
+    // Slot of key, -1 if it is not one of the known keys
+    int find(std::string_view key) const {
+        const Bucket& bucket = buckets_[(wholeKeys_ ? hashWhole(key, seed_) : hashSampled(key, seed_)) & mask_];
+        return bucket.key == key ? bucket.slot : -1;
+    }
+
+private:
+    struct Bucket {
+        std::string_view key;
+        int slot = -1;
+    };
+
+    // FNV-1a, seeded
+    static unsigned int hashWhole(std::string_view key, unsigned int seed) {
+        unsigned int h = 2166136261u ^ seed;
+        for (char c : key) h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+        return h;
+    }
+    // The same over the length and three characters
+    static unsigned int hashSampled(std::string_view key, unsigned int seed) {
+        size_t size = key.size();
+        unsigned int h = (2166136261u ^ seed ^ static_cast<unsigned int>(size)) * 16777619u;
+        if (size == 0) return h;
+        h = (h ^ static_cast<unsigned char>(key[0])) * 16777619u;
+        h = (h ^ static_cast<unsigned char>(key[size / 2])) * 16777619u;
+        return (h ^ static_cast<unsigned char>(key[size - 1])) * 16777619u;
+    }
+    // Looks for a seed and table size that place every key in a bucket of its own
+    bool place(const Key* keys, size_t count);
+
+    std::vector<Bucket> buckets_;
+    unsigned int mask_ = 0;
+    unsigned int seed_ = 0;
+    bool wholeKeys_ = false;
+};
+
+/**
+ * Reads many /proc files at once, e.g. /proc/<pid>/stat for every process.
+ *
+ * With io_uring, all queued reads go to the kernel in one submission per
+ * queueDepth reads and their completions are reaped in bulk from the shared
+ * ring, instead of one pread syscall per file. The ring is set up with raw
+ * syscalls (no liburing dependency). When io_uring is unavailable (kernels
+ * before 5.6, seccomp profiles in containers, kernel.io_uring_disabled) or
+ * STATS_NO_IO_URING is set, run() falls back to one pread per file. It also
+ * switches to pread for good when that measured faster on the early runs,
+ * as it does on single-CPU machines.
+ */
+class BatchFileReader {
+public:
+    explicit BatchFileReader(unsigned int queueDepth = 256);
+    ~BatchFileReader();
+
+    BatchFileReader(const BatchFileReader&) = delete;
+    BatchFileReader& operator=(const BatchFileReader&) = delete;
+
+    void clear() { reads_.clear(); }
+    // Queues a read from offset 0 of fd into buffer, returns its index for result()
+    size_t add(int fd, char* buffer, size_t size);
+    // Performs every queued read
+    void run();
+    // Bytes read by the read at index, or -errno
+    long result(size_t index) const { return reads_[index].result; }
+    size_t size() const { return reads_.size(); }
+
+    bool usingIoUring() const { return ringFd_ >= 0; }
+    unsigned long long syscalls() const { return syscalls_; } // Made by run() so far
+
+private:
+    struct Read {
+        int fd;
+        char* buffer;
+        unsigned int size;
+        long result;
+    };
+
+    bool setupRing(unsigned int queueDepth);
+    void closeRing();
+    bool runRing();  // False if the ring cannot do reads, run() then falls back
+    unsigned int reapCompletions();
+    bool drainRing(unsigned int inFlight);
+    void runPread(size_t from);
+
+    std::vector<Read> reads_;
+    unsigned long long syscalls_ = 0;
+    unsigned int runs_ = 0;           // Up to the choice between the ring and pread
+    double ringNsPerRead_ = 0.0;
+
+    // io_uring state, see io_uring_setup(2)
+    int ringFd_ = -1;
+    unsigned int entries_ = 0;
+    void* sqRing_ = nullptr;
+    size_t sqRingSize_ = 0;
+    void* cqRing_ = nullptr;   // Same mapping as sqRing_ with IORING_FEAT_SINGLE_MMAP
+    size_t cqRingSize_ = 0;
+    void* sqes_ = nullptr;
+    size_t sqesSize_ = 0;
+    unsigned int* sqTail_ = nullptr;
+    unsigned int* sqMask_ = nullptr;
+    unsigned int* sqArray_ = nullptr;
+    unsigned int* cqHead_ = nullptr;
+    unsigned int* cqTail_ = nullptr;
+    unsigned int* cqMask_ = nullptr;
+    void* cqes_ = nullptr;
+};
+
+#endif
+
+#endif
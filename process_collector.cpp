@@ -0,0 +1,194 @@
+#include "process_collector.hpp"
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+// Opens /proc/<pid>/stat, -1 if the process is already gone
+static int openStat(int pid) {
+    char path[32];
+    std::snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+// Parses the fields of a stat line the collector needs. The command name may contain
+// spaces and parentheses, so the fields are counted from the last ')'.
+static bool parseStat(const char* line, size_t length, unsigned long long& cpuTicks, unsigned long long& rssPages,
+                      const char*& comm, size_t& commLength) {
+    const char* open = static_cast<const char*>(std::memchr(line, '(', length));
+    const char* close = static_cast<const char*>(memrchr(line, ')', length));
+    if (!open || !close || close < open) {
+        return false;
+    }
+    comm = open + 1;
+    commLength = static_cast<size_t>(close - comm);
+
+    // Field 3 (state) follows ") "; utime and stime are fields 14 and 15, rss is 24
+    const char* p = close + 2;
+    const char* end = line + length;
+    unsigned long long utime = 0, stime = 0;
+    for (int field = 3; field <= 24; ++field) {
+        if (p >= end) {
+            return false;
+        }
+        unsigned long long value = 0;
+        for (; p < end && *p != ' '; ++p) {
+            value = value * 10 + static_cast<unsigned long long>(*p - '0'); // Only used for numeric fields
+        }
+        ++p;
+        if (field == 14) utime = value;
+        else if (field == 15) stime = value;
+        else if (field == 24) rssPages = value;
+    }
+    cpuTicks = utime + stime;
+    return true;
+}
+
+ProcessCollector::ProcessCollector(unsigned int periodMs)
+    : periodMs_(periodMs), reader_(PROCESS_QUEUE_DEPTH) {
+    ticksPerSecond_ = static_cast<double>(sysconf(_SC_CLK_TCK));
+    pageMb_ = static_cast<double>(sysconf(_SC_PAGESIZE)) / (1024.0 * 1024.0);
+
+    // Half of the descriptors; the cgroup collector takes a quarter, the rest is for everything else
+    fdBudget_ = std::min<size_t>(raiseOpenFileLimit() / 2, PROCESS_MAX_FDS);
+}
+
+ProcessCollector::~ProcessCollector() {
+    for (const Entry& entry : entries_) {
+        if (entry.fd >= 0) close(entry.fd);
+    }
+}
+
+void ProcessCollector::syncPids() {
+    DIR* dir = opendir("/proc");
+    if (!dir) {
+        throw std::runtime_error(std::string("Cannot list /proc: ") + std::strerror(errno));
+    }
+    pids_.clear();
+    while (dirent* item = readdir(dir)) {
+        const char* name = item->d_name;
+        if (*name < '1' || *name > '9') continue;
+        int pid = 0;
+        for (; *name >= '0' && *name <= '9'; ++name) pid = pid * 10 + (*name - '0');
+        if (*name == '\0') pids_.push_back(pid);
+    }
+    closedir(dir);
+    std::sort(pids_.begin(), pids_.end()); // Usually listed in order already
+
+    // Merge with the known processes: keep the survivors, drop the gone, add the new
+    merged_.clear();
+    size_t known = 0;
+    for (int pid : pids_) {
+        for (; known < entries_.size() && entries_[known].pid < pid; ++known) {
+            if (entries_[known].fd >= 0) {
+                close(entries_[known].fd);
+                --cachedFds_;
+            }
+        }
+        if (known < entries_.size() && entries_[known].pid == pid) {
+            merged_.push_back(entries_[known++]);
+            continue;
+        }
+        Entry entry = {pid, -1, 0, true};
+        if (cachedFds_ < fdBudget_) {
+            entry.fd = openStat(pid);
+            if (entry.fd < 0) continue; // Exited since the listing
+            ++cachedFds_;
+        }
+        merged_.push_back(entry);
+    }
+    for (; known < entries_.size(); ++known) {
+        if (entries_[known].fd >= 0) {
+            close(entries_[known].fd);
+            --cachedFds_;
+        }
+    }
+    entries_.swap(merged_);
+}
+
+void ProcessCollector::collect() {
+    syncPids();
+
+    // One read per process, all in one batch
+    const size_t count = entries_.size();
+    buffers_.resize(count * PROCESS_STAT_BUFFER);
+    readFds_.resize(count);
+    reader_.clear();
+    for (size_t i = 0; i < count; ++i) {
+        readFds_[i] = entries_[i].fd >= 0 ? entries_[i].fd : openStat(entries_[i].pid);
+        // A failed open gives fd -1, the read then fails with EBADF like any other gone process
+        reader_.add(readFds_[i], &buffers_[i * PROCESS_STAT_BUFFER], PROCESS_STAT_BUFFER);
+    }
+    reader_.run();
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(now - lastRead_).count();
+    lastRead_ = now;
+    for (size_t i = 0; i < count; ++i) {
+        if (entries_[i].fd < 0 && readFds_[i] >= 0) close(readFds_[i]);
+    }
+
+    ranked_.clear();
+    size_t alive = 0;
+    for (size_t i = 0; i < count; ++i) {
+        Entry& entry = entries_[i];
+        long length = reader_.result(i);
+        unsigned long long cpuTicks = 0, rssPages = 0;
+        const char* comm = nullptr;
+        size_t commLength = 0;
+        if (length <= 0 || !parseStat(&buffers_[i * PROCESS_STAT_BUFFER], static_cast<size_t>(length),
+                                      cpuTicks, rssPages, comm, commLength)) {
+            // Gone (ESRCH): drop it, compacted below
+            if (entry.fd >= 0) {
+                close(entry.fd);
+                --cachedFds_;
+            }
+            entry.pid = 0;
+            continue;
+        }
+        double cpuUsage = 0.0;
+        if (!entry.fresh && seconds > 0.0 && cpuTicks >= entry.cpuTicks) {
+            cpuUsage = static_cast<double>(cpuTicks - entry.cpuTicks) / ticksPerSecond_ / seconds * 100.0;
+        }
+        entry.cpuTicks = cpuTicks;
+        entry.fresh = false;
+        Ranked ranked = {cpuUsage, static_cast<double>(rssPages) * pageMb_, i, comm, commLength};
+        ranked_.push_back(ranked);
+        ++alive;
+    }
+    processCount_ = static_cast<unsigned int>(alive);
+
+    // Busiest first, ties broken by memory so the list does not flicker between idle processes
+    size_t shown = std::min<size_t>(PROCESS_TOP_COUNT, ranked_.size());
+    std::partial_sort(ranked_.begin(), ranked_.begin() + static_cast<long>(shown), ranked_.end(),
+                      [](const Ranked& a, const Ranked& b) {
+                          return a.cpuUsage != b.cpuUsage ? a.cpuUsage > b.cpuUsage : a.rssMb > b.rssMb;
+                      });
+    top_.resize(shown);
+    for (size_t i = 0; i < shown; ++i) {
+        const Ranked& ranked = ranked_[i];
+        top_[i].pid = entries_[ranked.entry].pid;
+        top_[i].name.assign(ranked.comm, ranked.commLength);
+        top_[i].cpuUsage = ranked.cpuUsage;
+        top_[i].rssMb = ranked.rssMb;
+    }
+
+    entries_.erase(std::remove_if(entries_.begin(), entries_.end(), [](const Entry& e) { return e.pid == 0; }),
+                   entries_.end());
+}
+
+unsigned int ProcessCollector::apply(StatsSnapshot& snapshot) {
+    bool changed = updateField(snapshot.processCount, processCount_);
+    if (snapshot.topProcesses != top_) {
+        snapshot.topProcesses = top_;
+        changed = true;
+    }
+    return changed ? SNAPSHOT_CHANGED_PROCESSES : 0;
+}
+
+#endif
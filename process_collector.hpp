@@ -0,0 +1,75 @@
+#ifndef STATS_PROCESS_COLLECTOR_HPP
+#define STATS_PROCESS_COLLECTOR_HPP
+
+#ifdef __linux__
+#include <chrono>
+#include <vector>
+#include "collector_engine.hpp"
+#include "proc_reader.hpp"
+
+#define PROCESS_TOP_COUNT 5          // Busiest processes shown
+#define PROCESS_STAT_BUFFER 512      // Per process; the fields up to rss fit, the tail may be cut
+#define PROCESS_QUEUE_DEPTH 1024     // Reads per io_uring submission
+#define PROCESS_MAX_FDS 32768        // Most stat files kept open
+
+/**
+ * Per-process CPU and memory from /proc/<pid>/stat (Linux).
+ *
+ * Each tick lists /proc, then reads the stat file of every process in one
+ * batch (see BatchFileReader): with io_uring that is one submission per
+ * PROCESS_QUEUE_DEPTH processes rather than one read per process. The stat
+ * files stay open from tick to tick, so a process costs no open or close
+ * after the tick it appeared in. Pid reuse is safe: an open stat file belongs
+ * to its process, and once that is gone reads fail with ESRCH and the entry
+ * is dropped. Processes beyond the descriptor budget (half of the open file
+ * limit, see raiseOpenFileLimit()) are opened and closed every tick instead.
+ */
+class ProcessCollector : public Collector {
+public:
+    explicit ProcessCollector(unsigned int periodMs);
+    ~ProcessCollector();
+
+    const char* name() const { return "processes"; }
+    unsigned int periodMs() const { return periodMs_; }
+    void collect();
+    unsigned int apply(StatsSnapshot& snapshot);
+
+private:
+    struct Entry {
+        int pid;
+        int fd;                       // Cached stat file, -1 when over the budget
+        unsigned long long cpuTicks;  // utime + stime at the previous read
+        bool fresh;                   // No previous read yet
+    };
+    struct Ranked {
+        double cpuUsage;
+        double rssMb;
+        size_t entry;
+        const char* comm;             // Into buffers_
+        size_t commLength;
+    };
+
+    void syncPids();  // Brings entries_ in line with the listing of /proc
+
+    unsigned int periodMs_;
+    BatchFileReader reader_;
+    std::vector<Entry> entries_;      // Sorted by pid
+    // Per-tick working sets, members so their storage is reused
+    std::vector<int> pids_;
+    std::vector<Entry> merged_;
+    std::vector<int> readFds_;
+    std::vector<Ranked> ranked_;
+    std::vector<char> buffers_;       // PROCESS_STAT_BUFFER bytes per entry
+    size_t cachedFds_ = 0;
+    size_t fdBudget_ = 0;
+    double ticksPerSecond_;
+    double pageMb_;
+    std::chrono::steady_clock::time_point lastRead_;
+
+    unsigned int processCount_ = 0;
+    std::vector<ProcessSample> top_;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,431 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include "process_runner.hpp"
+
+#define CANCEL_POLL_MS 50      // Longest wait between checks of the cancel flag
+#define READ_CHUNK_SIZE 65536
+
+static long long steadyNowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Time left until the deadline, clamped to one cancel polling slice
+static int nextWaitMs(long long deadlineMs) {
+    long long remaining = deadlineMs - steadyNowMs();
+    if (remaining <= 0) return 0;
+    return static_cast<int>(remaining < CANCEL_POLL_MS ? remaining : CANCEL_POLL_MS);
+}
+
+std::string describeFailure(const ProcessResult& result) {
+    std::ostringstream oss;
+    switch (result.status) {
+        case ProcessResult::EXITED: oss << "exited with code " << result.exitCode; break;
+        case ProcessResult::TIMED_OUT: oss << "timed out and was killed"; break;
+        case ProcessResult::CANCELLED: oss << "was cancelled"; break;
+        case ProcessResult::OUTPUT_LIMIT: oss << "produced too much output and was killed"; break;
+        case ProcessResult::SPAWN_FAILED: oss << "could not be started: " << result.error; break;
+    }
+    return oss.str();
+}
+
+void CircuitBreaker::recordSuccess() {
+    consecutiveFailures_ = 0;
+    openUntilMs_ = 0;
+}
+
+void CircuitBreaker::recordFailure(unsigned long long nowMs) {
+    consecutiveFailures_++;
+    if (consecutiveFailures_ < failureThreshold_) return;
+    unsigned long long backoff = baseBackoffMs_;
+    for (unsigned int i = failureThreshold_; i < consecutiveFailures_ && backoff < maxBackoffMs_; ++i) {
+        backoff *= 2;
+    }
+    if (backoff > maxBackoffMs_) backoff = maxBackoffMs_;
+    openUntilMs_ = nowMs + backoff;
+}
+
+
+void PreparedCommand::reserveChunk() {
+    if (buffer_.size() - outputSize_ >= READ_CHUNK_SIZE) return;
+    size_t grown = buffer_.size() * 2;
+    if (grown < outputSize_ + READ_CHUNK_SIZE) grown = outputSize_ + READ_CHUNK_SIZE;
+    buffer_.resize(grown); // Only grows up to the high-water mark, never shrinks
+}
+
+ProcessResult runProcess(const std::vector<std::string>& argv, const ProcessOptions& options) {
+    PreparedCommand command(argv);
+    ProcessResult result = command.run(options);
+    result.output.assign(command.output().data(), command.output().size());
+    return result;
+}
+
+#ifdef _WIN32
+
+// Quotes one argument the way CommandLineToArgvW splits it back
+static void appendQuotedArg(std::string& cmd, const std::string& arg) {
+    if (!cmd.empty()) cmd += ' ';
+    if (!arg.empty() && arg.find_first_of(" \t\"") == std::string::npos) {
+        cmd += arg;
+        return;
+    }
+    cmd += '"';
+    size_t backslashes = 0;
+    for (char c : arg) {
+        if (c == '\\') {
+            backslashes++;
+            continue;
+        }
+        if (c == '"') {
+            cmd.append(backslashes * 2 + 1, '\\'); // Escape the backslashes and the quote itself
+        } else {
+            cmd.append(backslashes, '\\');
+        }
+        cmd += c;
+        backslashes = 0;
+    }
+    cmd.append(backslashes * 2, '\\'); // Backslashes before the closing quote must be doubled
+    cmd += '"';
+}
+
+PreparedCommand::PreparedCommand(std::vector<std::string> argv) : argv_(std::move(argv)) {
+    for (const std::string& arg : argv_) appendQuotedArg(commandLine_, arg);
+    commandBuffer_.resize(commandLine_.size() + 1);
+    // With a full path CreateProcess does not need to search for the executable
+    if (!argv_.empty() && argv_[0].find_first_of("\\/") != std::string::npos) {
+        applicationName_ = argv_[0];
+    }
+    SIZE_T size = 0;
+    InitializeProcThreadAttributeList(NULL, 1, 0, &size);
+    attributeList_.resize(size);
+}
+
+PreparedCommand::~PreparedCommand() {}
+
+const ProcessResult& PreparedCommand::run(const ProcessOptions& options) {
+    ProcessResult& result = result_;
+    result.status = ProcessResult::SPAWN_FAILED;
+    result.exitCode = -1;
+    result.error.clear();
+    outputSize_ = 0;
+    if (argv_.empty()) {
+        result.error = "empty command";
+        return result;
+    }
+
+    // Anonymous pipes cannot do overlapped I/O, so use a uniquely named pipe instead
+    static volatile LONG pipeSerial = 0;
+    char pipeName[96];
+    std::snprintf(pipeName, sizeof(pipeName), "\\\\.\\pipe\\stats_display.%lu.%ld",
+                  GetCurrentProcessId(), InterlockedIncrement(&pipeSerial));
+    HANDLE hReadPipe = CreateNamedPipeA(pipeName,
+                                        PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+                                        PIPE_TYPE_BYTE | PIPE_WAIT, 1, 0, READ_CHUNK_SIZE, 0, NULL);
+    if (hReadPipe == INVALID_HANDLE_VALUE) {
+        result.error = "CreateNamedPipe failed with error code: " + std::to_string(GetLastError());
+        return result;
+    }
+
+    SECURITY_ATTRIBUTES sa;
+    sa.nLength = sizeof(SECURITY_ATTRIBUTES);
+    sa.bInheritHandle = TRUE;
+    sa.lpSecurityDescriptor = NULL;
+    HANDLE hWritePipe = CreateFileA(pipeName, GENERIC_WRITE, 0, &sa, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hWritePipe == INVALID_HANDLE_VALUE) {
+        result.error = "Opening the pipe failed with error code: " + std::to_string(GetLastError());
+        CloseHandle(hReadPipe);
+        return result;
+    }
+
+    // Inherit only the pipe, not every inheritable handle the monitor happens to hold
+    LPPROC_THREAD_ATTRIBUTE_LIST attributes = reinterpret_cast<LPPROC_THREAD_ATTRIBUTE_LIST>(attributeList_.data());
+    SIZE_T attributeSize = attributeList_.size();
+    InitializeProcThreadAttributeList(attributes, 1, 0, &attributeSize);
+    UpdateProcThreadAttribute(attributes, 0, PROC_THREAD_ATTRIBUTE_HANDLE_LIST, &hWritePipe, sizeof(HANDLE), NULL, NULL);
+
+    STARTUPINFOEXA si;
+    ZeroMemory(&si, sizeof(si));
+    si.StartupInfo.cb = sizeof(si);
+    si.StartupInfo.hStdError = hWritePipe;
+    si.StartupInfo.hStdOutput = hWritePipe;
+    si.StartupInfo.dwFlags |= STARTF_USESTDHANDLES;
+    si.StartupInfo.dwFlags |= STARTF_USESHOWWINDOW;
+    si.StartupInfo.wShowWindow = SW_HIDE;
+    si.lpAttributeList = attributes;
+
+    PROCESS_INFORMATION pi;
+    ZeroMemory(&pi, sizeof(pi));
+
+    std::memcpy(commandBuffer_.data(), commandLine_.c_str(), commandLine_.size() + 1);
+    BOOL created = CreateProcessA(applicationName_.empty() ? NULL : applicationName_.c_str(),
+                                  commandBuffer_.data(), NULL, NULL, TRUE,
+                                  CREATE_NO_WINDOW | EXTENDED_STARTUPINFO_PRESENT,
+                                  NULL, NULL, &si.StartupInfo, &pi);
+    DeleteProcThreadAttributeList(attributes);
+    CloseHandle(hWritePipe); // Only the child holds the write end now, so its exit means EOF
+    if (!created) {
+        result.error = "CreateProcess failed with error code: " + std::to_string(GetLastError());
+        CloseHandle(hReadPipe);
+        return result;
+    }
+
+    long long deadline = steadyNowMs() + options.timeoutMs;
+    result.status = ProcessResult::EXITED;
+    OVERLAPPED ov;
+    ZeroMemory(&ov, sizeof(ov));
+    ov.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+    bool childExited = false;
+
+    for (;;) {
+        DWORD dwRead = 0;
+        reserveChunk(); // Never while a read is pending, the buffer may move
+        ResetEvent(ov.hEvent);
+        if (!ReadFile(hReadPipe, buffer_.data() + outputSize_, static_cast<DWORD>(buffer_.size() - outputSize_),
+                      NULL, &ov)) {
+            if (GetLastError() != ERROR_IO_PENDING) break; // ERROR_BROKEN_PIPE: the child closed its end
+
+            // Wait for data, the child's exit, the deadline or cancellation, whichever comes first.
+            // The read event comes first so output written right before exiting is never lost.
+            // Once the child is gone a pending read means only a grandchild still holds the pipe.
+            HANDLE waitOn[2] = {ov.hEvent, pi.hProcess};
+            while (!childExited) {
+                int wait = nextWaitMs(deadline);
+                if (wait == 0) { result.status = ProcessResult::TIMED_OUT; break; }
+                DWORD w = WaitForMultipleObjects(2, waitOn, FALSE, static_cast<DWORD>(wait));
+                if (w == WAIT_OBJECT_0) break;
+                if (w == WAIT_OBJECT_0 + 1) { childExited = true; break; }
+                if (options.cancel && *options.cancel) { result.status = ProcessResult::CANCELLED; break; }
+            }
+            if (result.status != ProcessResult::EXITED || childExited) {
+                CancelIo(hReadPipe);
+            }
+        }
+        BOOL ok = GetOverlappedResult(hReadPipe, &ov, &dwRead, TRUE);
+        if (ok && dwRead > 0) {
+            outputSize_ += dwRead;
+            if (outputSize_ > options.maxOutputBytes) {
+                result.status = ProcessResult::OUTPUT_LIMIT;
+            }
+        }
+        if (!ok || result.status != ProcessResult::EXITED) break;
+    }
+
+    if (result.status == ProcessResult::EXITED) {
+        int wait = static_cast<int>(deadline - steadyNowMs());
+        if (WaitForSingleObject(pi.hProcess, wait > 0 ? static_cast<DWORD>(wait) : 0) != WAIT_OBJECT_0) {
+            result.status = ProcessResult::TIMED_OUT;
+        }
+    }
+    if (result.status != ProcessResult::EXITED) {
+        TerminateProcess(pi.hProcess, 1);
+        WaitForSingleObject(pi.hProcess, INFINITE); // Reap, termination is asynchronous
+    }
+    DWORD exitCode = 0;
+    GetExitCodeProcess(pi.hProcess, &exitCode);
+    result.exitCode = static_cast<int>(exitCode);
+
+    CloseHandle(ov.hEvent);
+    CloseHandle(pi.hProcess);
+    CloseHandle(pi.hThread);
+    CloseHandle(hReadPipe);
+    return result;
+}
+
+#else
+
+extern char** environ;
+
+// pidfd_open(2), Linux 5.3+. Returns -1 elsewhere, the runner then polls waitpid instead.
+static int openPidFd(pid_t pid) {
+#if defined(__linux__) && defined(SYS_pidfd_open)
+    return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+    (void)pid;
+    return -1;
+#endif
+}
+
+// Resolves a bare command name against PATH once, instead of posix_spawnp trying every entry per spawn
+static std::string resolveInPath(const std::string& name) {
+    if (name.find('/') != std::string::npos) return name;
+    const char* envPath = std::getenv("PATH");
+    if (!envPath) return "";
+    std::string dirs = envPath;
+    size_t start = 0;
+    while (start <= dirs.size()) {
+        size_t end = dirs.find(':', start);
+        if (end == std::string::npos) end = dirs.size();
+        std::string dir = dirs.substr(start, end - start);
+        std::string candidate = (dir.empty() ? std::string(".") : dir) + "/" + name;
+        if (access(candidate.c_str(), X_OK) == 0) return candidate;
+        start = end + 1;
+    }
+    return "";
+}
+
+PreparedCommand::PreparedCommand(std::vector<std::string> argv) : argv_(std::move(argv)) {
+    if (!argv_.empty()) path_ = resolveInPath(argv_[0]);
+    for (std::string& arg : argv_) args_.push_back(&arg[0]);
+    args_.push_back(nullptr);
+
+    // The child starts with default SIGPIPE handling and no blocked signals, whatever ours are
+    posix_spawnattr_init(&attr_);
+    sigset_t signals;
+    sigemptyset(&signals);
+    posix_spawnattr_setsigmask(&attr_, &signals);
+    sigaddset(&signals, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attr_, &signals);
+    short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+#ifdef POSIX_SPAWN_USEVFORK
+    flags |= POSIX_SPAWN_USEVFORK; // Implied by modern glibc, explicit for older ones
+#endif
+    posix_spawnattr_setflags(&attr_, flags);
+}
+
+PreparedCommand::~PreparedCommand() {
+    posix_spawnattr_destroy(&attr_);
+}
+
+// Reads everything available without blocking. Returns false once the pipe hit EOF.
+bool PreparedCommand::drainPipe(int fd, size_t maxOutputBytes) {
+    for (;;) {
+        reserveChunk();
+        ssize_t n = read(fd, buffer_.data() + outputSize_, buffer_.size() - outputSize_);
+        if (n > 0) {
+            outputSize_ += static_cast<size_t>(n);
+            if (outputSize_ > maxOutputBytes) {
+                result_.status = ProcessResult::OUTPUT_LIMIT;
+                return true;
+            }
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+        return false; // EOF or error
+    }
+}
+
+int PreparedCommand::start(pid_t& pid) {
+    result_.status = ProcessResult::SPAWN_FAILED;
+    result_.exitCode = -1;
+    result_.error.clear();
+    outputSize_ = 0;
+    if (argv_.empty()) {
+        result_.error = "empty command";
+        return -1;
+    }
+
+    // Close-on-exec from the start: the child only gets the dup2'd copies on stdout/stderr,
+    // and a process spawned by another thread in between (an alert hook) gets neither end
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        result_.error = std::string("pipe failed: ") + std::strerror(errno);
+        return -1;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 0, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], 1);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], 2);
+
+    int rc = !path_.empty()
+        ? posix_spawn(&pid, path_.c_str(), &actions, &attr_, args_.data(), environ)
+        : posix_spawnp(&pid, args_[0], &actions, &attr_, args_.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[1]);
+    if (rc != 0) {
+        close(fds[0]);
+        result_.error = std::strerror(rc);
+        return -1;
+    }
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL, 0) | O_NONBLOCK);
+    result_.status = ProcessResult::EXITED;
+    return fds[0];
+}
+
+const ProcessResult& PreparedCommand::finish(ProcessResult::Status status, int waitStatus) {
+    if (result_.status == ProcessResult::EXITED) result_.status = status;
+    if (WIFEXITED(waitStatus)) result_.exitCode = WEXITSTATUS(waitStatus);
+    else if (WIFSIGNALED(waitStatus)) result_.exitCode = 128 + WTERMSIG(waitStatus);
+    return result_;
+}
+
+const ProcessResult& PreparedCommand::run(const ProcessOptions& options) {
+    ProcessResult& result = result_;
+    pid_t pid;
+    int readFd = start(pid);
+    if (readFd < 0) {
+        return result;
+    }
+    int pidFd = openPidFd(pid);
+
+    long long deadline = steadyNowMs() + options.timeoutMs;
+    bool pipeOpen = true;
+    bool childExited = false;
+    bool reaped = false;
+    int waitStatus = 0;
+
+    while (result.status == ProcessResult::EXITED && !(childExited && !pipeOpen)) {
+        if (options.cancel && *options.cancel) { result.status = ProcessResult::CANCELLED; break; }
+        int wait = nextWaitMs(deadline);
+        if (wait == 0) { result.status = ProcessResult::TIMED_OUT; break; }
+
+        if (pidFd < 0 && !pipeOpen) {
+            // No pidfd: the pipe is closed, poll for the exit with waitpid
+            if (waitpid(pid, &waitStatus, WNOHANG) == pid) {
+                reaped = true;
+                childExited = true;
+                continue;
+            }
+            poll(nullptr, 0, wait < 5 ? wait : 5);
+            continue;
+        }
+
+        pollfd pfds[2];
+        int count = 0;
+        if (pipeOpen) pfds[count++] = {readFd, POLLIN, 0};
+        if (pidFd >= 0 && !childExited) pfds[count++] = {pidFd, POLLIN, 0};
+
+        if (poll(pfds, count, wait) < 0 && errno != EINTR) {
+            result.status = ProcessResult::TIMED_OUT; // Cannot wait safely any more
+            break;
+        }
+        for (int i = 0; i < count; ++i) {
+            if (!pfds[i].revents) continue;
+            if (pfds[i].fd == readFd) {
+                pipeOpen = drainPipe(readFd, options.maxOutputBytes);
+            } else {
+                // Exited: take what it wrote, and stop even if a grandchild keeps the pipe open
+                childExited = true;
+                if (pipeOpen) drainPipe(readFd, options.maxOutputBytes);
+                pipeOpen = false;
+            }
+        }
+    }
+
+    if (!reaped) {
+        if (result.status != ProcessResult::EXITED) kill(pid, SIGKILL);
+        while (waitpid(pid, &waitStatus, 0) < 0 && errno == EINTR) {}
+    }
+    if (pidFd >= 0) close(pidFd);
+    close(readFd);
+    return finish(result.status, waitStatus);
+}
+
+#endif
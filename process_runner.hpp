@@ -0,0 +1,135 @@
+#ifndef STATS_PROCESS_RUNNER_HPP
+#define STATS_PROCESS_RUNNER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+#ifndef _WIN32
+#include <spawn.h>
+#endif
+
+/**
+ * Child process execution with a hard deadline.
+ *
+ * The child's stdout and stderr go to one pipe that is read without blocking
+ * (overlapped I/O on Windows, poll() on POSIX), so a child that hangs, trickles
+ * output or floods the pipe can never hold the caller past timeoutMs. On timeout,
+ * cancellation or output overflow the child is killed and always reaped.
+ * On Linux the exit is watched through a pidfd, so a child that exits while a
+ * grandchild keeps the pipe open does not stall the reader either.
+ */
+
+struct ProcessOptions {
+    unsigned int timeoutMs = 2000;
+    size_t maxOutputBytes = 4 * 1024 * 1024;
+    const std::atomic<bool>* cancel = nullptr; // Checked at least every CANCEL_POLL_MS
+};
+
+struct ProcessResult {
+    enum Status {
+        EXITED,        // Ran to completion, exitCode is valid
+        TIMED_OUT,     // Killed at the deadline
+        CANCELLED,     // Killed because *cancel became true
+        OUTPUT_LIMIT,  // Killed after writing more than maxOutputBytes
+        SPAWN_FAILED   // Could not be started, error describes why
+    };
+    Status status = SPAWN_FAILED;
+    int exitCode = -1;
+    std::string output; // Filled by runProcess() only, PreparedCommand keeps it in its own buffer
+    std::string error;
+};
+
+/**
+ * A command that is prepared once and run many times, like the GPU probe at 4 Hz.
+ *
+ * Everything that does not change between runs is built in the constructor: the
+ * argv array, the resolved executable path (no PATH search per spawn) and the
+ * Windows command line. Output is read straight into a buffer that is kept
+ * between runs, so a steady-state run does not allocate or copy through a
+ * temporary buffer.
+ * Spawning uses the cheapest mechanism available: posix_spawn, which glibc
+ * implements as a vfork-style clone that never copies the monitor's page tables,
+ * and on Windows an explicit handle list so the child inherits only its pipe.
+ */
+class PreparedCommand {
+public:
+    explicit PreparedCommand(std::vector<std::string> argv);
+    ~PreparedCommand();
+
+    PreparedCommand(const PreparedCommand&) = delete;
+    PreparedCommand& operator=(const PreparedCommand&) = delete;
+
+    // Runs the command, output() holds what it wrote until the next run
+    const ProcessResult& run(const ProcessOptions& options = ProcessOptions());
+    std::string_view output() const { return std::string_view(buffer_.data(), outputSize_); }
+    const ProcessResult& result() const { return result_; } // Of the last run
+
+#ifndef _WIN32
+    // The parts of run() for a caller that waits some other way (runProcessAsync() in async_io.hpp).
+    // start() spawns the command and returns the non-blocking read end of its output pipe, or -1
+    // with result().error set; drain() reads what is available into output() and returns false
+    // at EOF; finish() records how the run ended, unless the output limit was hit first.
+    int start(pid_t& pid);
+    bool drain(int fd, size_t maxOutputBytes) { return drainPipe(fd, maxOutputBytes); }
+    const ProcessResult& finish(ProcessResult::Status status, int waitStatus);
+#endif
+
+private:
+    // Makes room for at least one more chunk after the current output
+    void reserveChunk();
+
+    std::vector<std::string> argv_;
+#ifdef _WIN32
+    std::string applicationName_;        // Full path, or empty to let CreateProcess search
+    std::string commandLine_;
+    std::vector<char> commandBuffer_;    // Writable copy CreateProcessA may modify
+    std::vector<char> attributeList_;    // Storage for the inherited handle list
+#else
+    std::string path_;                   // Resolved executable, or empty to use posix_spawnp
+    std::vector<char*> args_;
+    posix_spawnattr_t attr_;
+
+    bool drainPipe(int fd, size_t maxOutputBytes);
+#endif
+    std::vector<char> buffer_;
+    size_t outputSize_ = 0;
+    ProcessResult result_;
+};
+
+// Runs argv[0] (looked up in PATH when it has no directory) with the given arguments, once
+ProcessResult runProcess(const std::vector<std::string>& argv, const ProcessOptions& options = ProcessOptions());
+
+// Human readable reason for a result that is not a clean exit
+std::string describeFailure(const ProcessResult& result);
+
+/**
+ * Backs off from a command that keeps failing, instead of paying for a spawn
+ * (and possibly a full timeout) every tick. After failureThreshold consecutive
+ * failures the breaker opens for baseBackoffMs, doubling on every failed retry
+ * up to maxBackoffMs; one success closes it again.
+ */
+class CircuitBreaker {
+public:
+    CircuitBreaker(unsigned int failureThreshold = 3,
+                   unsigned long long baseBackoffMs = 1000,
+                   unsigned long long maxBackoffMs = 60000)
+        : failureThreshold_(failureThreshold), baseBackoffMs_(baseBackoffMs), maxBackoffMs_(maxBackoffMs) {}
+
+    // True if a call should be attempted now
+    bool allow(unsigned long long nowMs) const { return nowMs >= openUntilMs_; }
+    void recordSuccess();
+    void recordFailure(unsigned long long nowMs);
+
+    unsigned long long openUntilMs() const { return openUntilMs_; }
+
+private:
+    unsigned int failureThreshold_;
+    unsigned long long baseBackoffMs_;
+    unsigned long long maxBackoffMs_;
+    unsigned int consecutiveFailures_ = 0;
+    unsigned long long openUntilMs_ = 0;
+};
+
+#endif
@@ -52,6 +52,36 @@
 // Uncomment this to enable support for std::string_view (usually enabled automatically)
 // #define PUGIXML_HAS_STRING_VIEW
 
+// stats_display build profiles, selected on the compiler command line:
+//   /DSTATS_XML_PROFILE=minimal (cl) or -DSTATS_XML_PROFILE=minimal (gcc/clang)
+// Without STATS_XML_PROFILE the stock configuration above is used.
+//   minimal - no XPath (the built-in fields walk one known document shape with
+//             child(); user-configured STATS_GPU_FIELDS are not available),
+//             64 KB pages so a single-GPU nvidia-smi DOM fits in one page, and
+//             header-only so the few accessors used per tick can be inlined
+//             (pugixml.cpp can then be left out of the compile line).
+//   compact - minimal, plus compact node/attribute storage for the smallest
+//             footprint, on the default 32 KB pages.
+#define STATS_XML_PROFILE_ID_minimal 1
+#define STATS_XML_PROFILE_ID_compact 2
+#define STATS_XML_PROFILE_CAT(a, b) a##b
+#define STATS_XML_PROFILE_XCAT(a, b) STATS_XML_PROFILE_CAT(a, b)
+
+#ifdef STATS_XML_PROFILE
+#	define STATS_XML_PROFILE_ID STATS_XML_PROFILE_XCAT(STATS_XML_PROFILE_ID_, STATS_XML_PROFILE)
+#	if STATS_XML_PROFILE_ID == STATS_XML_PROFILE_ID_minimal
+#		define PUGIXML_NO_XPATH
+#		define PUGIXML_MEMORY_PAGE_SIZE 65536
+#		define PUGIXML_HEADER_ONLY
+#	elif STATS_XML_PROFILE_ID == STATS_XML_PROFILE_ID_compact
+#		define PUGIXML_NO_XPATH
+#		define PUGIXML_COMPACT
+#		define PUGIXML_HEADER_ONLY
+#	else
+#		error "Unknown STATS_XML_PROFILE, use minimal or compact"
+#	endif
+#endif
+
 #endif
 
 /**
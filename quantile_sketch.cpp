@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include "quantile_sketch.hpp"
+#include "snapshot_metrics.hpp"
+#include "wire_format.hpp"
+
+static const double GAMMA = (1.0 + SKETCH_RELATIVE_ACCURACY) / (1.0 - SKETCH_RELATIVE_ACCURACY);
+static const double LOG_GAMMA = std::log(GAMMA);
+static const unsigned long long ACCURACY_TAG = static_cast<unsigned long long>(SKETCH_RELATIVE_ACCURACY * 1e4 + 0.5);
+
+void QuantileSketch::Bins::add(int index, unsigned int n) {
+    if (counts.empty()) {
+        offset = index;
+        counts.assign(1, n);
+        return;
+    }
+    // Below the lowest bin that would survive a collapse: it would end up there anyway
+    int lowestKept = offset + static_cast<int>(counts.size()) - SKETCH_MAX_BINS;
+    if (index < lowestKept) index = lowestKept;
+    if (index < offset) {
+        counts.insert(counts.begin(), static_cast<size_t>(offset - index), 0);
+        offset = index;
+    } else if (static_cast<size_t>(index - offset) >= counts.size()) {
+        counts.resize(static_cast<size_t>(index - offset) + 1, 0);
+    }
+    counts[static_cast<size_t>(index - offset)] += n;
+    if (counts.size() > SKETCH_MAX_BINS) collapse(SKETCH_MAX_BINS);
+}
+
+// Folds the lowest bins into the lowest one kept, which only costs accuracy next to zero
+void QuantileSketch::Bins::collapse(size_t maxBins) {
+    if (maxBins == 0 || counts.size() <= maxBins) return;
+    size_t excess = counts.size() - maxBins;
+    for (size_t i = 0; i < excess; ++i) {
+        counts[excess] += counts[i];
+    }
+    counts.erase(counts.begin(), counts.begin() + static_cast<long>(excess));
+    offset += static_cast<int>(excess);
+}
+
+int QuantileSketch::binIndex(double magnitude) {
+    return static_cast<int>(std::ceil(std::log(magnitude) / LOG_GAMMA));
+}
+
+// The point of bin i within a relative SKETCH_RELATIVE_ACCURACY of both its ends
+double QuantileSketch::binValue(int index) {
+    return 2.0 * std::exp(index * LOG_GAMMA) / (GAMMA + 1.0);
+}
+
+void QuantileSketch::add(double value) {
+    if (!std::isfinite(value)) {
+        return;
+    }
+    if (count_ == 0) {
+        min_ = max_ = value;
+    } else {
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+    }
+    ++count_;
+    sum_ += value;
+    if (value > SKETCH_MIN_VALUE) {
+        positive_.add(binIndex(value), 1);
+    } else if (value < -SKETCH_MIN_VALUE) {
+        negative_.add(binIndex(-value), 1);
+    } else {
+        ++zeroCount_;
+    }
+}
+
+void QuantileSketch::merge(const QuantileSketch& other) {
+    if (other.count_ == 0) {
+        return;
+    }
+    if (count_ == 0) {
+        *this = other;
+        return;
+    }
+    for (size_t i = 0; i < other.positive_.counts.size(); ++i) {
+        if (other.positive_.counts[i]) positive_.add(other.positive_.offset + static_cast<int>(i), other.positive_.counts[i]);
+    }
+    for (size_t i = 0; i < other.negative_.counts.size(); ++i) {
+        if (other.negative_.counts[i]) negative_.add(other.negative_.offset + static_cast<int>(i), other.negative_.counts[i]);
+    }
+    zeroCount_ += other.zeroCount_;
+    count_ += other.count_;
+    sum_ += other.sum_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+}
+
+void QuantileSketch::collapseTo(size_t maxBins) {
+    positive_.collapse(maxBins);
+    negative_.collapse(maxBins);
+}
+
+void QuantileSketch::clear() {
+    positive_.counts.clear();
+    negative_.counts.clear();
+    zeroCount_ = count_ = 0;
+    min_ = max_ = sum_ = 0.0;
+}
+
+double QuantileSketch::quantile(double q) const {
+    if (count_ == 0) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    q = std::min(std::max(q, 0.0), 1.0);
+    const double rank = q * static_cast<double>(count_ - 1);
+    double value = max_;
+    double seen = 0.0;
+    bool found = false;
+    // Most negative first: the negative bins from the largest magnitude down
+    for (size_t i = negative_.counts.size(); i-- > 0 && !found;) {
+        seen += negative_.counts[i];
+        if (seen > rank) {
+            value = -binValue(negative_.offset + static_cast<int>(i));
+            found = true;
+        }
+    }
+    if (!found && (seen += static_cast<double>(zeroCount_)) > rank) {
+        value = 0.0;
+        found = true;
+    }
+    for (size_t i = 0; i < positive_.counts.size() && !found; ++i) {
+        seen += positive_.counts[i];
+        if (seen > rank) {
+            value = binValue(positive_.offset + static_cast<int>(i));
+            found = true;
+        }
+    }
+    // The exact extremes are known, a bin's midpoint must not overshoot them
+    return std::min(std::max(value, min_), max_);
+}
+
+size_t QuantileSketch::memoryBytes() const {
+    return sizeof(*this) + (positive_.counts.capacity() + negative_.counts.capacity()) * sizeof(unsigned int);
+}
+
+// ENCODING
+
+// Little-endian whatever the host is
+static void putDouble(std::string& out, double value) {
+    unsigned long long bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    for (int i = 0; i < 8; ++i) out.push_back(static_cast<char>((bits >> (8 * i)) & 0xFF));
+}
+
+// The frame reader plus the doubles only sketches carry
+struct SketchReader : FrameReader {
+    double number() {
+        if (end - p < 8) { ok = false; return 0.0; }
+        unsigned long long bits = 0;
+        for (int i = 0; i < 8; ++i) bits |= static_cast<unsigned long long>(*p++) << (8 * i);
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+};
+
+void QuantileSketch::encode(std::string& out) const {
+    putVarint(out, ACCURACY_TAG);
+    putVarint(out, count_);
+    putVarint(out, zeroCount_);
+    putDouble(out, min_);
+    putDouble(out, max_);
+    putDouble(out, sum_);
+    for (const Bins* bins : {&positive_, &negative_}) {
+        putVarint(out, zigzag(bins->offset)); // Offsets go negative for magnitudes below 1
+        putVarint(out, bins->counts.size());
+        for (unsigned int n : bins->counts) putVarint(out, n);
+    }
+}
+
+bool QuantileSketch::decode(const unsigned char* data, size_t size) {
+    clear();
+    SketchReader r;
+    r.p = data;
+    r.end = data + size;
+    if (r.getVarint() != ACCURACY_TAG || !r.ok) {
+        return false;
+    }
+    count_ = r.getVarint();
+    zeroCount_ = r.getVarint();
+    min_ = r.number();
+    max_ = r.number();
+    sum_ = r.number();
+    unsigned long long binned = zeroCount_;
+    for (Bins* bins : {&positive_, &negative_}) {
+        long long offset = unzigzag(r.getVarint());
+        if (offset < std::numeric_limits<int>::min() || offset > std::numeric_limits<int>::max()) r.ok = false;
+        bins->offset = static_cast<int>(offset);
+        unsigned long long length = r.getVarint();
+        if (length > SKETCH_MAX_BINS) r.ok = false;
+        if (!r.ok) break;
+        bins->counts.resize(static_cast<size_t>(length));
+        for (unsigned int& n : bins->counts) {
+            unsigned long long value = r.getVarint();
+            if (value > 0xFFFFFFFFull) r.ok = false;
+            n = static_cast<unsigned int>(value);
+            binned += value;
+        }
+        if (!r.ok) break;
+    }
+    if (!r.ok || r.p != r.end || binned != count_) {
+        clear();
+        return false;
+    }
+    return true;
+}
+
+// SNAPSHOT SKETCHES
+
+SnapshotSketches::SnapshotSketches(unsigned long long windowMs)
+    : windowMs_(windowMs ? windowMs : SKETCH_WINDOW_MS), current_(SNAPSHOT_METRIC_COUNT), closed_(SNAPSHOT_METRIC_COUNT) {}
+
+bool SnapshotSketches::add(const StatsSnapshot& snap) {
+    const unsigned long long startMs = snap.timestampMs / windowMs_ * windowMs_;
+    bool closed = false;
+    if (startMs != currentStartMs_) {
+        if (currentStartMs_ != 0) {
+            closed_.swap(current_);
+            closedStartMs_ = currentStartMs_;
+            closed = true;
+        }
+        for (QuantileSketch& sketch : current_) sketch.clear();
+        currentStartMs_ = startMs;
+    }
+    for (size_t i = 0; i < SNAPSHOT_METRIC_COUNT; ++i) {
+        current_[i].add(snapshotMetric(i).read(snap));
+    }
+    return closed;
+}
@@ -0,0 +1,99 @@
+#ifndef STATS_QUANTILE_SKETCH_HPP
+#define STATS_QUANTILE_SKETCH_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "snapshot.hpp"
+
+#define SKETCH_RELATIVE_ACCURACY 0.01 // Any quantile is within 1% of the true value
+#define SKETCH_MAX_BINS 1024          // Per sign, a 1:10^8 range; past that the bins nearest zero are collapsed together
+#define SKETCH_MIN_VALUE 1e-9         // Smaller magnitudes count as zero
+#define SKETCH_WINDOW_MS 60000        // Rollup window of the agent's sketches, aligned to the wall clock
+
+/**
+ * Mergeable quantile sketch (DDSketch): values are counted in logarithmic
+ * bins, bin i holding the magnitudes in (gamma^(i-1), gamma^i] with
+ * gamma = (1 + a) / (1 - a), so the bin's midpoint is within a relative a of
+ * everything in it and every quantile answer is too, whatever the
+ * distribution. Adding a value is a log and an increment; two sketches
+ * merge exactly by adding their bins, so sketches of successive windows, or
+ * of many hosts, combine into the sketch of all their samples.
+ *
+ * Bins are dense arrays of 32-bit counts from the lowest to the highest
+ * index seen, one for positive values and one for negative ones. A week of
+ * samples at 4 Hz stays far below 2^32 per bin.
+ */
+class QuantileSketch {
+public:
+    void add(double value); // NaN is ignored
+    void merge(const QuantileSketch& other);
+    void clear();
+    // Keeps at most maxBins bins per sign by folding the lowest ones into the lowest one kept,
+    // as past SKETCH_MAX_BINS: quantiles near zero lose accuracy, the rest keep theirs, and the
+    // sketch still merges with any other
+    void collapseTo(size_t maxBins);
+
+    // Value at rank q (0 to 1) of everything added, NaN when empty
+    double quantile(double q) const;
+    unsigned long long count() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    double min() const { return min_; }
+    double max() const { return max_; }
+    double sum() const { return sum_; }
+    size_t memoryBytes() const; // Heap and object, for sizing
+
+    // Compact form for the wire: varint counts, zero bins cost a byte
+    void encode(std::string& out) const;
+    // Replaces the sketch with an encoded one; false (and the sketch cleared) if it is malformed
+    // or was made with another accuracy, since only sketches with the same bins merge
+    bool decode(const unsigned char* data, size_t size);
+
+private:
+    // Counts of consecutive bins starting at index offset
+    struct Bins {
+        int offset = 0;
+        std::vector<unsigned int> counts;
+
+        void add(int index, unsigned int n);
+        void collapse(size_t maxBins);
+    };
+
+    static int binIndex(double magnitude);
+    static double binValue(int index);
+
+    Bins positive_;
+    Bins negative_;              // Indexed by magnitude
+    unsigned long long zeroCount_ = 0;
+    unsigned long long count_ = 0;
+    double min_ = 0.0;
+    double max_ = 0.0;
+    double sum_ = 0.0;
+};
+
+/**
+ * One sketch per snapshot metric (see snapshot_metrics.hpp) for the current
+ * rollup window. Every snapshot adds each metric's value, collected or
+ * unchanged alike, so a sketch weighs values by how long they held. When a
+ * snapshot falls in a new window, add() returns true and the sketches of the
+ * window that just closed are in closed() until the next one closes.
+ */
+class SnapshotSketches {
+public:
+    explicit SnapshotSketches(unsigned long long windowMs = SKETCH_WINDOW_MS);
+
+    bool add(const StatsSnapshot& snap);
+
+    unsigned long long windowMs() const { return windowMs_; }
+    unsigned long long closedStartMs() const { return closedStartMs_; }
+    const std::vector<QuantileSketch>& closed() const { return closed_; } // Index of the snapshot metric
+
+private:
+    unsigned long long windowMs_;
+    unsigned long long currentStartMs_ = 0;
+    unsigned long long closedStartMs_ = 0;
+    std::vector<QuantileSketch> current_;
+    std::vector<QuantileSketch> closed_;
+};
+
+#endif
@@ -0,0 +1,124 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <cstring>
+#include "shm_publisher.hpp"
+#include "snapshot_metrics.hpp"
+
+#ifndef _WIN32
+// True if fd is still the region the name refers to. The previous writer may have unlinked it
+// between our shm_open and getting its lock, a region nobody else can open is of no use.
+static bool isCurrentRegion(int fd) {
+    int current = shm_open(STATS_SHM_NAME_POSIX, O_RDONLY | O_CLOEXEC, 0);
+    if (current < 0) return false;
+    struct stat a, b;
+    bool same = fstat(fd, &a) == 0 && fstat(current, &b) == 0 && a.st_dev == b.st_dev && a.st_ino == b.st_ino;
+    close(current);
+    return same;
+}
+#endif
+
+ShmPublisher::ShmPublisher() {
+#ifdef _WIN32
+    HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                        0, sizeof(stats_shm_region), STATS_SHM_NAME_WIN32);
+    if (!mapping) return;
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        CloseHandle(mapping); // Another monitor instance is already the writer
+        return;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, sizeof(stats_shm_region));
+    if (!view) {
+        CloseHandle(mapping);
+        return;
+    }
+    mapping_ = mapping;
+#else
+    // The writer holds an exclusive flock on the region for as long as it runs. Unlike O_EXCL
+    // this lets a new instance take over the region of one that crashed, the kernel dropped
+    // its lock, while a second live instance finds the lock taken and publishes nothing.
+    int fd = shm_open(STATS_SHM_NAME_POSIX, O_CREAT | O_RDWR | O_CLOEXEC, 0644);
+    if (fd < 0) return;
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0 || !isCurrentRegion(fd) ||
+        ftruncate(fd, sizeof(stats_shm_region)) != 0) {
+        close(fd);
+        return;
+    }
+    void* view = mmap(nullptr, sizeof(stats_shm_region), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (view == MAP_FAILED) {
+        close(fd);
+        return;
+    }
+    lockFd_ = fd;
+#endif
+    region_ = static_cast<stats_shm_region*>(view);
+
+    // Readers check magic/version when they attach; seq 0 tells them nothing was published yet
+    stats_shm_store_seq(region_, 0);
+    std::memset(&region_->data, 0, sizeof(region_->data));
+    region_->version = STATS_SHM_VERSION;
+    region_->magic = STATS_SHM_MAGIC;
+}
+
+ShmPublisher::~ShmPublisher() {
+    if (!region_) return;
+#ifdef _WIN32
+    UnmapViewOfFile(region_);
+    CloseHandle(static_cast<HANDLE>(mapping_));
+#else
+    munmap(region_, sizeof(stats_shm_region));
+    // Only the owner gets here. Readers that are still attached keep their mapping, new ones
+    // will not find stale data. Unlinked before the lock goes, so no other instance can take
+    // over the name and then lose it to this unlink.
+    shm_unlink(STATS_SHM_NAME_POSIX);
+    close(lockFd_);
+#endif
+}
+
+// Copies a fixed-size, always NUL-terminated string field
+static void copyField(char* dst, size_t size, const std::string& src) {
+    size_t n = src.size() < size - 1 ? src.size() : size - 1;
+    std::memcpy(dst, src.data(), n);
+    std::memset(dst + n, 0, size - n);
+}
+
+void ShmPublisher::publish(const StatsSnapshot& snap) {
+    if (!region_) return;
+
+    // Build the record first so the odd (in-progress) window is just one memcpy.
+    // It is kept between calls, so the strings are only copied when the descriptor changed.
+    stats_shm_snapshot& record = record_;
+    record.timestamp_ms = snap.timestampMs;
+    record.cpu_usage = snap.cpuUsage;
+    record.ram_usage = snap.ramUsage;
+    record.gpu_data_available = snap.gpuDataAvailable ? 1 : 0;
+    record.gpu_temperature = snap.gpu.temperature;
+    record.gpu_utilization = snap.gpu.utilizationGpu;
+    record.reserved = 0;
+    record.gpu_memory_used = snap.gpu.memoryUsed;
+    if (snap.changed & SNAPSHOT_CHANGED_GPU_DESCRIPTOR) {
+        record.gpu_memory_total = snap.gpu.memoryTotal;
+        copyField(record.gpu_name, sizeof(record.gpu_name), snap.gpu.name);
+        copyField(record.driver_version, sizeof(record.driver_version), snap.gpu.driverVersion);
+    }
+    if (snap.changed & SNAPSHOT_CHANGED_ANOMALIES) {
+        std::string names;
+        for (size_t i = 0; i < SNAPSHOT_METRIC_COUNT; ++i) {
+            if (!(snap.anomalies & (1ULL << i))) continue;
+            if (!names.empty()) names += ',';
+            names += snapshotMetric(i).name;
+        }
+        copyField(record.anomalies, sizeof(record.anomalies), names);
+    }
+
+    uint32_t seq = region_->seq; // Single writer, nobody else changes it
+    stats_shm_store_seq(region_, seq + 1);
+    std::memcpy(&region_->data, &record, sizeof(record));
+    stats_shm_store_seq(region_, seq + 2);
+}
@@ -0,0 +1,30 @@
+#ifndef STATS_SHM_PUBLISHER_HPP
+#define STATS_SHM_PUBLISHER_HPP
+
+#include "snapshot.hpp"
+#include "stats_shm.h"
+
+// Writer side of the shared-memory snapshot (see stats_shm.h for the layout and reader library).
+// There must be a single writer, which is why only the monitor process owns one; a second
+// monitor instance finds the region owned (a file lock on POSIX, the mapping already existing
+// on Windows) and publishes nothing, and only the owner removes the region when it exits.
+class ShmPublisher {
+public:
+    ShmPublisher();
+    ~ShmPublisher();
+
+    ShmPublisher(const ShmPublisher&) = delete;
+    ShmPublisher& operator=(const ShmPublisher&) = delete;
+
+    // False if the region could not be created or another instance owns it, publish() is then a no-op
+    bool ok() const { return region_ != nullptr; }
+    void publish(const StatsSnapshot& snap);
+
+private:
+    stats_shm_region* region_ = nullptr;
+    stats_shm_snapshot record_ = {};  // Last record published
+    void* mapping_ = nullptr; // HANDLE of the file mapping on Windows
+    int lockFd_ = -1;         // Region descriptor holding the writer's flock elsewhere
+};
+
+#endif
@@ -0,0 +1,255 @@
+#ifndef STATS_SNAPSHOT_HPP
+#define STATS_SNAPSHOT_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// What identifies the GPU. Parsed once and then only refreshed now and then,
+// so the strings keep their storage from tick to tick.
+struct GpuDescriptor {
+    std::string name;
+    std::string driverVersion;
+    std::string uuid;
+    double memoryTotal = 0.0;
+    unsigned int generation = 0; // Bumped by the backend whenever a descriptor field changes
+};
+
+// Why the GPU clocks are held down, GpuExtendedCounters::throttleReasons.
+// Same values as NVML's nvmlClocksThrottleReason* so its mask is taken as is.
+#define GPU_THROTTLE_IDLE               0x001
+#define GPU_THROTTLE_APPLICATION_CLOCKS 0x002
+#define GPU_THROTTLE_SW_POWER_CAP       0x004
+#define GPU_THROTTLE_HW_SLOWDOWN        0x008
+#define GPU_THROTTLE_SYNC_BOOST         0x010
+#define GPU_THROTTLE_SW_THERMAL         0x020
+#define GPU_THROTTLE_HW_THERMAL         0x040
+#define GPU_THROTTLE_HW_POWER_BRAKE     0x080
+#define GPU_THROTTLE_DISPLAY_CLOCKS     0x100
+
+// The rest of what moves every tick: power, clocks, PCIe, codecs, ECC and throttling
+struct GpuExtendedCounters {
+    double powerDraw = 0.0;            // W
+    double powerLimit = 0.0;           // W
+    unsigned int smClock = 0;          // MHz
+    unsigned int memoryClock = 0;      // MHz
+    double pcieRx = 0.0;               // KB/s
+    double pcieTx = 0.0;               // KB/s
+    unsigned int utilizationEncoder = 0;
+    unsigned int utilizationDecoder = 0;
+    unsigned long long eccCorrected = 0;   // Since the driver loaded
+    unsigned long long eccUncorrected = 0;
+    unsigned int throttleReasons = 0;  // GPU_THROTTLE_* bits
+
+    bool operator==(const GpuExtendedCounters& other) const {
+        return powerDraw == other.powerDraw && powerLimit == other.powerLimit && smClock == other.smClock &&
+               memoryClock == other.memoryClock && pcieRx == other.pcieRx && pcieTx == other.pcieTx &&
+               utilizationEncoder == other.utilizationEncoder && utilizationDecoder == other.utilizationDecoder &&
+               eccCorrected == other.eccCorrected && eccUncorrected == other.eccUncorrected &&
+               throttleReasons == other.throttleReasons;
+    }
+};
+
+// What moves every tick, updated in place
+struct GpuCounters {
+    unsigned int temperature = 0;
+    double memoryUsed = 0.0;
+    unsigned int utilizationGpu = 0;
+    GpuExtendedCounters extended;
+};
+
+// A structure to hold the GPU data
+struct GpuData : GpuDescriptor, GpuCounters {};
+
+// Stores value into field unless it already holds it, returns whether it changed.
+// An unchanged string then costs one compare and no allocation or copy.
+inline bool updateField(std::string& field, const char* value) {
+    if (field == value) return false;
+    field = value;
+    return true;
+}
+
+template <typename T>
+inline bool updateField(T& field, T value) {
+    if (field == value) return false;
+    field = value;
+    return true;
+}
+
+// Bits of StatsSnapshot::changed
+#define SNAPSHOT_CHANGED_CPU            0x01
+#define SNAPSHOT_CHANGED_RAM            0x02
+#define SNAPSHOT_CHANGED_GPU_AVAILABLE  0x04
+#define SNAPSHOT_CHANGED_GPU_DESCRIPTOR 0x08
+#define SNAPSHOT_CHANGED_GPU_TEMP       0x10
+#define SNAPSHOT_CHANGED_GPU_MEM_USED   0x20
+#define SNAPSHOT_CHANGED_GPU_UTIL       0x40
+#define SNAPSHOT_CHANGED_GPU_FIELDS     0x80
+#define SNAPSHOT_CHANGED_PROCESSES      0x100
+#define SNAPSHOT_CHANGED_DISKS          0x200
+#define SNAPSHOT_CHANGED_NETWORK        0x400
+#define SNAPSHOT_CHANGED_PRESSURE       0x800
+#define SNAPSHOT_CHANGED_CGROUPS        0x1000
+#define SNAPSHOT_CHANGED_MEMORY         0x2000
+#define SNAPSHOT_CHANGED_THERMAL        0x4000
+#define SNAPSHOT_CHANGED_GPU_EXTENDED   0x8000
+#define SNAPSHOT_CHANGED_ANOMALIES      0x10000
+#define SNAPSHOT_CHANGED_GPU_COUNTERS   (SNAPSHOT_CHANGED_GPU_TEMP | SNAPSHOT_CHANGED_GPU_MEM_USED | SNAPSHOT_CHANGED_GPU_UTIL | \
+                                         SNAPSHOT_CHANGED_GPU_EXTENDED)
+
+// Values of the user-configured GPU fields (see gpu_fields.hpp), stored column by column:
+// cell (field, gpu) is at field * gpuCount + gpu, so one field across all GPUs is contiguous.
+struct GpuFieldRecord {
+    std::vector<std::string> names;  // One per field, in configuration order
+    std::vector<bool> isText;        // Per field, whether its cells are in texts or numbers
+    size_t gpuCount = 0;
+    std::vector<double> numbers;     // NaN when the field is missing or not a number
+    std::vector<std::string> texts;  // Empty for numeric fields
+
+    double number(size_t field, size_t gpu) const { return numbers[field * gpuCount + gpu]; }
+    const std::string& text(size_t field, size_t gpu) const { return texts[field * gpuCount + gpu]; }
+};
+
+// One of the busiest processes of the last interval
+struct ProcessSample {
+    int pid = 0;
+    std::string name;         // comm, at most 15 characters
+    double cpuUsage = 0.0;    // Percent of one CPU
+    double rssMb = 0.0;       // Resident memory in MB
+
+    bool operator==(const ProcessSample& other) const {
+        return pid == other.pid && cpuUsage == other.cpuUsage && rssMb == other.rssMb && name == other.name;
+    }
+};
+
+// Activity of one block device over the last interval. The name is inline so that
+// copying samples between snapshots never allocates.
+struct DiskSample {
+    char name[32] = {};
+    double readIops = 0.0;
+    double writeIops = 0.0;
+    double readBytesPerSec = 0.0;
+    double writeBytesPerSec = 0.0;
+    double utilization = 0.0;  // Percent of the interval with I/O in flight
+    double awaitMs = 0.0;      // Average time of a completed I/O, queueing included
+    double queueDepth = 0.0;   // Average number of I/Os in flight
+
+    bool operator==(const DiskSample& other) const {
+        return readIops == other.readIops && writeIops == other.writeIops &&
+               readBytesPerSec == other.readBytesPerSec && writeBytesPerSec == other.writeBytesPerSec &&
+               utilization == other.utilization && awaitMs == other.awaitMs &&
+               queueDepth == other.queueDepth && std::strcmp(name, other.name) == 0;
+    }
+};
+
+// Traffic of one network interface over the last interval, name inline like DiskSample
+struct NetSample {
+    char name[16] = {};  // IFNAMSIZ
+    double rxBytesPerSec = 0.0;
+    double txBytesPerSec = 0.0;
+    double rxPacketsPerSec = 0.0;
+    double txPacketsPerSec = 0.0;
+    double rxDropsPerSec = 0.0;
+    double txDropsPerSec = 0.0;
+    double rxErrorsPerSec = 0.0;
+    double txErrorsPerSec = 0.0;
+
+    bool operator==(const NetSample& other) const {
+        return rxBytesPerSec == other.rxBytesPerSec && txBytesPerSec == other.txBytesPerSec &&
+               rxPacketsPerSec == other.rxPacketsPerSec && txPacketsPerSec == other.txPacketsPerSec &&
+               rxDropsPerSec == other.rxDropsPerSec && txDropsPerSec == other.txDropsPerSec &&
+               rxErrorsPerSec == other.rxErrorsPerSec && txErrorsPerSec == other.txErrorsPerSec &&
+               std::strcmp(name, other.name) == 0;
+    }
+};
+
+// Pressure stall information of one resource (Linux PSI): percent of the time some, or all,
+// non-idle tasks were stalled waiting for it, averaged over 10 s, 60 s and 300 s
+enum PressureResource { PRESSURE_CPU, PRESSURE_MEMORY, PRESSURE_IO, PRESSURE_RESOURCES };
+
+struct PressureSample {
+    bool available = false;
+    double some[3] = {};
+    double full[3] = {};  // Always 0 for CPU at the system level
+
+    bool operator==(const PressureSample& other) const {
+        return available == other.available && std::memcmp(some, other.some, sizeof(some)) == 0 &&
+               std::memcmp(full, other.full, sizeof(full)) == 0;
+    }
+};
+
+// Resource use of one cgroup (a container, a service) over the last interval
+struct CgroupSample {
+    std::string path;               // Relative to the cgroup root
+    double cpuUsage = 0.0;          // Percent of one CPU
+    double throttledPercent = 0.0;  // Share of the interval its CPU quota held it back
+    double memoryMb = 0.0;
+    double readBytesPerSec = 0.0;
+    double writeBytesPerSec = 0.0;
+
+    bool operator==(const CgroupSample& other) const {
+        return cpuUsage == other.cpuUsage && throttledPercent == other.throttledPercent &&
+               memoryMb == other.memoryMb && readBytesPerSec == other.readBytesPerSec &&
+               writeBytesPerSec == other.writeBytesPerSec && path == other.path;
+    }
+};
+
+// Where the memory goes (Linux /proc/meminfo and /proc/vmstat), one slot per field
+enum MemoryField {
+    MEMORY_TOTAL, MEMORY_FREE, MEMORY_AVAILABLE, MEMORY_BUFFERS, MEMORY_CACHED, MEMORY_SHMEM,
+    MEMORY_ANON, MEMORY_SLAB, MEMORY_SWAP_TOTAL, MEMORY_SWAP_FREE, MEMORY_SWAP_CACHED,
+    MEMORY_DIRTY, MEMORY_WRITEBACK, MEMORY_COMMITTED, MEMORY_COMMIT_LIMIT,
+    MEMORY_HUGEPAGES, MEMORY_HUGEPAGES_FREE,      // All sizes so far in MB
+    MEMORY_PAGE_FAULTS, MEMORY_MAJOR_FAULTS,      // Per second
+    MEMORY_SWAP_IN, MEMORY_SWAP_OUT,              // MB/s
+    MEMORY_FIELDS
+};
+
+struct MemoryStats {
+    bool available = false;
+    double values[MEMORY_FIELDS] = {};
+
+    double operator[](MemoryField field) const { return values[field]; }
+    bool operator==(const MemoryStats& other) const {
+        return available == other.available && std::memcmp(values, other.values, sizeof(values)) == 0;
+    }
+};
+
+// Temperature of one thermal zone (a CPU package, the chipset, a sensor), type inline like DiskSample
+struct ThermalZoneSample {
+    char type[20] = {};        // e.g. "x86_pkg_temp", "acpitz"
+    double temperature = 0.0;  // Degrees C
+
+    bool operator==(const ThermalZoneSample& other) const {
+        return temperature == other.temperature && std::strcmp(type, other.type) == 0;
+    }
+};
+
+// One sample of everything the monitor collects in a tick.
+// This is what gets displayed, and what the agent mode ships to the aggregator.
+struct StatsSnapshot {
+    unsigned long long timestampMs = 0; // Milliseconds since the Unix epoch
+    double cpuUsage = 0.0;              // Percent, -1.0 when the CPU time query failed
+    double ramUsage = 0.0;              // Used physical memory in GB
+    MemoryStats memory;                 // The breakdown behind ramUsage, not available on Windows
+    bool gpuDataAvailable = false;
+    GpuData gpu;
+    GpuFieldRecord gpuFields;           // Empty unless fields are configured
+    double loadAverage[3] = {-1.0, -1.0, -1.0}; // 1, 5 and 15 minutes, -1.0 where not collected
+    PressureSample pressure[PRESSURE_RESOURCES];
+    unsigned int processCount = 0;      // 0 where processes are not collected
+    std::vector<ProcessSample> topProcesses; // Busiest first
+    std::vector<DiskSample> disks;      // Busiest first, only devices that did I/O
+    std::vector<NetSample> interfaces;  // Busiest first, only interfaces with traffic
+    unsigned int cgroupCount = 0;       // 0 without cgroup v2
+    std::vector<CgroupSample> cgroups;  // Busiest leaf cgroups first
+    std::vector<double> coreFrequencyMhz; // Current clock of each core, empty without cpufreq
+    double coreThrottlesPerSec = 0.0;   // Thermal throttling events of all cores,
+    double packageThrottlesPerSec = 0.0; // and of all packages (Intel thermal_throttle)
+    std::vector<ThermalZoneSample> thermalZones;
+    unsigned long long anomalies = 0;   // Bit i: metric i of snapshot_metrics.hpp looks anomalous (see anomaly_detector.hpp)
+    unsigned int changed = ~0u;         // SNAPSHOT_CHANGED_* bits that differ from the producer's previous snapshot
+};
+
+#endif
@@ -0,0 +1,147 @@
+#include <stdexcept>
+#include "snapshot_bus.hpp"
+
+// Layout of the control word. Nodes are 64-byte aligned, so the pointer is stored
+// without its 6 low zero bits; 42 bits cover the 48-bit user address space.
+#define BUS_NODE_ALIGN_BITS 6
+#define BUS_COUNT_BITS 22
+#define BUS_COUNT_MASK ((uint64_t(1) << BUS_COUNT_BITS) - 1)
+#define BUS_COUNT_TRANSFER (uint64_t(1) << 20) // Fold the count into the node from here on, far from overflowing
+#define BUS_NODE_BIAS (1LL << 40)              // Reference the bus itself holds on the current node
+
+struct alignas(1 << BUS_NODE_ALIGN_BITS) SnapshotBus::Node {
+    StatsSnapshot snapshot;
+    unsigned long long sequence = 0;
+    // BUS_NODE_BIAS while current, minus the Refs dropped. Once replaced, the publisher
+    // swaps the bias for the Refs counted in the control word, leaving the number still held.
+    std::atomic<long long> refs{BUS_NODE_BIAS};
+};
+
+// Nodes whose last Ref is gone, kept so that a publish reuses one, and the string and vector
+// storage of its snapshot, instead of allocating all of it again every tick.
+// Shared by all buses since a node can outlive its bus. A slot is only ever compared
+// against empty, never against a node, so a node coming back cannot confuse it (ABA).
+std::atomic<SnapshotBus::Node*> SnapshotBus::spareNodes_[BUS_SPARE_NODES];
+
+SnapshotBus::Node* SnapshotBus::allocateNode() {
+    for (std::atomic<Node*>& slot : spareNodes_) {
+        if (slot.load(std::memory_order_relaxed)) {
+            if (Node* node = slot.exchange(nullptr, std::memory_order_acquire)) {
+                node->refs.store(BUS_NODE_BIAS, std::memory_order_relaxed);
+                return node;
+            }
+        }
+    }
+    return new Node();
+}
+
+void SnapshotBus::freeNode(Node* node) {
+    for (std::atomic<Node*>& slot : spareNodes_) {
+        Node* empty = nullptr;
+        if (slot.compare_exchange_strong(empty, node, std::memory_order_release, std::memory_order_relaxed)) {
+            return;
+        }
+    }
+    delete node;
+}
+
+bool SnapshotBus::fits(const Node* node) {
+    uint64_t address = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(node));
+    return (address >> (64 - BUS_COUNT_BITS + BUS_NODE_ALIGN_BITS)) == 0;
+}
+
+uint64_t SnapshotBus::pack(Node* node) {
+    uint64_t address = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(node));
+    return (address >> BUS_NODE_ALIGN_BITS) << BUS_COUNT_BITS;
+}
+
+SnapshotBus::Node* SnapshotBus::unpack(uint64_t word) {
+    return reinterpret_cast<Node*>(static_cast<uintptr_t>((word >> BUS_COUNT_BITS) << BUS_NODE_ALIGN_BITS));
+}
+
+void SnapshotBus::addRefs(Node* node, long long delta) {
+    if (node->refs.fetch_add(delta, std::memory_order_acq_rel) + delta == 0) {
+        freeNode(node);
+    }
+}
+
+SnapshotBus::SnapshotBus() {
+    Node* node = new Node();
+    if (!fits(node)) {
+        delete node;
+        throw std::runtime_error("Snapshot address does not fit the bus control word");
+    }
+    control_.store(pack(node), std::memory_order_relaxed);
+}
+
+SnapshotBus::~SnapshotBus() {
+    uint64_t word = control_.load(std::memory_order_acquire);
+    addRefs(unpack(word), static_cast<long long>(word & BUS_COUNT_MASK) - BUS_NODE_BIAS);
+}
+
+bool SnapshotBus::publish(const StatsSnapshot& snapshot) {
+    Node* node = allocateNode();
+    if (!fits(node)) {
+        delete node;
+        return false;
+    }
+    node->snapshot = snapshot; // Copy-assignment, a reused node's storage is reused too
+    node->sequence = nextSequence_.fetch_add(1, std::memory_order_relaxed);
+    uint64_t previous = control_.exchange(pack(node), std::memory_order_acq_rel);
+    addRefs(unpack(previous), static_cast<long long>(previous & BUS_COUNT_MASK) - BUS_NODE_BIAS);
+    return true;
+}
+
+SnapshotBus::Ref SnapshotBus::latest() const {
+    uint64_t word = control_.fetch_add(1, std::memory_order_acquire) + 1;
+    if ((word & BUS_COUNT_MASK) >= BUS_COUNT_TRANSFER) {
+        transferRefs(word);
+    }
+    return Ref(unpack(word));
+}
+
+// Moves the Refs counted in the control word into the node, so the count cannot overflow
+// while one snapshot stays current for a long time. This is the slow path, the caller does
+// not return until the count is below BUS_COUNT_TRANSFER again, done by itself, another
+// consumer or a publisher replacing the node. Each thread therefore has at most one
+// increment past BUS_COUNT_TRANSFER, which keeps the 22-bit count from carrying into the
+// pointer for anything short of three million threads.
+void SnapshotBus::transferRefs(uint64_t word) const {
+    Node* node = unpack(word);
+    while ((word & BUS_COUNT_MASK) >= BUS_COUNT_TRANSFER) {
+        long long count = static_cast<long long>(word & BUS_COUNT_MASK);
+        node->refs.fetch_add(count, std::memory_order_relaxed);
+        if (control_.compare_exchange_weak(word, word & ~BUS_COUNT_MASK, std::memory_order_acq_rel)) {
+            return;
+        }
+        // Cannot reach zero, the caller still holds its own Ref
+        node->refs.fetch_sub(count, std::memory_order_relaxed);
+        if (unpack(word) != node) {
+            return; // Replaced, the publisher folded the count into the node
+        }
+    }
+}
+
+SnapshotBus::Ref& SnapshotBus::Ref::operator=(Ref&& other) {
+    if (this != &other) {
+        release();
+        node_ = other.node_;
+        other.node_ = nullptr;
+    }
+    return *this;
+}
+
+void SnapshotBus::Ref::release() {
+    if (node_) {
+        addRefs(node_, -1);
+        node_ = nullptr;
+    }
+}
+
+const StatsSnapshot& SnapshotBus::Ref::operator*() const {
+    return node_->snapshot;
+}
+
+unsigned long long SnapshotBus::Ref::sequence() const {
+    return node_->sequence;
+}
@@ -0,0 +1,80 @@
+#ifndef STATS_SNAPSHOT_BUS_HPP
+#define STATS_SNAPSHOT_BUS_HPP
+
+#include <atomic>
+#include <cstdint>
+#include "snapshot.hpp"
+
+#define BUS_SPARE_NODES 4 // Released nodes kept for reuse, enough for a few producers
+
+/**
+ * Hands the latest snapshot from any number of producers to any number of consumers.
+ *
+ * Every publish() copies the snapshot into a new immutable node and swaps it in;
+ * consumers get a Ref that keeps that node alive for as long as they hold it,
+ * however many snapshots are published meanwhile. The last Ref to a replaced
+ * node releases it to a few spare slots, from which the next publish() takes
+ * it, so in the steady state a publish is a copy-assignment into storage that
+ * is already there rather than an allocation per string and vector.
+ * Taking a Ref is a single atomic fetch_add and dropping it a fetch_sub, so
+ * consumers never wait for producers or for each other. This is a split
+ * reference count: the control word packs the node pointer with a count of the
+ * Refs taken through it, which the publisher that replaces the node folds into
+ * the node's own count.
+ */
+class SnapshotBus {
+    struct Node;
+
+public:
+    // Shared, read-only access to one published snapshot
+    class Ref {
+    public:
+        Ref() {}
+        Ref(Ref&& other) : node_(other.node_) { other.node_ = nullptr; }
+        Ref& operator=(Ref&& other);
+        ~Ref() { release(); }
+
+        Ref(const Ref&) = delete;
+        Ref& operator=(const Ref&) = delete;
+
+        const StatsSnapshot& operator*() const;
+        const StatsSnapshot* operator->() const { return &**this; }
+        // Different for every publish (and increasing for a single producer),
+        // so a consumer can tell whether anything new arrived
+        unsigned long long sequence() const;
+
+    private:
+        friend class SnapshotBus;
+        explicit Ref(Node* node) : node_(node) {}
+        void release();
+
+        Node* node_ = nullptr;
+    };
+
+    SnapshotBus(); // Starts out holding an empty snapshot with sequence 0
+    ~SnapshotBus(); // Refs still held stay valid
+
+    SnapshotBus(const SnapshotBus&) = delete;
+    SnapshotBus& operator=(const SnapshotBus&) = delete;
+
+    // False if the snapshot could not be published: the new node's address does not fit the
+    // control word (never for a 48-bit user address space). Consumers keep the previous one.
+    bool publish(const StatsSnapshot& snapshot);
+    Ref latest() const;
+
+private:
+    static Node* allocateNode();
+    static void freeNode(Node* node);
+    static bool fits(const Node* node);
+    static uint64_t pack(Node* node);
+    static Node* unpack(uint64_t word);
+    static void addRefs(Node* node, long long delta); // Frees the node when its count reaches zero
+    void transferRefs(uint64_t word) const;
+
+    static std::atomic<Node*> spareNodes_[BUS_SPARE_NODES];
+
+    mutable std::atomic<uint64_t> control_; // Node pointer << COUNT_BITS | Refs taken through it
+    std::atomic<unsigned long long> nextSequence_{1};
+};
+
+#endif
@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <limits>
+#include "snapshot_metrics.hpp"
+
+static const double NOT_AVAILABLE = std::numeric_limits<double>::quiet_NaN();
+
+static double gpuValue(const StatsSnapshot& snap, double value) {
+    return snap.gpuDataAvailable ? value : NOT_AVAILABLE;
+}
+
+static double memoryValue(const StatsSnapshot& snap, MemoryField field) {
+    return snap.memory.available ? snap.memory[field] : NOT_AVAILABLE;
+}
+
+static double pressureValue(const StatsSnapshot& snap, PressureResource resource, bool full) {
+    const PressureSample& sample = snap.pressure[resource];
+    return sample.available ? (full ? sample.full[0] : sample.some[0]) : NOT_AVAILABLE;
+}
+
+static const SnapshotMetric SNAPSHOT_METRICS[] = {
+    {"cpu.usage", SNAPSHOT_CHANGED_CPU, [](const StatsSnapshot& s) { return s.cpuUsage >= 0 ? s.cpuUsage : NOT_AVAILABLE; }},
+    {"ram.used_gb", SNAPSHOT_CHANGED_RAM, [](const StatsSnapshot& s) { return s.ramUsage; }},
+    {"ram.percent", SNAPSHOT_CHANGED_MEMORY, [](const StatsSnapshot& s) {
+         return s.memory.available && s.memory[MEMORY_TOTAL] > 0
+                    ? (s.memory[MEMORY_TOTAL] - s.memory[MEMORY_AVAILABLE]) / s.memory[MEMORY_TOTAL] * 100.0
+                    : NOT_AVAILABLE;
+     }},
+    {"swap.used_mb", SNAPSHOT_CHANGED_MEMORY,
+     [](const StatsSnapshot& s) { return memoryValue(s, MEMORY_SWAP_TOTAL) - memoryValue(s, MEMORY_SWAP_FREE); }},
+    {"memory.dirty_mb", SNAPSHOT_CHANGED_MEMORY, [](const StatsSnapshot& s) { return memoryValue(s, MEMORY_DIRTY); }},
+    {"memory.page_faults", SNAPSHOT_CHANGED_MEMORY, [](const StatsSnapshot& s) { return memoryValue(s, MEMORY_PAGE_FAULTS); }},
+    {"memory.major_faults", SNAPSHOT_CHANGED_MEMORY, [](const StatsSnapshot& s) { return memoryValue(s, MEMORY_MAJOR_FAULTS); }},
+    {"memory.swap_in_mb", SNAPSHOT_CHANGED_MEMORY, [](const StatsSnapshot& s) { return memoryValue(s, MEMORY_SWAP_IN); }},
+    {"memory.swap_out_mb", SNAPSHOT_CHANGED_MEMORY, [](const StatsSnapshot& s) { return memoryValue(s, MEMORY_SWAP_OUT); }},
+    {"load.1", SNAPSHOT_CHANGED_PRESSURE,
+     [](const StatsSnapshot& s) { return s.loadAverage[0] >= 0 ? s.loadAverage[0] : NOT_AVAILABLE; }},
+    {"load.5", SNAPSHOT_CHANGED_PRESSURE,
+     [](const StatsSnapshot& s) { return s.loadAverage[1] >= 0 ? s.loadAverage[1] : NOT_AVAILABLE; }},
+    {"load.15", SNAPSHOT_CHANGED_PRESSURE,
+     [](const StatsSnapshot& s) { return s.loadAverage[2] >= 0 ? s.loadAverage[2] : NOT_AVAILABLE; }},
+    {"pressure.cpu", SNAPSHOT_CHANGED_PRESSURE, [](const StatsSnapshot& s) { return pressureValue(s, PRESSURE_CPU, false); }},
+    {"pressure.memory", SNAPSHOT_CHANGED_PRESSURE, [](const StatsSnapshot& s) { return pressureValue(s, PRESSURE_MEMORY, false); }},
+    {"pressure.memory_full", SNAPSHOT_CHANGED_PRESSURE, [](const StatsSnapshot& s) { return pressureValue(s, PRESSURE_MEMORY, true); }},
+    {"pressure.io", SNAPSHOT_CHANGED_PRESSURE, [](const StatsSnapshot& s) { return pressureValue(s, PRESSURE_IO, false); }},
+    {"pressure.io_full", SNAPSHOT_CHANGED_PRESSURE, [](const StatsSnapshot& s) { return pressureValue(s, PRESSURE_IO, true); }},
+    {"gpu.temperature", SNAPSHOT_CHANGED_GPU_TEMP | SNAPSHOT_CHANGED_GPU_AVAILABLE,
+     [](const StatsSnapshot& s) { return gpuValue(s, s.gpu.temperature); }},
+    {"gpu.utilization", SNAPSHOT_CHANGED_GPU_UTIL | SNAPSHOT_CHANGED_GPU_AVAILABLE,
+     [](const StatsSnapshot& s) { return gpuValue(s, s.gpu.utilizationGpu); }},
+    {"gpu.memory_used_gb", SNAPSHOT_CHANGED_GPU_MEM_USED | SNAPSHOT_CHANGED_GPU_AVAILABLE,
+     [](const StatsSnapshot& s) { return gpuValue(s, s.gpu.memoryUsed); }},
+    {"gpu.memory_percent", SNAPSHOT_CHANGED_GPU_MEM_USED | SNAPSHOT_CHANGED_GPU_DESCRIPTOR | SNAPSHOT_CHANGED_GPU_AVAILABLE,
+     [](const StatsSnapshot& s) {
+         return s.gpu.memoryTotal > 0 ? gpuValue(s, s.gpu.memoryUsed / s.gpu.memoryTotal * 100.0) : NOT_AVAILABLE;
+     }},
+    {"gpu.power_w", SNAPSHOT_CHANGED_GPU_EXTENDED | SNAPSHOT_CHANGED_GPU_AVAILABLE,
+     [](const StatsSnapshot& s) { return gpuValue(s, s.gpu.extended.powerDraw); }},
+    {"gpu.sm_clock_mhz", SNAPSHOT_CHANGED_GPU_EXTENDED | SNAPSHOT_CHANGED_GPU_AVAILABLE,
+     [](const StatsSnapshot& s) { return gpuValue(s, s.gpu.extended.smClock); }},
+    {"gpu.ecc_uncorrected", SNAPSHOT_CHANGED_GPU_EXTENDED | SNAPSHOT_CHANGED_GPU_AVAILABLE,
+     [](const StatsSnapshot& s) { return gpuValue(s, static_cast<double>(s.gpu.extended.eccUncorrected)); }},
+    {"gpu.throttled", SNAPSHOT_CHANGED_GPU_EXTENDED | SNAPSHOT_CHANGED_GPU_AVAILABLE,
+     [](const StatsSnapshot& s) { return gpuValue(s, (s.gpu.extended.throttleReasons & ~GPU_THROTTLE_IDLE) ? 1.0 : 0.0); }},
+    {"cpu.clock_mhz", SNAPSHOT_CHANGED_THERMAL, [](const StatsSnapshot& s) {
+         if (s.coreFrequencyMhz.empty()) return NOT_AVAILABLE;
+         double sum = 0.0;
+         for (double mhz : s.coreFrequencyMhz) sum += mhz;
+         return sum / static_cast<double>(s.coreFrequencyMhz.size());
+     }},
+    {"cpu.throttles", SNAPSHOT_CHANGED_THERMAL,
+     [](const StatsSnapshot& s) { return s.coreThrottlesPerSec + s.packageThrottlesPerSec; }},
+    {"thermal.max_c", SNAPSHOT_CHANGED_THERMAL, [](const StatsSnapshot& s) {
+         double hottest = NOT_AVAILABLE;
+         for (const ThermalZoneSample& zone : s.thermalZones) {
+             if (!(zone.temperature <= hottest)) hottest = zone.temperature;
+         }
+         return hottest;
+     }},
+    {"processes.count", SNAPSHOT_CHANGED_PROCESSES, [](const StatsSnapshot& s) { return static_cast<double>(s.processCount); }},
+    {"disk.max_util", SNAPSHOT_CHANGED_DISKS, [](const StatsSnapshot& s) {
+         double most = 0.0;
+         for (const DiskSample& disk : s.disks) most = std::max(most, disk.utilization);
+         return most;
+     }},
+    {"net.max_rx_mb", SNAPSHOT_CHANGED_NETWORK, [](const StatsSnapshot& s) {
+         double most = 0.0;
+         for (const NetSample& nic : s.interfaces) most = std::max(most, nic.rxBytesPerSec / (1024.0 * 1024.0));
+         return most;
+     }},
+    {"net.max_tx_mb", SNAPSHOT_CHANGED_NETWORK, [](const StatsSnapshot& s) {
+         double most = 0.0;
+         for (const NetSample& nic : s.interfaces) most = std::max(most, nic.txBytesPerSec / (1024.0 * 1024.0));
+         return most;
+     }},
+};
+
+static_assert(sizeof(SNAPSHOT_METRICS) / sizeof(SNAPSHOT_METRICS[0]) == SNAPSHOT_METRIC_COUNT,
+              "SNAPSHOT_METRIC_COUNT must match the table");
+
+const SnapshotMetric& snapshotMetric(size_t index) {
+    return SNAPSHOT_METRICS[index];
+}
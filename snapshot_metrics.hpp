@@ -0,0 +1,22 @@
+#ifndef STATS_SNAPSHOT_METRICS_HPP
+#define STATS_SNAPSHOT_METRICS_HPP
+
+#include <cstddef>
+#include "snapshot.hpp"
+
+#define SNAPSHOT_METRIC_COUNT 32 // Entries of the table, at most 64 so a metric mask fits in 64 bits
+
+// One number of the snapshot under a stable dotted name ("cpu.usage", "gpu.power_w"),
+// what the alert rules and the anomaly detectors read. read() gives NaN when the value
+// is not collected; changedBits are the SNAPSHOT_CHANGED_* bits it depends on, so
+// consumers only look at it in snapshots where one of them is set.
+struct SnapshotMetric {
+    const char* name;
+    unsigned int changedBits;
+    double (*read)(const StatsSnapshot& snap);
+};
+
+// Metric 0 to SNAPSHOT_METRIC_COUNT - 1. The order is fixed: bit i of a metric mask is metric i.
+const SnapshotMetric& snapshotMetric(size_t index);
+
+#endif
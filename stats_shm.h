@@ -0,0 +1,99 @@
+/**
+ * Shared-memory snapshot published by stats_display for other local tools.
+ *
+ * The monitor writes its latest snapshot into a named shared-memory region
+ * guarded by a seqlock: the sequence number is odd while an update is in
+ * progress, and a reader retries whenever it changed during its copy. Readers
+ * never take a lock or make a syscall once the region is mapped, and any
+ * number of them can read concurrently without slowing the writer down.
+ *
+ *      stats_shm_reader* r = stats_shm_open();
+ *      stats_shm_snapshot snap;
+ *      if (r && stats_shm_read(r, &snap) == STATS_SHM_OK) { ... }
+ *      stats_shm_close(r);
+ *
+ * Plain C so it can be used from any language with a C FFI.
+ */
+#ifndef STATS_SHM_H
+#define STATS_SHM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STATS_SHM_NAME_WIN32 "Local\\StatsDisplaySnapshot"
+#define STATS_SHM_NAME_POSIX "/stats_display"
+#define STATS_SHM_MAGIC 0x53445348u /* "SDSH" */
+#define STATS_SHM_VERSION 2u
+
+/* Return codes of stats_shm_read() */
+#define STATS_SHM_OK 0
+#define STATS_SHM_EMPTY -1 /* Region exists but nothing was published yet */
+#define STATS_SHM_BUSY -2  /* Could not get a consistent copy, try again */
+
+typedef struct stats_shm_snapshot {
+    uint64_t timestamp_ms;    /* Milliseconds since the Unix epoch */
+    double cpu_usage;         /* Percent, -1.0 when unavailable */
+    double ram_usage;         /* Used physical memory in GB */
+    uint32_t gpu_data_available;
+    uint32_t gpu_temperature; /* Celsius */
+    uint32_t gpu_utilization; /* Percent */
+    uint32_t reserved;
+    double gpu_memory_total;  /* GB */
+    double gpu_memory_used;   /* GB */
+    char gpu_name[96];        /* NUL-terminated, truncated if longer */
+    char driver_version[32];
+    char anomalies[128];      /* Metrics flagged as anomalous, comma-separated ("cpu.usage,gpu.power_w"),
+                                 empty when none; truncated if longer */
+} stats_shm_snapshot;
+
+typedef struct stats_shm_region {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t seq; /* Odd while the writer is updating data, 0 until the first publish */
+    uint32_t reserved;
+    stats_shm_snapshot data;
+} stats_shm_region;
+
+/* Seqlock primitives, shared by the writer (shm_publisher.cpp) and the reader library */
+#if defined(_MSC_VER)
+#include <windows.h>
+static __inline uint32_t stats_shm_load_seq(const stats_shm_region* r) {
+    uint32_t s = *(const volatile uint32_t*)&r->seq;
+    MemoryBarrier();
+    return s;
+}
+static __inline void stats_shm_store_seq(stats_shm_region* r, uint32_t s) {
+    MemoryBarrier();
+    *(volatile uint32_t*)&r->seq = s;
+    MemoryBarrier();
+}
+static __inline void stats_shm_read_fence(void) { MemoryBarrier(); }
+#else
+static inline uint32_t stats_shm_load_seq(const stats_shm_region* r) {
+    return __atomic_load_n(&r->seq, __ATOMIC_ACQUIRE);
+}
+static inline void stats_shm_store_seq(stats_shm_region* r, uint32_t s) {
+    /* Release orders the data writes before an even store; the fence orders the odd
+       store before the data writes that follow it. */
+    __atomic_store_n(&r->seq, s, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+static inline void stats_shm_read_fence(void) { __atomic_thread_fence(__ATOMIC_ACQUIRE); }
+#endif
+
+typedef struct stats_shm_reader stats_shm_reader;
+
+/* Maps the region read-only. Returns NULL if the monitor is not running. */
+stats_shm_reader* stats_shm_open(void);
+/* Copies the latest snapshot into *out, see the STATS_SHM_* return codes */
+int stats_shm_read(stats_shm_reader* reader, stats_shm_snapshot* out);
+void stats_shm_close(stats_shm_reader* reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
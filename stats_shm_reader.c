@@ -0,0 +1,93 @@
+/* Reader side of the shared-memory snapshot, see stats_shm.h */
+#include "stats_shm.h"
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/* A writer updates at most every few milliseconds, so this many collisions in a row
+   means it died in the middle of an update. */
+#define STATS_SHM_MAX_RETRIES 100000
+
+struct stats_shm_reader {
+    const stats_shm_region* region;
+#ifdef _WIN32
+    HANDLE mapping;
+#endif
+};
+
+stats_shm_reader* stats_shm_open(void) {
+    stats_shm_reader* reader;
+    const stats_shm_region* region;
+#ifdef _WIN32
+    HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, STATS_SHM_NAME_WIN32);
+    if (!mapping) return NULL;
+    region = (const stats_shm_region*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, sizeof(stats_shm_region));
+    if (!region) {
+        CloseHandle(mapping);
+        return NULL;
+    }
+#else
+    int fd = shm_open(STATS_SHM_NAME_POSIX, O_RDONLY, 0);
+    void* p;
+    if (fd < 0) return NULL;
+    p = mmap(NULL, sizeof(stats_shm_region), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); /* The mapping keeps the region alive */
+    if (p == MAP_FAILED) return NULL;
+    region = (const stats_shm_region*)p;
+#endif
+
+    reader = (stats_shm_reader*)malloc(sizeof(stats_shm_reader));
+    if (!reader || region->magic != STATS_SHM_MAGIC || region->version != STATS_SHM_VERSION) {
+        free(reader);
+#ifdef _WIN32
+        UnmapViewOfFile(region);
+        CloseHandle(mapping);
+#else
+        munmap((void*)region, sizeof(stats_shm_region));
+#endif
+        return NULL;
+    }
+    reader->region = region;
+#ifdef _WIN32
+    reader->mapping = mapping;
+#endif
+    return reader;
+}
+
+int stats_shm_read(stats_shm_reader* reader, stats_shm_snapshot* out) {
+    const stats_shm_region* region = reader->region;
+    int attempt;
+    for (attempt = 0; attempt < STATS_SHM_MAX_RETRIES; ++attempt) {
+        uint32_t before = stats_shm_load_seq(region);
+        if (before == 0) return STATS_SHM_EMPTY;
+        if (before & 1) continue; /* Update in progress */
+
+        memcpy(out, (const void*)&region->data, sizeof(*out));
+        stats_shm_read_fence();
+
+        if (stats_shm_load_seq(region) == before) {
+            return STATS_SHM_OK;
+        }
+    }
+    return STATS_SHM_BUSY;
+}
+
+void stats_shm_close(stats_shm_reader* reader) {
+    if (!reader) return;
+#ifdef _WIN32
+    UnmapViewOfFile(reader->region);
+    CloseHandle(reader->mapping);
+#else
+    munmap((void*)reader->region, sizeof(stats_shm_region));
+#endif
+    free(reader);
+}
+
+/* comand line to compile:
+ * cl /c /O2 stats_shm_reader.c && lib stats_shm_reader.obj      (Windows)
+ * cc -O2 -fPIC -shared stats_shm_reader.c -o libstats_shm.so     (Linux)
+ */
@@ -0,0 +1,110 @@
+#ifndef STATS_TESTS_AGGREGATOR_PROCESS_HPP
+#define STATS_TESTS_AGGREGATOR_PROCESS_HPP
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Blocking TCP connection to a local port, -1 if nothing listens there
+inline int connectLocal(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(static_cast<unsigned short>(port));
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+inline bool sendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+/**
+ * The aggregator (build/stats_aggregator) running as a child process on its own ports,
+ * with a connection to its query port. Killed when this goes out of scope.
+ */
+class AggregatorProcess {
+public:
+    AggregatorProcess(int agentPort, int queryPort, const std::vector<std::string>& extraArgs = std::vector<std::string>())
+        : agentPort_(agentPort) {
+        std::vector<std::string> args = {"build/stats_aggregator", "--listen", std::to_string(agentPort),
+                                         "--query", std::to_string(queryPort)};
+        args.insert(args.end(), extraArgs.begin(), extraArgs.end());
+        pid_ = fork();
+        if (pid_ == 0) {
+            std::vector<char*> argv;
+            for (std::string& arg : args) argv.push_back(&arg[0]);
+            argv.push_back(nullptr);
+            execv(argv[0], argv.data());
+            _exit(127);
+        }
+        for (int attempt = 0; attempt < 200 && query_ < 0; ++attempt) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            query_ = connectLocal(queryPort);
+        }
+    }
+
+    ~AggregatorProcess() {
+        if (query_ >= 0) close(query_);
+        if (pid_ > 0) {
+            kill(pid_, SIGTERM);
+            waitpid(pid_, nullptr, 0);
+        }
+    }
+
+    bool ok() const { return query_ >= 0; }
+    int agentPort() const { return agentPort_; }
+
+    // Sends a query line and returns the response without its "." terminator. One connection,
+    // so one thread at a time: replies are not matched to queries
+    std::string query(const std::string& line) {
+        std::string response;
+        if (!sendAll(query_, line + "\n")) return response;
+        char buffer[65536];
+        while (response.size() < 2 || response.compare(response.size() - 2, 2, ".\n") != 0 ||
+               (response.size() > 2 && response[response.size() - 3] != '\n')) {
+            ssize_t n = recv(query_, buffer, sizeof(buffer), 0);
+            if (n <= 0) break;
+            response.append(buffer, static_cast<size_t>(n));
+        }
+        if (response.size() >= 2) response.resize(response.size() - 2);
+        return response;
+    }
+
+    // A number from the STATS line, e.g. stat("samples")
+    unsigned long long stat(const char* name) {
+        std::string stats = query("STATS");
+        size_t at = stats.find(std::string(name) + "=");
+        return at == std::string::npos ? 0 : std::strtoull(stats.c_str() + at + std::strlen(name) + 1, nullptr, 10);
+    }
+
+private:
+    pid_t pid_ = -1;
+    int query_ = -1;
+    int agentPort_;
+};
+
+#endif
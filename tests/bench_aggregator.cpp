@@ -0,0 +1,132 @@
+// Load generator for the aggregator: many simulated agents streaming samples (and a sketch
+// per metric and window) while a query client measures how long each kind of query takes.
+// Reports the offered and ingested sample rates and the query latency percentiles. By default
+// 10,000 agents at the monitor's 4 Hz; --hz 0 sends as fast as the aggregator takes them.
+//   build/bench_aggregator [--agents n] [--hz samples/s per agent, 0 = flat out] [--seconds s]
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <map>
+#include "aggregator_process.hpp"
+#include "check.hpp"
+#include "quantile_sketch.hpp"
+#include "snapshot_metrics.hpp"
+#include "wire_format.hpp"
+
+#define AGENT_PORT 19500
+#define QUERY_PORT 19501
+
+typedef std::chrono::steady_clock Clock;
+
+struct LoadAgent {
+    int fd = -1;
+    FrameEncoder encoder;
+    std::string out;
+};
+
+int main(int argc, char** argv) {
+    int agents = 10000;
+    double hz = 4.0;
+    double seconds = 5.0;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string opt = argv[i];
+        if (opt == "--agents") agents = std::atoi(argv[i + 1]);
+        else if (opt == "--hz") hz = std::atof(argv[i + 1]);
+        else if (opt == "--seconds") seconds = std::atof(argv[i + 1]);
+    }
+
+    double rate = hz * agents;
+    AggregatorProcess aggregator(AGENT_PORT, QUERY_PORT);
+    CHECK(aggregator.ok());
+    if (!aggregator.ok()) return checkResult();
+
+    std::vector<LoadAgent> fleet(static_cast<size_t>(agents));
+    for (int i = 0; i < agents; ++i) {
+        LoadAgent& agent = fleet[static_cast<size_t>(i)];
+        agent.fd = connectLocal(AGENT_PORT);
+        CHECK(agent.fd >= 0);
+        if (agent.fd < 0) return checkResult();
+        agent.encoder.encodeHello("load-" + std::to_string(i), agent.out);
+    }
+
+    // One closed window of sketches per agent, sent up front so QUANTILE has data to merge
+    QuantileSketch sketch;
+    for (int v = 0; v < 240; ++v) sketch.add(20.0 + v % 60);
+    WireSketch wire;
+    wire.startMs = static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count()) / SKETCH_WINDOW_MS * SKETCH_WINDOW_MS - SKETCH_WINDOW_MS;
+    wire.windowMs = SKETCH_WINDOW_MS;
+    sketch.encode(wire.data);
+    for (LoadAgent& agent : fleet) {
+        for (size_t m = 0; m < SNAPSHOT_METRIC_COUNT; ++m) {
+            wire.metric = snapshotMetric(m).name;
+            agent.encoder.encodeSketch(wire, agent.out);
+        }
+        sendAll(agent.fd, agent.out);
+        agent.out.clear();
+    }
+
+    std::atomic<bool> stop(false);
+    std::map<std::string, std::vector<double>> latencies;
+    std::thread queries([&] {
+        const char* kinds[] = {"STATS", "FLEET", "TOP 10", "QUANTILE cpu.usage 5", "QUANTILE gpu.utilization 5 load-7"};
+        while (!stop.load()) {
+            for (const char* kind : kinds) {
+                Clock::time_point start = Clock::now();
+                aggregator.query(kind);
+                latencies[kind].push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+    });
+
+    StatsSnapshot snap;
+    snap.gpuDataAvailable = true;
+    snap.gpu.name = "NVIDIA A100-SXM4-80GB";
+    snap.gpu.memoryTotal = 80.0;
+    unsigned long long sent = 0;
+    Clock::time_point begin = Clock::now();
+    Clock::time_point end = begin + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    while (Clock::now() < end) {
+        // A round is one sample from every agent, paced to the requested rate
+        for (size_t i = 0; i < fleet.size(); ++i) {
+            LoadAgent& agent = fleet[i];
+            snap.timestampMs = sent;
+            snap.cpuUsage = static_cast<double>((sent * 7 + i) % 10000) / 100.0;
+            snap.gpu.temperature = static_cast<unsigned int>(40 + (sent + i) % 50);
+            snap.gpu.utilizationGpu = static_cast<unsigned int>((sent + 3 * i) % 101);
+            agent.out.clear();
+            agent.encoder.encodeSample(snap, agent.out);
+            sendAll(agent.fd, agent.out);
+            ++sent;
+        }
+        if (rate > 0) {
+            std::this_thread::sleep_until(begin + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(sent / rate)));
+        }
+    }
+    double sendSeconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    // The query thread shares the query connection with stat() below, so it stops first
+    stop = true;
+    queries.join();
+
+    // Wait for the shards to drain what is in flight
+    unsigned long long ingested = 0;
+    for (int attempt = 0; attempt < 500 && ingested < sent; ++attempt) {
+        ingested = aggregator.stat("samples");
+        if (ingested < sent) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    double ingestSeconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    for (LoadAgent& agent : fleet) close(agent.fd);
+
+    std::printf("%d agents: offered %.0f samples/s, ingested %llu of %llu at %.0f samples/s\n", agents,
+                sent / sendSeconds, ingested, sent, ingested / ingestSeconds);
+    for (auto& entry : latencies) {
+        std::vector<double>& v = entry.second;
+        std::sort(v.begin(), v.end());
+        std::printf("  %-34s n=%-5zu p50 %8.0f us  p99 %8.0f us  max %8.0f us\n", entry.first.c_str(), v.size(),
+                    v[v.size() / 2], v[v.size() * 99 / 100], v.back());
+    }
+    CHECK(ingested == sent); // Every sample counted, and only samples: the sketches are not
+    return checkResult();
+}
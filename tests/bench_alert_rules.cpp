@@ -0,0 +1,102 @@
+// Cost of the alert engine with 10,000 rules over 100 metrics sampled at 4 Hz: a tick where
+// a few metrics changed (what SnapshotAlerts feeds it) only evaluates the rules reading them,
+// against a tick where every metric is set and so every rule runs.
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include "check.hpp"
+#include "alert_rules.hpp"
+
+#define METRICS 100
+#define RULES 10000
+#define TICKS 2400   // 10 minutes at 4 Hz
+#define TICK_MS 250
+
+struct TickCost {
+    double us;
+    double evaluations;
+    unsigned long long events;
+};
+
+static AlertEngine makeEngine() {
+    std::vector<std::string> names;
+    for (int m = 0; m < METRICS; ++m) names.push_back("m" + std::to_string(m));
+    AlertEngine engine(names);
+    // Thresholds, durations, rates and and/or mixed, every metric read by about as many rules
+    for (int r = 0; r < RULES; ++r) {
+        AlertRuleSpec spec;
+        spec.name = "rule" + std::to_string(r);
+        std::string a = names[static_cast<size_t>(r % METRICS)];
+        std::string b = names[static_cast<size_t>((r * 7 + 3) % METRICS)];
+        int threshold = 60 + r % 35;
+        switch (r % 4) {
+        case 0:
+            spec.condition = a + " > " + std::to_string(threshold);
+            spec.forMs = 30000;
+            spec.clear = a + " < " + std::to_string(threshold - 5);
+            break;
+        case 1:
+            spec.condition = a + " > " + std::to_string(threshold) + " and " + b + " > 50";
+            break;
+        case 2:
+            spec.condition = "rate(" + a + ") > 20 or (" + a + " > 95 and " + b + " < 10)";
+            spec.forMs = 5000;
+            break;
+        default:
+            spec.condition = a + " >= " + std::to_string(threshold) + " or " + b + " <= 1";
+            spec.forMs = 1000;
+            break;
+        }
+        engine.addRule(spec);
+    }
+    return engine;
+}
+
+// Random walks between 0 and 100; changed metrics per tick, the others left as they were
+static TickCost run(size_t changedPerTick) {
+    AlertEngine engine = makeEngine();
+    std::mt19937 random(48);
+    std::vector<double> values(METRICS, 50.0);
+    std::vector<AlertEvent> events;
+    unsigned long long eventCount = 0;
+    unsigned long long evaluationsBefore = engine.evaluations();
+    double totalUs = 0.0;
+    for (int t = 1; t <= TICKS; ++t) {
+        unsigned long long nowMs = static_cast<unsigned long long>(t) * TICK_MS;
+        // Which metrics move is decided outside the timed part
+        std::vector<size_t> changed;
+        for (size_t i = 0; i < changedPerTick; ++i) {
+            size_t m = changedPerTick == METRICS ? i : random() % METRICS;
+            values[m] += static_cast<double>(static_cast<int>(random() % 21) - 10);
+            if (values[m] < 0) values[m] = 0;
+            if (values[m] > 100) values[m] = 100;
+            changed.push_back(m);
+        }
+        events.clear();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (size_t m : changed) engine.set(m, values[m], nowMs);
+        engine.evaluate(nowMs, events);
+        totalUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        eventCount += events.size();
+    }
+    TickCost cost;
+    cost.us = totalUs / TICKS;
+    cost.evaluations = static_cast<double>(engine.evaluations() - evaluationsBefore) / TICKS;
+    cost.events = eventCount;
+    return cost;
+}
+
+int main() {
+    TickCost few = run(5);
+    TickCost all = run(METRICS);
+    std::printf("%d rules, %d metrics at 4 Hz: 5 metrics changed %.1f us/tick (%.0f rule evaluations, %llu events), "
+                "all %d changed %.1f us/tick (%.0f evaluations, %llu events)\n",
+                RULES, METRICS, few.us, few.evaluations, few.events, METRICS, all.us, all.evaluations, all.events);
+    // Every rule reads one or two metrics, so 5 changed metrics touch at most about 10% of them
+    CHECK(few.evaluations < RULES * 0.11);
+    CHECK(all.evaluations == RULES);
+    CHECK(few.us * 4 < all.us);
+    CHECK(few.us < TICK_MS * 1000.0 / 100); // Under 1% of the tick
+    return checkResult();
+}
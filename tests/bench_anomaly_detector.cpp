@@ -0,0 +1,32 @@
+// Update cost of the anomaly detectors across 10,000 series, one sample per series per tick.
+#include <chrono>
+#include <random>
+#include <vector>
+#include "check.hpp"
+#include "anomaly_detector.hpp"
+
+#define SERIES 10000
+#define TICKS 400
+
+int main() {
+    std::mt19937 random(7);
+    std::normal_distribution<double> noise(0.0, 1.0);
+    std::vector<double> level(SERIES);
+    for (double& l : level) l = 1.0 + random() % 1000;
+    // Generated up front, so only the updates are timed
+    std::vector<double> samples(static_cast<size_t>(SERIES) * TICKS);
+    for (size_t i = 0; i < samples.size(); ++i) samples[i] = level[i % SERIES] * (1.0 + 0.05 * noise(random));
+
+    AnomalyDetectors detectors(SERIES);
+    unsigned long long flagged = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < TICKS; ++t) {
+        const double* tick = &samples[t * SERIES];
+        for (size_t s = 0; s < SERIES; ++s) flagged += detectors.update(s, tick[s]) != 0;
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+                (static_cast<double>(SERIES) * TICKS);
+    std::printf("%d series: %.1f ns per update, %.2f ms per tick, %llu flagged\n", SERIES, ns, ns * SERIES / 1e6, flagged);
+    CHECK(flagged < static_cast<unsigned long long>(SERIES) * TICKS / 100);
+    return checkResult();
+}
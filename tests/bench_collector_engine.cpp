@@ -0,0 +1,114 @@
+// Tick length of the collector engine with 50 synthetic collectors: 45 that wait briefly
+// like a file read, 4 that burn CPU like a parser, and one slow one standing in for
+// nvidia-smi. Against the same collectors run one after the other on the calling thread,
+// and the engine without the slow one: a tick is never shorter than its slowest collector.
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "check.hpp"
+#include "collector_engine.hpp"
+
+#define WAITING_COLLECTORS 45
+#define BUSY_COLLECTORS 4
+#define WAIT_US 200
+#define BUSY_US 1000
+#define SLOW_MS 20
+#define TICKS 20
+#define TICK_MS 250
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+class SyntheticCollector : public Collector {
+public:
+    SyntheticCollector(bool busy, unsigned int us) : busy_(busy), us_(us) {}
+
+    const char* name() const { return busy_ ? "busy" : "waiting"; }
+    unsigned int periodMs() const { return TICK_MS; }
+    void collect() {
+        if (!busy_) {
+            std::this_thread::sleep_for(std::chrono::microseconds(us_));
+            return;
+        }
+        Clock::time_point end = Clock::now() + std::chrono::microseconds(us_);
+        while (Clock::now() < end) {
+        }
+    }
+    unsigned int apply(StatsSnapshot& snapshot) {
+        snapshot.cpuUsage += 1.0;
+        return SNAPSHOT_CHANGED_CPU;
+    }
+
+private:
+    bool busy_;
+    unsigned int us_;
+};
+
+static void addCollectors(CollectorEngine& engine, bool withSlow) {
+    for (int i = 0; i < WAITING_COLLECTORS; ++i) {
+        engine.add(std::unique_ptr<Collector>(new SyntheticCollector(false, WAIT_US)));
+    }
+    for (int i = 0; i < BUSY_COLLECTORS; ++i) {
+        engine.add(std::unique_ptr<Collector>(new SyntheticCollector(true, BUSY_US)));
+    }
+    if (withSlow) engine.add(std::unique_ptr<Collector>(new SyntheticCollector(false, SLOW_MS * 1000)));
+}
+
+// Average and longest tick in ms, every collector due each tick
+static void runTicks(CollectorEngine& engine, size_t collectors, double& averageMs, double& worstMs) {
+    averageMs = worstMs = 0.0;
+    for (int tick = 0; tick < TICKS; ++tick) {
+        StatsSnapshot snapshot;
+        Clock::time_point start = Clock::now();
+        engine.tick(snapshot, static_cast<unsigned long long>(tick + 1) * TICK_MS);
+        double ms = elapsedMs(start);
+        averageMs += ms / TICKS;
+        worstMs = ms > worstMs ? ms : worstMs;
+        CHECK(snapshot.cpuUsage == static_cast<double>(collectors));
+    }
+}
+
+int main() {
+    size_t collectors = WAITING_COLLECTORS + BUSY_COLLECTORS + 1;
+    std::vector<std::unique_ptr<SyntheticCollector>> sequential;
+    for (int i = 0; i < WAITING_COLLECTORS; ++i) sequential.emplace_back(new SyntheticCollector(false, WAIT_US));
+    for (int i = 0; i < BUSY_COLLECTORS; ++i) sequential.emplace_back(new SyntheticCollector(true, BUSY_US));
+    sequential.emplace_back(new SyntheticCollector(false, SLOW_MS * 1000));
+    Clock::time_point start = Clock::now();
+    for (int tick = 0; tick < TICKS; ++tick) {
+        StatsSnapshot snapshot;
+        for (auto& collector : sequential) {
+            collector->collect();
+            collector->apply(snapshot);
+        }
+    }
+    double sequentialMs = elapsedMs(start) / TICKS;
+
+    double pooledMs, pooledWorstMs, fourMs, fourWorstMs, fastMs, fastWorstMs;
+    {
+        CollectorEngine engine;
+        addCollectors(engine, true);
+        runTicks(engine, collectors, pooledMs, pooledWorstMs);
+    }
+    {
+        CollectorEngine engine(4);
+        addCollectors(engine, true);
+        runTicks(engine, collectors, fourMs, fourWorstMs);
+    }
+    {
+        CollectorEngine engine;
+        addCollectors(engine, false);
+        runTicks(engine, collectors - 1, fastMs, fastWorstMs);
+    }
+    CHECK(pooledMs >= SLOW_MS && fourMs >= SLOW_MS); // The slow collector sets the tick
+
+    std::printf("%zu collectors, one of %d ms: one after the other %.1f ms per tick; engine %.1f ms "
+                "(worst %.1f), 4 workers %.1f ms (worst %.1f); without the slow one %.1f ms (worst %.1f)\n",
+                collectors, SLOW_MS, sequentialMs, pooledMs, pooledWorstMs, fourMs, fourWorstMs, fastMs, fastWorstMs);
+    return checkResult();
+}
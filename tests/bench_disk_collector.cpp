@@ -0,0 +1,119 @@
+// Cost of a disk collector tick over a diskstats file of 500 devices (NVMe namespaces,
+// device-mapper volumes and loop devices) generated by the bench: the first tick, a steady
+// tick with every counter moved, and a tick after a device appeared in the middle of the
+// list. Against reading the same file with getline and sscanf into a map by name.
+// The file is on tmpfs, rewritten between ticks; only collect() and apply() are timed.
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include "check.hpp"
+#include "disk_collector.hpp"
+
+#define NVME_NAMESPACES 200
+#define DM_VOLUMES 200
+#define LOOP_DEVICES 100 // 500 devices
+#define TICKS 50
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsedUs(Clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+static void writeFile(const std::string& path, const std::string& content) {
+    std::ofstream(path, std::ios::trunc) << content;
+}
+
+// One diskstats line, every counter derived from n so that each tick moves all of them
+static void appendLine(std::string& out, unsigned int major, unsigned int minor, const std::string& name,
+                       unsigned long long n) {
+    char line[256];
+    std::snprintf(line, sizeof(line), "%4u %7u %s %llu 0 %llu %llu %llu 0 %llu %llu 0 %llu %llu 0 0 0 0 0 0\n",
+                  major, minor, name.c_str(), n * 10, n * 80, n * 3, n * 5, n * 40, n * 2, n, n * 5);
+    out += line;
+}
+
+// The diskstats of the fake host at tick t, with one more NVMe namespace when extra is set
+static std::string diskstats(unsigned long long t, bool extra) {
+    std::string out;
+    for (int i = 0; i < NVME_NAMESPACES; ++i) {
+        std::string name = "nvme" + std::to_string(i / 8) + "n" + std::to_string(i % 8 + 1);
+        appendLine(out, 259, static_cast<unsigned int>(i), name, t * (i + 1));
+        if (extra && i == NVME_NAMESPACES / 2) appendLine(out, 259, 4000, "nvme99n1", t);
+    }
+    for (int i = 0; i < DM_VOLUMES; ++i) {
+        appendLine(out, 253, static_cast<unsigned int>(i), "dm-" + std::to_string(i), t * (i % 7 + 1));
+    }
+    for (int i = 0; i < LOOP_DEVICES; ++i) {
+        appendLine(out, 7, static_cast<unsigned int>(i), "loop" + std::to_string(i), i % 10 == 0 ? t : 1);
+    }
+    return out;
+}
+
+struct ScannedDisk {
+    unsigned long long fields[11];
+};
+
+int main() {
+    char dir[] = "/tmp/stats_disk_bench_XXXXXX";
+    CHECK(mkdtemp(dir) != nullptr);
+    std::string path = std::string(dir) + "/diskstats";
+    writeFile(path, diskstats(1, false));
+
+    DiskCollector collector(250, path.c_str());
+    StatsSnapshot snapshot;
+    Clock::time_point start = Clock::now();
+    collector.collect();
+    collector.apply(snapshot);
+    double firstUs = elapsedUs(start);
+
+    double steadyUs = 0.0;
+    for (unsigned long long t = 2; t < 2 + TICKS; ++t) {
+        writeFile(path, diskstats(t, false));
+        start = Clock::now();
+        collector.collect();
+        collector.apply(snapshot);
+        steadyUs += elapsedUs(start) / TICKS;
+    }
+    CHECK(snapshot.disks.size() == DISK_TOP_COUNT);
+    CHECK(std::string(snapshot.disks[0].name) == "nvme24n8"); // The highest multiplier
+
+    writeFile(path, diskstats(2 + TICKS, true));
+    start = Clock::now();
+    collector.collect();
+    collector.apply(snapshot);
+    double addedUs = elapsedUs(start);
+
+    // getline and sscanf, the devices kept in a map by name
+    std::map<std::string, ScannedDisk> scanned;
+    double sscanfUs = 0.0;
+    for (int round = 0; round < TICKS; ++round) {
+        start = Clock::now();
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line)) {
+            unsigned int major, minor;
+            char name[64];
+            ScannedDisk disk;
+            unsigned long long* f = disk.fields;
+            if (std::sscanf(line.c_str(), "%u %u %63s %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu", &major,
+                            &minor, name, &f[0], &f[1], &f[2], &f[3], &f[4], &f[5], &f[6], &f[7], &f[8], &f[9],
+                            &f[10]) == 14) {
+                scanned[name] = disk;
+            }
+        }
+        sscanfUs += elapsedUs(start) / TICKS;
+    }
+    CHECK(scanned.size() == NVME_NAMESPACES + DM_VOLUMES + LOOP_DEVICES + 1);
+
+    std::printf("%d devices: first tick %.0f us, steady tick %.0f us, tick after a new device %.0f us; "
+                "getline and sscanf into a map %.0f us\n",
+                NVME_NAMESPACES + DM_VOLUMES + LOOP_DEVICES, firstUs, steadyUs, addedUs, sscanfUs);
+    std::filesystem::remove_all(dir);
+    return checkResult();
+}
@@ -0,0 +1,61 @@
+// Per-sample cost of the two GPU backends: an NVML query against the stub library, against
+// spawning an nvidia-smi stand-in (a shell script printing a one-GPU document) and loading
+// its output with pugixml. A real nvidia-smi takes far longer to start than the script.
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include "check.hpp"
+#include "gpu_backend.hpp"
+#include "process_runner.hpp"
+#include "pugixml.hpp"
+
+#define NVML_QUERIES 200000
+#define SPAWNS 200
+
+static double nsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main() {
+    setenv("STATS_NVML_LIBRARY", "build/libnvml_stub.so", 1);
+    std::unique_ptr<NvmlGpuBackend> nvml = NvmlGpuBackend::load();
+    CHECK(nvml != nullptr);
+    if (!nvml) return checkResult();
+    GpuData data;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < NVML_QUERIES; ++i) nvml->query(data);
+    double nvmlNs = nsSince(start) / NVML_QUERIES;
+
+    char dir[] = "/tmp/stats_gpu_bench_XXXXXX";
+    CHECK(mkdtemp(dir) != nullptr);
+    std::string script = std::string(dir) + "/nvidia-smi";
+    std::ofstream(script) << "#!/bin/sh\n"
+                             "echo '<?xml version=\"1.0\" ?><nvidia_smi_log><driver_version>550.54.15</driver_version>"
+                             "<gpu><product_name>Fake GPU</product_name><uuid>GPU-0</uuid>"
+                             "<fb_memory_usage><total>81920 MiB</total><used>1024 MiB</used></fb_memory_usage>"
+                             "<utilization><gpu_util>37 %</gpu_util></utilization>"
+                             "<temperature><gpu_temp>61 C</gpu_temp></temperature></gpu></nvidia_smi_log>'\n";
+    CHECK(chmod(script.c_str(), 0755) == 0);
+    PreparedCommand command({script, "-q", "-x"});
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < SPAWNS; ++i) {
+        const ProcessResult& result = command.run();
+        pugi::xml_document doc;
+        if (result.status != ProcessResult::EXITED ||
+            !doc.load_buffer(command.output().data(), command.output().size())) {
+            CHECK(!"nvidia-smi stand-in failed");
+            break;
+        }
+    }
+    double spawnNs = nsSince(start) / SPAWNS;
+    unlink(script.c_str());
+    rmdir(dir);
+
+    std::printf("nvml (stub): %.0f ns per sample\n", nvmlNs);
+    std::printf("spawn + XML load (shell stand-in): %.0f us per sample, %.0fx\n", spawnNs / 1000, spawnNs / nvmlNs);
+    return checkResult();
+}
@@ -0,0 +1,81 @@
+// Cost of extracting the extended GPU fields from the recorded 8-GPU nvidia-smi document:
+// parseGpuExtended()'s single walk over each <gpu> node's children against looking every
+// section up by name, and the document load both work on, for scale.
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include "check.hpp"
+#include "gpu_fields.hpp"
+#include "pugixml.hpp"
+#include "value_parse.hpp"
+
+#define ROUNDS 20000
+
+// The same fields with one child() lookup per section, the way parseGpuData() reads the rest
+static void lookupEach(pugi::xml_node gpu, GpuExtendedCounters& out) {
+    parseDouble(gpu.child("pci").child("rx_util").text().get(), out.pcieRx);
+    parseDouble(gpu.child("pci").child("tx_util").text().get(), out.pcieTx);
+    parseUnsigned(gpu.child("utilization").child("encoder_util").text().get(), out.utilizationEncoder);
+    parseUnsigned(gpu.child("utilization").child("decoder_util").text().get(), out.utilizationDecoder);
+    pugi::xml_node reasons = gpu.child("clocks_event_reasons");
+    for (pugi::xml_node reason = reasons.first_child(); reason; reason = reason.next_sibling()) {
+        if (std::strcmp(reason.text().get(), "Active") != 0) continue;
+        const char* suffix = std::strstr(reason.name(), "reason_");
+        if (!suffix) continue;
+        for (const GpuThrottleName& known : GPU_THROTTLE_NAMES) {
+            if (std::strcmp(suffix + 7, known.name) == 0) out.throttleReasons |= known.bit;
+        }
+    }
+    for (pugi::xml_node counter = gpu.child("ecc_errors").child("volatile").first_child(); counter;
+         counter = counter.next_sibling()) {
+        unsigned int count = 0;
+        if (!parseUnsigned(counter.text().get(), count)) continue;
+        (std::strstr(counter.name(), "uncorrectable") ? out.eccUncorrected : out.eccCorrected) += count;
+    }
+    parseDouble(gpu.child("gpu_power_readings").child("power_draw").text().get(), out.powerDraw);
+    parseDouble(gpu.child("gpu_power_readings").child("current_power_limit").text().get(), out.powerLimit);
+    parseUnsigned(gpu.child("clocks").child("sm_clock").text().get(), out.smClock);
+    parseUnsigned(gpu.child("clocks").child("mem_clock").text().get(), out.memoryClock);
+}
+
+// Extracts all GPUs ROUNDS times, in us per document
+template <typename Extract>
+static double usPerDocument(const pugi::xml_document& doc, Extract extract, GpuExtendedCounters& last) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int round = 0; round < ROUNDS; ++round) {
+        for (pugi::xml_node gpu = doc.child("nvidia_smi_log").child("gpu"); gpu; gpu = gpu.next_sibling("gpu")) {
+            last = GpuExtendedCounters();
+            extract(gpu, last);
+        }
+    }
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / ROUNDS;
+}
+
+int main() {
+    std::ifstream file("data/nvidia_smi_8gpu.xml");
+    std::stringstream content;
+    content << file.rdbuf();
+    std::string xml = content.str();
+    pugi::xml_document doc;
+    CHECK(doc.load_buffer(xml.data(), xml.size()));
+
+    GpuExtendedCounters walked, looked;
+    double walk = usPerDocument(doc, parseGpuExtended, walked);
+    double lookup = usPerDocument(doc, lookupEach, looked);
+    CHECK(walked == looked); // Same values for the last GPU
+    CHECK(walked.powerDraw == 257.5);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int round = 0; round < ROUNDS / 10; ++round) {
+        pugi::xml_document reloaded;
+        reloaded.load_buffer(xml.data(), xml.size());
+    }
+    double load = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / (ROUNDS / 10);
+
+    std::printf("8 GPUs: parseGpuExtended %.2f us, a lookup per section %.2f us; document load %.1f us\n", walk,
+                lookup, load);
+    return checkResult();
+}
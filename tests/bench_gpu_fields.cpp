@@ -0,0 +1,111 @@
+// Cost of the user-configured GPU fields (STATS_GPU_FIELDS) per tick, on the recorded 8-GPU
+// nvidia-smi document: 6 fields, about what a site adds, and 60, every leaf of a <gpu> node
+// plus a few computed expressions. GpuFieldQueryCache::extract() with the queries compiled
+// once, against compiling every expression again each tick, and the document load for scale.
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "check.hpp"
+#include "gpu_fields.hpp"
+#include "pugixml.hpp"
+
+#define ROUNDS 2000
+#define MANY_FIELDS 60
+
+typedef std::chrono::steady_clock Clock;
+
+static double usSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+static const GpuFieldSpec FEW_FIELDS[] = {
+    {"power", "gpu_power_readings/power_draw", false},
+    {"sm_clock", "clocks/sm_clock", false},
+    {"temperature", "temperature/gpu_temp", false},
+    {"fan", "fan_speed", false},
+    {"pstate", "performance_state", true},
+    {"link_gen", "pci/pci_gpu_link_info/pcie_gen/current_link_gen", false},
+};
+
+static const char* const COMPUTED[] = {
+    "concat(product_name, ' ', uuid)", "count(clocks_event_reasons/*)", "sum(ecc_errors/volatile/*)",
+    "number(substring-before(gpu_power_readings/power_draw, ' '))", "string-length(uuid)",
+};
+
+// Every leaf element below node, as a path relative to the <gpu> node
+static void collectLeaves(pugi::xml_node node, const std::string& path, std::vector<GpuFieldSpec>& out) {
+    for (pugi::xml_node child = node.first_child(); child; child = child.next_sibling()) {
+        if (child.type() != pugi::node_element) continue;
+        std::string childPath = path.empty() ? child.name() : path + "/" + child.name();
+        if (child.first_child().type() == pugi::node_element) {
+            collectLeaves(child, childPath, out);
+        } else {
+            out.push_back(GpuFieldSpec{"field" + std::to_string(out.size()), childPath, true});
+        }
+    }
+}
+
+// extract() ROUNDS times, in us per tick
+static double usPerExtract(const pugi::xml_document& doc, const std::vector<GpuFieldSpec>& specs) {
+    GpuFieldQueryCache cache(specs);
+    GpuFieldRecord record;
+    Clock::time_point start = Clock::now();
+    for (int round = 0; round < ROUNDS; ++round) cache.extract(doc, record);
+    double us = usSince(start) / ROUNDS;
+    CHECK(record.gpuCount == 8 && record.names.size() == specs.size());
+    return us;
+}
+
+// The same with every query compiled again each tick
+static double usPerCompile(const pugi::xml_document& doc, const std::vector<GpuFieldSpec>& specs) {
+    volatile size_t sink = 0;
+    char value[256];
+    Clock::time_point start = Clock::now();
+    for (int round = 0; round < ROUNDS / 10; ++round) {
+        for (const GpuFieldSpec& spec : specs) {
+            pugi::xpath_query query(spec.xpath.c_str());
+            for (pugi::xml_node gpu = doc.child("nvidia_smi_log").child("gpu"); gpu; gpu = gpu.next_sibling("gpu")) {
+                sink = sink + query.evaluate_string(value, sizeof(value), gpu);
+            }
+        }
+    }
+    return usSince(start) / (ROUNDS / 10);
+}
+
+int main() {
+    std::ifstream file("data/nvidia_smi_8gpu.xml");
+    std::stringstream content;
+    content << file.rdbuf();
+    std::string xml = content.str();
+    pugi::xml_document doc;
+    CHECK(doc.load_buffer(xml.data(), xml.size()));
+
+    std::vector<GpuFieldSpec> few(FEW_FIELDS, FEW_FIELDS + sizeof(FEW_FIELDS) / sizeof(FEW_FIELDS[0]));
+    std::vector<GpuFieldSpec> many;
+    collectLeaves(doc.child("nvidia_smi_log").child("gpu"), "", many);
+    for (size_t i = 0; many.size() < MANY_FIELDS; ++i) {
+        const char* xpath = COMPUTED[i % (sizeof(COMPUTED) / sizeof(COMPUTED[0]))];
+        many.push_back(GpuFieldSpec{"computed" + std::to_string(i), xpath, false});
+    }
+    many.resize(MANY_FIELDS);
+
+    double fewUs = usPerExtract(doc, few);
+    double manyUs = usPerExtract(doc, many);
+    double fewCompileUs = usPerCompile(doc, few);
+    double manyCompileUs = usPerCompile(doc, many);
+
+    Clock::time_point start = Clock::now();
+    for (int round = 0; round < ROUNDS / 10; ++round) {
+        pugi::xml_document reloaded;
+        reloaded.load_buffer(xml.data(), xml.size());
+    }
+    double loadUs = usSince(start) / (ROUNDS / 10);
+
+    std::printf("8 GPUs: %zu fields %.1f us (compiled each tick %.1f us), %zu fields %.1f us (compiled each tick "
+                "%.1f us); document load %.1f us\n",
+                few.size(), fewUs, fewCompileUs, many.size(), manyUs, manyCompileUs, loadUs);
+    return checkResult();
+}
@@ -0,0 +1,109 @@
+// Cost of parsing the memory breakdown per tick, on the recorded data/memory files: the key
+// lookup through KeySlotMap against a std::unordered_map from key to slot, the map lookup a
+// parser would otherwise use, and against the strstr and sscanf scan the RAM collector did
+// for its two fields before. Then a whole MemoryStatsReader::read() from tmpfs copies.
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "check.hpp"
+#include "memory_stats.hpp"
+
+#define ROUNDS 20000
+
+// The keys memory_stats.cpp looks up, with their slots
+static const KeySlotMap::Key MEMINFO_KEYS[] = {
+    {"MemTotal", 0}, {"MemFree", 1}, {"MemAvailable", 2}, {"Buffers", 3}, {"Cached", 4}, {"Shmem", 5},
+    {"AnonPages", 6}, {"Slab", 7}, {"SwapTotal", 8}, {"SwapFree", 9}, {"SwapCached", 10}, {"Dirty", 11},
+    {"Writeback", 12}, {"Committed_AS", 13}, {"CommitLimit", 14}, {"HugePages_Total", 15},
+    {"HugePages_Free", 16}, {"Hugepagesize", 17},
+};
+static const KeySlotMap::Key VMSTAT_KEYS[] = {{"pgfault", 0}, {"pgmajfault", 1}, {"pswpin", 2}, {"pswpout", 3}};
+
+static std::string readFile(const std::string& path) {
+    std::ifstream file(path);
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+// Parses both files ROUNDS times, looking up every line's key with find(key), in us per tick
+template <typename Find>
+static double usPerTick(const std::string& meminfo, const std::string& vmstat, Find find) {
+    volatile unsigned long long sink = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int round = 0; round < ROUNDS; ++round) {
+        unsigned long long values[32] = {};
+        for (ProcScanner scan(meminfo.data(), meminfo.size()); !scan.atEnd(); scan.nextLine()) {
+            int slot = find(scan.token(':'), false);
+            if (slot >= 0) values[slot] = scan.number();
+        }
+        for (ProcScanner scan(vmstat.data(), vmstat.size()); !scan.atEnd(); scan.nextLine()) {
+            int slot = find(scan.token(), true);
+            if (slot >= 0) values[20 + slot] = scan.number();
+        }
+        sink = sink + values[0] + values[20];
+    }
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / ROUNDS;
+}
+
+int main() {
+    std::string meminfo = readFile("data/memory/meminfo");
+    std::string vmstat = readFile("data/memory/vmstat");
+    CHECK(!meminfo.empty() && !vmstat.empty());
+
+    KeySlotMap meminfoKeys(MEMINFO_KEYS, sizeof(MEMINFO_KEYS) / sizeof(MEMINFO_KEYS[0]));
+    KeySlotMap vmstatKeys(VMSTAT_KEYS, sizeof(VMSTAT_KEYS) / sizeof(VMSTAT_KEYS[0]));
+    double perfect = usPerTick(meminfo, vmstat, [&](std::string_view key, bool isVmstat) {
+        return isVmstat ? vmstatKeys.find(key) : meminfoKeys.find(key);
+    });
+
+    std::unordered_map<std::string_view, int> meminfoMap, vmstatMap;
+    for (const KeySlotMap::Key& key : MEMINFO_KEYS) meminfoMap[key.key] = key.slot;
+    for (const KeySlotMap::Key& key : VMSTAT_KEYS) vmstatMap[key.key] = key.slot;
+    double hashed = usPerTick(meminfo, vmstat, [&](std::string_view key, bool isVmstat) {
+        const std::unordered_map<std::string_view, int>& map = isVmstat ? vmstatMap : meminfoMap;
+        auto it = map.find(key);
+        return it != map.end() ? it->second : -1;
+    });
+
+    // The RAM collector before the breakdown: two fields of meminfo, nothing of vmstat
+    volatile unsigned long long sink = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int round = 0; round < ROUNDS; ++round) {
+        unsigned long long totalKb = 0, availKb = 0;
+        const char* total = std::strstr(meminfo.c_str(), "MemTotal:");
+        const char* avail = std::strstr(meminfo.c_str(), "MemAvailable:");
+        if (total) std::sscanf(total, "MemTotal: %llu kB", &totalKb);
+        if (avail) std::sscanf(avail, "MemAvailable: %llu kB", &availKb);
+        sink = sink + totalKb - availKb;
+    }
+    double scanned = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / ROUNDS;
+
+    // Whole reads, the files kept open and re-read in place like /proc
+    char dir[] = "/tmp/stats_memory_bench_XXXXXX";
+    CHECK(mkdtemp(dir) != nullptr);
+    std::ofstream(std::string(dir) + "/meminfo") << meminfo;
+    std::ofstream(std::string(dir) + "/vmstat") << vmstat;
+    MemoryStatsReader reader(dir);
+    MemoryStats stats;
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < ROUNDS; ++round) reader.read(stats);
+    double whole = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / ROUNDS;
+    CHECK(stats.available);
+    std::filesystem::remove_all(dir);
+
+    size_t lines = 0;
+    for (char c : meminfo + vmstat) lines += c == '\n';
+    std::printf("%zu lines per tick: KeySlotMap %.2f us, std::unordered_map %.2f us; "
+                "old MemTotal/MemAvailable scan %.2f us; read() from tmpfs %.2f us\n",
+                lines, perfect, hashed, scanned, whole);
+    return checkResult();
+}
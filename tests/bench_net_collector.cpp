@@ -0,0 +1,118 @@
+// Cost of a network collector tick over a /proc/net/dev of 2000 container veths plus the
+// host's lo, eth0 and ib0, generated by the bench: the first tick, a steady tick with every
+// counter moved, and a tick after a container started in the middle of the list. Against
+// reading the same file with getline and sscanf into a map by name.
+// The file is on tmpfs, rewritten between ticks; only collect() and apply() are timed.
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include "check.hpp"
+#include "net_collector.hpp"
+
+#define VETHS 2000
+#define TICKS 50
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsedUs(Clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+static void writeFile(const std::string& path, const std::string& content) {
+    std::ofstream(path, std::ios::trunc) << content;
+}
+
+// One interface line, every counter derived from n so that each tick moves all of them
+static void appendLine(std::string& out, const char* name, unsigned long long n) {
+    char line[256];
+    std::snprintf(line, sizeof(line), "%6s: %llu %llu %llu %llu 0 0 0 0 %llu %llu %llu %llu 0 0 0 0\n", name,
+                  n * 1500, n, n / 1000, n / 500, n * 700, n, n / 2000, n / 1000);
+    out += line;
+}
+
+// The net/dev of the fake host at tick t, with one more veth when extra is set
+static std::string netDev(unsigned long long t, bool extra) {
+    std::string out =
+        "Inter-|   Receive                                                |  Transmit\n"
+        " face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed\n";
+    appendLine(out, "lo", t * 10);
+    appendLine(out, "eth0", t * 5000);
+    appendLine(out, "ib0", t * 20000);
+    char name[16];
+    for (int i = 0; i < VETHS; ++i) {
+        std::snprintf(name, sizeof(name), "veth%06x", i * 7919); // Scattered, like the random suffixes
+        appendLine(out, name, t * (i % 50 + 1));
+        if (extra && i == VETHS / 2) appendLine(out, "vethnew", t);
+    }
+    return out;
+}
+
+struct ScannedInterface {
+    unsigned long long fields[16];
+};
+
+int main() {
+    char dir[] = "/tmp/stats_net_bench_XXXXXX";
+    CHECK(mkdtemp(dir) != nullptr);
+    std::string path = std::string(dir) + "/net_dev";
+    writeFile(path, netDev(1, false));
+
+    NetCollector collector(250, path.c_str());
+    StatsSnapshot snapshot;
+    Clock::time_point start = Clock::now();
+    collector.collect();
+    collector.apply(snapshot);
+    double firstUs = elapsedUs(start);
+
+    double steadyUs = 0.0;
+    for (unsigned long long t = 2; t < 2 + TICKS; ++t) {
+        writeFile(path, netDev(t, false));
+        start = Clock::now();
+        collector.collect();
+        collector.apply(snapshot);
+        steadyUs += elapsedUs(start) / TICKS;
+    }
+    CHECK(snapshot.interfaces.size() == NET_TOP_COUNT);
+    CHECK(std::string(snapshot.interfaces[0].name) == "ib0" && std::string(snapshot.interfaces[1].name) == "eth0");
+
+    writeFile(path, netDev(2 + TICKS, true));
+    start = Clock::now();
+    collector.collect();
+    collector.apply(snapshot);
+    double addedUs = elapsedUs(start);
+
+    // getline and sscanf, the interfaces kept in a map by name
+    std::map<std::string, ScannedInterface> scanned;
+    double sscanfUs = 0.0;
+    for (int round = 0; round < TICKS; ++round) {
+        start = Clock::now();
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line)) {
+            size_t colon = line.find(':');
+            if (colon == std::string::npos) continue;
+            size_t begin = line.find_first_not_of(' ');
+            ScannedInterface counters;
+            unsigned long long* f = counters.fields;
+            if (std::sscanf(line.c_str() + colon + 1,
+                            "%llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu", &f[0],
+                            &f[1], &f[2], &f[3], &f[4], &f[5], &f[6], &f[7], &f[8], &f[9], &f[10], &f[11], &f[12],
+                            &f[13], &f[14], &f[15]) == 16) {
+                scanned[line.substr(begin, colon - begin)] = counters;
+            }
+        }
+        sscanfUs += elapsedUs(start) / TICKS;
+    }
+    CHECK(scanned.size() == VETHS + 4);
+
+    std::printf("%d interfaces: first tick %.0f us, steady tick %.0f us, tick after a new interface %.0f us; "
+                "getline and sscanf into a map %.0f us\n",
+                VETHS + 3, firstUs, steadyUs, addedUs, sscanfUs);
+    std::filesystem::remove_all(dir);
+    return checkResult();
+}
@@ -0,0 +1,99 @@
+// Cost of running a short command the way the GPU probe runs nvidia-smi: a PreparedCommand
+// reused for every run, runProcess() preparing it every time, and the older ways, popen()
+// and fork() + execvp() with a pipe. In spawns per second and p99 latency, first from a
+// small process, then again with 256 MB of touched heap, as fork() copies the page tables
+// of everything the parent has mapped and posix_spawn's vfork-style clone does not.
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "check.hpp"
+#include "process_runner.hpp"
+
+#define RUNS 300
+#define RESIDENT_MB 256
+
+typedef std::chrono::steady_clock Clock;
+
+struct SpawnCost {
+    double perSecond;
+    double p99Ms;
+};
+
+// Runs spawn RUNS times, each must return the command's output
+template <typename Spawn>
+static SpawnCost measure(Spawn spawn) {
+    std::vector<double> ms;
+    Clock::time_point begin = Clock::now();
+    for (int i = 0; i < RUNS; ++i) {
+        Clock::time_point start = Clock::now();
+        std::string output = spawn();
+        ms.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        CHECK(output == "probe\n");
+    }
+    double totalMs = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+    std::sort(ms.begin(), ms.end());
+    return SpawnCost{RUNS * 1000.0 / totalMs, ms[ms.size() * 99 / 100]};
+}
+
+static std::string viaPopen() {
+    std::string output;
+    FILE* pipe = popen("echo probe", "r");
+    if (!pipe) return output;
+    char chunk[256];
+    size_t n;
+    while ((n = std::fread(chunk, 1, sizeof(chunk), pipe)) > 0) output.append(chunk, n);
+    pclose(pipe);
+    return output;
+}
+
+static std::string viaFork() {
+    std::string output;
+    int fds[2];
+    if (pipe(fds) != 0) return output;
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        char* argv[] = {const_cast<char*>("echo"), const_cast<char*>("probe"), nullptr};
+        execvp(argv[0], argv);
+        _exit(127);
+    }
+    close(fds[1]);
+    char chunk[256];
+    ssize_t n;
+    while ((n = read(fds[0], chunk, sizeof(chunk))) > 0) output.append(chunk, static_cast<size_t>(n));
+    close(fds[0]);
+    int status;
+    waitpid(pid, &status, 0);
+    return output;
+}
+
+static void report(const char* label, PreparedCommand& prepared) {
+    SpawnCost reused = measure([&]() {
+        return std::string(prepared.run().status == ProcessResult::EXITED ? prepared.output() : "");
+    });
+    SpawnCost oneOff = measure([]() { return runProcess({"echo", "probe"}).output; });
+    SpawnCost popened = measure(viaPopen);
+    SpawnCost forked = measure(viaFork);
+    std::printf("%s: PreparedCommand %.0f/s (p99 %.2f ms), runProcess() %.0f/s (p99 %.2f ms), "
+                "popen() %.0f/s (p99 %.2f ms), fork() + execvp() %.0f/s (p99 %.2f ms)\n",
+                label, reused.perSecond, reused.p99Ms, oneOff.perSecond, oneOff.p99Ms, popened.perSecond,
+                popened.p99Ms, forked.perSecond, forked.p99Ms);
+}
+
+int main() {
+    PreparedCommand prepared({"echo", "probe"});
+    report("small process", prepared);
+
+    std::vector<char> resident(static_cast<size_t>(RESIDENT_MB) << 20);
+    std::memset(resident.data(), 1, resident.size());
+    report(std::to_string(RESIDENT_MB).append(" MB resident").c_str(), prepared);
+    CHECK(resident[resident.size() / 2] == 1);
+    return checkResult();
+}
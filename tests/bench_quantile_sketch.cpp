@@ -0,0 +1,65 @@
+// Cost of a QuantileSketch against keeping every value and sorting: ns per add() for a
+// latency-like lognormal stream, bytes per sketch for a one-window agent sketch (240 samples,
+// 60 s at 4 Hz) and for a million samples, the encoded size, and the worst relative error
+// of its quantiles against the exact ones from the sorted values.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include "check.hpp"
+#include "quantile_sketch.hpp"
+
+#define VALUES 1000000
+#define WINDOW_SAMPLES 240
+
+static const double QUANTILES[] = {0.001, 0.01, 0.05, 0.25, 0.5, 0.75, 0.9, 0.95, 0.99, 0.999};
+
+// Worst relative error of the sketch over QUANTILES, against the sorted values
+static double worstError(const QuantileSketch& sketch, const std::vector<double>& sorted) {
+    double worst = 0.0;
+    for (double q : QUANTILES) {
+        double exact = sorted[static_cast<size_t>(q * static_cast<double>(sorted.size() - 1))];
+        worst = std::max(worst, std::fabs(sketch.quantile(q) - exact) / std::fabs(exact));
+    }
+    return worst;
+}
+
+int main() {
+    std::mt19937 random(1);
+    std::lognormal_distribution<double> latency(3.0, 2.0);
+    std::vector<double> values(VALUES);
+    for (double& value : values) value = latency(random);
+
+    QuantileSketch sketch;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (double value : values) sketch.add(value);
+    double addNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / VALUES;
+
+    // The exact way: keep the values, sort them to answer
+    start = std::chrono::steady_clock::now();
+    std::vector<double> kept;
+    for (double value : values) kept.push_back(value);
+    std::sort(kept.begin(), kept.end());
+    double exactNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / VALUES;
+
+    double error = worstError(sketch, kept);
+    CHECK(error <= SKETCH_RELATIVE_ACCURACY * (1 + 1e-9));
+    std::string encoded;
+    sketch.encode(encoded);
+
+    // One agent window: a metric moving around a level, as CPU or GPU utilization does
+    QuantileSketch window;
+    std::normal_distribution<double> utilization(60.0, 15.0);
+    for (int i = 0; i < WINDOW_SAMPLES; ++i) window.add(std::max(0.0, utilization(random)));
+    std::string windowEncoded;
+    window.encode(windowEncoded);
+
+    std::printf("add() %.1f ns (keep and sort %.1f ns per value); %d values: %zu bytes in memory (exact %zu), "
+                "%zu encoded, worst error %.3f%%; a %d-sample window: %zu bytes in memory, %zu encoded\n",
+                addNs, exactNs, VALUES, sketch.memoryBytes(), kept.capacity() * sizeof(double), encoded.size(),
+                100.0 * error, WINDOW_SAMPLES, window.memoryBytes(), windowEncoded.size());
+    return checkResult();
+}
@@ -0,0 +1,78 @@
+// 64 readers polling the shared-memory snapshot while the writer publishes every
+// millisecond, 250 times the monitor's rate: read latency, retries and torn reads.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "check.hpp"
+#include "shm_publisher.hpp"
+
+#define READERS 64
+#define PUBLISHES 2000
+
+typedef std::chrono::steady_clock Clock;
+
+int main() {
+    ShmPublisher publisher;
+    if (!publisher.ok()) {
+        std::fprintf(stderr, "skipped: shared memory unavailable or a monitor is running\n");
+        return 0;
+    }
+    StatsSnapshot snap;
+    snap.gpu.name = "bench";
+    publisher.publish(snap);
+
+    std::atomic<bool> stop(false);
+    std::atomic<long long> reads(0), busy(0), torn(0);
+    std::vector<std::vector<double>> latencies(READERS);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < READERS; ++t) {
+        readers.emplace_back([&, t] {
+            stats_shm_reader* reader = stats_shm_open();
+            if (!reader) return;
+            stats_shm_snapshot out;
+            long long n = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                Clock::time_point start = Clock::now();
+                int rc = stats_shm_read(reader, &out);
+                Clock::time_point end = Clock::now();
+                if ((n & 63) == 0) latencies[t].push_back(std::chrono::duration<double, std::nano>(end - start).count());
+                if (rc == STATS_SHM_BUSY) ++busy;
+                // The writer keeps these three equal, any difference is a torn copy
+                if (rc == STATS_SHM_OK && (out.cpu_usage != out.ram_usage || out.gpu_temperature != static_cast<unsigned>(out.cpu_usage))) ++torn;
+                ++n;
+            }
+            reads += n;
+            stats_shm_close(reader);
+        });
+    }
+
+    std::vector<double> publishNs;
+    Clock::time_point begin = Clock::now();
+    for (int i = 1; i <= PUBLISHES; ++i) {
+        snap.cpuUsage = snap.ramUsage = i;
+        snap.gpu.temperature = static_cast<unsigned int>(i);
+        Clock::time_point start = Clock::now();
+        publisher.publish(snap);
+        publishNs.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    stop = true;
+    for (std::thread& t : readers) t.join();
+
+    std::vector<double> all;
+    for (const std::vector<double>& v : latencies) all.insert(all.end(), v.begin(), v.end());
+    std::sort(all.begin(), all.end());
+    std::sort(publishNs.begin(), publishNs.end());
+    CHECK(!all.empty());
+    if (!all.empty()) {
+        std::printf("%d readers: %.1f M reads/s, read p50 %.0f ns, p99 %.0f ns, max %.0f ns\n", READERS,
+                    reads.load() / seconds / 1e6, all[all.size() / 2], all[all.size() * 99 / 100], all.back());
+    }
+    std::printf("writer: publish p50 %.0f ns, p99 %.0f ns; busy %lld, torn %lld\n", publishNs[publishNs.size() / 2],
+                publishNs[publishNs.size() * 99 / 100], busy.load(), torn.load());
+    CHECK(torn.load() == 0);
+    return checkResult();
+}
@@ -0,0 +1,128 @@
+// Bytes copied and heap allocations per tick to bring the GPU part of the snapshot up to
+// date from a parsed nvidia-smi document, before and after the change mask: a fresh GpuData
+// per tick, descriptor strings included, assigned over the snapshot's; against parseGpuData()
+// in place with the descriptor re-read once a minute and applyGpuData() copying only what
+// differs. The documents are the recorded 8-GPU one with the first GPU's temperature and
+// power moving from tick to tick, loaded beforehand, so only the update itself is measured.
+// Allocations are counted with a replacement operator new.
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "check.hpp"
+#include "gpu_fields.hpp"
+#include "pugixml.hpp"
+
+#define TICKS 24000              // 100 minutes at 4 Hz
+#define DESCRIPTOR_REFRESH 240   // As GPU_DESCRIPTOR_REFRESH_TICKS in main.cpp
+#define VARIANTS 4
+
+static std::atomic<bool> counting(false);
+static std::atomic<unsigned long long> allocations(0);
+
+void* operator new(size_t size) {
+    if (counting.load(std::memory_order_relaxed)) allocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = std::malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+typedef std::chrono::steady_clock Clock;
+
+static size_t descriptorBytes(const GpuDescriptor& gpu) {
+    return sizeof(GpuDescriptor) + gpu.name.size() + gpu.driverVersion.size() + gpu.uuid.size();
+}
+
+// Bytes applyGpuData() copied for these SNAPSHOT_CHANGED_* bits
+static size_t maskedBytes(unsigned int changed, const GpuData& gpu) {
+    size_t bytes = 0;
+    if (changed & SNAPSHOT_CHANGED_GPU_AVAILABLE) bytes += sizeof(bool);
+    if (changed & SNAPSHOT_CHANGED_GPU_DESCRIPTOR) bytes += descriptorBytes(gpu);
+    if (changed & SNAPSHOT_CHANGED_GPU_TEMP) bytes += sizeof(gpu.temperature);
+    if (changed & SNAPSHOT_CHANGED_GPU_MEM_USED) bytes += sizeof(gpu.memoryUsed);
+    if (changed & SNAPSHOT_CHANGED_GPU_UTIL) bytes += sizeof(gpu.utilizationGpu);
+    if (changed & SNAPSHOT_CHANGED_GPU_EXTENDED) bytes += sizeof(GpuExtendedCounters);
+    return bytes;
+}
+
+static void replaceFirst(std::string& text, const std::string& from, const std::string& to) {
+    size_t at = text.find(from);
+    CHECK(at != std::string::npos);
+    if (at != std::string::npos) text.replace(at, from.size(), to);
+}
+
+struct Cost {
+    double bytes;
+    double allocations;
+    double us;
+};
+
+int main() {
+    std::ifstream file("data/nvidia_smi_8gpu.xml");
+    std::stringstream content;
+    content << file.rdbuf();
+    std::vector<std::string> xml(VARIANTS, content.str());
+    pugi::xml_document docs[VARIANTS];
+    for (int v = 0; v < VARIANTS; ++v) {
+        replaceFirst(xml[v], "<gpu_temp>60 C</gpu_temp>", "<gpu_temp>" + std::to_string(60 + v) + " C</gpu_temp>");
+        replaceFirst(xml[v], "<power_draw>250.50 W</power_draw>", "<power_draw>" + std::to_string(250 + v) + " W</power_draw>");
+        CHECK(docs[v].load_buffer(xml[v].data(), xml[v].size()));
+    }
+
+    // Before: a GpuData built from scratch every tick and assigned over the snapshot's
+    Cost before;
+    {
+        StatsSnapshot snapshot;
+        unsigned long long bytes = 0;
+        allocations = 0;
+        counting = true;
+        Clock::time_point start = Clock::now();
+        for (int tick = 0; tick < TICKS; ++tick) {
+            GpuData fresh;
+            parseGpuData(docs[tick % VARIANTS], fresh, true);
+            snapshot.gpuDataAvailable = true;
+            snapshot.gpu = fresh;
+            bytes += sizeof(bool) + descriptorBytes(fresh) + sizeof(GpuCounters);
+        }
+        double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+        counting = false;
+        CHECK(snapshot.gpu.name == "NVIDIA A100-SXM4-80GB");
+        before = Cost{static_cast<double>(bytes) / TICKS, static_cast<double>(allocations) / TICKS, us / TICKS};
+    }
+
+    // After: updated in place, only what changed copied
+    Cost after;
+    {
+        StatsSnapshot snapshot;
+        GpuData data;
+        unsigned long long bytes = 0;
+        allocations = 0;
+        counting = true;
+        Clock::time_point start = Clock::now();
+        for (int tick = 0; tick < TICKS; ++tick) {
+            parseGpuData(docs[tick % VARIANTS], data, tick % DESCRIPTOR_REFRESH == 0);
+            bytes += maskedBytes(applyGpuData(snapshot, true, data, nullptr), data);
+        }
+        double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+        counting = false;
+        CHECK(snapshot.gpu.name == "NVIDIA A100-SXM4-80GB" && snapshot.gpu.generation == 1);
+        after = Cost{static_cast<double>(bytes) / TICKS, static_cast<double>(allocations) / TICKS, us / TICKS};
+    }
+    CHECK(after.bytes < before.bytes && after.allocations < before.allocations);
+
+    std::printf("GPU snapshot update per tick: before %.0f bytes copied, %.2f allocations, %.2f us; "
+                "after %.0f bytes copied, %.4f allocations, %.2f us\n",
+                before.bytes, before.allocations, before.us, after.bytes, after.allocations, after.us);
+    return checkResult();
+}
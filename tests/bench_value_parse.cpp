@@ -0,0 +1,53 @@
+// Cost of converting the values of a recorded nvidia-smi document: parseValue() against
+// std::stoul, which the GPU extraction used before, and strtod.
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "check.hpp"
+#include "pugixml.hpp"
+#include "value_parse.hpp"
+
+#define ROUNDS 20000
+
+template <typename Convert>
+static double nsPerValue(const std::vector<std::string>& values, Convert convert) {
+    volatile double sink = 0.0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int round = 0; round < ROUNDS; ++round) {
+        for (const std::string& value : values) sink = sink + convert(value);
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+           (static_cast<double>(ROUNDS) * values.size());
+}
+
+int main() {
+    std::ifstream file("data/nvidia_smi_8gpu.xml");
+    std::stringstream content;
+    content << file.rdbuf();
+    std::string xml = content.str();
+    pugi::xml_document doc;
+    CHECK(doc.load_buffer(xml.data(), xml.size()));
+
+    // The leaves std::stoul can convert, so all three are timed on the same strings
+    std::vector<std::string> values;
+    for (pugi::xpath_node leaf : doc.select_nodes("//*[not(*)]")) {
+        const char* text = leaf.node().text().get();
+        if (text[0] >= '0' && text[0] <= '9') values.push_back(text);
+    }
+    CHECK(!values.empty());
+    if (values.empty()) return checkResult();
+
+    double parse = nsPerValue(values, [](const std::string& s) {
+        double d = 0.0;
+        parseDouble(s, d);
+        return d;
+    });
+    double stoul = nsPerValue(values, [](const std::string& s) { return static_cast<double>(std::stoul(s)); });
+    double strtod = nsPerValue(values, [](const std::string& s) { return std::strtod(s.c_str(), nullptr); });
+    std::printf("%zu values: parseValue %.1f ns, std::stoul %.1f ns, strtod %.1f ns per value\n", values.size(),
+                parse, stoul, strtod);
+    return checkResult();
+}
@@ -0,0 +1,58 @@
+// Per-tick nvidia-smi parse under the pugixml build profile this program was compiled with
+// (STATS_XML_PROFILE, see pugiconfig.hpp): the time to load the document and read the GPU
+// data the way SmiGpuBackend::parse() does, and the most memory the parse took, from the
+// XML arena's high-water mark. For the recorded 8-GPU document and for its first GPU alone.
+// `make -C tests profiles` builds and runs it, and the monitor, once per profile.
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include "check.hpp"
+#include "gpu_fields.hpp"
+#include "pugixml.hpp"
+#include "xml_arena.hpp"
+
+#define ROUNDS 5000
+
+#ifdef STATS_XML_PROFILE
+#define PROFILE_NAME_STRING(name) #name
+#define PROFILE_NAME(name) PROFILE_NAME_STRING(name)
+static const char* const PROFILE = PROFILE_NAME(STATS_XML_PROFILE);
+#else
+static const char* const PROFILE = "stock";
+#endif
+
+// Parses xml ROUNDS times in us per tick, peakBytes set to the arena's high-water mark
+static double usPerParse(const std::string& xml, size_t& peakBytes) {
+    XmlArena arena;
+    GpuData data;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int round = 0; round < ROUNDS; ++round) {
+        XmlArenaScope scope(arena);
+        pugi::xml_document doc;
+        CHECK(doc.load_buffer(xml.data(), xml.size()));
+        parseGpuData(doc, data, round == 0);
+    }
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / ROUNDS;
+    CHECK(data.name == "NVIDIA A100-SXM4-80GB" && data.temperature == 60);
+    peakBytes = arena.highWaterBytes();
+    return us;
+}
+
+int main() {
+    std::ifstream file("data/nvidia_smi_8gpu.xml");
+    std::stringstream content;
+    content << file.rdbuf();
+    std::string eight = content.str();
+    size_t secondGpu = eight.find("<gpu ", eight.find("<gpu ") + 1);
+    CHECK(secondGpu != std::string::npos);
+    std::string one = eight.substr(0, secondGpu) + "</nvidia_smi_log>\n";
+
+    size_t onePeak = 0, eightPeak = 0;
+    double oneUs = usPerParse(one, onePeak);
+    double eightUs = usPerParse(eight, eightPeak);
+    std::printf("%s profile: 1 GPU %.1f us, %zu KB peak; 8 GPUs %.1f us, %zu KB peak\n", PROFILE, oneUs,
+                onePeak / 1024, eightUs, eightPeak / 1024);
+    return checkResult();
+}
@@ -0,0 +1,29 @@
+#ifndef STATS_TESTS_CHECK_HPP
+#define STATS_TESTS_CHECK_HPP
+
+#include <cstdio>
+
+// Minimal assertions for the test programs: a failed CHECK is reported and counted,
+// the test keeps going, and main() ends with return checkResult().
+inline int& checkFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                           \
+    do {                                                                           \
+        if (!(condition)) {                                                        \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            ++checkFailures();                                                     \
+        }                                                                          \
+    } while (0)
+
+inline int checkResult() {
+    if (checkFailures()) {
+        std::fprintf(stderr, "%d check(s) failed\n", checkFailures());
+        return 1;
+    }
+    return 0;
+}
+
+#endif
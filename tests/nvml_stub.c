@@ -0,0 +1,119 @@
+/*
+ * Stand-in for libnvidia-ml.so.1 with the ABI gpu_backend.cpp uses and synthetic values,
+ * loaded through STATS_NVML_LIBRARY. Built twice: libnvml_stub.so with every entry point,
+ * libnvml_stub_minimal.so (NVML_STUB_MINIMAL) with only the required ones, like old drivers.
+ * NVML_STUB_DEVICES sets the device count (default 1), NVML_STUB_INIT_FAIL makes init fail.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#define NVML_SUCCESS 0
+#define NVML_ERROR_NOT_SUPPORTED 3
+#define NVML_ERROR_DRIVER_NOT_LOADED 9
+
+typedef struct { unsigned long long total, free, used; } nvmlMemory_t;
+typedef struct { unsigned int gpu, memory; } nvmlUtilization_t;
+
+static unsigned int temperature = 60; /* Rises by one per query, so each tick is visible */
+
+int nvmlInit_v2(void) { return getenv("NVML_STUB_INIT_FAIL") ? NVML_ERROR_DRIVER_NOT_LOADED : NVML_SUCCESS; }
+int nvmlShutdown(void) { return NVML_SUCCESS; }
+
+int nvmlDeviceGetCount_v2(unsigned int* count) {
+    const char* devices = getenv("NVML_STUB_DEVICES");
+    *count = devices ? (unsigned int)atoi(devices) : 1;
+    return NVML_SUCCESS;
+}
+
+int nvmlDeviceGetHandleByIndex_v2(unsigned int index, void** device) {
+    *device = (void*)(size_t)(index + 1);
+    return NVML_SUCCESS;
+}
+
+int nvmlDeviceGetName(void* device, char* name, unsigned int length) {
+    (void)device;
+    strncpy(name, "Stub GPU 9000", length);
+    return NVML_SUCCESS;
+}
+
+int nvmlSystemGetDriverVersion(char* version, unsigned int length) {
+    strncpy(version, "999.1", length);
+    return NVML_SUCCESS;
+}
+
+int nvmlDeviceGetTemperature(void* device, int sensor, unsigned int* value) {
+    (void)device;
+    (void)sensor;
+    *value = temperature++;
+    return NVML_SUCCESS;
+}
+
+int nvmlDeviceGetMemoryInfo(void* device, nvmlMemory_t* memory) {
+    (void)device;
+    memory->total = 24ull << 30;
+    memory->used = 6ull << 30;
+    memory->free = memory->total - memory->used;
+    return NVML_SUCCESS;
+}
+
+int nvmlDeviceGetUtilizationRates(void* device, nvmlUtilization_t* utilization) {
+    (void)device;
+    utilization->gpu = 42;
+    utilization->memory = 10;
+    return NVML_SUCCESS;
+}
+
+#ifndef NVML_STUB_MINIMAL
+int nvmlDeviceGetUUID(void* device, char* uuid, unsigned int length) {
+    (void)device;
+    strncpy(uuid, "GPU-5f1b-stub", length);
+    return NVML_SUCCESS;
+}
+
+int nvmlDeviceGetPowerUsage(void* device, unsigned int* milliwatts) {
+    (void)device;
+    *milliwatts = 123456;
+    return NVML_SUCCESS;
+}
+
+int nvmlDeviceGetEnforcedPowerLimit(void* device, unsigned int* milliwatts) {
+    (void)device;
+    *milliwatts = 300000;
+    return NVML_SUCCESS;
+}
+
+int nvmlDeviceGetClockInfo(void* device, int type, unsigned int* mhz) {
+    (void)device;
+    *mhz = type == 1 ? 1800 : 9501; /* SM, memory */
+    return NVML_SUCCESS;
+}
+
+int nvmlDeviceGetPcieThroughput(void* device, int counter, unsigned int* kbPerSecond) {
+    (void)device;
+    *kbPerSecond = counter ? 2048 : 1024; /* RX, TX */
+    return NVML_SUCCESS;
+}
+
+int nvmlDeviceGetEncoderUtilization(void* device, unsigned int* utilization, unsigned int* samplingUs) {
+    (void)device;
+    *utilization = 7;
+    *samplingUs = 166667;
+    return NVML_SUCCESS;
+}
+
+/* No nvmlDeviceGetDecoderUtilization: an entry point missing from an otherwise full library */
+
+int nvmlDeviceGetTotalEccErrors(void* device, int errorType, int counterType, unsigned long long* count) {
+    (void)device;
+    (void)errorType;
+    (void)counterType;
+    (void)count;
+    return NVML_ERROR_NOT_SUPPORTED; /* As on consumer cards */
+}
+
+int nvmlDeviceGetCurrentClocksThrottleReasons(void* device, unsigned long long* reasons) {
+    (void)device;
+    *reasons = 0x41;
+    return NVML_SUCCESS;
+}
+#endif
@@ -0,0 +1,233 @@
+// 500 agents streaming into one aggregator: every sample sent is ingested, each agent shows
+// up as its own host, and the wire cost per sample is measured. Also checks that an endpoint
+// whose name does not resolve never holds up submit(), the lookup runs off the sampling path,
+// and that a sketch too wide for one frame still reaches the aggregator, with fewer bins,
+// while the sketches of a batch shed for an aggregator that stopped reading count as dropped.
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include "agent.hpp"
+#include "aggregator_process.hpp"
+#include "check.hpp"
+
+#define AGENT_PORT 19520
+#define QUERY_PORT 19521
+#define AGENTS 500
+#define ROUNDS 120 // 30 s of samples at the monitor's 4 Hz, sent back to back
+#define WIDE_AGENT_PORT 19522
+#define WIDE_QUERY_PORT 19523
+#define WIDE_MAGNITUDES 1500 // 10^-6 to 10^6, at least one per bin
+#define WIDE_ROUNDS 130      // Over 127 per bin, two varint bytes each
+#define STALLED_PORT 19524
+#define STALLED_MAX_SUBMITS 2000000
+
+typedef std::chrono::steady_clock Clock;
+
+static void testFleet() {
+    AggregatorProcess aggregator(AGENT_PORT, QUERY_PORT);
+    CHECK(aggregator.ok());
+    if (!aggregator.ok()) return;
+
+    std::vector<std::unique_ptr<AgentSender>> agents;
+    std::vector<StatsSnapshot> snaps(AGENTS);
+    for (int i = 0; i < AGENTS; ++i) {
+        agents.emplace_back(new AgentSender("127.0.0.1:" + std::to_string(AGENT_PORT), 64 * 1024, 4,
+                                            "agent-" + std::to_string(i)));
+        StatsSnapshot& snap = snaps[static_cast<size_t>(i)];
+        snap.ramUsage = 12.0 + i % 7;
+        snap.gpuDataAvailable = true;
+        snap.gpu.name = "NVIDIA A100-SXM4-80GB";
+        snap.gpu.driverVersion = "550.54.15";
+        snap.gpu.memoryTotal = 80.0;
+        snap.gpu.temperature = 45;
+    }
+    // Connect first, samples submitted before that are dropped by design
+    for (int attempt = 0; attempt < 500; ++attempt) {
+        size_t connected = 0;
+        for (auto& agent : agents) {
+            agent->pump();
+            connected += agent->connected();
+        }
+        if (connected == agents.size()) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    // Values that move like a busy node's: CPU every sample, memory and GPU now and then
+    unsigned long long timestampMs = 1700000000000ULL;
+    for (int round = 0; round < ROUNDS; ++round) {
+        timestampMs += 250;
+        for (size_t i = 0; i < agents.size(); ++i) {
+            StatsSnapshot& snap = snaps[i];
+            snap.timestampMs = timestampMs;
+            snap.cpuUsage = 50.0 + 40.0 * std::sin(round * 0.3 + static_cast<double>(i));
+            if (round % 4 == 0) snap.ramUsage += 0.01;
+            if (round % 8 == 0) snap.gpu.temperature = 45 + static_cast<unsigned int>((round + i) % 20);
+            snap.gpu.utilizationGpu = static_cast<unsigned int>(round * 7 + i) % 101;
+            snap.gpu.memoryUsed = 40.0 + (round % 16) * 0.5;
+            agents[i]->submit(snap);
+        }
+    }
+    for (int attempt = 0; attempt < 100; ++attempt) {
+        for (auto& agent : agents) agent->pump();
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    unsigned long long sent = 0, dropped = 0, bytes = 0;
+    for (auto& agent : agents) {
+        sent += agent->samplesSent();
+        dropped += agent->samplesDropped();
+        bytes += agent->bytesSent();
+    }
+    unsigned long long ingested = 0;
+    for (int attempt = 0; attempt < 200 && ingested < sent; ++attempt) {
+        ingested = aggregator.stat("samples");
+        if (ingested < sent) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    double perSample = sent ? static_cast<double>(bytes) / sent : 0.0;
+    std::printf("%d agents: %llu samples sent, %llu dropped, %llu ingested, %.2f bytes/sample "
+                "(%zu bytes in memory)\n", AGENTS, sent, dropped, ingested, perSample, sizeof(StatsSnapshot));
+    CHECK(sent == static_cast<unsigned long long>(AGENTS) * ROUNDS);
+    CHECK(dropped == 0);
+    CHECK(ingested == sent);
+    CHECK(aggregator.stat("hosts") == AGENTS);
+    CHECK(perSample < 16.0); // Deltas, HELLO and keyframes included
+}
+
+static void testUnresolvableEndpoint() {
+    AgentSender agent("no-such-host.invalid:9400");
+    StatsSnapshot snap;
+    double worstMs = 0.0;
+    for (int i = 0; i < 20; ++i) {
+        Clock::time_point start = Clock::now();
+        agent.submit(snap);
+        worstMs = std::max(worstMs, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    CHECK(!agent.connected());
+    CHECK(worstMs < 20.0);
+    std::printf("unresolvable endpoint: slowest submit() %.2f ms\n", worstMs);
+}
+
+// Reads "name=value" out of a QUANTILE reply, NaN if it is not there
+static double replyField(const std::string& reply, const std::string& name) {
+    size_t at = reply.find(" " + name + "=");
+    return at == std::string::npos ? std::nan("") : std::strtod(reply.c_str() + at + name.size() + 2, nullptr);
+}
+
+static bool within(double value, double expected, double relative) {
+    return std::fabs(value - expected) <= relative * std::fabs(expected);
+}
+
+// Temperatures of both signs over twelve decades, every bin well filled: the window's
+// thermal.max_c sketch has SKETCH_MAX_BINS bins per sign at two bytes each, more than a frame
+// holds. It goes out narrowed, and its high and low quantiles keep their accuracy.
+static void testWideSketch() {
+    AggregatorProcess aggregator(WIDE_AGENT_PORT, WIDE_QUERY_PORT);
+    CHECK(aggregator.ok());
+    if (!aggregator.ok()) return;
+    AgentSender agent("127.0.0.1:" + std::to_string(WIDE_AGENT_PORT), 64 * 1024, 4, "agent-wide");
+    for (int attempt = 0; attempt < 500 && !agent.connected(); ++attempt) {
+        agent.pump();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CHECK(agent.connected());
+
+    std::vector<double> values;
+    for (int j = 0; j < WIDE_MAGNITUDES; ++j) {
+        double magnitude = std::pow(10.0, -6.0 + 12.0 * j / WIDE_MAGNITUDES);
+        values.push_back(magnitude);
+        values.push_back(-magnitude);
+    }
+    StatsSnapshot snap;
+    snap.thermalZones.resize(1);
+    snap.timestampMs = 1700000040000ULL; // A window start
+    for (int round = 0; round < WIDE_ROUNDS; ++round) {
+        for (double value : values) {
+            snap.thermalZones[0].temperature = value;
+            agent.submit(snap);
+        }
+        // Let the aggregator drain the samples so the connection stays up
+        agent.pump();
+    }
+    for (int attempt = 0; attempt < 50; ++attempt) {
+        agent.pump();
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    // The first closes the window, the batch goes out with the fourth
+    snap.timestampMs += SKETCH_WINDOW_MS;
+    for (int i = 0; i < 4; ++i) agent.submit(snap);
+    for (int attempt = 0; attempt < 100; ++attempt) {
+        agent.pump();
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    CHECK(agent.sketchesNarrowed() == 1); // thermal.max_c, the other metrics held still
+    CHECK(agent.sketchesDropped() == 0);
+
+    std::string reply;
+    unsigned long long expected = static_cast<unsigned long long>(WIDE_ROUNDS) * values.size();
+    for (int attempt = 0; attempt < 200; ++attempt) {
+        reply = aggregator.query("QUANTILE thermal.max_c 100000000000 agent-wide");
+        if (reply.find("count=" + std::to_string(expected)) != std::string::npos) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    // Every round adds the same values, so the quantiles of one round are the window's
+    std::sort(values.begin(), values.end());
+    double p5 = values[static_cast<size_t>(0.05 * (values.size() - 1))];
+    double p99 = values[static_cast<size_t>(0.99 * (values.size() - 1))];
+    std::printf("wide sketch: %llu narrowed, %llu dropped; p5 %.2f (true %.2f), p99 %.2f (true %.2f)\n",
+                agent.sketchesNarrowed(), agent.sketchesDropped(), replyField(reply, "p5"), p5,
+                replyField(reply, "p99"), p99);
+    CHECK(reply.find("count=" + std::to_string(expected)) != std::string::npos);
+    CHECK(within(replyField(reply, "p5"), p5, 2 * SKETCH_RELATIVE_ACCURACY));
+    CHECK(within(replyField(reply, "p99"), p99, 2 * SKETCH_RELATIVE_ACCURACY));
+    CHECK(within(replyField(reply, "max"), values.back(), 1e-6));
+}
+
+// A listener that never accepts: the kernel completes the connection, then the buffers fill
+// up and every later batch is shed, sketches included
+static void testStalledAggregator() {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int small = 4096;
+    setsockopt(listener, SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(STALLED_PORT);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    CHECK(bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+    CHECK(listen(listener, 1) == 0);
+
+    AgentSender agent("127.0.0.1:" + std::to_string(STALLED_PORT), 4096, 4, "agent-stalled");
+    for (int attempt = 0; attempt < 500 && !agent.connected(); ++attempt) {
+        agent.pump();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CHECK(agent.connected());
+
+    StatsSnapshot snap;
+    snap.timestampMs = 1700000040000ULL; // A window start
+    int submits = 0;
+    for (; submits < STALLED_MAX_SUBMITS && agent.samplesDropped() == 0; ++submits) {
+        snap.cpuUsage = submits % 100;
+        agent.submit(snap);
+    }
+    CHECK(agent.samplesDropped() > 0);
+    // The first closes the window, the batch with its sketches is shed with the fourth
+    snap.timestampMs += SKETCH_WINDOW_MS;
+    for (int i = 0; i < 4; ++i) agent.submit(snap);
+    std::printf("stalled aggregator: shed after %d samples; %llu sketches sent, %llu dropped\n", submits,
+                agent.sketchesSent(), agent.sketchesDropped());
+    CHECK(agent.connected());
+    CHECK(agent.sketchesSent() == 0 && agent.sketchesDropped() > 0);
+    close(listener);
+}
+
+int main() {
+    testFleet();
+    testUnresolvableEndpoint();
+    testWideSketch();
+    testStalledAggregator();
+    return checkResult();
+}
@@ -0,0 +1,83 @@
+// Aggregator bookkeeping: sketches are stored but not counted as samples, QUANTILE takes any
+// span without wrapping around, hosts that go silent are forgotten, and a query client that
+// never reads its responses is dropped instead of growing the aggregator's memory.
+#include <cerrno>
+#include <sys/time.h>
+#include "aggregator_process.hpp"
+#include "check.hpp"
+#include "quantile_sketch.hpp"
+#include "wire_format.hpp"
+
+#define AGENT_PORT 19510
+#define QUERY_PORT 19511
+
+int main() {
+    AggregatorProcess aggregator(AGENT_PORT, QUERY_PORT, {"--shards", "2", "--expire", "1"});
+    CHECK(aggregator.ok());
+    if (!aggregator.ok()) return checkResult();
+
+    int fd = connectLocal(AGENT_PORT);
+    CHECK(fd >= 0);
+    FrameEncoder encoder;
+    std::string out;
+    encoder.encodeHello("host-a", out);
+    StatsSnapshot snap;
+    snap.cpuUsage = 25.0;
+    encoder.encodeSample(snap, out);
+    encoder.encodeSample(snap, out);
+    QuantileSketch sketch;
+    for (int i = 1; i <= 100; ++i) sketch.add(i);
+    WireSketch wire;
+    wire.metric = "cpu.usage";
+    wire.startMs = 60000; // 1970: only a span reaching back that far includes it
+    wire.windowMs = 60000;
+    sketch.encode(wire.data);
+    CHECK(encoder.encodeSketch(wire, out));
+    CHECK(sendAll(fd, out));
+
+    unsigned long long samples = 0;
+    for (int attempt = 0; attempt < 100 && samples < 2; ++attempt) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        samples = aggregator.stat("samples");
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK(aggregator.stat("samples") == 2);
+    CHECK(aggregator.stat("hosts") == 1);
+
+    // Minutes beyond the epoch clamp to everything kept instead of wrapping to nothing
+    std::string all = aggregator.query("QUANTILE cpu.usage 100000000000 host-a");
+    CHECK(all.find("count=100") != std::string::npos);
+    CHECK(aggregator.query("QUANTILE cpu.usage 99999999999999999 host-a").find("count=100") != std::string::npos);
+    CHECK(aggregator.query("QUANTILE cpu.usage 5 host-a").compare(0, 3, "ERR") == 0);
+
+    // Silent for longer than --expire: gone, sketches included
+    std::this_thread::sleep_for(std::chrono::milliseconds(2500));
+    CHECK(aggregator.stat("hosts") == 0);
+    CHECK(aggregator.stat("expired") == 1);
+    CHECK(aggregator.query("QUANTILE cpu.usage 100000000000 host-a").compare(0, 3, "ERR") == 0);
+    close(fd);
+
+    // 42 MB of error responses asked for and not read: closed past MAX_QUERY_OUTPUT (16 MB)
+    // unsent, which shows as a reset once the client reads what did arrive. The receive buffer
+    // is fixed, autotuned it would take in most of the flood.
+    int flood = connectLocal(QUERY_PORT);
+    CHECK(flood >= 0);
+    timeval timeout = {5, 0};
+    setsockopt(flood, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    int receiveBuffer = 256 * 1024;
+    setsockopt(flood, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof(receiveBuffer));
+    std::string lines;
+    for (int i = 0; i < 1000; ++i) lines += "X\n";
+    for (int i = 0; i < 500 && sendAll(flood, lines); ++i) {
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(2)); // Queries in, nothing read
+    char buffer[65536];
+    ssize_t got;
+    size_t received = 0;
+    while ((got = recv(flood, buffer, sizeof(buffer), 0)) > 0) received += static_cast<size_t>(got);
+    CHECK(got == 0 || errno == ECONNRESET); // Not EAGAIN, the timeout
+    CHECK(received < (32u << 20));
+    close(flood);
+    CHECK(aggregator.stat("hosts") == 0); // Still answering the others
+    return checkResult();
+}
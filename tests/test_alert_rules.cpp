@@ -0,0 +1,326 @@
+// Alert rules: the rules file and its errors, compile errors naming the rule, and/or
+// precedence, NaN and rates, "for" durations that fire from the deadline heap and reset when
+// the condition lapses, hysteresis through the clear condition, firing again after recovery,
+// and the log, socket and exec sinks behind the dispatcher.
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "check.hpp"
+#include "alert_rules.hpp"
+
+// Loads the rules file with this content, returns the error or "" if it loaded
+static std::string loadError(const std::string& content, AlertConfig* config = nullptr) {
+    char path[] = "/tmp/stats_alert_rules_XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    close(fd);
+    std::ofstream(path) << content;
+    setenv("STATS_ALERT_RULES", path, 1);
+    std::string error;
+    try {
+        AlertConfig loaded = loadAlertConfig();
+        if (config) *config = loaded;
+    } catch (const std::runtime_error& e) {
+        error = e.what();
+    }
+    unsetenv("STATS_ALERT_RULES");
+    unlink(path);
+    return error;
+}
+
+// Compiles a rule into the engine, returns the error or "" if it compiled
+static std::string addError(AlertEngine& engine, const std::string& condition, const std::string& clear = "") {
+    AlertRuleSpec spec;
+    spec.name = "r";
+    spec.condition = condition;
+    spec.clear = clear;
+    try {
+        engine.addRule(spec);
+    } catch (const std::runtime_error& e) {
+        return e.what();
+    }
+    return "";
+}
+
+static bool contains(const std::string& text, const std::string& part) {
+    return text.find(part) != std::string::npos;
+}
+
+static void testConfigFile() {
+    AlertConfig config;
+    CHECK(loadError("# comment\n"
+                    "\n"
+                    "rule gpu_hot gpu.temperature > 85 for 30s clear gpu.temperature < 80\n"
+                    "rule ram_climbing rate(ram.used_gb) > 0.5 and ram.percent > 80 for 1m\n"
+                    "rule quick cpu.usage>99 for 250ms\n"
+                    "sink log /var/log/stats_alerts.log\n"
+                    "sink exec /usr/local/bin/page me now\n", &config) == "");
+    CHECK(config.rules.size() == 3 && config.sinks.size() == 2);
+    if (config.rules.size() == 3 && config.sinks.size() == 2) {
+        CHECK(config.rules[0].name == "gpu_hot" && config.rules[0].condition == "gpu.temperature > 85");
+        CHECK(config.rules[0].forMs == 30000 && config.rules[0].clear == "gpu.temperature < 80");
+        CHECK(config.rules[1].condition == "rate(ram.used_gb) > 0.5 and ram.percent > 80");
+        CHECK(config.rules[1].forMs == 60000 && config.rules[1].clear.empty());
+        CHECK(config.rules[2].forMs == 250);
+        CHECK(config.sinks[1].first == "exec" && config.sinks[1].second == "/usr/local/bin/page me now");
+    }
+
+    // Errors name the file and line
+    CHECK(contains(loadError("rule a cpu.usage > 1\nalert b cpu.usage > 2\n"), ":2: expected a rule or sink line"));
+    CHECK(contains(loadError("rule a cpu.usage > 1 for soon\n"), ":1: expected a duration"));
+    CHECK(contains(loadError("rule a cpu.usage > 1 for 5d\n"), "expected a duration"));
+    CHECK(contains(loadError("rule a cpu.usage > 1 for\n"), "expected a duration"));
+    CHECK(contains(loadError("rule lonely\n"), "expected rule <name> <condition>"));
+    CHECK(contains(loadError("sink log\n"), "expected sink <log|exec|socket> <target>"));
+
+    setenv("STATS_ALERT_RULES", "/nonexistent/rules", 1);
+    bool threw = false;
+    try {
+        loadAlertConfig();
+    } catch (const std::runtime_error& e) {
+        threw = contains(e.what(), "/nonexistent/rules");
+    }
+    unsetenv("STATS_ALERT_RULES");
+    CHECK(threw);
+    CHECK(loadAlertConfig().rules.empty()); // Not set: no rules
+}
+
+static void testCompileErrors() {
+    AlertEngine engine({"a", "b"});
+    std::string error = addError(engine, "c > 1");
+    CHECK(contains(error, "Alert rule r:") && contains(error, "unknown metric \"c\", known: a, b"));
+    CHECK(contains(addError(engine, "a 1"), "expected a comparison after a"));
+    CHECK(contains(addError(engine, "a >"), "expected a number after a >"));
+    CHECK(contains(addError(engine, "a > 85C"), "expected a number"));
+    CHECK(contains(addError(engine, "(a > 1 or b > 1"), "expected \")\""));
+    CHECK(contains(addError(engine, "rate(a > 1"), "expected \")\""));
+    CHECK(contains(addError(engine, "a > 1 b > 1"), "unexpected \"b\""));
+    CHECK(contains(addError(engine, "a > 1", "a <"), "expected a number")); // In the clear condition
+    CHECK(addError(engine, "a > 1 and b > 1 and a < 5") == "");
+
+    // 33 comparisons all waiting for the last "and": deeper than the evaluation stack
+    std::string deep = "a > 0", deeper = "a > 0";
+    for (int i = 1; i < ALERT_STACK_DEPTH; ++i) deep = "a > 0 and (" + deep + ")";
+    deeper = "a > 0 and (" + deep + ")";
+    CHECK(addError(engine, deep) == "");
+    CHECK(contains(addError(engine, deeper), "nested too deeply"));
+    CHECK(engine.ruleCount() == 2); // The failed ones left nothing behind
+
+    // Code from the failed rules was rolled back: the next rule evaluates on its own
+    engine.set(0, 3.0, 1000);
+    engine.set(1, 3.0, 1000);
+    std::vector<AlertEvent> events;
+    engine.evaluate(1000, events);
+    CHECK(events.size() == 2); // Both rules hold
+}
+
+// Fires at once (no duration) for the values given; one rule over metrics a, b, c
+static bool fires(const std::string& condition, double a, double b, double c) {
+    AlertEngine engine({"a", "b", "c"});
+    CHECK(addError(engine, condition) == "");
+    double values[3] = {a, b, c};
+    for (size_t i = 0; i < 3; ++i) {
+        if (!std::isnan(values[i])) engine.set(i, values[i], 1000);
+    }
+    std::vector<AlertEvent> events;
+    engine.evaluate(1000, events);
+    return events.size() == 1 && events[0].firing;
+}
+
+static void testPrecedence() {
+    // "and" binds tighter than "or": a or (b and c)
+    CHECK(fires("a > 1 or b > 1 and c > 1", 2, 0, 0));
+    CHECK(!fires("a > 1 or b > 1 and c > 1", 0, 2, 0));
+    CHECK(fires("a > 1 or b > 1 and c > 1", 0, 2, 2));
+    CHECK(fires("b > 1 and c > 1 or a > 1", 2, 0, 0));
+    // Parentheses override it
+    CHECK(!fires("(a > 1 or b > 1) and c > 1", 2, 0, 0));
+    CHECK(fires("(a > 1 or b > 1) and c > 1", 2, 0, 2));
+    CHECK(fires("((a > 1) or (b > 1 and (c > 1)))", 0, 2, 2));
+    // Every comparison
+    CHECK(fires("a >= 2 and a <= 2 and a == 2 and a != 3 and b < 1 and c > -1", 2, 0, 0));
+    CHECK(!fires("a != 2", 2, 0, 0));
+    // A metric never set is NaN: false whichever way it is compared, "!=" included
+    CHECK(!fires("c > 1", 0, 0, NAN));
+    CHECK(!fires("c <= 1", 0, 0, NAN));
+    CHECK(!fires("c != 1", 0, 0, NAN));
+    CHECK(fires("c > 1 or a == 0", 0, 0, NAN));
+}
+
+static void testRate() {
+    AlertEngine engine({"ram"});
+    CHECK(addError(engine, "rate(ram) > 0.5") == "");
+    CHECK(engine.usesRate(0));
+    std::vector<AlertEvent> events;
+    engine.set(0, 10.0, 1000);
+    engine.evaluate(1000, events);
+    CHECK(events.empty()); // One sample, no rate yet
+    engine.set(0, 10.4, 2000);
+    engine.evaluate(2000, events);
+    CHECK(events.empty()); // 0.4 per second
+    engine.set(0, 11.0, 2500);
+    engine.evaluate(2500, events);
+    CHECK(events.size() == 1 && events[0].firing && contains(events[0].detail, "rate(ram)=1.2"));
+}
+
+// gpu_hot: above 85 for 30 s fires, resolves only below 80
+static void testDurationAndHysteresis() {
+    AlertEngine engine({"gpu.temperature", "other"});
+    AlertRuleSpec spec;
+    spec.name = "gpu_hot";
+    spec.condition = "gpu.temperature > 85";
+    spec.forMs = 30000;
+    spec.clear = "gpu.temperature < 80";
+    engine.addRule(spec);
+    std::vector<AlertEvent> events;
+    auto sample = [&](unsigned long long ms, double value) {
+        events.clear();
+        engine.set(0, value, ms);
+        engine.evaluate(ms, events);
+    };
+
+    // A burst shorter than the duration never fires, and its deadline is void afterwards
+    sample(0, 90);
+    sample(20000, 91);
+    CHECK(events.empty());
+    sample(25000, 84);
+    events.clear();
+    engine.evaluate(31000, events);
+    CHECK(events.empty());
+
+    // Held from 40 s: pending until 70 s, where the deadline fires it with no new sample
+    sample(40000, 88);
+    sample(69000, 88);
+    CHECK(events.empty());
+    unsigned long long evaluated = engine.evaluations();
+    events.clear();
+    engine.evaluate(70000, events);
+    CHECK(events.size() == 1 && events[0].firing && events[0].rule == "gpu_hot");
+    CHECK(engine.evaluations() == evaluated); // From the heap, not by re-running the rule
+    CHECK(contains(events[0].detail, "gpu.temperature > 85 (gpu.temperature=88)"));
+
+    // Between the thresholds it keeps firing, no flapping around 85
+    sample(71000, 84);
+    sample(72000, 86);
+    sample(73000, 81);
+    CHECK(events.empty());
+    sample(74000, 79.5);
+    CHECK(events.size() == 1 && !events[0].firing);
+
+    // Recovered: the next excursion goes through the duration again and fires again
+    sample(75000, 95);
+    CHECK(events.empty());
+    events.clear();
+    engine.evaluate(104999, events);
+    CHECK(events.empty());
+    engine.evaluate(105000, events);
+    CHECK(events.size() == 1 && events[0].firing);
+
+    // Only the rules reading a metric are evaluated when it is set
+    evaluated = engine.evaluations();
+    engine.set(1, 1.0, 106000);
+    events.clear();
+    engine.evaluate(106000, events);
+    CHECK(engine.evaluations() == evaluated);
+}
+
+// Without a clear condition a rule resolves as soon as its condition stops holding
+static void testResolveWithoutClear() {
+    AlertEngine engine({"vram"});
+    CHECK(addError(engine, "vram > 95") == "");
+    std::vector<AlertEvent> events;
+    double values[] = {96, 97, 94, 96, 10};
+    bool expected[] = {true, false, true, true, true}; // Event expected, then its kind below
+    bool firing[] = {true, false, false, true, false};
+    for (int i = 0; i < 5; ++i) {
+        events.clear();
+        engine.set(0, values[i], 1000 + i * 250);
+        engine.evaluate(1000 + i * 250, events);
+        CHECK(events.size() == (expected[i] ? 1u : 0u));
+        if (expected[i] && !events.empty()) CHECK(events[0].firing == firing[i]);
+    }
+}
+
+static void testSinks() {
+    AlertEvent event;
+    event.rule = "gpu_hot";
+    event.firing = true;
+    event.timeMs = 1792144800000ULL; // 2026-10-16T10:00:00Z
+    event.detail = "gpu.temperature > 85 (gpu.temperature=87)";
+    CHECK(formatAlertEvent(event) == "2026-10-16T10:00:00Z FIRING gpu_hot: gpu.temperature > 85 (gpu.temperature=87)");
+
+    char dir[] = "/tmp/stats_alert_sinks_XXXXXX";
+    CHECK(mkdtemp(dir) != nullptr);
+    std::string logPath = std::string(dir) + "/alerts.log";
+    std::string socketPath = std::string(dir) + "/alerts.sock";
+    std::string hookOut = std::string(dir) + "/hook.out";
+    std::string hookPath = std::string(dir) + "/hook.sh";
+    std::ofstream(hookPath) << "#!/bin/sh\necho \"$1 $2\" >> " << hookOut << "\n";
+    CHECK(std::system(("chmod +x " + hookPath).c_str()) == 0);
+
+    int listener = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strcpy(addr.sun_path, socketPath.c_str());
+    CHECK(bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+
+    bool unknownThrew = false;
+    try {
+        makeAlertSink("pager", "x");
+    } catch (const std::runtime_error&) {
+        unknownThrew = true;
+    }
+    CHECK(unknownThrew);
+
+    {
+        std::vector<std::unique_ptr<AlertSink>> sinks;
+        sinks.push_back(makeAlertSink("log", logPath));
+        sinks.push_back(makeAlertSink("socket", socketPath));
+        sinks.push_back(makeAlertSink("exec", hookPath));
+        AlertDispatcher dispatcher(std::move(sinks));
+        AlertEvent resolved = event;
+        resolved.firing = false;
+        resolved.timeMs += 60000;
+        dispatcher.post({event, resolved});
+        CHECK(dispatcher.dropped() == 0);
+    } // Delivers what is queued before it goes
+
+    std::ifstream log(logPath);
+    std::string first, second;
+    std::getline(log, first);
+    std::getline(log, second);
+    CHECK(first == formatAlertEvent(event));
+    CHECK(contains(second, "2026-10-16T10:01:00Z RESOLVED gpu_hot"));
+
+    char datagram[512];
+    ssize_t n = recv(listener, datagram, sizeof(datagram), MSG_DONTWAIT);
+    CHECK(n > 0 && std::string(datagram, static_cast<size_t>(n)).find("FIRING gpu_hot") != std::string::npos);
+    n = recv(listener, datagram, sizeof(datagram), MSG_DONTWAIT);
+    CHECK(n > 0 && std::string(datagram, static_cast<size_t>(n)).find("RESOLVED gpu_hot") != std::string::npos);
+    close(listener);
+
+    std::stringstream hook;
+    hook << std::ifstream(hookOut).rdbuf();
+    CHECK(hook.str() == "firing gpu_hot\nresolved gpu_hot\n");
+    std::system(("rm -rf " + std::string(dir)).c_str());
+}
+
+int main() {
+    testConfigFile();
+    testCompileErrors();
+    testPrecedence();
+    testRate();
+    testDurationAndHysteresis();
+    testResolveWithoutClear();
+    testSinks();
+    return checkResult();
+}
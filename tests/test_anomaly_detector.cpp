@@ -0,0 +1,132 @@
+// Detection accuracy of the anomaly detectors on traces with injected anomalies: spikes on
+// noisy series of very different levels are found with few false alarms, a level shift is
+// flagged and then becomes the new baseline, and flat series, warm-up and NaN are handled.
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "check.hpp"
+#include "anomaly_detector.hpp"
+#include "snapshot_metrics.hpp"
+
+#define SERIES 2000
+#define SAMPLES 400
+#define JUDGED_FROM 50       // Past the warm-up
+#define SPIKE_SIGMAS 8.0
+#define SPIKE_ODDS 100       // One sample in this many is a spike
+
+struct Accuracy {
+    size_t truePositives = 0;
+    size_t falsePositives = 0;
+    size_t positives = 0;
+    size_t negatives = 0;
+
+    double recall() const { return static_cast<double>(truePositives) / static_cast<double>(positives); }
+    double falsePositiveRate() const { return static_cast<double>(falsePositives) / static_cast<double>(negatives); }
+};
+
+// Gaussian noise around levels from 1 to 1000, deviations from 2% to 10% of the level,
+// with spikes of SPIKE_SIGMAS deviations up or down
+static void testSpikes(std::mt19937& random) {
+    AnomalyDetectors detectors(SERIES);
+    std::normal_distribution<double> noise(0.0, 1.0);
+    std::vector<double> level(SERIES), sigma(SERIES);
+    for (size_t s = 0; s < SERIES; ++s) {
+        level[s] = 1.0 + random() % 1000;
+        sigma[s] = level[s] * 0.02 * (1 + random() % 5);
+    }
+    Accuracy ewma, mad, either;
+    for (size_t t = 0; t < SAMPLES; ++t) {
+        for (size_t s = 0; s < SERIES; ++s) {
+            double value = level[s] + sigma[s] * noise(random);
+            bool spike = t >= JUDGED_FROM && random() % SPIKE_ODDS == 0;
+            if (spike) value += (random() % 2 ? SPIKE_SIGMAS : -SPIKE_SIGMAS) * sigma[s];
+            unsigned int flags = detectors.update(s, value);
+            if (t < JUDGED_FROM) {
+                CHECK(t >= ANOMALY_WARMUP || flags == 0);
+                continue;
+            }
+            Accuracy* accuracies[3] = {&ewma, &mad, &either};
+            bool flagged[3] = {(flags & ANOMALY_EWMA) != 0, (flags & ANOMALY_MAD) != 0, flags != 0};
+            for (int i = 0; i < 3; ++i) {
+                (spike ? accuracies[i]->positives : accuracies[i]->negatives)++;
+                if (flagged[i]) (spike ? accuracies[i]->truePositives : accuracies[i]->falsePositives)++;
+            }
+        }
+    }
+    std::printf("spikes of %.0f sigma: ewma recall %.3f fpr %.5f, mad recall %.3f fpr %.5f, either recall %.3f fpr %.5f\n",
+                SPIKE_SIGMAS, ewma.recall(), ewma.falsePositiveRate(), mad.recall(), mad.falsePositiveRate(),
+                either.recall(), either.falsePositiveRate());
+    CHECK(ewma.recall() >= 0.90 && ewma.falsePositiveRate() <= 0.001);
+    CHECK(mad.recall() >= 0.95 && mad.falsePositiveRate() <= 0.001);
+    CHECK(either.recall() >= 0.98 && either.falsePositiveRate() <= 0.002);
+}
+
+// A step from 100 to 150: flagged when it happens, accepted as the new level soon after
+static void testLevelShift(std::mt19937& random) {
+    AnomalyDetectors detectors(1);
+    std::normal_distribution<double> noise(0.0, 2.0);
+    for (int t = 0; t < 200; ++t) detectors.update(0, 100.0 + noise(random));
+    CHECK(detectors.update(0, 150.0 + noise(random)) == (ANOMALY_EWMA | ANOMALY_MAD));
+    int lastFlag = 0;
+    for (int t = 1; t < 300; ++t) {
+        if (detectors.update(0, 150.0 + noise(random))) lastFlag = t;
+    }
+    std::printf("level shift: flagged for %d samples\n", lastFlag);
+    CHECK(lastFlag < 100);
+}
+
+// A perfectly flat series tolerates ANOMALY_MIN_SCALE_FRACTION of its level
+static void testFlatSeries() {
+    AnomalyDetectors detectors(1);
+    for (int t = 0; t < 100; ++t) detectors.update(0, 50.0);
+    CHECK(detectors.update(0, 50.5) == 0); // 1%, within the floor
+    CHECK(detectors.update(0, 50.0) == 0);
+    CHECK(detectors.update(0, 60.0) == (ANOMALY_EWMA | ANOMALY_MAD));
+}
+
+static void testWarmupAndNaN() {
+    AnomalyDetectors detectors(2);
+    for (int t = 0; t < ANOMALY_WARMUP - 1; ++t) {
+        CHECK(detectors.update(0, t % 2 ? 1.0 : 1e6) == 0); // Wild, but still warming up
+        CHECK(detectors.update(1, std::nan("")) == 0);
+    }
+    // Series 1 only had NaN, so it is still warming up; series 0 has its samples now
+    for (int t = 0; t < ANOMALY_WARMUP - 1; ++t) CHECK(detectors.update(1, 10.0) == 0);
+    CHECK(detectors.update(1, 10.0) == 0);
+    CHECK(detectors.update(1, 1000.0) != 0);
+}
+
+// The snapshot side: a CPU spike flags cpu.usage, and the flag clears with the next normal sample
+static void testSnapshotAnomalies(std::mt19937& random) {
+    size_t cpuMetric = SNAPSHOT_METRIC_COUNT;
+    for (size_t i = 0; i < SNAPSHOT_METRIC_COUNT; ++i) {
+        if (std::strcmp(snapshotMetric(i).name, "cpu.usage") == 0) cpuMetric = i;
+    }
+    CHECK(cpuMetric < SNAPSHOT_METRIC_COUNT);
+    if (cpuMetric == SNAPSHOT_METRIC_COUNT) return;
+
+    SnapshotAnomalies anomalies;
+    std::normal_distribution<double> noise(0.0, 1.0);
+    StatsSnapshot snap;
+    snap.changed = SNAPSHOT_CHANGED_CPU;
+    for (int t = 0; t < 100; ++t) {
+        snap.cpuUsage = 20.0 + noise(random);
+        anomalies.update(snap);
+    }
+    snap.cpuUsage = 95.0;
+    unsigned long long flagged = anomalies.update(snap);
+    CHECK(flagged == 1ULL << cpuMetric);
+    snap.cpuUsage = 20.0;
+    CHECK(anomalies.update(snap) == 0);
+}
+
+int main() {
+    std::mt19937 random(49);
+    testSpikes(random);
+    testLevelShift(random);
+    testFlatSeries();
+    testWarmupAndNaN();
+    testSnapshotAnomalies(random);
+    return checkResult();
+}
@@ -0,0 +1,153 @@
+// runProcessAsync() and ReactorCollector against slow fake children: probes run concurrently
+// on one reactor, and deadlines, cancellation, output limits and children that close their
+// output early all end the way runProcess() ends them. Needs -std=c++20.
+#include <atomic>
+#include <thread>
+#include "async_io.hpp"
+#include "check.hpp"
+
+#ifdef STATS_ASYNC_IO
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static ProcessResult runAsync(std::vector<std::string> argv, ProcessOptions options = ProcessOptions()) {
+    Reactor reactor;
+    ProcessResult result;
+    auto task = [&](Reactor& r) -> Task<void> { result = co_await runProcessAsync(r, argv, options); };
+    reactor.spawn(task(reactor));
+    reactor.run();
+    return result;
+}
+
+// A probe that runs a shell command and reports its output, prepared once like AsyncGpuCollector
+class ShellProbe : public AsyncCollector {
+public:
+    ShellProbe(const char* name, const char* script) : name_(name), command_({"/bin/sh", "-c", script}) {}
+    const char* name() const { return name_; }
+    Task<void> collect(Reactor& reactor) {
+        co_await runProcessAsync(reactor, command_);
+        const ProcessResult& result = command_.result();
+        if (result.status != ProcessResult::EXITED || result.exitCode != 0) {
+            throw std::runtime_error(name_ + std::string(" failed"));
+        }
+        output_ = command_.output();
+        outputData_.push_back(command_.output().data());
+    }
+    unsigned int apply(StatsSnapshot&) { return applied_ = 1; }
+
+    std::string output_;
+    std::vector<const char*> outputData_; // Where each tick's output was read to
+    unsigned int applied_ = 0;
+
+private:
+    const char* name_;
+    PreparedCommand command_;
+};
+
+static void testProbesOverlap() {
+    ReactorCollector collector("probes", 250);
+    ShellProbe* a = new ShellProbe("a", "sleep 0.3; echo a");
+    ShellProbe* b = new ShellProbe("b", "sleep 0.3; echo b");
+    ShellProbe* failing = new ShellProbe("failing", "sleep 0.1; exit 1");
+    collector.add(std::unique_ptr<AsyncCollector>(a));
+    collector.add(std::unique_ptr<AsyncCollector>(b));
+    collector.add(std::unique_ptr<AsyncCollector>(failing));
+    for (int tick = 0; tick < 2; ++tick) {
+        Clock::time_point start = Clock::now();
+        collector.collect();
+        double ms = elapsedMs(start);
+        CHECK(ms < 550.0); // The slowest probe, not the sum of them
+        std::printf("three probes of 300, 300 and 100 ms: tick %d took %.0f ms\n", tick, ms);
+    }
+    StatsSnapshot snap;
+    CHECK(collector.apply(snap) == 1);
+    CHECK(a->output_ == "a\n" && b->output_ == "b\n");
+    CHECK(a->applied_ && b->applied_ && !failing->applied_); // A failed probe is not applied
+    CHECK(a->outputData_.size() == 2 && a->outputData_[0] == a->outputData_[1]); // Buffer reused between ticks
+}
+
+static void testOutputInPieces() {
+    ProcessResult r = runAsync({"/bin/sh", "-c", "echo first; sleep 0.2; echo second; exit 4"});
+    CHECK(r.status == ProcessResult::EXITED);
+    CHECK(r.exitCode == 4);
+    CHECK(r.output == "first\nsecond\n");
+}
+
+static void testTimeout() {
+    ProcessOptions options;
+    options.timeoutMs = 200;
+    Clock::time_point start = Clock::now();
+    ProcessResult r = runAsync({"sleep", "5"}, options);
+    double ms = elapsedMs(start);
+    CHECK(r.status == ProcessResult::TIMED_OUT);
+    CHECK(ms >= 190.0 && ms < 1000.0);
+}
+
+// Closes its output and keeps running: waited for through the pidfd, not the pipe
+static void testClosedOutput() {
+    Clock::time_point start = Clock::now();
+    ProcessResult r = runAsync({"/bin/sh", "-c", "echo early; exec >&- 2>&-; sleep 0.3; exit 3"});
+    CHECK(r.status == ProcessResult::EXITED);
+    CHECK(r.exitCode == 3);
+    CHECK(r.output == "early\n");
+    CHECK(elapsedMs(start) >= 290.0);
+
+    // Same with the deadline passing while only the exit is awaited
+    ProcessOptions options;
+    options.timeoutMs = 200;
+    r = runAsync({"/bin/sh", "-c", "exec >&- 2>&-; sleep 5"}, options);
+    CHECK(r.status == ProcessResult::TIMED_OUT);
+}
+
+static void testCancel() {
+    std::atomic<bool> cancel(false);
+    ProcessOptions options;
+    options.timeoutMs = 5000;
+    options.cancel = &cancel;
+    std::thread canceller([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        cancel = true;
+    });
+    Clock::time_point start = Clock::now();
+    ProcessResult r = runAsync({"sleep", "5"}, options);
+    canceller.join();
+    CHECK(r.status == ProcessResult::CANCELLED);
+    CHECK(elapsedMs(start) < 1000.0);
+}
+
+static void testOutputLimit() {
+    ProcessOptions options;
+    options.maxOutputBytes = 4096;
+    ProcessResult r = runAsync({"yes"}, options);
+    CHECK(r.status == ProcessResult::OUTPUT_LIMIT);
+}
+
+static void testSpawnFailure() {
+    ProcessResult r = runAsync({"/nonexistent/nvidia-smi", "-q", "-x"});
+    CHECK(r.status == ProcessResult::SPAWN_FAILED);
+    CHECK(!r.error.empty());
+}
+
+int main() {
+    testProbesOverlap();
+    testOutputInPieces();
+    testTimeout();
+    testClosedOutput();
+    testCancel();
+    testOutputLimit();
+    testSpawnFailure();
+    return checkResult();
+}
+
+#else
+
+int main() {
+    std::fprintf(stderr, "skipped: built without coroutine support (needs -std=c++20)\n");
+    return 0;
+}
+
+#endif
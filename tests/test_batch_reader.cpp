@@ -0,0 +1,184 @@
+// BatchFileReader when io_uring_enter() fails part way, injected by interposing syscall()
+// and pread(): reads still in flight (from pipes, which block until written) are waited for
+// and never redone with pread, only the reads the kernel did not take are, and if even
+// waiting fails the reads in flight are reported as failed instead of being read again
+// into buffers the kernel may still fill.
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "check.hpp"
+#include "proc_reader.hpp"
+
+#define FILES 40
+#define PIPES 16 // Also the queue depth
+
+enum Fault {
+    FAULT_NONE,
+    FAULT_AFTER_SUBMIT,    // The batch is submitted, then waiting for it fails once
+    FAULT_BEFORE_SUBMIT,   // Nothing is submitted
+    FAULT_WAIT_TOO         // Submitted, and every wait for it fails
+};
+
+static Fault fault = FAULT_NONE;
+static int preads = 0;
+
+typedef long (*SyscallFn)(long, ...);
+typedef ssize_t (*PreadFn)(int, void*, size_t, off_t);
+
+extern "C" long syscall(long number, ...) {
+    static SyscallFn next = reinterpret_cast<SyscallFn>(dlsym(RTLD_NEXT, "syscall"));
+    va_list args;
+    va_start(args, number);
+    long a[6];
+    for (int i = 0; i < 6; ++i) a[i] = va_arg(args, long);
+    va_end(args);
+#ifdef __NR_io_uring_enter
+    if (number == __NR_io_uring_enter && fault != FAULT_NONE) {
+        static bool failedOnce = false;
+        if (fault == FAULT_BEFORE_SUBMIT) {
+            errno = EIO;
+            return -1;
+        }
+        if (a[1] > 0) {
+            failedOnce = false;
+            return next(number, a[0], a[1], 0, 0, nullptr, 0); // Submitted, returns before completion
+        }
+        // The wait after a submission fails, as io_uring_enter() reports errors only when it submitted nothing
+        if (fault == FAULT_WAIT_TOO || !failedOnce) {
+            failedOnce = true;
+            errno = fault == FAULT_WAIT_TOO ? ENXIO : EIO;
+            return -1;
+        }
+    }
+#endif
+    return next(number, a[0], a[1], a[2], a[3], a[4], a[5]);
+}
+
+extern "C" ssize_t pread(int fd, void* buffer, size_t size, off_t offset) {
+    static PreadFn next = reinterpret_cast<PreadFn>(dlsym(RTLD_NEXT, "pread"));
+    ++preads;
+    return next(fd, buffer, size, offset);
+}
+
+extern "C" ssize_t pread64(int fd, void* buffer, size_t size, off_t offset) {
+    return pread(fd, buffer, size, offset);
+}
+
+// The first PIPES reads are from pipes, which stay in flight until written to, the rest from files
+struct Files {
+    std::string dir;
+    std::vector<int> fds;
+    std::vector<int> pipeWriters;
+    std::vector<std::string> contents;
+    char buffers[FILES][64];
+
+    Files() {
+        char name[] = "/tmp/stats_batch_reader_XXXXXX";
+        dir = mkdtemp(name) ? name : "";
+        for (int i = 0; i < FILES; ++i) {
+            std::string content = (i < PIPES ? "pipe " : "file ") + std::to_string(i) + " " + std::string(i % 7, 'x');
+            int fd;
+            if (i < PIPES) {
+                int ends[2];
+                CHECK(pipe2(ends, O_CLOEXEC) == 0);
+                fd = ends[0];
+                pipeWriters.push_back(ends[1]);
+            } else {
+                std::string path = dir + "/" + std::to_string(i);
+                fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+                CHECK(fd >= 0 && write(fd, content.data(), content.size()) == static_cast<ssize_t>(content.size()));
+            }
+            fds.push_back(fd);
+            contents.push_back(content);
+        }
+    }
+    ~Files() {
+        for (int i = 0; i < FILES; ++i) {
+            close(fds[i]);
+            if (i < PIPES) {
+                close(pipeWriters[i]);
+            } else {
+                unlink((dir + "/" + std::to_string(i)).c_str());
+            }
+        }
+        rmdir(dir.c_str());
+    }
+
+    void queue(BatchFileReader& reader) {
+        reader.clear();
+        std::memset(buffers, 0, sizeof(buffers));
+        for (int i = 0; i < FILES; ++i) reader.add(fds[i], buffers[i], sizeof(buffers[i]));
+    }
+
+    // The pipe reads complete a while after the batch was submitted
+    std::thread writePipesLater() {
+        return std::thread([this] {
+            usleep(50000);
+            for (int i = 0; i < PIPES; ++i) {
+                CHECK(write(pipeWriters[i], contents[i].data(), contents[i].size()) ==
+                      static_cast<ssize_t>(contents[i].size()));
+            }
+        });
+    }
+
+    bool readBack(const BatchFileReader& reader, int i) const {
+        return reader.result(i) == static_cast<long>(contents[i].size()) &&
+               std::string(buffers[i], contents[i].size()) == contents[i];
+    }
+};
+
+// Runs one batch of FILES reads on a fresh ring (queue depth PIPES, so the pipes are the first
+// submission) with the fault injected from the start; returns the preads it took
+static int runWithFault(Files& files, Fault injected, bool writePipes, BatchFileReader*& kept) {
+    BatchFileReader* reader = new BatchFileReader(PIPES);
+    kept = reader;
+    if (!reader->usingIoUring()) return -1;
+    files.queue(*reader);
+    std::thread writer;
+    if (writePipes) writer = files.writePipesLater();
+    preads = 0;
+    fault = injected;
+    reader->run();
+    fault = FAULT_NONE;
+    if (writer.joinable()) writer.join();
+    CHECK(!reader->usingIoUring()); // Closed after the failure
+    return preads;
+}
+
+int main() {
+    Files files;
+    BatchFileReader* reader = nullptr;
+
+    int n = runWithFault(files, FAULT_AFTER_SUBMIT, true, reader);
+    if (n < 0) {
+        std::printf("io_uring not available here, nothing to test\n");
+        delete reader;
+        return checkResult();
+    }
+    // The pipe reads in flight were waited for, only the unsubmitted file reads done with pread
+    CHECK(n == FILES - PIPES);
+    for (int i = 0; i < FILES; ++i) CHECK(files.readBack(*reader, i));
+    delete reader;
+
+    n = runWithFault(files, FAULT_BEFORE_SUBMIT, false, reader);
+    CHECK(n == FILES); // Nothing was in flight, everything is read with pread, which pipes refuse
+    for (int i = 0; i < PIPES; ++i) CHECK(reader->result(i) == -ESPIPE);
+    for (int i = PIPES; i < FILES; ++i) CHECK(files.readBack(*reader, i));
+    delete reader;
+
+    // Waiting fails too: the pipe reads are given up on, never redone into their buffers
+    n = runWithFault(files, FAULT_WAIT_TOO, false, reader);
+    CHECK(n == FILES - PIPES);
+    for (int i = 0; i < PIPES; ++i) CHECK(reader->result(i) == -EIO);
+    for (int i = PIPES; i < FILES; ++i) CHECK(files.readBack(*reader, i));
+    delete reader;
+    return checkResult();
+}
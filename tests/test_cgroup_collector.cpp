@@ -0,0 +1,132 @@
+// The cgroup collector on a fake cgroup2 tree written by the test: rates from cpu.stat and
+// io.stat deltas, cgroups without some controller files, only leaves ranked, and cgroups
+// created and removed between ticks picked up through inotify.
+// Rates depend on the time between ticks, so they are checked through time-free ratios.
+#include <unistd.h>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include "cgroup_collector.hpp"
+#include "check.hpp"
+
+// Writes content to path in place, creating the directories; open descriptors see the new content
+static void writeFile(const std::string& path, const std::string& content) {
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+    std::ofstream(path, std::ios::trunc) << content;
+}
+
+static bool near(double value, double expected) {
+    return std::fabs(value - expected) <= 1e-9 * std::fabs(expected);
+}
+
+static std::string cpuStat(unsigned long long usageUsec, unsigned long long throttledUsec) {
+    return "usage_usec " + std::to_string(usageUsec) + "\nuser_usec " + std::to_string(usageUsec / 2) +
+           "\nsystem_usec " + std::to_string(usageUsec / 2) + "\nnr_periods 0\nnr_throttled 0\nthrottled_usec " +
+           std::to_string(throttledUsec) + "\n";
+}
+
+// Two devices, their bytes add up
+static std::string ioStat(unsigned long long readBytes, unsigned long long writeBytes) {
+    return "8:0 rbytes=" + std::to_string(readBytes) + " wbytes=" + std::to_string(writeBytes) +
+           " rios=10 wios=10 dbytes=0 dios=0\n259:0 rbytes=" + std::to_string(readBytes) +
+           " wbytes=0 rios=1 wios=0 dbytes=0 dios=0\n";
+}
+
+static void writeGroup(const std::string& dir, unsigned long long usageUsec, unsigned long long throttledUsec,
+                       unsigned long long memoryBytes, unsigned long long readBytes, unsigned long long writeBytes) {
+    writeFile(dir + "/cpu.stat", cpuStat(usageUsec, throttledUsec));
+    writeFile(dir + "/memory.current", std::to_string(memoryBytes) + "\n");
+    writeFile(dir + "/io.stat", ioStat(readBytes, writeBytes));
+}
+
+static const CgroupSample* find(const StatsSnapshot& snapshot, const std::string& path) {
+    for (const CgroupSample& sample : snapshot.cgroups) {
+        if (sample.path == path) return &sample;
+    }
+    return nullptr;
+}
+
+int main() {
+    char dir[] = "/tmp/stats_cgroup_XXXXXX";
+    CHECK(mkdtemp(dir) != nullptr);
+    std::string root = dir;
+
+    // The root has no memory.current, user.slice no io controller; the slices are not leaves
+    writeFile(root + "/cgroup.controllers", "cpu io memory\n");
+    writeFile(root + "/cpu.stat", cpuStat(1000000, 0));
+    writeFile(root + "/io.stat", ioStat(0, 0));
+    writeFile(root + "/system.slice/cpu.stat", cpuStat(500000, 0));
+    writeFile(root + "/system.slice/memory.current", "0\n");
+    writeGroup(root + "/system.slice/a.service", 100000, 0, 64 << 20, 0, 0);
+    writeGroup(root + "/system.slice/b.service", 200000, 0, 32 << 20, 0, 0);
+    writeFile(root + "/user.slice/cpu.stat", cpuStat(300000, 0));
+    writeFile(root + "/user.slice/memory.current", std::to_string(16 << 20) + "\n");
+
+    CgroupCollector collector(250, root);
+    StatsSnapshot snapshot;
+    collector.collect();
+    CHECK(collector.apply(snapshot) == SNAPSHOT_CHANGED_CGROUPS);
+    CHECK(snapshot.cgroupCount == 5);
+    CHECK(snapshot.cgroups.size() == 3); // The leaves only
+    CHECK(find(snapshot, "system.slice") == nullptr && find(snapshot, "/") == nullptr);
+    // No deltas yet: ranked by memory
+    CHECK(snapshot.cgroups.size() == 3 && snapshot.cgroups[0].path == "system.slice/a.service");
+    CHECK(snapshot.cgroups.size() == 3 && snapshot.cgroups[0].memoryMb == 64.0 && snapshot.cgroups[0].cpuUsage == 0.0);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    // b used twice the CPU of a and was throttled for a quarter of it; a read 1 MB from each
+    // device and wrote 3 MB; user.slice used a tenth of a's CPU
+    writeGroup(root + "/system.slice/a.service", 100000 + 20000, 0, 64 << 20, 1 << 20, 3 << 20);
+    writeGroup(root + "/system.slice/b.service", 200000 + 40000, 10000, 32 << 20, 0, 0);
+    writeFile(root + "/user.slice/cpu.stat", cpuStat(300000 + 2000, 0));
+    collector.collect();
+    CHECK(collector.apply(snapshot) == SNAPSHOT_CHANGED_CGROUPS);
+    const CgroupSample* a = find(snapshot, "system.slice/a.service");
+    const CgroupSample* b = find(snapshot, "system.slice/b.service");
+    const CgroupSample* user = find(snapshot, "user.slice");
+    CHECK(a && b && user);
+    if (a && b && user) {
+        CHECK(snapshot.cgroups[0].path == "system.slice/b.service"); // Busiest first
+        CHECK(a->cpuUsage > 0.0 && near(b->cpuUsage, 2 * a->cpuUsage));
+        CHECK(near(b->throttledPercent, b->cpuUsage / 4));
+        CHECK(near(user->cpuUsage, a->cpuUsage / 10));
+        CHECK(near(a->readBytesPerSec, a->cpuUsage * (1 << 20))); // 2 MB in the time a used 20 ms of CPU
+        CHECK(near(a->writeBytesPerSec, a->readBytesPerSec * 3 / 2));
+        CHECK(user->readBytesPerSec == 0.0 && user->memoryMb == 16.0);
+    }
+
+    // A cgroup created, then one removed; inotify brings both in on the next tick
+    writeGroup(root + "/system.slice/c.service", 0, 0, 1 << 20, 0, 0);
+    collector.collect();
+    collector.apply(snapshot);
+    CHECK(snapshot.cgroupCount == 6);
+    const CgroupSample* c = find(snapshot, "system.slice/c.service");
+    CHECK(c && c->cpuUsage == 0.0 && c->memoryMb == 1.0);
+
+    std::filesystem::remove_all(root + "/system.slice/a.service");
+    collector.collect();
+    collector.apply(snapshot);
+    CHECK(snapshot.cgroupCount == 5);
+    CHECK(find(snapshot, "system.slice/a.service") == nullptr);
+    CHECK(find(snapshot, "system.slice/b.service") != nullptr);
+
+    // A steady tick with nothing changed changes nothing in the snapshot once the rates are zero
+    collector.collect();
+    collector.apply(snapshot);
+    collector.collect();
+    CHECK(collector.apply(snapshot) == 0);
+
+    // No cgroup2 mount: nothing to show
+    CgroupCollector missing(250, root + "/nonexistent");
+    missing.collect();
+    StatsSnapshot empty;
+    missing.apply(empty);
+    CHECK(empty.cgroupCount == 0 && empty.cgroups.empty());
+
+    std::filesystem::remove_all(dir);
+    return checkResult();
+}
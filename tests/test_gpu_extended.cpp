@@ -0,0 +1,100 @@
+// parseGpuData() and parseGpuExtended() on the recorded 8-GPU nvidia-smi document
+// (data/nvidia_smi_8gpu.xml), and on hand-written documents in the layouts of older and
+// newer drivers: renamed power and throttle sections, single/double bit ECC totals, "N/A".
+#include <fstream>
+#include <sstream>
+#include <string>
+#include "check.hpp"
+#include "gpu_fields.hpp"
+#include "pugixml.hpp"
+
+static std::string readFile(const std::string& path) {
+    std::ifstream file(path);
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+// Every GPU of the recording differs from the previous one by one step in most fields
+static void testEightGpus() {
+    std::string xml = readFile("data/nvidia_smi_8gpu.xml");
+    pugi::xml_document doc;
+    CHECK(doc.load_buffer(xml.data(), xml.size()));
+    unsigned int index = 0;
+    for (pugi::xml_node gpu = doc.child("nvidia_smi_log").child("gpu"); gpu; gpu = gpu.next_sibling("gpu"), ++index) {
+        GpuExtendedCounters out;
+        parseGpuExtended(gpu, out);
+        CHECK(out.pcieRx == 3400.0 + index && out.pcieTx == 1200.0 + index);
+        CHECK(out.utilizationEncoder == index && out.utilizationDecoder == 0);
+        CHECK(out.powerDraw == 250.5 + index && out.powerLimit == 400.0);
+        CHECK(out.smClock == 1410 - index && out.memoryClock == 1593); // Not the max_clocks after them
+        CHECK(out.eccCorrected == index && out.eccUncorrected == 0);   // Volatile counts, not aggregate
+        CHECK(out.throttleReasons == (index == 3 ? GPU_THROTTLE_SW_POWER_CAP : 0u)); // The others all "Not Active"
+    }
+    CHECK(index == 8);
+
+    GpuData data;
+    parseGpuData(doc, data, true);
+    CHECK(data.name == "NVIDIA A100-SXM4-80GB" && data.driverVersion == "550.54.15");
+    CHECK(data.uuid == "GPU-00000000-1111-2222-3333-444455556666");
+    CHECK(data.memoryTotal == 80.0 && data.memoryUsed == 20000.0 / 1024);
+    CHECK(data.temperature == 60 && data.utilizationGpu == 50);
+    CHECK(data.extended.powerDraw == 250.5 && data.extended.smClock == 1410);
+    CHECK(data.generation == 1);
+    parseGpuData(doc, data, true);
+    CHECK(data.generation == 1); // Same descriptor
+}
+
+// Drivers before 530: clocks_throttle_reasons, power_readings, single_bit/double_bit totals
+static void testOlderDriver() {
+    const char* xml =
+        "<nvidia_smi_log><gpu>"
+        "<clocks_throttle_reasons>"
+        "<clocks_throttle_reason_gpu_idle>Not Active</clocks_throttle_reason_gpu_idle>"
+        "<clocks_throttle_reason_sw_power_cap>Active</clocks_throttle_reason_sw_power_cap>"
+        "<clocks_throttle_reason_hw_slowdown>Active</clocks_throttle_reason_hw_slowdown>"
+        "<clocks_throttle_reason_some_future_reason>Active</clocks_throttle_reason_some_future_reason>"
+        "</clocks_throttle_reasons>"
+        "<ecc_errors><volatile>"
+        "<single_bit><device_memory>3</device_memory><total>5</total></single_bit>"
+        "<double_bit><device_memory>1</device_memory><total>2</total></double_bit>"
+        "</volatile></ecc_errors>"
+        "<power_readings><power_draw>70.25 W</power_draw><power_limit>150.00 W</power_limit></power_readings>"
+        "<utilization><encoder_util>N/A</encoder_util><decoder_util>12 %</decoder_util></utilization>"
+        "</gpu></nvidia_smi_log>";
+    pugi::xml_document doc;
+    CHECK(doc.load_string(xml));
+    GpuExtendedCounters out;
+    parseGpuExtended(doc.child("nvidia_smi_log").child("gpu"), out);
+    CHECK(out.throttleReasons == (GPU_THROTTLE_SW_POWER_CAP | GPU_THROTTLE_HW_SLOWDOWN));
+    CHECK(out.eccCorrected == 5 && out.eccUncorrected == 2);
+    CHECK(out.powerDraw == 70.25 && out.powerLimit == 150.0);
+    CHECK(out.utilizationEncoder == 0 && out.utilizationDecoder == 12);
+    CHECK(out.pcieRx == 0.0 && out.smClock == 0); // Sections that are missing
+}
+
+// Newer drivers: instant_power_draw and enforced_power_limit, ECC not supported
+static void testNewerDriver() {
+    const char* xml =
+        "<nvidia_smi_log><gpu>"
+        "<gpu_power_readings><instant_power_draw>301.00 W</instant_power_draw>"
+        "<enforced_power_limit>700.00 W</enforced_power_limit></gpu_power_readings>"
+        "<clocks_event_reasons><clocks_event_reason_sw_thermal_slowdown>Active</clocks_event_reason_sw_thermal_slowdown>"
+        "<clocks_event_reason_gpu_idle>Active</clocks_event_reason_gpu_idle></clocks_event_reasons>"
+        "<ecc_errors><volatile><sram_correctable>N/A</sram_correctable><dram_uncorrectable>4</dram_uncorrectable></volatile></ecc_errors>"
+        "</gpu></nvidia_smi_log>";
+    pugi::xml_document doc;
+    CHECK(doc.load_string(xml));
+    GpuExtendedCounters out;
+    parseGpuExtended(doc.child("nvidia_smi_log").child("gpu"), out);
+    CHECK(out.powerDraw == 301.0 && out.powerLimit == 700.0);
+    CHECK(out.throttleReasons == (GPU_THROTTLE_SW_THERMAL | GPU_THROTTLE_IDLE));
+    CHECK(out.eccCorrected == 0 && out.eccUncorrected == 4);
+}
+
+int main() {
+    testEightGpus();
+    testOlderDriver();
+    testNewerDriver();
+    return checkResult();
+}
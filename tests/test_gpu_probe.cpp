@@ -0,0 +1,66 @@
+// The monitor's GPU probe end to end, against a fake nvidia-smi that is slow, or hangs:
+// the data arrives through the reactor (the "probes" collector of the C++20 build), and a
+// hung nvidia-smi is killed at its deadline while the rest of the stats keep coming.
+#include <stdlib.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include "async_io.hpp"
+#include "check.hpp"
+
+static std::string readAll(const std::string& path) {
+    std::ifstream file(path);
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+static size_t countOf(const std::string& text, const std::string& what) {
+    size_t count = 0;
+    for (size_t at = text.find(what); at != std::string::npos; at = text.find(what, at + 1)) ++count;
+    return count;
+}
+
+// Runs the monitor for a while with nvidia-smi (and no NVML) replaced by a script that runs
+// prelude, then prints a one-GPU document; stdout and stderr are returned
+static void runMonitor(const std::string& dir, const char* prelude, double runSeconds, std::string& out, std::string& err) {
+    std::ofstream script(dir + "/nvidia-smi");
+    script << "#!/bin/sh\n" << prelude << "\n"
+           << "echo '<?xml version=\"1.0\" ?><nvidia_smi_log><driver_version>550.54.15</driver_version>"
+              "<gpu><product_name>Fake GPU</product_name><uuid>GPU-0</uuid>"
+              "<fb_memory_usage><total>81920 MiB</total><used>1024 MiB</used></fb_memory_usage>"
+              "<utilization><gpu_util>37 %</gpu_util></utilization>"
+              "<temperature><gpu_temp>61 C</gpu_temp></temperature></gpu></nvidia_smi_log>'\n";
+    script.close();
+    std::string command = "chmod +x " + dir + "/nvidia-smi && STATS_NVML_LIBRARY=/nonexistent PATH=" + dir +
+                          ":$PATH timeout " + std::to_string(runSeconds) + " build/stats_display --timings > " + dir +
+                          "/out 2> " + dir + "/err";
+    int rc = std::system(command.c_str());
+    (void)rc; // timeout's own status
+    out = readAll(dir + "/out");
+    err = readAll(dir + "/err");
+}
+
+int main() {
+    char dir[] = "/tmp/stats_gpu_probe_XXXXXX";
+    CHECK(mkdtemp(dir) != nullptr);
+    std::string out, err;
+
+    // 300 ms per run: slow, but within the deadline
+    runMonitor(dir, "sleep 0.3", 2.5, out, err);
+    CHECK(out.find("GPU: Fake GPU") != std::string::npos);
+    CHECK(out.find("GPU Util: 37 %") != std::string::npos);
+#ifdef STATS_ASYNC_IO
+    CHECK(out.find("probes: ") != std::string::npos); // nvidia-smi ran through the ReactorCollector
+#endif
+    CHECK(err.find("Error") == std::string::npos);
+
+    // Hung: killed at the 2 s deadline, and the CPU numbers never stop
+    runMonitor(dir, "exec sleep 30", 5.0, out, err);
+    CHECK(err.find("Error getting GPU data: nvidia-smi timed out") != std::string::npos);
+    CHECK(countOf(out, "CPU Usage:") >= 2);
+    CHECK(out.find("GPU: Fake GPU") == std::string::npos);
+
+    std::system((std::string("rm -rf ") + dir).c_str());
+    return checkResult();
+}
@@ -0,0 +1,126 @@
+// MemoryStatsReader and KeySlotMap on recorded /proc/meminfo and /proc/vmstat files
+// (data/memory): a field the kernel does not have stays 0, keys the reader does not know,
+// including ones that share a prefix with a known key, are skipped, and the vmstat counters
+// become rates. Rates depend on the time between reads, so they are checked through ratios.
+#include <unistd.h>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "check.hpp"
+#include "memory_stats.hpp"
+
+static void writeFile(const std::string& path, const std::string& content) {
+    std::ofstream(path, std::ios::trunc) << content;
+}
+
+static std::string readFile(const std::string& path) {
+    std::ifstream file(path);
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+static bool near(double value, double expected) {
+    return std::fabs(value - expected) <= 1e-9 * std::fabs(expected);
+}
+
+static void testKeySlotMap() {
+    static const KeySlotMap::Key keys[] = {{"Cached", 0}, {"SwapCached", 1}, {"MemTotal", 2}, {"pgfault", 3}};
+    KeySlotMap map(keys, sizeof(keys) / sizeof(keys[0]));
+    CHECK(map.find("Cached") == 0 && map.find("SwapCached") == 1);
+    CHECK(map.find("MemTotal") == 2 && map.find("pgfault") == 3);
+    CHECK(map.find("") == -1);
+    CHECK(map.find("Cache") == -1 && map.find("Cachedx") == -1 && map.find("cached") == -1);
+    CHECK(map.find("MemTotal ") == -1 && map.find("pgfaults") == -1);
+
+    // Many keys still get a bucket each
+    std::vector<std::string> names;
+    for (int i = 0; i < 300; ++i) names.push_back("counter_" + std::to_string(i));
+    std::vector<KeySlotMap::Key> many;
+    for (int i = 0; i < 300; ++i) many.push_back({names[static_cast<size_t>(i)].c_str(), i});
+    KeySlotMap large(many.data(), many.size());
+    bool all = true;
+    for (int i = 0; i < 300; ++i) all = all && large.find(names[static_cast<size_t>(i)]) == i;
+    CHECK(all);
+    CHECK(large.find("counter_300") == -1);
+
+    // A key listed twice can never get a bucket of its own
+    static const KeySlotMap::Key twice[] = {{"Dirty", 0}, {"Dirty", 1}};
+    bool threw = false;
+    try {
+        KeySlotMap broken(twice, 2);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+// The fixture has no Writeback line (an older kernel) and a FutureCounter line (a newer one)
+static void testFixture() {
+    MemoryStatsReader reader("data/memory");
+    MemoryStats stats;
+    CHECK(reader.read(stats));
+    CHECK(stats.available);
+    CHECK(stats[MEMORY_TOTAL] == 6147400 / 1024.0);
+    CHECK(stats[MEMORY_AVAILABLE] == 5547940 / 1024.0);
+    CHECK(stats[MEMORY_CACHED] == 949076 / 1024.0);   // Not SwapCached, not Active(file)
+    CHECK(stats[MEMORY_SWAP_CACHED] == 0.0);
+    CHECK(stats[MEMORY_SHMEM] == 9180 / 1024.0);      // Not the FutureCounter after it
+    CHECK(stats[MEMORY_SWAP_TOTAL] == 2048.0 && stats[MEMORY_SWAP_FREE] == 1024.0);
+    CHECK(stats[MEMORY_DIRTY] == 30284 / 1024.0);
+    CHECK(stats[MEMORY_WRITEBACK] == 0.0);             // Missing
+    CHECK(stats[MEMORY_COMMITTED] == 409464 / 1024.0 && stats[MEMORY_COMMIT_LIMIT] == 3073700 / 1024.0);
+    CHECK(stats[MEMORY_HUGEPAGES] == 32.0 && stats[MEMORY_HUGEPAGES_FREE] == 8.0); // 16 and 4 of 2 MB
+    // No rates from the first read
+    CHECK(stats[MEMORY_PAGE_FAULTS] == 0.0 && stats[MEMORY_SWAP_OUT] == 0.0);
+}
+
+static void testRates(const std::string& dir) {
+    std::string meminfo = readFile("data/memory/meminfo");
+    std::string vmstat = readFile("data/memory/vmstat"); // Has no pswpin
+    writeFile(dir + "/meminfo", meminfo);
+    writeFile(dir + "/vmstat", vmstat);
+    MemoryStatsReader reader(dir);
+    MemoryStats stats;
+    CHECK(reader.read(stats));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    // 10000 more faults, 100 of them major; 256 pages swapped in (pswpin appears) and 512 out
+    std::string next = vmstat;
+    next.replace(next.find("pgfault 55954763"), 16, "pgfault 55964763");
+    next.replace(next.find("pgmajfault 294"), 14, "pgmajfault 394");
+    next.replace(next.find("pswpout 5120"), 12, "pswpout 5632\npswpin 256");
+    writeFile(dir + "/vmstat", next);
+    CHECK(reader.read(stats));
+    CHECK(stats[MEMORY_PAGE_FAULTS] > 0.0);
+    CHECK(near(stats[MEMORY_MAJOR_FAULTS], stats[MEMORY_PAGE_FAULTS] / 100));
+    CHECK(near(stats[MEMORY_SWAP_OUT], 2 * stats[MEMORY_SWAP_IN]));
+    double pageMb = static_cast<double>(sysconf(_SC_PAGESIZE)) / (1024.0 * 1024.0);
+    CHECK(near(stats[MEMORY_SWAP_OUT], stats[MEMORY_PAGE_FAULTS] / 10000 * 512 * pageMb));
+
+    // No vmstat: the meminfo fields without rates; no meminfo: nothing
+    std::filesystem::remove(dir + "/vmstat");
+    MemoryStatsReader noVmstat(dir);
+    CHECK(noVmstat.read(stats));
+    CHECK(stats.available && stats[MEMORY_TOTAL] > 0.0 && stats[MEMORY_PAGE_FAULTS] == 0.0);
+    MemoryStatsReader missing(dir + "/nonexistent");
+    CHECK(!missing.read(stats));
+    CHECK(!stats.available);
+}
+
+int main() {
+    char dir[] = "/tmp/stats_memory_XXXXXX";
+    CHECK(mkdtemp(dir) != nullptr);
+    testKeySlotMap();
+    testFixture();
+    testRates(dir);
+    std::filesystem::remove_all(dir);
+    return checkResult();
+}
@@ -0,0 +1,86 @@
+// The in-process NVML backend against the stub libraries (nvml_stub.c), loaded through
+// STATS_NVML_LIBRARY: the values come through, optional entry points may be missing or
+// unsupported, and a library that is absent or does not initialize falls back.
+#include <stdlib.h>
+#include <string>
+#include "check.hpp"
+#include "gpu_backend.hpp"
+
+// Stands in for the nvidia-smi backend
+class FallbackBackend : public GpuBackend {
+public:
+    const char* name() const { return "fallback"; }
+    bool query(GpuData&) { return false; }
+};
+
+static std::unique_ptr<NvmlGpuBackend> loadFrom(const char* library) {
+    setenv("STATS_NVML_LIBRARY", library, 1);
+    return NvmlGpuBackend::load();
+}
+
+static void testFullLibrary() {
+    std::unique_ptr<NvmlGpuBackend> nvml = loadFrom("build/libnvml_stub.so");
+    CHECK(nvml != nullptr);
+    if (!nvml) return;
+    GpuData data;
+    CHECK(nvml->query(data));
+    CHECK(data.name == "Stub GPU 9000");
+    CHECK(data.driverVersion == "999.1");
+    CHECK(data.uuid == "GPU-5f1b-stub");
+    CHECK(data.memoryTotal == 24.0);
+    CHECK(data.memoryUsed == 6.0);
+    CHECK(data.utilizationGpu == 42);
+    CHECK(data.generation == 1);
+    unsigned int temperature = data.temperature;
+
+    const GpuExtendedCounters& extended = data.extended;
+    CHECK(extended.powerDraw == 123.456);
+    CHECK(extended.powerLimit == 300.0);
+    CHECK(extended.smClock == 1800 && extended.memoryClock == 9501);
+    CHECK(extended.pcieRx == 2048.0 && extended.pcieTx == 1024.0);
+    CHECK(extended.utilizationEncoder == 7);
+    CHECK(extended.utilizationDecoder == 0);                          // Entry point missing
+    CHECK(extended.eccCorrected == 0 && extended.eccUncorrected == 0); // Not supported
+    CHECK(extended.throttleReasons == (GPU_THROTTLE_IDLE | GPU_THROTTLE_HW_THERMAL));
+
+    // The counters move, the descriptor is left alone
+    CHECK(nvml->query(data));
+    CHECK(data.temperature == temperature + 1);
+    CHECK(data.generation == 1);
+}
+
+static void testMinimalLibrary() {
+    std::unique_ptr<NvmlGpuBackend> nvml = loadFrom("build/libnvml_stub_minimal.so");
+    CHECK(nvml != nullptr);
+    if (!nvml) return;
+    GpuData data;
+    CHECK(nvml->query(data));
+    CHECK(data.name == "Stub GPU 9000");
+    CHECK(data.uuid.empty());
+    CHECK(data.extended == GpuExtendedCounters());
+}
+
+static void testFallback() {
+    CHECK(loadFrom("/nonexistent/libnvidia-ml.so.1") == nullptr);
+    std::unique_ptr<GpuBackend> backend = selectGpuBackend(std::unique_ptr<GpuBackend>(new FallbackBackend()));
+    CHECK(std::string(backend->name()) == "fallback");
+
+    setenv("NVML_STUB_INIT_FAIL", "1", 1);
+    CHECK(loadFrom("build/libnvml_stub.so") == nullptr);
+    unsetenv("NVML_STUB_INIT_FAIL");
+
+    setenv("NVML_STUB_DEVICES", "0", 1);
+    CHECK(loadFrom("build/libnvml_stub.so") == nullptr);
+    unsetenv("NVML_STUB_DEVICES");
+
+    setenv("STATS_NVML_LIBRARY", "build/libnvml_stub.so", 1);
+    backend = selectGpuBackend(std::unique_ptr<GpuBackend>(new FallbackBackend()));
+    CHECK(std::string(backend->name()) == "nvml");
+}
+
+int main() {
+    testFullLibrary();
+    testMinimalLibrary();
+    testFallback();
+    return checkResult();
+}
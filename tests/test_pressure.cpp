@@ -0,0 +1,124 @@
+// Load averages and PSI from recorded /proc files (data/psi), re-read in place as they change,
+// and the trigger wait against a fake trigger descriptor, the read end of a pipe that the
+// test writes to when the "trigger" fires.
+#include <fcntl.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include "check.hpp"
+#include "pressure_collector.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+static long long msSince(Clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+}
+
+static void testRecorded() {
+    PressureCollector collector(250, "data/psi/loaded");
+    StatsSnapshot snapshot;
+    collector.collect();
+    CHECK(collector.apply(snapshot) == SNAPSHOT_CHANGED_PRESSURE);
+    CHECK(snapshot.loadAverage[0] == 7.53 && snapshot.loadAverage[1] == 4.61 && snapshot.loadAverage[2] == 2.71);
+    const PressureSample& memory = snapshot.pressure[PRESSURE_MEMORY];
+    CHECK(memory.available);
+    CHECK(memory.some[0] == 37.41 && memory.some[1] == 21.08 && memory.some[2] == 6.35);
+    CHECK(memory.full[0] == 30.12 && memory.full[2] == 5.02);
+    CHECK(snapshot.pressure[PRESSURE_CPU].available && snapshot.pressure[PRESSURE_CPU].some[0] == 1.92);
+    CHECK(snapshot.pressure[PRESSURE_IO].available && snapshot.pressure[PRESSURE_IO].full[1] == 0.10);
+
+    collector.collect();
+    CHECK(collector.apply(snapshot) == 0); // Nothing moved
+}
+
+// A kernel booted with psi=0, or before 4.20: load averages only
+static void testPsiDisabled() {
+    PressureCollector collector(250, "data/psi/psi_disabled");
+    StatsSnapshot snapshot;
+    collector.collect();
+    collector.apply(snapshot);
+    CHECK(snapshot.loadAverage[0] == 0.53);
+    for (int r = 0; r < PRESSURE_RESOURCES; ++r) CHECK(!snapshot.pressure[r].available);
+}
+
+// The files stay open and are re-read from the start, so rewriting one in place is seen
+static void testRereadInPlace() {
+    char dir[] = "/tmp/stats_pressure_XXXXXX";
+    CHECK(mkdtemp(dir) != nullptr);
+    std::string root = dir;
+    std::system(("cp -r data/psi/loaded/. " + root).c_str());
+    PressureCollector collector(250, root);
+    StatsSnapshot snapshot;
+    collector.collect();
+    collector.apply(snapshot);
+
+    std::ofstream(root + "/pressure/io", std::ios::trunc)
+        << "some avg10=64.00 avg60=40.00 avg300=12.00 total=99999999\n"
+           "full avg10=60.00 avg60=38.00 avg300=11.00 total=88888888\n";
+    collector.collect();
+    CHECK(collector.apply(snapshot) == SNAPSHOT_CHANGED_PRESSURE);
+    CHECK(snapshot.pressure[PRESSURE_IO].some[0] == 64.0 && snapshot.pressure[PRESSURE_IO].full[0] == 60.0);
+    std::system(("rm -rf " + root).c_str());
+}
+
+static void testFakeTrigger() {
+    int ends[2];
+    CHECK(pipe2(ends, O_CLOEXEC) == 0);
+    PressureTriggers triggers;
+    CHECK(triggers.empty());
+    triggers.addDescriptor(ends[0]);
+    CHECK(!triggers.empty());
+
+    // Quiet: the wait lasts until the deadline
+    Clock::time_point start = Clock::now();
+    CHECK(!triggers.waitUntil(start + std::chrono::milliseconds(50)));
+    CHECK(msSince(start) >= 50);
+
+    // Fires 30 ms into a 5 s wait, which ends right there
+    std::thread fire([&ends] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        CHECK(write(ends[1], "xyz", 3) == 3);
+    });
+    start = Clock::now();
+    CHECK(triggers.waitUntil(start + std::chrono::seconds(5)));
+    long long waited = msSince(start);
+    fire.join();
+    CHECK(waited >= 25 && waited < 1000);
+
+    // The event was drained, so the next wait sleeps again
+    CHECK(!triggers.waitUntil(Clock::now() + std::chrono::milliseconds(20)));
+
+    // The writer going away ends the watch, the wait turns into a plain sleep
+    close(ends[1]);
+    start = Clock::now();
+    CHECK(!triggers.waitUntil(start + std::chrono::milliseconds(40)));
+    CHECK(msSince(start) >= 40);
+    CHECK(triggers.empty());
+}
+
+static void testInvalidTriggers() {
+    PressureTriggers triggers;
+    std::string error;
+    CHECK(!triggers.add("gpu", "some 150000 1000000", error));
+    CHECK(error.find("unknown resource") != std::string::npos);
+    error.clear();
+    CHECK(!triggers.add("memory", "sometimes 1 2", error)); // Refused by the kernel, or no PSI at all
+    CHECK(!error.empty());
+
+    setenv("STATS_PSI_TRIGGERS", "disk some 1 2;cpu nonsense", 1);
+    triggers.addFromEnvironment();
+    unsetenv("STATS_PSI_TRIGGERS");
+    CHECK(triggers.empty());
+}
+
+int main() {
+    testRecorded();
+    testPsiDisabled();
+    testRereadInPlace();
+    testFakeTrigger();
+    testInvalidTriggers();
+    return checkResult();
+}
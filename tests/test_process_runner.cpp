@@ -0,0 +1,162 @@
+// runProcess() and PreparedCommand against misbehaving children: one that hangs, one that
+// trickles output forever, one that floods the pipe, and one that fails, all end within the
+// deadline with the right status. Also the CircuitBreaker's open, half-open and closed states.
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "check.hpp"
+#include "process_runner.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void testHang() {
+    ProcessOptions options;
+    options.timeoutMs = 200;
+    Clock::time_point start = Clock::now();
+    ProcessResult r = runProcess({"sleep", "5"}, options);
+    double ms = elapsedMs(start);
+    CHECK(r.status == ProcessResult::TIMED_OUT);
+    CHECK(ms >= 190.0 && ms < 1000.0);
+    CHECK(describeFailure(r) == "timed out and was killed");
+}
+
+// Output keeps arriving, but that does not move the deadline
+static void testTrickle() {
+    ProcessOptions options;
+    options.timeoutMs = 300;
+    Clock::time_point start = Clock::now();
+    ProcessResult r = runProcess({"/bin/sh", "-c", "while :; do echo tick; sleep 0.02; done"}, options);
+    double ms = elapsedMs(start);
+    CHECK(r.status == ProcessResult::TIMED_OUT);
+    CHECK(ms < 1000.0);
+    CHECK(r.output.compare(0, 5, "tick\n") == 0);
+}
+
+static void testFlood() {
+    ProcessOptions options;
+    options.maxOutputBytes = 64 * 1024;
+    Clock::time_point start = Clock::now();
+    ProcessResult r = runProcess({"yes"}, options);
+    CHECK(r.status == ProcessResult::OUTPUT_LIMIT);
+    CHECK(elapsedMs(start) < 1000.0);
+
+    // A lot of output under the limit is read whole
+    ProcessResult whole = runProcess({"head", "-c", "3000000", "/dev/zero"}, ProcessOptions());
+    CHECK(whole.status == ProcessResult::EXITED && whole.exitCode == 0);
+    CHECK(whole.output.size() == 3000000);
+}
+
+static void testExitCodes() {
+    ProcessResult r = runProcess({"/bin/sh", "-c", "echo out; echo err >&2; exit 7"});
+    CHECK(r.status == ProcessResult::EXITED);
+    CHECK(r.exitCode == 7);
+    CHECK(r.output == "out\nerr\n"); // stderr shares the pipe
+    CHECK(describeFailure(r) == "exited with code 7");
+
+    r = runProcess({"/bin/sh", "-c", "kill -9 $$"});
+    CHECK(r.status == ProcessResult::EXITED);
+    CHECK(r.exitCode == 128 + 9);
+
+    r = runProcess({"/nonexistent/nvidia-smi", "-q", "-x"});
+    CHECK(r.status == ProcessResult::SPAWN_FAILED);
+    CHECK(!r.error.empty());
+}
+
+// The child exits while a background grandchild keeps the pipe open
+static void testGrandchildHoldsPipe() {
+    Clock::time_point start = Clock::now();
+    ProcessResult r = runProcess({"/bin/sh", "-c", "sleep 2 & echo done; exit 2"});
+    CHECK(r.status == ProcessResult::EXITED);
+    CHECK(r.exitCode == 2);
+    CHECK(elapsedMs(start) < 1000.0);
+}
+
+static void testCancel() {
+    std::atomic<bool> cancel(false);
+    ProcessOptions options;
+    options.timeoutMs = 5000;
+    options.cancel = &cancel;
+    std::thread canceller([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        cancel = true;
+    });
+    Clock::time_point start = Clock::now();
+    ProcessResult r = runProcess({"sleep", "5"}, options);
+    canceller.join();
+    CHECK(r.status == ProcessResult::CANCELLED);
+    CHECK(elapsedMs(start) < 1000.0);
+}
+
+// Runs again and again into the same buffer, each run's output replacing the last
+static void testPreparedCommandReuse() {
+    PreparedCommand command({"/bin/sh", "-c", "echo run"});
+    const ProcessResult& first = command.run();
+    CHECK(first.status == ProcessResult::EXITED && first.exitCode == 0);
+    CHECK(command.output() == "run\n");
+    const char* buffer = command.output().data();
+    for (int i = 0; i < 20; ++i) {
+        command.run();
+        CHECK(command.output() == "run\n");
+    }
+    CHECK(command.output().data() == buffer);
+
+    ProcessOptions options;
+    options.timeoutMs = 100;
+    PreparedCommand hang({"sleep", "5"});
+    CHECK(hang.run(options).status == ProcessResult::TIMED_OUT);
+    CHECK(hang.run(options).status == ProcessResult::TIMED_OUT); // The killed child was reaped, a rerun works
+
+    PreparedCommand missing({"/nonexistent/nvidia-smi"});
+    CHECK(missing.run().status == ProcessResult::SPAWN_FAILED);
+    CHECK(missing.output().empty());
+}
+
+static void testCircuitBreaker() {
+    CircuitBreaker breaker(3, 1000, 4000);
+    unsigned long long now = 10000;
+    CHECK(breaker.allow(now));
+    breaker.recordFailure(now);
+    breaker.recordFailure(now);
+    CHECK(breaker.allow(now)); // Below the threshold: still closed
+
+    breaker.recordFailure(now);
+    CHECK(!breaker.allow(now)); // Open
+    CHECK(!breaker.allow(now + 999));
+    CHECK(breaker.allow(now + 1000)); // Half-open: one retry goes through
+
+    // A failed retry opens it again for twice as long, up to the maximum
+    now += 1000;
+    breaker.recordFailure(now);
+    CHECK(breaker.openUntilMs() == now + 2000);
+    now += 2000;
+    breaker.recordFailure(now);
+    CHECK(breaker.openUntilMs() == now + 4000);
+    now += 4000;
+    breaker.recordFailure(now);
+    CHECK(breaker.openUntilMs() == now + 4000);
+
+    // A successful retry closes it, and the count starts over
+    now += 4000;
+    CHECK(breaker.allow(now));
+    breaker.recordSuccess();
+    CHECK(breaker.allow(now));
+    breaker.recordFailure(now);
+    breaker.recordFailure(now);
+    CHECK(breaker.allow(now));
+}
+
+int main() {
+    testHang();
+    testTrickle();
+    testFlood();
+    testExitCodes();
+    testGrandchildHoldsPipe();
+    testCancel();
+    testPreparedCommandReuse();
+    testCircuitBreaker();
+    return checkResult();
+}
@@ -0,0 +1,175 @@
+// QuantileSketch against exact quantiles of the same values: every answer within
+// SKETCH_RELATIVE_ACCURACY on distributions of both signs, with zeros and over many decades;
+// collapsing keeps the high quantiles accurate; merging equals adding everything to one
+// sketch; and encode()/decode() round-trip exactly while rejecting malformed bytes.
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+#include "check.hpp"
+#include "quantile_sketch.hpp"
+
+#define VALUES 20000
+
+static const double QUANTILES[] = {0.0, 0.001, 0.01, 0.05, 0.25, 0.5, 0.75, 0.9, 0.95, 0.99, 0.999, 1.0};
+
+// The value of rank q * (n - 1) in sorted, the rank quantile() answers for
+static double exactQuantile(const std::vector<double>& sorted, double q) {
+    return sorted[static_cast<size_t>(q * static_cast<double>(sorted.size() - 1))];
+}
+
+static bool withinAccuracy(double value, double exact) {
+    return std::fabs(value - exact) <= SKETCH_RELATIVE_ACCURACY * std::fabs(exact) * (1 + 1e-9);
+}
+
+// Every quantile of the list for values added to a sketch, then the extremes and the sum
+static void checkAccuracy(std::vector<double> values) {
+    QuantileSketch sketch;
+    double sum = 0.0;
+    for (double value : values) {
+        sketch.add(value);
+        sum += value;
+    }
+    std::sort(values.begin(), values.end());
+    bool accurate = true;
+    for (double q : QUANTILES) accurate = accurate && withinAccuracy(sketch.quantile(q), exactQuantile(values, q));
+    CHECK(accurate);
+    CHECK(sketch.count() == values.size());
+    CHECK(sketch.min() == values.front() && sketch.max() == values.back());
+    CHECK(std::fabs(sketch.sum() - sum) <= 1e-9 * std::fabs(sum) + 1e-9);
+}
+
+static void testAccuracy() {
+    std::mt19937 random(42);
+    std::vector<double> uniform, lognormal, mixed, idle;
+    std::uniform_real_distribution<double> percent(0.0, 100.0);
+    std::lognormal_distribution<double> latency(3.0, 2.0);
+    std::normal_distribution<double> centered(0.0, 50.0);
+    std::exponential_distribution<double> bursts(0.1);
+    for (int i = 0; i < VALUES; ++i) {
+        uniform.push_back(percent(random));
+        lognormal.push_back(latency(random));
+        mixed.push_back(centered(random));                      // Both signs
+        idle.push_back(i % 3 == 0 ? bursts(random) : 0.0);      // Mostly zeros
+    }
+    checkAccuracy(uniform);
+    checkAccuracy(lognormal);
+    checkAccuracy(mixed);
+    checkAccuracy(idle);
+    checkAccuracy(std::vector<double>(10, 42.0));
+
+    QuantileSketch empty;
+    CHECK(std::isnan(empty.quantile(0.5)));
+    empty.add(std::nan(""));
+    CHECK(empty.empty());
+}
+
+// Values over twelve decades need more than SKETCH_MAX_BINS bins: the lowest are folded,
+// quantiles above them keep their accuracy
+static void testCollapse() {
+    std::vector<double> values;
+    for (int i = 0; i < VALUES; ++i) values.push_back(std::pow(10.0, -6.0 + 12.0 * i / VALUES));
+    QuantileSketch sketch;
+    for (double value : values) sketch.add(value);
+    CHECK(sketch.count() == values.size());
+    CHECK(withinAccuracy(sketch.quantile(0.5), exactQuantile(values, 0.5)));
+    CHECK(withinAccuracy(sketch.quantile(0.99), exactQuantile(values, 0.99)));
+    CHECK(sketch.quantile(0.01) > exactQuantile(values, 0.01) * (1 + SKETCH_RELATIVE_ACCURACY)); // Folded
+
+    // Down to 100 bins, a little under the top decade
+    size_t before = sketch.memoryBytes();
+    sketch.collapseTo(100);
+    CHECK(sketch.memoryBytes() <= before);
+    CHECK(sketch.count() == values.size());
+    CHECK(withinAccuracy(sketch.quantile(0.95), exactQuantile(values, 0.95)));
+    CHECK(withinAccuracy(sketch.quantile(0.999), exactQuantile(values, 0.999)));
+    CHECK(sketch.quantile(0.5) >= exactQuantile(values, 0.5));
+    CHECK(sketch.max() == values.back());
+
+    // A collapsed sketch still merges with a full one
+    QuantileSketch full;
+    for (double value : values) full.add(value);
+    full.merge(sketch);
+    CHECK(full.count() == 2 * values.size());
+    CHECK(withinAccuracy(full.quantile(0.99), exactQuantile(values, 0.99)));
+}
+
+// Two halves merged answer like one sketch of everything
+static void testMerge() {
+    std::mt19937 random(7);
+    std::lognormal_distribution<double> latency(1.0, 1.5);
+    QuantileSketch whole, first, second;
+    for (int i = 0; i < VALUES; ++i) {
+        double value = i % 5 == 0 ? -latency(random) : latency(random);
+        whole.add(value);
+        (i < VALUES / 3 ? first : second).add(value);
+    }
+    first.merge(second);
+    CHECK(first.count() == whole.count());
+    CHECK(first.min() == whole.min() && first.max() == whole.max());
+    bool same = true;
+    for (double q : QUANTILES) same = same && first.quantile(q) == whole.quantile(q);
+    CHECK(same);
+}
+
+static bool decodes(QuantileSketch& sketch, const std::string& data) {
+    return sketch.decode(reinterpret_cast<const unsigned char*>(data.data()), data.size());
+}
+
+static void testEncoding() {
+    QuantileSketch sketch;
+    for (int i = -500; i < 2000; ++i) sketch.add(i * 0.37);
+    std::string data;
+    sketch.encode(data);
+
+    QuantileSketch decoded;
+    CHECK(decodes(decoded, data));
+    CHECK(decoded.count() == sketch.count());
+    CHECK(decoded.min() == sketch.min() && decoded.max() == sketch.max() && decoded.sum() == sketch.sum());
+    bool same = true;
+    for (double q : QUANTILES) same = same && decoded.quantile(q) == sketch.quantile(q);
+    CHECK(same);
+    std::string again;
+    decoded.encode(again);
+    CHECK(again == data);
+
+    // Offsets below zero: magnitudes under 1 only
+    QuantileSketch small;
+    small.add(1e-5);
+    small.add(-0.003);
+    data.clear();
+    small.encode(data);
+    CHECK(decodes(decoded, data));
+    CHECK(withinAccuracy(decoded.quantile(0.0), -0.003) && withinAccuracy(decoded.quantile(1.0), 1e-5));
+
+    QuantileSketch empty;
+    data.clear();
+    empty.encode(data);
+    CHECK(decodes(decoded, data) && decoded.empty());
+
+    // Every truncation, a trailing byte, another accuracy, and bin counts that disagree with
+    // the total are all rejected, leaving the sketch empty
+    data.clear();
+    sketch.encode(data);
+    bool rejected = true;
+    for (size_t size = 0; size < data.size(); ++size) {
+        rejected = rejected && !decodes(decoded, data.substr(0, size)) && decoded.empty();
+    }
+    CHECK(rejected);
+    CHECK(!decodes(decoded, data + '\0') && decoded.empty());
+    std::string otherAccuracy = data;
+    otherAccuracy[0] = static_cast<char>(otherAccuracy[0] + 1);
+    CHECK(!decodes(decoded, otherAccuracy));
+    std::string wrongCount = data;
+    wrongCount[2] = static_cast<char>(wrongCount[2] ^ 1); // The count varint's second byte
+    CHECK(!decodes(decoded, wrongCount) && decoded.empty());
+}
+
+int main() {
+    testAccuracy();
+    testCollapse();
+    testMerge();
+    testEncoding();
+    return checkResult();
+}
@@ -0,0 +1,44 @@
+// Single writer of the shared-memory snapshot: a second publisher stays disabled and
+// leaves the region alone, readers see what the owner publishes, the owner removes it.
+#include "check.hpp"
+#include "shm_publisher.hpp"
+
+int main() {
+    {
+        ShmPublisher owner;
+        if (!owner.ok()) {
+            std::fprintf(stderr, "skipped: shared memory unavailable or a monitor is running\n");
+            return 0;
+        }
+        StatsSnapshot snap;
+        snap.cpuUsage = 12.5;
+        owner.publish(snap);
+
+        {
+            ShmPublisher second;
+            CHECK(!second.ok());
+            snap.cpuUsage = 99.0;
+            second.publish(snap); // No-op
+        }
+
+        // The second one neither reset nor unlinked the region
+        stats_shm_reader* reader = stats_shm_open();
+        CHECK(reader != nullptr);
+        if (reader) {
+            stats_shm_snapshot out;
+            CHECK(stats_shm_read(reader, &out) == STATS_SHM_OK);
+            CHECK(out.cpu_usage == 12.5);
+            snap.cpuUsage = 50.0;
+            owner.publish(snap);
+            CHECK(stats_shm_read(reader, &out) == STATS_SHM_OK);
+            CHECK(out.cpu_usage == 50.0);
+            stats_shm_close(reader);
+        }
+    }
+
+    // Gone with its owner, and free for the next one
+    CHECK(stats_shm_open() == nullptr);
+    ShmPublisher next;
+    CHECK(next.ok());
+    return checkResult();
+}
@@ -0,0 +1,100 @@
+// Snapshot bus under concurrent producers and consumers (run it under ThreadSanitizer with
+// make tsan): every Ref sees one whole snapshot, sequences from one producer only move forward,
+// Refs held across many publishes stay valid, and nodes are recycled instead of allocated per publish.
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "check.hpp"
+#include "snapshot_bus.hpp"
+
+#define PRODUCERS 8
+#define CONSUMERS 32
+#define PUBLISHES 5000 // Per producer
+
+static void testSequenceAndRecycling() {
+    SnapshotBus bus;
+    CHECK(bus.latest().sequence() == 0);
+    StatsSnapshot snap;
+    snap.gpu.name = std::string(200, 'x'); // Heap storage, reused along with the node
+    CHECK(bus.publish(snap));
+    const StatsSnapshot* first = &*bus.latest();
+    CHECK(bus.latest().sequence() == 1);
+    CHECK(bus.publish(snap));
+    CHECK(bus.publish(snap));
+    // The first node was released when the second was replaced and came back for the third
+    CHECK(&*bus.latest() == first);
+    CHECK(bus.latest()->gpu.name == snap.gpu.name);
+}
+
+static void testConcurrent() {
+    SnapshotBus bus;
+    std::atomic<bool> stop(false);
+    std::atomic<long long> torn(0), backwards(0), reads(0);
+    std::vector<std::thread> threads;
+    for (int p = 0; p < PRODUCERS; ++p) {
+        threads.emplace_back([&bus, p] {
+            StatsSnapshot snap;
+            for (int i = 0; i < PUBLISHES; ++i) {
+                snap.cpuUsage = snap.ramUsage = p * 1e6 + i;
+                snap.gpu.name = std::to_string(snap.cpuUsage);
+                bus.publish(snap);
+            }
+        });
+    }
+    for (int c = 0; c < CONSUMERS; ++c) {
+        threads.emplace_back([&] {
+            SnapshotBus::Ref held = bus.latest(); // Kept across many publishes
+            // Last sequence seen from each producer: publishes of different producers may be
+            // swapped in out of sequence order, those of one producer never are
+            std::vector<unsigned long long> lastSequence(PRODUCERS, 0);
+            long long n = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                SnapshotBus::Ref ref = bus.latest();
+                if (ref->cpuUsage != ref->ramUsage || (ref.sequence() && ref->gpu.name != std::to_string(ref->cpuUsage))) ++torn;
+                if (ref.sequence()) {
+                    unsigned long long& last = lastSequence[static_cast<size_t>(ref->cpuUsage / 1e6)];
+                    if (ref.sequence() < last || ref.sequence() > PRODUCERS * PUBLISHES) ++backwards;
+                    last = ref.sequence();
+                }
+                if ((n++ & 255) == 0) held = std::move(ref);
+            }
+            if (held->cpuUsage != held->ramUsage) ++torn;
+            reads += n;
+        });
+    }
+    for (int p = 0; p < PRODUCERS; ++p) threads[p].join();
+    stop = true;
+    for (size_t i = PRODUCERS; i < threads.size(); ++i) threads[i].join();
+    CHECK(torn.load() == 0);
+    CHECK(backwards.load() == 0);
+    // The last publish to be swapped in need not be the one with the highest sequence
+    CHECK(bus.latest().sequence() >= 1 && bus.latest().sequence() <= PRODUCERS * PUBLISHES);
+    std::printf("%lld reads during %d publishes\n", reads.load(), PRODUCERS * PUBLISHES);
+}
+
+// Far more Refs through one node than the control word counts, all folded into the node
+static void testManyRefs() {
+    SnapshotBus bus;
+    StatsSnapshot snap;
+    snap.cpuUsage = 42.0;
+    bus.publish(snap);
+    SnapshotBus::Ref held = bus.latest();
+    for (int i = 0; i < 5000000; ++i) {
+        SnapshotBus::Ref ref = bus.latest();
+        if (ref->cpuUsage != 42.0) {
+            CHECK(ref->cpuUsage == 42.0);
+            break;
+        }
+    }
+    bus.publish(StatsSnapshot());
+    CHECK(held->cpuUsage == 42.0);
+    CHECK(bus.latest().sequence() == 2);
+}
+
+int main() {
+    testSequenceAndRecycling();
+    testManyRefs();
+    testConcurrent();
+    return checkResult();
+}
@@ -0,0 +1,186 @@
+// The thermal, disk and network collectors on a fake sysfs tree and fake /proc files written
+// by the test: per-core clocks of 512 CPUs, throttle counts read once per package, thermal
+// zones below zero or without a sensor, and diskstats / net/dev counters turned into rates.
+// Rates depend on the time between ticks, so they are checked through time-free ratios.
+#include <unistd.h>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include "check.hpp"
+#include "disk_collector.hpp"
+#include "net_collector.hpp"
+#include "thermal_collector.hpp"
+
+#define FAKE_CPUS 512
+#define CPUS_PER_PACKAGE 256
+
+// Writes content to path in place, creating the directories; open descriptors see the new content
+static void writeFile(const std::string& path, const std::string& content) {
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+    std::ofstream(path, std::ios::trunc) << content;
+}
+
+static bool near(double value, double expected) {
+    return std::fabs(value - expected) <= 1e-9 * std::fabs(expected);
+}
+
+static void buildSysfs(const std::string& root) {
+    for (int cpu = 0; cpu < FAKE_CPUS; ++cpu) {
+        std::string core = root + "/devices/system/cpu/cpu" + std::to_string(cpu);
+        writeFile(core + "/cpufreq/scaling_cur_freq", std::to_string(800000 + cpu * 1000) + "\n");
+        writeFile(core + "/topology/physical_package_id", std::to_string(cpu / CPUS_PER_PACKAGE) + "\n");
+        writeFile(core + "/thermal_throttle/core_throttle_count", "0\n");
+        writeFile(core + "/thermal_throttle/package_throttle_count", "0\n");
+    }
+    // Not a CPU, must be ignored
+    writeFile(root + "/devices/system/cpu/cpufreq/boost", "1\n");
+    writeFile(root + "/devices/system/cpu/cpuidle/current_driver", "intel_idle\n");
+
+    writeFile(root + "/class/thermal/thermal_zone0/type", "x86_pkg_temp\n");
+    writeFile(root + "/class/thermal/thermal_zone0/temp", "45000\n");
+    writeFile(root + "/class/thermal/thermal_zone1/type", "acpitz\n");
+    writeFile(root + "/class/thermal/thermal_zone1/temp", "-5500\n");
+    writeFile(root + "/class/thermal/thermal_zone2/type", "iwlwifi_1\n"); // No temp file
+    writeFile(root + "/class/thermal/cooling_device0/type", "Processor\n");
+}
+
+static void testThermal(const std::string& root) {
+    buildSysfs(root);
+    ThermalCollector collector(250, root);
+    StatsSnapshot snapshot;
+    collector.collect();
+    CHECK(collector.apply(snapshot) == SNAPSHOT_CHANGED_THERMAL);
+    CHECK(snapshot.coreFrequencyMhz.size() == FAKE_CPUS);
+    if (snapshot.coreFrequencyMhz.size() == FAKE_CPUS) {
+        CHECK(snapshot.coreFrequencyMhz[0] == 800.0);
+        CHECK(snapshot.coreFrequencyMhz[FAKE_CPUS - 1] == 800.0 + FAKE_CPUS - 1);
+    }
+    CHECK(snapshot.thermalZones.size() == 2);
+    if (snapshot.thermalZones.size() == 2) {
+        CHECK(std::string(snapshot.thermalZones[0].type) == "x86_pkg_temp" && snapshot.thermalZones[0].temperature == 45.0);
+        CHECK(std::string(snapshot.thermalZones[1].type) == "acpitz" && snapshot.thermalZones[1].temperature == -5.5);
+    }
+    CHECK(snapshot.coreThrottlesPerSec == 0.0 && snapshot.packageThrottlesPerSec == 0.0);
+
+    // Every core throttled 3 times. Every core reports its package's count, 10 per package,
+    // and that must only be counted once per package.
+    for (int cpu = 0; cpu < FAKE_CPUS; ++cpu) {
+        std::string core = root + "/devices/system/cpu/cpu" + std::to_string(cpu);
+        writeFile(core + "/thermal_throttle/core_throttle_count", "3\n");
+        writeFile(core + "/thermal_throttle/package_throttle_count", "10\n");
+    }
+    writeFile(root + "/devices/system/cpu/cpu7/cpufreq/scaling_cur_freq", "3900000\n");
+    writeFile(root + "/class/thermal/thermal_zone0/temp", "97000\n");
+    collector.collect();
+    CHECK(collector.apply(snapshot) == SNAPSHOT_CHANGED_THERMAL);
+    CHECK(snapshot.coreThrottlesPerSec > 0.0);
+    CHECK(near(snapshot.packageThrottlesPerSec * 3 * FAKE_CPUS, snapshot.coreThrottlesPerSec * 10 * (FAKE_CPUS / CPUS_PER_PACKAGE)));
+    CHECK(snapshot.coreFrequencyMhz.size() == FAKE_CPUS && snapshot.coreFrequencyMhz[7] == 3900.0);
+    CHECK(!snapshot.thermalZones.empty() && snapshot.thermalZones[0].temperature == 97.0);
+
+    // A steady tick costs the batch of reads only
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 200; ++i) collector.collect();
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / 200;
+    collector.apply(snapshot);
+    CHECK(snapshot.coreThrottlesPerSec == 0.0);
+    std::printf("thermal: %d cores, %zu zones, %.0f us per tick\n", FAKE_CPUS, snapshot.thermalZones.size(), us);
+}
+
+// major minor name reads merged sectors ms writes merged sectors ms in-flight io-ms weighted-ms
+static std::string diskLine(const char* name, int minor, unsigned long long reads, unsigned long long writes,
+                            unsigned long long ioMs) {
+    return "   8 " + std::to_string(minor) + " " + name + " " + std::to_string(reads) + " 0 " +
+           std::to_string(reads * 8) + " " + std::to_string(reads * 2) + " " + std::to_string(writes) + " 0 " +
+           std::to_string(writes * 16) + " " + std::to_string(writes * 4) + " 0 " + std::to_string(ioMs) + " " +
+           std::to_string(ioMs * 2) + " 0 0 0 0 0 0\n";
+}
+
+static void testDisks(const std::string& root) {
+    std::string path = root + "/diskstats";
+    writeFile(path, diskLine("sda", 0, 1000, 500, 100) + diskLine("sdb", 16, 10, 0, 0) + diskLine("loop0", 32, 5, 0, 0));
+    DiskCollector collector(250, path.c_str());
+    StatsSnapshot snapshot;
+    collector.collect();
+    collector.apply(snapshot);
+    CHECK(snapshot.disks.empty()); // First read, no deltas yet
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    // sda: 400 reads of 4 KiB taking 2 ms, 100 writes of 8 KiB taking 4 ms; sdb: 20 reads; loop0 idle.
+    // A new device appears between them and has no rate until the next tick.
+    writeFile(path, diskLine("sda", 0, 1400, 600, 130) + diskLine("nvme0n1", 48, 7, 7, 7) +
+                        diskLine("sdb", 16, 30, 0, 1) + diskLine("loop0", 32, 5, 0, 0));
+    collector.collect();
+    CHECK(collector.apply(snapshot) == SNAPSHOT_CHANGED_DISKS);
+    CHECK(snapshot.disks.size() == 2);
+    if (snapshot.disks.size() != 2) return;
+    const DiskSample& sda = snapshot.disks[0];
+    CHECK(std::string(sda.name) == "sda" && std::string(snapshot.disks[1].name) == "sdb");
+    CHECK(near(sda.readIops, 4 * sda.writeIops));
+    CHECK(near(sda.readBytesPerSec, sda.readIops * 8 * DISK_SECTOR_BYTES));
+    CHECK(near(sda.writeBytesPerSec, sda.writeIops * 16 * DISK_SECTOR_BYTES));
+    CHECK(near(sda.awaitMs, (400.0 * 2 + 100.0 * 4) / 500));
+    CHECK(sda.utilization > 0.0 && sda.utilization <= 100.0);
+    CHECK(near(snapshot.disks[1].readIops, sda.readIops / 20));
+}
+
+static void testNetwork(const std::string& root) {
+    std::string path = root + "/net_dev";
+    const std::string header =
+        "Inter-|   Receive                                                |  Transmit\n"
+        " face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed\n";
+    writeFile(path, header +
+                        "    lo: 1500 10 0 0 0 0 0 0 1500 10 0 0 0 0 0 0\n"
+                        "  eth0: 4294960000 1000 0 1 0 0 0 0 900000 1000 0 0 0 0 0 0\n"
+                        "   ib0: 7500000 5000 0 1 0 0 0 0 4500000 5000 0 0 0 0 0 0\n");
+    NetCollector collector(250, path.c_str());
+    StatsSnapshot snapshot;
+    collector.collect();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    // eth0's receive byte counter is 32 bits wide and wraps: 4294960000 -> 12704 is 20000 bytes
+    writeFile(path, header +
+                        "    lo: 999999 900 0 0 0 0 0 0 999999 900 0 0 0 0 0 0\n"
+                        "  eth0: 12704 1010 0 3 0 0 0 0 910000 1010 0 0 0 0 0 0\n"
+                        "   ib0: 8500000 5500 1 1 0 0 0 0 5000000 5500 0 0 0 0 0 0\n");
+    collector.collect();
+    CHECK(collector.apply(snapshot) == SNAPSHOT_CHANGED_NETWORK);
+    CHECK(snapshot.interfaces.size() == 2); // lo is tracked, not shown
+    if (snapshot.interfaces.size() != 2) return;
+    const NetSample& ib0 = snapshot.interfaces[0];
+    const NetSample& eth0 = snapshot.interfaces[1];
+    CHECK(std::string(ib0.name) == "ib0" && std::string(eth0.name) == "eth0");
+    CHECK(near(ib0.rxBytesPerSec, 2 * ib0.txBytesPerSec));
+    CHECK(near(eth0.rxBytesPerSec, ib0.rxBytesPerSec / 50)); // 20000 bytes, no spike from the wrap
+    CHECK(near(eth0.rxDropsPerSec, 2 * eth0.rxPacketsPerSec / 10));
+    CHECK(near(ib0.rxErrorsPerSec, ib0.rxPacketsPerSec / 500));
+
+    // eth0 goes away and veth0 takes its place: veth0 has a rate from the tick after
+    std::string withVeth = header +
+                           "    lo: 999999 900 0 0 0 0 0 0 999999 900 0 0 0 0 0 0\n"
+                           "  veth0: 1000 10 0 0 0 0 0 0 1000 10 0 0 0 0 0 0\n"
+                           "   ib0: 8500000 5500 1 1 0 0 0 0 5000000 5500 0 0 0 0 0 0\n";
+    writeFile(path, withVeth);
+    collector.collect();
+    collector.apply(snapshot);
+    CHECK(snapshot.interfaces.empty());
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    withVeth.replace(withVeth.find("veth0: 1000 10"), 14, "veth0: 3000 30");
+    writeFile(path, withVeth);
+    collector.collect();
+    collector.apply(snapshot);
+    CHECK(snapshot.interfaces.size() == 1 && std::string(snapshot.interfaces[0].name) == "veth0");
+}
+
+int main() {
+    char dir[] = "/tmp/stats_sysfs_XXXXXX";
+    CHECK(mkdtemp(dir) != nullptr);
+    testThermal(std::string(dir) + "/sys");
+    testDisks(dir);
+    testNetwork(dir);
+    std::filesystem::remove_all(dir);
+    return checkResult();
+}
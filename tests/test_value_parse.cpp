@@ -0,0 +1,138 @@
+// Fuzzing the value parser (value_parse.hpp): random input never crashes and always gives a
+// consistent answer, generated numbers match strtod exactly up to 15 significant digits and
+// within a few ulps past that, and every value in a recorded nvidia-smi document parses the
+// way strtod and std::stoul read it.
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include "check.hpp"
+#include "pugixml.hpp"
+#include "value_parse.hpp"
+
+#define RANDOM_INPUTS 2000000
+#define GENERATED_NUMBERS 1000000
+
+static const char* const kUnits[] = {"", " C", " W", " MiB", " MHz", " %", " KB/s", "W", "  MiB  "};
+
+// Random strings over the characters nvidia-smi values are made of, and a few others
+static void testRandomInput(std::mt19937& random) {
+    static const char kAlphabet[] = "0123456789.-+ \t NA/MiBWHz%[]eE,\x80\xff";
+    int inconsistent = 0;
+    for (int i = 0; i < RANDOM_INPUTS; ++i) {
+        char buffer[16];
+        size_t size = random() % sizeof(buffer);
+        for (size_t j = 0; j < size; ++j) buffer[j] = kAlphabet[random() % (sizeof(kAlphabet) - 1)];
+        std::string_view text(buffer, size);
+        ParsedValue value = parseValue(text);
+        bool consistent = value.status == VALUE_OK || value.status == VALUE_NOT_AVAILABLE || value.status == VALUE_INVALID;
+        if (value.status == VALUE_OK) {
+            // The unit is what is left of the input after the number
+            consistent &= !std::isnan(value.number) && value.unit.data() >= buffer &&
+                          value.unit.data() + value.unit.size() <= buffer + size;
+            double number = -1.0;
+            consistent &= parseDouble(text, number) && number == value.number;
+        } else {
+            double untouched = -1.0;
+            unsigned int untouchedUnsigned = 7;
+            consistent &= !parseDouble(text, untouched) && untouched == -1.0 &&
+                          !parseUnsigned(text, untouchedUnsigned) && untouchedUnsigned == 7;
+        }
+        if (!consistent && inconsistent++ < 5) {
+            std::fprintf(stderr, "inconsistent result for '%.*s'\n", static_cast<int>(size), buffer);
+        }
+    }
+    CHECK(inconsistent == 0);
+}
+
+// Fixed-point numbers of the given number of integer and fraction digits, compared with strtod
+static int compareWithStrtod(std::mt19937& random, int maxDigits, double tolerance) {
+    int mismatches = 0;
+    for (int i = 0; i < GENERATED_NUMBERS; ++i) {
+        int integerDigits = 1 + static_cast<int>(random() % maxDigits);
+        int fractionDigits = static_cast<int>(random() % (maxDigits - integerDigits + 1));
+        std::string text;
+        if (random() % 4 == 0) text += '-';
+        for (int d = 0; d < integerDigits; ++d) text += static_cast<char>('0' + random() % 10);
+        if (fractionDigits) {
+            text += '.';
+            for (int d = 0; d < fractionDigits; ++d) text += static_cast<char>('0' + random() % 10);
+        }
+        text += kUnits[random() % (sizeof(kUnits) / sizeof(kUnits[0]))];
+
+        double expected = std::strtod(text.c_str(), nullptr);
+        ParsedValue value = parseValue(text);
+        bool match = value.status == VALUE_OK &&
+                     (tolerance == 0.0 ? value.number == expected
+                                       : std::fabs(value.number - expected) <= tolerance * std::fabs(expected));
+        if (!match && mismatches++ < 5) {
+            std::fprintf(stderr, "'%s': %.17g, strtod %.17g\n", text.c_str(), value.number, expected);
+        }
+    }
+    return mismatches;
+}
+
+static std::string readFile(const char* path) {
+    std::ifstream file(path);
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+// Every leaf of a recorded nvidia-smi document: numbers as strtod (and std::stoul) read them,
+// the placeholders as not available
+static void testRecordedValues() {
+    std::string xml = readFile("data/nvidia_smi_8gpu.xml");
+    pugi::xml_document doc;
+    CHECK(doc.load_buffer(xml.data(), xml.size()));
+    int numbers = 0, placeholders = 0;
+    for (pugi::xpath_node leaf : doc.select_nodes("//*[not(*)]")) {
+        const char* text = leaf.node().text().get();
+        ParsedValue value = parseValue(text);
+        char* end = nullptr;
+        double expected = std::strtod(text, &end);
+        if (end != text && std::strchr("0123456789", text[0]) && !std::strchr(text, ':') && !std::strchr(text, 'x')) {
+            CHECK(value.status == VALUE_OK && value.number == expected);
+            if (std::strchr(text, '.') == nullptr) {
+                unsigned int parsed = 0;
+                CHECK(parseUnsigned(text, parsed) && parsed == std::stoul(text));
+            }
+            ++numbers;
+        } else if (std::strcmp(text, "N/A") == 0 || std::strcmp(text, "[N/A]") == 0) {
+            CHECK(value.status == VALUE_NOT_AVAILABLE);
+            ++placeholders;
+        }
+    }
+    std::printf("recorded document: %d numbers, %d placeholders\n", numbers, placeholders);
+    CHECK(numbers > 100 && placeholders > 0);
+}
+
+static void testExamples() {
+    ParsedValue value = parseValue("  250.50 W ");
+    CHECK(value.status == VALUE_OK && value.number == 250.5 && value.unit == "W");
+    value = parseValue("81920 MiB");
+    CHECK(value.status == VALUE_OK && value.number == 81920.0 && value.unit == "MiB");
+    CHECK(parseValue("[Not Supported]").status == VALUE_NOT_AVAILABLE);
+    CHECK(parseValue("").status == VALUE_NOT_AVAILABLE);
+    CHECK(parseValue("Enabled").status == VALUE_INVALID);
+    CHECK(parseValue(".5").number == 0.5);
+
+    unsigned int rounded = 0;
+    CHECK(parseUnsigned("59.5 C", rounded) && rounded == 60);
+    CHECK(!parseUnsigned("-3 C", rounded) && rounded == 60);
+    CHECK(!parseUnsigned("4294967296", rounded));
+    CHECK(memoryUnitToMiB("GiB") == 1024.0 && memoryUnitToMiB("W") == 0.0);
+}
+
+int main() {
+    std::mt19937 random(20261016);
+    testExamples();
+    testRandomInput(random);
+    CHECK(compareWithStrtod(random, 15, 0.0) == 0);    // Exact, as promised in value_parse.hpp
+    CHECK(compareWithStrtod(random, 30, 1e-15) == 0);  // Longer mantissas are cut, a few ulps at most
+    testRecordedValues();
+    return checkResult();
+}
@@ -0,0 +1,156 @@
+// Heap calls of the per-tick GPU parse, counted by interposing malloc and friends: once the
+// arena has seen a tick, loading an 8-GPU nvidia-smi document, reading its values and
+// evaluating the configured XPath fields makes no heap call at all.
+#include <atomic>
+#include <cstddef>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include "check.hpp"
+#include "gpu_fields.hpp"
+#include "pugixml.hpp"
+#include "value_parse.hpp"
+#include "xml_arena.hpp"
+
+#define WARMUP_TICKS 3
+#define MEASURED_TICKS 1000
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* p);
+}
+
+static std::atomic<bool> counting(false);
+static std::atomic<unsigned long long> heapCalls(0);
+
+static void count() {
+    if (counting.load(std::memory_order_relaxed)) heapCalls.fetch_add(1, std::memory_order_relaxed);
+}
+
+extern "C" {
+void* malloc(size_t size) {
+    count();
+    return __libc_malloc(size);
+}
+void* calloc(size_t n, size_t size) {
+    count();
+    return __libc_calloc(n, size);
+}
+void* realloc(void* p, size_t size) {
+    count();
+    return __libc_realloc(p, size);
+}
+void* aligned_alloc(size_t alignment, size_t size) {
+    count();
+    return __libc_memalign(alignment, size);
+}
+void* memalign(size_t alignment, size_t size) {
+    count();
+    return __libc_memalign(alignment, size);
+}
+int posix_memalign(void** p, size_t alignment, size_t size) {
+    count();
+    *p = __libc_memalign(alignment, size);
+    return *p ? 0 : 12; // ENOMEM
+}
+void free(void* p) {
+    if (p) count();
+    __libc_free(p);
+}
+}
+
+static std::string readFile(const char* path) {
+    std::ifstream file(path);
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+// What SmiGpuBackend::parse() does with a document, on every GPU instead of the first
+struct Tick {
+    GpuFieldQueryCache& fieldQueries;
+    GpuFieldRecord record;
+    std::string name;
+    double sum = 0.0;
+
+    bool run(XmlArena& arena, const std::string& xml) {
+        XmlArenaScope scope(arena);
+        pugi::xml_document doc;
+        if (!doc.load_buffer(xml.data(), xml.size())) return false;
+        for (pugi::xml_node gpu : doc.child("nvidia_smi_log").children("gpu")) {
+            updateField(name, gpu.child("product_name").text().get());
+            unsigned int temperature = 0, utilization = 0;
+            double power = 0.0;
+            parseUnsigned(gpu.child("temperature").child("gpu_temp").text().get(), temperature);
+            parseUnsigned(gpu.child("utilization").child("gpu_util").text().get(), utilization);
+            parseDouble(gpu.child("gpu_power_readings").child("power_draw").text().get(), power);
+            sum += temperature + utilization + power;
+        }
+        fieldQueries.extract(doc, record);
+        return true;
+    }
+};
+
+static std::vector<GpuFieldSpec> fieldSpecs() {
+    std::vector<GpuFieldSpec> specs(3);
+    specs[0].name = "power";
+    specs[0].xpath = "gpu_power_readings/power_draw";
+    specs[1].name = "memory_temp";
+    specs[1].xpath = "temperature/memory_temp";
+    specs[2].name = "pstate";
+    specs[2].xpath = "performance_state";
+    specs[2].isText = true;
+    return specs;
+}
+
+static void testSteadyState(const std::string& xml, size_t initialBytes) {
+    XmlArena arena(initialBytes);
+    GpuFieldQueryCache fieldQueries(fieldSpecs());
+    Tick tick{fieldQueries, GpuFieldRecord(), std::string()};
+    for (int i = 0; i < WARMUP_TICKS; ++i) CHECK(tick.run(arena, xml));
+    size_t highWater = arena.highWaterBytes();
+    unsigned long long arenaCalls = arena.heapCalls();
+
+    heapCalls = 0;
+    counting = true;
+    bool parsed = true;
+    for (int i = 0; i < MEASURED_TICKS; ++i) parsed &= tick.run(arena, xml);
+    counting = false;
+    CHECK(parsed);
+    std::printf("arena of %zu bytes: %llu heap calls in %d ticks, high water %zu bytes\n", initialBytes,
+                heapCalls.load(), MEASURED_TICKS, highWater);
+    CHECK(heapCalls.load() == 0);
+    CHECK(arena.heapCalls() == arenaCalls);
+    CHECK(arena.highWaterBytes() == highWater);
+
+#ifndef PUGIXML_NO_XPATH
+    CHECK(tick.record.gpuCount == 8);
+    CHECK(tick.record.number(0, 0) == 250.5);
+    CHECK(tick.record.text(2, 0) == "P0");
+#endif
+    CHECK(tick.name == "NVIDIA A100-SXM4-80GB");
+}
+
+// The counter itself: without the arena the same parse does go to the heap
+static void testCounterWorks(const std::string& xml) {
+    heapCalls = 0;
+    counting = true;
+    {
+        pugi::xml_document doc;
+        CHECK(doc.load_buffer(xml.data(), xml.size()));
+    }
+    counting = false;
+    CHECK(heapCalls.load() > 0);
+}
+
+int main() {
+    std::string xml = readFile("data/nvidia_smi_8gpu.xml");
+    CHECK(!xml.empty());
+    testCounterWorks(xml);
+    testSteadyState(xml, 128 * 1024);
+    testSteadyState(xml, 4096); // Overflows at first, then the blocks are merged into one
+    return checkResult();
+}
@@ -0,0 +1,196 @@
+#include "thermal_collector.hpp"
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+// Per core files, in the order of readIndex_
+enum CoreFile { CORE_FREQUENCY, CORE_THROTTLE, PACKAGE_THROTTLE, CORE_FILES };
+
+static int openFile(const std::string& path) {
+    return open(path.c_str(), O_RDONLY | O_CLOEXEC);
+}
+
+// Numbered entries of a directory ("cpu12", "thermal_zone3") with that prefix, by number
+static std::vector<int> listNumbered(const std::string& directory, const char* prefix) {
+    std::vector<int> numbers;
+    DIR* dir = opendir(directory.c_str());
+    if (!dir) {
+        return numbers;
+    }
+    const size_t prefixLength = std::strlen(prefix);
+    while (dirent* item = readdir(dir)) {
+        const char* name = item->d_name;
+        if (std::strncmp(name, prefix, prefixLength) != 0) continue;
+        name += prefixLength;
+        if (*name < '0' || *name > '9') continue;
+        int number = 0;
+        for (; *name >= '0' && *name <= '9'; ++name) number = number * 10 + (*name - '0');
+        if (*name == '\0') numbers.push_back(number);
+    }
+    closedir(dir);
+    std::sort(numbers.begin(), numbers.end());
+    return numbers;
+}
+
+// Reads a small file once, without the trailing newline; empty if it cannot be read
+static std::string readOnce(const std::string& path) {
+    char buffer[64];
+    int fd = openFile(path);
+    if (fd < 0) {
+        return "";
+    }
+    ssize_t n = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+    if (n <= 0) return "";
+    while (n > 0 && (buffer[n - 1] == '\n' || buffer[n - 1] == ' ')) --n;
+    return std::string(buffer, static_cast<size_t>(n));
+}
+
+// A signed decimal, thermal zones go below zero
+static long long parseSigned(const char* text, long length) {
+    bool negative = length > 0 && *text == '-';
+    ProcScanner scan(text + (negative ? 1 : 0), static_cast<size_t>(length - (negative ? 1 : 0)));
+    long long value = static_cast<long long>(scan.number());
+    return negative ? -value : value;
+}
+
+ThermalCollector::ThermalCollector(unsigned int periodMs, const std::string& sysRoot)
+    : periodMs_(periodMs), sysRoot_(sysRoot) {}
+
+ThermalCollector::~ThermalCollector() {
+    closeFiles();
+}
+
+void ThermalCollector::closeFiles() {
+    for (std::vector<int>* fds : {&frequencyFds_, &coreThrottleFds_, &packageThrottleFds_, &zoneFds_}) {
+        for (int fd : *fds) {
+            if (fd >= 0) close(fd);
+        }
+        fds->clear();
+    }
+}
+
+void ThermalCollector::rescan() {
+    closeFiles();
+    zones_.clear();
+    dirty_ = false;
+    fresh_ = true;
+
+    const std::string cpuRoot = sysRoot_ + "/devices/system/cpu/cpu";
+    std::vector<int> cpus = listNumbered(sysRoot_ + "/devices/system/cpu", "cpu");
+    if (cpus.size() > THERMAL_MAX_CORES) cpus.resize(THERMAL_MAX_CORES);
+    std::vector<std::string> packages; // Seen physical_package_id values, a handful at most
+    for (int cpu : cpus) {
+        std::string core = cpuRoot + std::to_string(cpu);
+        frequencyFds_.push_back(openFile(core + "/cpufreq/scaling_cur_freq"));
+        coreThrottleFds_.push_back(openFile(core + "/thermal_throttle/core_throttle_count"));
+        // Every core of a package reports the same package count, so only its first one is read
+        int packageFd = -1;
+        std::string package = readOnce(core + "/topology/physical_package_id");
+        if (std::find(packages.begin(), packages.end(), package) == packages.end()) {
+            packages.push_back(package);
+            packageFd = openFile(core + "/thermal_throttle/package_throttle_count");
+        }
+        packageThrottleFds_.push_back(packageFd);
+    }
+    coreThrottles_.assign(cpus.size(), 0);
+    packageThrottles_.assign(cpus.size(), 0);
+
+    const std::string zoneRoot = sysRoot_ + "/class/thermal/thermal_zone";
+    for (int zone : listNumbered(sysRoot_ + "/class/thermal", "thermal_zone")) {
+        std::string directory = zoneRoot + std::to_string(zone);
+        int fd = openFile(directory + "/temp");
+        if (fd < 0) continue;
+        ThermalZoneSample sample;
+        std::string type = readOnce(directory + "/type");
+        std::snprintf(sample.type, sizeof(sample.type), "%s", type.empty() ? "zone" : type.c_str());
+        zoneFds_.push_back(fd);
+        zones_.push_back(sample);
+    }
+}
+
+void ThermalCollector::collect() {
+    if (dirty_) {
+        rescan();
+    }
+    const size_t cores = frequencyFds_.size();
+    const size_t files = cores * CORE_FILES + zoneFds_.size();
+    const std::vector<int>* coreFds[CORE_FILES] = {&frequencyFds_, &coreThrottleFds_, &packageThrottleFds_};
+    buffers_.resize(files * THERMAL_VALUE_BUFFER);
+    readIndex_.assign(files, -1);
+    reader_.clear();
+    for (size_t i = 0; i < files; ++i) {
+        int fd = i < cores * CORE_FILES ? (*coreFds[i / cores])[i % cores] : zoneFds_[i - cores * CORE_FILES];
+        if (fd < 0) continue;
+        readIndex_[i] = static_cast<long>(reader_.add(fd, &buffers_[i * THERMAL_VALUE_BUFFER], THERMAL_VALUE_BUFFER));
+    }
+    reader_.run();
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(now - lastRead_).count();
+    lastRead_ = now;
+
+    // Length read for file i, -1 if it was not read or failed
+    auto length = [this](size_t i) { return readIndex_[i] < 0 ? -1L : reader_.result(static_cast<size_t>(readIndex_[i])); };
+
+    frequencyMhz_.clear();
+    unsigned long long coreThrottles = 0, packageThrottles = 0;
+    for (size_t core = 0; core < cores; ++core) {
+        size_t i = CORE_FREQUENCY * cores + core;
+        long n = length(i);
+        if (n > 0) {
+            frequencyMhz_.push_back(static_cast<double>(parseSigned(&buffers_[i * THERMAL_VALUE_BUFFER], n)) / 1000.0);
+        } else if (frequencyFds_[core] >= 0) {
+            dirty_ = true; // ENODEV: the core went offline, list the cores again
+        }
+        i = CORE_THROTTLE * cores + core;
+        if ((n = length(i)) > 0) {
+            unsigned long long count = static_cast<unsigned long long>(parseSigned(&buffers_[i * THERMAL_VALUE_BUFFER], n));
+            coreThrottles += counterDelta(coreThrottles_[core], count);
+            coreThrottles_[core] = count;
+        }
+        i = PACKAGE_THROTTLE * cores + core;
+        if ((n = length(i)) > 0) {
+            unsigned long long count = static_cast<unsigned long long>(parseSigned(&buffers_[i * THERMAL_VALUE_BUFFER], n));
+            packageThrottles += counterDelta(packageThrottles_[core], count);
+            packageThrottles_[core] = count;
+        }
+    }
+    if (!fresh_ && seconds > 0.0) {
+        coreThrottlesPerSec_ = static_cast<double>(coreThrottles) / seconds;
+        packageThrottlesPerSec_ = static_cast<double>(packageThrottles) / seconds;
+    } else {
+        coreThrottlesPerSec_ = packageThrottlesPerSec_ = 0.0;
+    }
+    fresh_ = false;
+
+    // A zone whose sensor is asleep (ENODATA, EAGAIN) is left out until it answers again
+    readZones_.clear();
+    for (size_t zone = 0; zone < zones_.size(); ++zone) {
+        size_t i = cores * CORE_FILES + zone;
+        long n = length(i);
+        if (n <= 0) continue;
+        zones_[zone].temperature = static_cast<double>(parseSigned(&buffers_[i * THERMAL_VALUE_BUFFER], n)) / 1000.0;
+        readZones_.push_back(zones_[zone]);
+    }
+}
+
+unsigned int ThermalCollector::apply(StatsSnapshot& snapshot) {
+    bool changed = updateField(snapshot.coreThrottlesPerSec, coreThrottlesPerSec_);
+    changed |= updateField(snapshot.packageThrottlesPerSec, packageThrottlesPerSec_);
+    if (snapshot.coreFrequencyMhz != frequencyMhz_) {
+        snapshot.coreFrequencyMhz = frequencyMhz_;
+        changed = true;
+    }
+    if (snapshot.thermalZones != readZones_) {
+        snapshot.thermalZones = readZones_;
+        changed = true;
+    }
+    return changed ? SNAPSHOT_CHANGED_THERMAL : 0;
+}
+
+#endif
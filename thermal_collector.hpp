@@ -0,0 +1,72 @@
+#ifndef STATS_THERMAL_COLLECTOR_HPP
+#define STATS_THERMAL_COLLECTOR_HPP
+
+#ifdef __linux__
+#include <chrono>
+#include <string>
+#include <vector>
+#include "collector_engine.hpp"
+#include "proc_reader.hpp"
+
+#define THERMAL_VALUE_BUFFER 32   // One number per sysfs file
+#define THERMAL_MAX_CORES 8192
+
+/**
+ * CPU clocks, thermal throttling and temperatures from sysfs (Linux).
+ *
+ * Per core: the current frequency (cpufreq/scaling_cur_freq) and, on Intel,
+ * the thermal throttling counters (thermal_throttle/core_throttle_count, and
+ * package_throttle_count once per package). Then the temperature of every
+ * thermal zone (/sys/class/thermal/thermal_zone*). All the files are found
+ * once, kept open and read each tick in one BatchFileReader batch; some
+ * thermal zones take milliseconds to answer, so the reads overlap where
+ * io_uring is available. The tree is listed again only when a read fails,
+ * e.g. after a CPU was taken offline.
+ *
+ * With hundreds of cores the per-core state is kept as one array per field
+ * (file, counter), so a tick walks a few dense arrays instead of a vector
+ * of per-core structs. sysRoot is "/sys" outside of tests.
+ */
+class ThermalCollector : public Collector {
+public:
+    explicit ThermalCollector(unsigned int periodMs, const std::string& sysRoot = "/sys");
+    ~ThermalCollector();
+
+    const char* name() const { return "thermal"; }
+    unsigned int periodMs() const { return periodMs_; }
+    void collect();
+    unsigned int apply(StatsSnapshot& snapshot);
+
+private:
+    void rescan();
+    void closeFiles();
+
+    unsigned int periodMs_;
+    std::string sysRoot_;
+    bool dirty_ = true;
+    bool fresh_ = true;              // No previous throttle counts yet
+    std::chrono::steady_clock::time_point lastRead_;
+
+    // Per core, one entry each, -1 where the core lacks the file
+    std::vector<int> frequencyFds_;
+    std::vector<int> coreThrottleFds_;
+    std::vector<int> packageThrottleFds_;  // Only on the first core of each package
+    std::vector<unsigned long long> coreThrottles_;
+    std::vector<unsigned long long> packageThrottles_;
+    // Per thermal zone
+    std::vector<int> zoneFds_;
+    std::vector<ThermalZoneSample> zones_;     // Type filled in by rescan()
+
+    BatchFileReader reader_;
+    std::vector<char> buffers_;      // THERMAL_VALUE_BUFFER per file read
+    std::vector<long> readIndex_;    // Index in reader_ of each file, per file kind and core, or -1
+
+    std::vector<double> frequencyMhz_;
+    std::vector<ThermalZoneSample> readZones_; // The zones that answered this tick
+    double coreThrottlesPerSec_ = 0.0;
+    double packageThrottlesPerSec_ = 0.0;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,113 @@
+#include <cmath>
+#include "value_parse.hpp"
+
+#define VALUE_MAX_DIGITS 19 // Decimal digits that always fit in an unsigned long long
+
+// Exactly representable powers of ten, for the division that places the decimal point
+static const double kPowersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static std::string_view trim(std::string_view text) {
+    while (!text.empty() && isSpace(text.front())) text.remove_prefix(1);
+    while (!text.empty() && isSpace(text.back())) text.remove_suffix(1);
+    return text;
+}
+
+// The placeholders nvidia-smi prints instead of a value, with or without brackets
+static bool isNotAvailable(std::string_view text) {
+    if (text.size() >= 2 && text.front() == '[' && text.back() == ']') {
+        text = text.substr(1, text.size() - 2);
+    }
+    return text.empty() || text == "N/A" || text == "Not Supported" || text == "Unknown Error" ||
+           text == "Insufficient Permissions" || text == "Not Available" || text == "GPU is lost" ||
+           text == "Requested functionality has been deprecated";
+}
+
+ParsedValue parseValue(std::string_view text) {
+    ParsedValue result;
+    text = trim(text);
+
+    size_t pos = 0;
+    bool negative = false;
+    if (pos < text.size() && (text[pos] == '-' || text[pos] == '+')) {
+        negative = (text[pos] == '-');
+        ++pos;
+    }
+
+    unsigned long long mantissa = 0;
+    int digits = 0;        // Significant digits held in the mantissa
+    int scale = 0;         // Power of ten the mantissa is multiplied by
+    bool anyDigit = false;
+    for (; pos < text.size() && isDigit(text[pos]); ++pos) {
+        anyDigit = true;
+        if (digits < VALUE_MAX_DIGITS) {
+            mantissa = mantissa * 10 + static_cast<unsigned int>(text[pos] - '0');
+            if (mantissa) ++digits;
+        } else {
+            ++scale; // Integer digit past what fits, keep the magnitude
+        }
+    }
+    if (pos < text.size() && text[pos] == '.') {
+        ++pos;
+        for (; pos < text.size() && isDigit(text[pos]); ++pos) {
+            anyDigit = true;
+            if (digits < VALUE_MAX_DIGITS) {
+                mantissa = mantissa * 10 + static_cast<unsigned int>(text[pos] - '0');
+                if (mantissa) ++digits;
+                --scale;
+            } // Fraction digits past what fits are dropped
+        }
+    }
+
+    if (!anyDigit) {
+        result.status = isNotAvailable(text) ? VALUE_NOT_AVAILABLE : VALUE_INVALID;
+        return result;
+    }
+
+    double number = static_cast<double>(mantissa);
+    if (scale < 0) {
+        number = -scale <= 22 ? number / kPowersOfTen[-scale] : number * std::pow(10.0, scale);
+    } else if (scale > 0) {
+        number = scale <= 22 ? number * kPowersOfTen[scale] : number * std::pow(10.0, scale);
+    }
+    result.status = VALUE_OK;
+    result.number = negative ? -number : number;
+    result.unit = trim(text.substr(pos));
+    return result;
+}
+
+bool parseDouble(std::string_view text, double& out) {
+    ParsedValue value = parseValue(text);
+    if (value.status != VALUE_OK) {
+        return false;
+    }
+    out = value.number;
+    return true;
+}
+
+bool parseUnsigned(std::string_view text, unsigned int& out) {
+    ParsedValue value = parseValue(text);
+    if (value.status != VALUE_OK || value.number < 0.0 || value.number > 4294967295.0) {
+        return false;
+    }
+    out = static_cast<unsigned int>(value.number + 0.5);
+    return true;
+}
+
+double memoryUnitToMiB(std::string_view unit) {
+    if (unit == "MiB" || unit == "MB") return 1.0;
+    if (unit == "GiB" || unit == "GB") return 1024.0;
+    if (unit == "KiB" || unit == "KB" || unit == "kB") return 1.0 / 1024.0;
+    if (unit == "B") return 1.0 / (1024.0 * 1024.0);
+    return 0.0;
+}
@@ -0,0 +1,40 @@
+#ifndef STATS_VALUE_PARSE_HPP
+#define STATS_VALUE_PARSE_HPP
+
+#include <string_view>
+
+/**
+ * Parsing of the values nvidia-smi writes, like "60 C", "250.50 W", "81920 MiB" or "N/A".
+ *
+ * Nothing here throws, allocates or looks at the C locale: the decimal separator
+ * is always '.'. Fixed-point decimals are read as an integer mantissa and a
+ * power of ten. Up to 15 significant digits and 22 decimals, which covers
+ * everything nvidia-smi writes, that is one correctly rounded division and
+ * "250.50" gives exactly the double nearest to 250.5, same as strtod. Longer
+ * mantissas are cut to 19 digits and may differ from strtod in the last bits.
+ * Exponents are not accepted, nvidia-smi never writes them.
+ */
+
+enum ValueStatus {
+    VALUE_OK,
+    VALUE_NOT_AVAILABLE, // "N/A", "[N/A]", "Not Supported", "[Unknown Error]", empty, ...
+    VALUE_INVALID        // Anything else that does not start with a number
+};
+
+struct ParsedValue {
+    ValueStatus status = VALUE_INVALID;
+    double number = 0.0;   // Valid when status is VALUE_OK
+    std::string_view unit; // What follows the number, trimmed: "W", "MiB", "%", or empty
+};
+
+// Parses an optionally signed decimal number followed by an optional unit suffix
+ParsedValue parseValue(std::string_view text);
+
+// Shorthands that leave out untouched unless the value parsed
+bool parseDouble(std::string_view text, double& out);
+bool parseUnsigned(std::string_view text, unsigned int& out); // Rounds, rejects negatives
+
+// Multiplier that converts a value in the given unit to MiB, or 0 if it is not a memory unit
+double memoryUnitToMiB(std::string_view unit);
+
+#endif
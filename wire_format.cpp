@@ -0,0 +1,251 @@
+#include "wire_format.hpp"
+#include <cmath>
+
+// Bits of the DELTA frame change mask, one per numeric field
+#define DELTA_CPU        0x01
+#define DELTA_RAM        0x02
+#define DELTA_GPU_TEMP   0x04
+#define DELTA_GPU_TOTAL  0x08
+#define DELTA_GPU_USED   0x10
+#define DELTA_GPU_UTIL   0x20
+
+// ENCODING HELPERS
+
+void putVarint(std::string& out, unsigned long long value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+static void putString(std::string& out, const std::string& s) {
+    putVarint(out, s.size());
+    out.append(s);
+}
+
+// Appends "varint length | body" to out
+static void putFrame(std::string& out, const std::string& body) {
+    putVarint(out, body.size());
+    out.append(body);
+}
+
+unsigned long long FrameReader::getVarint() {
+    unsigned long long value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (p >= end) break;
+        unsigned char byte = *p++;
+        value |= static_cast<unsigned long long>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return value;
+    }
+    ok = false;
+    return 0;
+}
+
+unsigned char FrameReader::getByte() {
+    if (p >= end) { ok = false; return 0; }
+    return *p++;
+}
+
+std::string FrameReader::getString() {
+    unsigned long long len = getVarint();
+    if (!ok || len > static_cast<unsigned long long>(end - p)) { ok = false; return std::string(); }
+    std::string s(reinterpret_cast<const char*>(p), static_cast<size_t>(len));
+    p += len;
+    return s;
+}
+
+// QUANTIZATION
+
+WireSample quantizeSnapshot(const StatsSnapshot& snap) {
+    WireSample s;
+    s.timestampMs = snap.timestampMs;
+    s.cpuCentiPercent = std::llround(snap.cpuUsage * 100.0);
+    s.ramMiB = static_cast<unsigned long long>(std::llround(snap.ramUsage * 1024.0));
+    s.gpuDataAvailable = snap.gpuDataAvailable;
+    if (snap.gpuDataAvailable) {
+        s.gpuName = snap.gpu.name;
+        s.driverVersion = snap.gpu.driverVersion;
+        s.gpuTemperature = snap.gpu.temperature;
+        s.gpuMemoryTotalMiB = static_cast<unsigned long long>(std::llround(snap.gpu.memoryTotal * 1024.0));
+        s.gpuMemoryUsedMiB = static_cast<unsigned long long>(std::llround(snap.gpu.memoryUsed * 1024.0));
+        s.gpuUtilization = snap.gpu.utilizationGpu;
+    }
+    return s;
+}
+
+StatsSnapshot dequantizeSample(const WireSample& sample) {
+    StatsSnapshot snap;
+    snap.timestampMs = sample.timestampMs;
+    snap.cpuUsage = sample.cpuCentiPercent / 100.0;
+    snap.ramUsage = sample.ramMiB / 1024.0;
+    snap.gpuDataAvailable = sample.gpuDataAvailable;
+    if (sample.gpuDataAvailable) {
+        snap.gpu.name = sample.gpuName;
+        snap.gpu.driverVersion = sample.driverVersion;
+        snap.gpu.temperature = static_cast<unsigned int>(sample.gpuTemperature);
+        snap.gpu.memoryTotal = sample.gpuMemoryTotalMiB / 1024.0;
+        snap.gpu.memoryUsed = sample.gpuMemoryUsedMiB / 1024.0;
+        snap.gpu.utilizationGpu = static_cast<unsigned int>(sample.gpuUtilization);
+    }
+    return snap;
+}
+
+// ENCODER
+
+void FrameEncoder::encodeHello(const std::string& hostName, std::string& out) {
+    std::string body;
+    body.push_back(static_cast<char>(WIRE_VERSION));
+    body.push_back(static_cast<char>(WIRE_FRAME_HELLO));
+    putString(body, hostName);
+    putFrame(out, body);
+    havePrevious_ = false;
+}
+
+void FrameEncoder::encodeSample(const StatsSnapshot& snap, std::string& out) {
+    WireSample cur = quantizeSnapshot(snap);
+    std::string body;
+    body.push_back(static_cast<char>(WIRE_VERSION));
+
+    // Strings and the GPU presence are only carried by keyframes, so any change
+    // to them (or a clock going backwards) forces one.
+    bool key = !havePrevious_
+        || cur.timestampMs < previous_.timestampMs
+        || cur.gpuDataAvailable != previous_.gpuDataAvailable
+        || cur.gpuName != previous_.gpuName
+        || cur.driverVersion != previous_.driverVersion;
+
+    if (key) {
+        body.push_back(static_cast<char>(WIRE_FRAME_KEY));
+        putVarint(body, cur.timestampMs);
+        putVarint(body, zigzag(cur.cpuCentiPercent));
+        putVarint(body, cur.ramMiB);
+        body.push_back(cur.gpuDataAvailable ? 1 : 0);
+        if (cur.gpuDataAvailable) {
+            putString(body, cur.gpuName);
+            putString(body, cur.driverVersion);
+            putVarint(body, cur.gpuTemperature);
+            putVarint(body, cur.gpuMemoryTotalMiB);
+            putVarint(body, cur.gpuMemoryUsedMiB);
+            putVarint(body, cur.gpuUtilization);
+        }
+    } else {
+        long long dCpu = cur.cpuCentiPercent - previous_.cpuCentiPercent;
+        long long dRam = static_cast<long long>(cur.ramMiB - previous_.ramMiB);
+        long long dTemp = static_cast<long long>(cur.gpuTemperature - previous_.gpuTemperature);
+        long long dTotal = static_cast<long long>(cur.gpuMemoryTotalMiB - previous_.gpuMemoryTotalMiB);
+        long long dUsed = static_cast<long long>(cur.gpuMemoryUsedMiB - previous_.gpuMemoryUsedMiB);
+        long long dUtil = static_cast<long long>(cur.gpuUtilization - previous_.gpuUtilization);
+
+        unsigned char mask = 0;
+        if (dCpu) mask |= DELTA_CPU;
+        if (dRam) mask |= DELTA_RAM;
+        if (dTemp) mask |= DELTA_GPU_TEMP;
+        if (dTotal) mask |= DELTA_GPU_TOTAL;
+        if (dUsed) mask |= DELTA_GPU_USED;
+        if (dUtil) mask |= DELTA_GPU_UTIL;
+
+        body.push_back(static_cast<char>(WIRE_FRAME_DELTA));
+        putVarint(body, cur.timestampMs - previous_.timestampMs);
+        body.push_back(static_cast<char>(mask));
+        if (mask & DELTA_CPU) putVarint(body, zigzag(dCpu));
+        if (mask & DELTA_RAM) putVarint(body, zigzag(dRam));
+        if (mask & DELTA_GPU_TEMP) putVarint(body, zigzag(dTemp));
+        if (mask & DELTA_GPU_TOTAL) putVarint(body, zigzag(dTotal));
+        if (mask & DELTA_GPU_USED) putVarint(body, zigzag(dUsed));
+        if (mask & DELTA_GPU_UTIL) putVarint(body, zigzag(dUtil));
+    }
+
+    putFrame(out, body);
+    previous_ = cur;
+    havePrevious_ = true;
+}
+
+bool FrameEncoder::encodeSketch(const WireSketch& sketch, std::string& out) {
+    std::string body;
+    body.push_back(static_cast<char>(WIRE_VERSION));
+    body.push_back(static_cast<char>(WIRE_FRAME_SKETCH));
+    putString(body, sketch.metric);
+    putVarint(body, sketch.startMs);
+    putVarint(body, sketch.windowMs);
+    putString(body, sketch.data);
+    if (body.size() > WIRE_MAX_FRAME_SIZE) return false;
+    putFrame(out, body);
+    return true;
+}
+
+// DECODER
+
+FrameDecoder::Result FrameDecoder::decode(const unsigned char* data, size_t size, size_t& consumed) {
+    consumed = 0;
+
+    // Frame length prefix, which may itself be split across reads
+    FrameReader prefix{data, data + size};
+    unsigned long long length = prefix.getVarint();
+    if (!prefix.ok) {
+        return size >= 10 ? CORRUPT : NEED_MORE;
+    }
+    if (length < 2 || length > WIRE_MAX_FRAME_SIZE) return CORRUPT;
+    size_t headerLen = static_cast<size_t>(prefix.p - data);
+    if (size - headerLen < length) return NEED_MORE;
+
+    FrameReader r{prefix.p, prefix.p + length};
+    consumed = headerLen + static_cast<size_t>(length);
+
+    if (r.getByte() != WIRE_VERSION) return CORRUPT;
+    unsigned char type = r.getByte();
+
+    if (type == WIRE_FRAME_HELLO) {
+        std::string host = r.getString();
+        if (!r.ok) return CORRUPT;
+        hostName_ = host;
+        haveKeyframe_ = false;
+        return HELLO;
+    }
+
+    if (type == WIRE_FRAME_SKETCH) {
+        WireSketch sketch;
+        sketch.metric = r.getString();
+        sketch.startMs = r.getVarint();
+        sketch.windowMs = r.getVarint();
+        sketch.data = r.getString();
+        if (!r.ok) return CORRUPT;
+        sketch_ = std::move(sketch);
+        return SKETCH;
+    }
+
+    WireSample next;
+    if (type == WIRE_FRAME_KEY) {
+        next.timestampMs = r.getVarint();
+        next.cpuCentiPercent = unzigzag(r.getVarint());
+        next.ramMiB = r.getVarint();
+        next.gpuDataAvailable = r.getByte() != 0;
+        if (next.gpuDataAvailable) {
+            next.gpuName = r.getString();
+            next.driverVersion = r.getString();
+            next.gpuTemperature = r.getVarint();
+            next.gpuMemoryTotalMiB = r.getVarint();
+            next.gpuMemoryUsedMiB = r.getVarint();
+            next.gpuUtilization = r.getVarint();
+        }
+    } else if (type == WIRE_FRAME_DELTA) {
+        // A delta without the keyframe it refers to cannot be applied
+        if (!haveKeyframe_) return CORRUPT;
+        next = current_;
+        next.timestampMs += r.getVarint();
+        unsigned char mask = r.getByte();
+        if (mask & DELTA_CPU) next.cpuCentiPercent += unzigzag(r.getVarint());
+        if (mask & DELTA_RAM) next.ramMiB += unzigzag(r.getVarint());
+        if (mask & DELTA_GPU_TEMP) next.gpuTemperature += unzigzag(r.getVarint());
+        if (mask & DELTA_GPU_TOTAL) next.gpuMemoryTotalMiB += unzigzag(r.getVarint());
+        if (mask & DELTA_GPU_USED) next.gpuMemoryUsedMiB += unzigzag(r.getVarint());
+        if (mask & DELTA_GPU_UTIL) next.gpuUtilization += unzigzag(r.getVarint());
+    } else {
+        return CORRUPT;
+    }
+
+    if (!r.ok) return CORRUPT;
+    current_ = next;
+    haveKeyframe_ = true;
+    return SAMPLE;
+}
@@ -0,0 +1,124 @@
+#ifndef STATS_WIRE_FORMAT_HPP
+#define STATS_WIRE_FORMAT_HPP
+
+#include <cstddef>
+#include <string>
+#include "snapshot.hpp"
+
+/**
+ * Compact binary frames used between the agent mode and the aggregator.
+ *
+ * Every frame on the stream is:  varint length | u8 version | u8 type | payload
+ *      HELLO - hostname of the agent, sent once per connection.
+ *      KEY   - full sample, including the GPU name/driver strings.
+ *      DELTA - only the fields that changed, as zigzag varint deltas against
+ *              the previous frame, selected by a bit mask.
+ *      SKETCH - quantile sketch of one metric over one rollup window (see
+ *               quantile_sketch.hpp), carried as opaque bytes. Independent of
+ *               the sample chain, so it never forces a keyframe.
+ * Values are quantized before encoding (CPU in 1/100 %, memory in MiB) so the
+ * encoder and decoder keep bit-identical state and deltas never drift.
+ */
+
+#define WIRE_VERSION 2
+#define WIRE_MAX_FRAME_SIZE 4096 // Anything longer is treated as a corrupt stream
+
+enum WireFrameType : unsigned char {
+    WIRE_FRAME_HELLO = 1,
+    WIRE_FRAME_KEY = 2,
+    WIRE_FRAME_DELTA = 3,
+    WIRE_FRAME_SKETCH = 4
+};
+
+// A SKETCH frame's content
+struct WireSketch {
+    std::string metric;               // Snapshot metric name, e.g. "gpu.utilization"
+    unsigned long long startMs = 0;   // Window start, milliseconds since the Unix epoch
+    unsigned long long windowMs = 0;
+    std::string data;                 // QuantileSketch::encode() output
+};
+
+// Sample values as they travel on the wire
+struct WireSample {
+    unsigned long long timestampMs = 0;
+    long long cpuCentiPercent = 0;
+    unsigned long long ramMiB = 0;
+    bool gpuDataAvailable = false;
+    std::string gpuName;
+    std::string driverVersion;
+    unsigned long long gpuTemperature = 0;
+    unsigned long long gpuMemoryTotalMiB = 0;
+    unsigned long long gpuMemoryUsedMiB = 0;
+    unsigned long long gpuUtilization = 0;
+};
+
+// Encoding helpers, shared with the sketch encoding of quantile_sketch.cpp
+void putVarint(std::string& out, unsigned long long value);
+
+// Zigzag maps small negative numbers to small unsigned ones: 0,-1,1,-2 -> 0,1,2,3
+inline unsigned long long zigzag(long long value) {
+    return (static_cast<unsigned long long>(value) << 1) ^ static_cast<unsigned long long>(value >> 63);
+}
+
+inline long long unzigzag(unsigned long long value) {
+    return static_cast<long long>(value >> 1) ^ -static_cast<long long>(value & 1);
+}
+
+// Reader over one frame body, every get* fails once the body is exhausted
+struct FrameReader {
+    const unsigned char* p;
+    const unsigned char* end;
+    bool ok = true;
+
+    unsigned long long getVarint();
+    unsigned char getByte();
+    std::string getString();
+};
+
+WireSample quantizeSnapshot(const StatsSnapshot& snap);
+StatsSnapshot dequantizeSample(const WireSample& sample);
+
+// Turns snapshots into frames, delta-encoded against the last frame it produced
+class FrameEncoder {
+public:
+    // Appends a HELLO frame and resets the delta state, as a new connection needs a keyframe
+    void encodeHello(const std::string& hostName, std::string& out);
+    // Appends a KEY or DELTA frame for this snapshot
+    void encodeSample(const StatsSnapshot& snap, std::string& out);
+    // Appends a SKETCH frame, false (nothing appended) if it would exceed WIRE_MAX_FRAME_SIZE;
+    // the caller narrows the sketch and retries, see AgentSender::encodeClosedSketches()
+    bool encodeSketch(const WireSketch& sketch, std::string& out);
+    // The next sample is sent as a keyframe (e.g. after frames were dropped)
+    void forceKeyframe() { havePrevious_ = false; }
+
+private:
+    WireSample previous_;
+    bool havePrevious_ = false;
+};
+
+// Parses frames back, keeping the per-stream state the deltas refer to
+class FrameDecoder {
+public:
+    enum Result {
+        NEED_MORE,   // Not a whole frame in the buffer yet
+        HELLO,       // hostName() was updated
+        SAMPLE,      // sample() holds a new sample
+        SKETCH,      // sketch() holds a new sketch
+        CORRUPT      // Stream cannot be decoded any further
+    };
+
+    // Decodes the first frame in [data, data + size); consumed is set to its length
+    Result decode(const unsigned char* data, size_t size, size_t& consumed);
+
+    const std::string& hostName() const { return hostName_; }
+    const WireSample& sample() const { return current_; }
+    const WireSketch& sketch() const { return sketch_; }
+
+private:
+    std::string hostName_;
+    WireSample current_;
+    WireSketch sketch_;
+    bool haveKeyframe_ = false;
+};
+
+#endif
@@ -0,0 +1,87 @@
+#include <cstdlib>
+#include <new>
+#include "pugixml.hpp"
+#include "xml_arena.hpp"
+
+#define ARENA_ALIGNMENT 16 // Same guarantee as malloc, pugixml relies on it
+#define ARENA_MAX_OVERFLOW_BLOCKS 16
+
+static thread_local XmlArena* t_activeArena = nullptr;
+
+static void* arenaAllocate(size_t size) {
+    return t_activeArena ? t_activeArena->allocate(size) : std::malloc(size);
+}
+
+static void arenaDeallocate(void* p) {
+    if (t_activeArena && t_activeArena->owns(p)) return; // Freed wholesale on reset
+    std::free(p);
+}
+
+XmlArena::XmlArena(size_t initialBytes) {
+    // Reserved up front so overflowing during a parse does not allocate for the bookkeeping too
+    blocks_.reserve(ARENA_MAX_OVERFLOW_BLOCKS + 1);
+    addBlock(initialBytes);
+}
+
+XmlArena::~XmlArena() {
+    for (Block& block : blocks_) std::free(block.data);
+}
+
+void XmlArena::addBlock(size_t size) {
+    char* data = static_cast<char*>(std::malloc(size));
+    if (!data) throw std::bad_alloc();
+    heapCalls_++;
+    blocks_.push_back({data, size});
+    used_ = 0;
+}
+
+void* XmlArena::allocate(size_t size) {
+    size = (size + ARENA_ALIGNMENT - 1) & ~static_cast<size_t>(ARENA_ALIGNMENT - 1);
+    if (blocks_.back().size - used_ < size) {
+        if (blocks_.size() > ARENA_MAX_OVERFLOW_BLOCKS) return nullptr; // pugixml reports out of memory
+        // Overflow: grow geometrically so even a much bigger document needs few blocks
+        size_t next = blocks_.back().size * 2;
+        addBlock(next > size ? next : size);
+    }
+    void* p = blocks_.back().data + used_;
+    used_ += size;
+    cycleBytes_ += size;
+    return p;
+}
+
+bool XmlArena::owns(const void* p) const {
+    const char* c = static_cast<const char*>(p);
+    for (const Block& block : blocks_) {
+        if (c >= block.data && c < block.data + block.size) return true;
+    }
+    return false;
+}
+
+void XmlArena::reset() {
+    if (cycleBytes_ > highWater_) highWater_ = cycleBytes_;
+    if (blocks_.size() > 1) {
+        // This cycle did not fit: replace all blocks with one that would have held it
+        size_t total = 0;
+        for (Block& block : blocks_) {
+            total += block.size;
+            std::free(block.data);
+            heapCalls_++;
+        }
+        blocks_.clear();
+        addBlock(total > highWater_ ? total : highWater_);
+    }
+    used_ = 0;
+    cycleBytes_ = 0;
+}
+
+XmlArenaScope::XmlArenaScope(XmlArena& arena) : arena_(arena), previous_(t_activeArena) {
+    // The hooks are process-wide, install them once. They fall back to malloc/free outside a scope.
+    static bool installed = (pugi::set_memory_management_functions(arenaAllocate, arenaDeallocate), true);
+    (void)installed;
+    t_activeArena = &arena_;
+}
+
+XmlArenaScope::~XmlArenaScope() {
+    t_activeArena = previous_;
+    arena_.reset();
+}
@@ -0,0 +1,65 @@
+#ifndef STATS_XML_ARENA_HPP
+#define STATS_XML_ARENA_HPP
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * Monotonic arena for the per-tick XML parse.
+ *
+ * pugixml gets its memory through global hooks (set_memory_management_functions).
+ * While an XmlArenaScope is active on a thread, those hooks bump-allocate from
+ * the arena and ignore frees; everything is released at once when the scope
+ * ends. Allocations made outside a scope, or on other threads, still go to
+ * malloc/free.
+ * The arena remembers the most a parse ever needed: if a tick overflowed into
+ * extra blocks, they are merged into one block of the high-water size on reset,
+ * so steady-state ticks make no heap calls at all.
+ */
+class XmlArena {
+public:
+    explicit XmlArena(size_t initialBytes = 128 * 1024);
+    ~XmlArena();
+
+    XmlArena(const XmlArena&) = delete;
+    XmlArena& operator=(const XmlArena&) = delete;
+
+    void* allocate(size_t size);
+    bool owns(const void* p) const;
+    // Releases everything allocated since the last reset
+    void reset();
+
+    size_t highWaterBytes() const { return highWater_; }
+    unsigned long long heapCalls() const { return heapCalls_; } // Blocks malloc'd or freed so far
+
+private:
+    struct Block {
+        char* data;
+        size_t size;
+    };
+
+    void addBlock(size_t size);
+
+    std::vector<Block> blocks_; // The last block is the one being filled
+    size_t used_ = 0;           // Bytes used in the last block
+    size_t cycleBytes_ = 0;     // Bytes handed out since the last reset
+    size_t highWater_ = 0;
+    unsigned long long heapCalls_ = 0;
+};
+
+// Routes pugixml allocations on this thread into the arena for the scope's lifetime.
+// Declare it before the xml_document so the document is destroyed first.
+class XmlArenaScope {
+public:
+    explicit XmlArenaScope(XmlArena& arena);
+    ~XmlArenaScope();
+
+    XmlArenaScope(const XmlArenaScope&) = delete;
+    XmlArenaScope& operator=(const XmlArenaScope&) = delete;
+
+private:
+    XmlArena& arena_;
+    XmlArena* previous_;
+};
+
+#endif